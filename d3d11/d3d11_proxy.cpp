@@ -1,4 +1,7 @@
 #include "d3d11_proxy.h"
+#include "../patches/call_trace.h"
+#include "../patches/frame_timing.h"
+#include "../patches/hook_profiler.h"
 #include "../patches/viewportwidescreenfix.h"
 #include "../patches/texturedump.h"
 #include "../patches/sampleroverride.h"
@@ -109,12 +112,33 @@ static DWORD SafeApplyTextureDumpHooks(ID3D11Device *pDevice,
   }
 }
 
+static DWORD SafeApplyCallTracePatch(ID3D11Device *pDevice,
+                                     ID3D11DeviceContext *pContext) {
+  __try {
+    ApplyCallTracePatch(pDevice, pContext);
+    return 0;
+  } __except (EXCEPTION_EXECUTE_HANDLER) {
+    return GetExceptionCode();
+  }
+}
+
+static DWORD SafeApplyHookProfilerPatch(ID3D11Device *pDevice,
+                                        ID3D11DeviceContext *pContext) {
+  __try {
+    ApplyHookProfilerPatch(pDevice, pContext);
+    return 0;
+  } __except (EXCEPTION_EXECUTE_HANDLER) {
+    return GetExceptionCode();
+  }
+}
+
 // Apply all hooks with SEH protection
 static void ApplyHooksWithProtection(ID3D11Device *pDevice,
                                      ID3D11DeviceContext *pContext) {
   DWORD exCode;
 
-  // Try to apply viewport widescreen fix first (for when upscale is disabled)
+  // Patches sharing a vtable slot run in HookOrder (utils/hook_registry.h),
+  // whatever order they are applied in here
   exCode = SafeApplyViewportWidescreenFixPatch(pDevice, pContext);
   if (exCode != 0) {
     std::cout << "Warning: Viewport widescreen fix hooks failed (0x"
@@ -129,9 +153,6 @@ static void ApplyHooksWithProtection(ID3D11Device *pDevice,
               << std::endl;
   }
 
-  // Apply upscale patch (includes viewport widescreen fix when enabled)
-  // If upscale is enabled, this will overwrite the viewport fix hook but
-  // includes the same logic
   exCode = SafeApplyUpscale4KPatch(pDevice, pContext);
   if (exCode != 0) {
     std::cout << "Warning: Upscale hooks failed (0x" << std::hex << exCode
@@ -144,6 +165,19 @@ static void ApplyHooksWithProtection(ID3D11Device *pDevice,
     std::cout << "Warning: Texture dump hooks failed (0x" << std::hex << exCode
               << std::dec << "), continuing without them" << std::endl;
   }
+
+  exCode = SafeApplyCallTracePatch(pDevice, pContext);
+  if (exCode != 0) {
+    std::cout << "Warning: Call trace hooks failed (0x" << std::hex << exCode
+              << std::dec << "), continuing without them" << std::endl;
+  }
+
+  exCode = SafeApplyHookProfilerPatch(pDevice, pContext);
+  if (exCode != 0) {
+    std::cout << "Warning: Hook profiler hooks failed (0x" << std::hex
+              << exCode << std::dec << "), continuing without them"
+              << std::endl;
+  }
 }
 
 extern "C" {
@@ -189,6 +223,9 @@ HRESULT WINAPI D3D11CreateDeviceAndSwapChain_wrapper(
       *ppImmediateContext) {
     if (g_versionCheckPassed) {
       ApplyHooksWithProtection(*ppDevice, *ppImmediateContext);
+      // Created before the factory hooks went in
+      if (ppSwapChain && *ppSwapChain)
+        HookSwapChainPresent(*ppSwapChain);
     }
   }
   return hr;
@@ -2,6 +2,7 @@
 #include "patches/battleuimenu.h"
 #include "patches/dialog.h"
 #include "patches/fps.h"
+#include "patches/hook_profiler.h"
 #include "patches/misc.h"
 #include "patches/modloader.h"
 #include "patches/pausefix.h"
@@ -80,6 +81,11 @@ DWORD WINAPI MainThread(LPVOID param) {
     return 0;
   }
 
+  // Before any hook it times is installed (mod loader, device)
+  if (settings.GetBool("profile_hooks", false)) {
+    EnableHookProfiler(settings.GetInt("profile_dump_frames", 600));
+  }
+
   // Version check passed - enable patching (set BEFORE InitModLoader to avoid
   // race: if the game creates D3D11 device while mod loader init runs, hooks
   // would be skipped)
@@ -0,0 +1,159 @@
+#define NOMINMAX
+#include "band_hash.h"
+#include "../utils/worker_pool.h"
+#include <algorithm>
+
+namespace {
+struct BandJob {
+  const uint8_t *pData;
+  UINT rowPitch;
+  UINT rowSize;
+  UINT numRows;
+  const size_t *bands; // Band per work item, nullptr = item is the band
+  uint64_t *bandHashes;
+  volatile LONG faulted;
+};
+
+void HashBandItem(void *context, size_t index) {
+  BandJob *job = static_cast<BandJob *>(context);
+  size_t band = job->bands ? job->bands[index] : index;
+  UINT first = (UINT)band * BAND_HASH_ROWS;
+  UINT rows = std::min(BAND_HASH_ROWS, job->numRows - first);
+  __try {
+    job->bandHashes[band] =
+        HashBandRows(job->pData + static_cast<size_t>(first) * job->rowPitch,
+                     job->rowPitch, job->rowSize, rows);
+  } __except (EXCEPTION_EXECUTE_HANDLER) {
+    InterlockedExchange(&job->faulted, 1);
+  }
+}
+} // namespace
+
+uint64_t HashBandRows(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+                      UINT numRows) {
+  uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+  for (UINT row = 0; row < numRows; ++row) {
+    const uint8_t *rowData = pData + static_cast<size_t>(row) * rowPitch;
+    for (UINT i = 0; i < rowSize; ++i) {
+      hash ^= rowData[i];
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+bool HashBands(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+               UINT numRows, const uint8_t *bandMask, uint64_t *bandHashes) {
+  size_t bandCount = (numRows + BAND_HASH_ROWS - 1) / BAND_HASH_ROWS;
+  std::vector<size_t> selected;
+  if (bandMask) {
+    for (size_t b = 0; b < bandCount; ++b) {
+      if (bandMask[b])
+        selected.push_back(b);
+    }
+  }
+
+  BandJob job = {};
+  job.pData = pData;
+  job.rowPitch = rowPitch;
+  job.rowSize = rowSize;
+  job.numRows = numRows;
+  job.bands = bandMask ? selected.data() : nullptr;
+  job.bandHashes = bandHashes;
+  ParallelFor(bandMask ? selected.size() : bandCount, HashBandItem, &job);
+  return job.faulted == 0;
+}
+
+bool HashBandsCombined(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+                       UINT numRows, uint64_t seed, uint64_t *outHash) {
+  std::vector<uint64_t> bandHashes((numRows + BAND_HASH_ROWS - 1) /
+                                   BAND_HASH_ROWS);
+  if (!HashBands(pData, rowPitch, rowSize, numRows, nullptr,
+                 bandHashes.data()))
+    return false;
+  uint64_t hash = seed;
+  for (uint64_t bandHash : bandHashes)
+    hash = CombineBandHash(hash, bandHash);
+  *outHash = hash;
+  return true;
+}
+
+bool HashBuffer(const uint8_t *pData, size_t size, uint64_t seed,
+                uint64_t *outHash) {
+  size_t rows = size / BUFFER_HASH_ROW;
+  size_t tail = size - rows * BUFFER_HASH_ROW;
+  uint64_t hash = seed ^ FlatHashMix((uint64_t)size);
+  if (rows && !HashBandsCombined(pData, BUFFER_HASH_ROW, BUFFER_HASH_ROW,
+                                 (UINT)rows, hash, &hash))
+    return false;
+  if (tail) {
+    __try {
+      hash = CombineBandHash(hash, HashBandRows(pData + rows * BUFFER_HASH_ROW,
+                                                (UINT)tail, (UINT)tail, 1));
+    } __except (EXCEPTION_EXECUTE_HANDLER) {
+      return false;
+    }
+  }
+  *outHash = hash;
+  return true;
+}
+
+BandHashState::BandHashState()
+    : m_height(0), m_numRows(0), m_pixelRowsPerRow(1) {}
+
+void BandHashState::Init(UINT height, UINT numRows, UINT pixelRowsPerRow) {
+  m_height = height;
+  m_numRows = numRows;
+  m_pixelRowsPerRow = pixelRowsPerRow ? pixelRowsPerRow : 1;
+  size_t bands = (numRows + BAND_HASH_ROWS - 1) / BAND_HASH_ROWS;
+  m_bandHashes.assign(bands, 0);
+  m_dirty.assign(bands, 1);
+}
+
+void BandHashState::MarkDirty(UINT top, UINT bottom) {
+  if (m_dirty.empty() || top >= bottom || top >= m_height)
+    return;
+  UINT bandPixels = BAND_HASH_ROWS * m_pixelRowsPerRow;
+  size_t first = top / bandPixels;
+  size_t last = std::min<size_t>((std::min(bottom, m_height) - 1) / bandPixels,
+                                 m_dirty.size() - 1);
+  std::fill(m_dirty.begin() + first, m_dirty.begin() + last + 1, 1);
+}
+
+void BandHashState::MarkAllDirty() {
+  std::fill(m_dirty.begin(), m_dirty.end(), 1);
+}
+
+bool BandHashState::HasDirty() const {
+  return std::find(m_dirty.begin(), m_dirty.end(), 1) != m_dirty.end();
+}
+
+void BandHashState::GetDirtySpans(
+    std::vector<std::pair<UINT, UINT>> *out) const {
+  out->clear();
+  UINT bandPixels = BAND_HASH_ROWS * m_pixelRowsPerRow;
+  for (size_t b = 0; b < m_dirty.size(); ++b) {
+    if (!m_dirty[b])
+      continue;
+    UINT top = (UINT)b * bandPixels;
+    UINT bottom = std::min(top + bandPixels, m_height);
+    if (!out->empty() && out->back().second == top)
+      out->back().second = bottom;
+    else
+      out->push_back(std::make_pair(top, bottom));
+  }
+}
+
+void BandHashState::Refresh(const uint8_t *pData, UINT rowPitch,
+                            UINT rowSize) {
+  HashBands(pData, rowPitch, rowSize, m_numRows, m_dirty.data(),
+            m_bandHashes.data());
+  std::fill(m_dirty.begin(), m_dirty.end(), 0);
+}
+
+uint64_t BandHashState::Combine(uint64_t seed) const {
+  uint64_t hash = seed;
+  for (uint64_t bandHash : m_bandHashes)
+    hash = CombineBandHash(hash, bandHash);
+  return hash;
+}
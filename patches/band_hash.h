@@ -0,0 +1,78 @@
+#pragma once
+#include "../utils/flat_hash.h"
+#include <Windows.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Band hashing for very large textures (the emulator's VRAM surface)
+//
+// Textures of at least BAND_HASH_MIN_PIXELS are hashed as BAND_HASH_ROWS-row
+// bands, each FNV-1a'd on its own and folded into the content hash in band
+// order. A write then costs a rehash of the bands it touched instead of the
+// whole surface. Draws into a band-hashed render target dirty the rows under
+// the viewports set while it is bound; UAV writes and clears dirty all rows.
+
+constexpr UINT BAND_HASH_ROWS = 16; // Rows (block rows for BC) per band
+constexpr uint64_t BAND_HASH_MIN_PIXELS = 2048ull * 2048;
+
+inline bool UsesBandHash(UINT width, UINT height) {
+  return (uint64_t)width * height >= BAND_HASH_MIN_PIXELS;
+}
+
+inline uint64_t CombineBandHash(uint64_t hash, uint64_t bandHash) {
+  return FlatHashMix(hash ^ bandHash);
+}
+
+// FNV-1a over numRows rows of rowSize bytes
+uint64_t HashBandRows(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+                      UINT numRows);
+
+// Hash the bands of a texture (only those with bandMask[b] set, if given)
+// into bandHashes[b], spread across the worker pool. Each band is hashed
+// independently, so the result doesn't depend on the thread count. Returns
+// false if reading the data faulted.
+bool HashBands(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+               UINT numRows, const uint8_t *bandMask, uint64_t *bandHashes);
+
+// Whole-texture band hash: seed folded with every band hash in order
+bool HashBandsCombined(const uint8_t *pData, UINT rowPitch, UINT rowSize,
+                       UINT numRows, uint64_t seed, uint64_t *outHash);
+
+// Hash an arbitrary byte buffer (a replacement file or pack payload) as
+// BUFFER_HASH_ROW-byte rows banded across the worker pool, plus its tail.
+// The size is folded into the seed. Returns false if reading faulted.
+constexpr UINT BUFFER_HASH_ROW = 4096;
+bool HashBuffer(const uint8_t *pData, size_t size, uint64_t seed,
+                uint64_t *outHash);
+
+// Band hashes and dirty bits for one texture. Not thread-safe.
+class BandHashState {
+public:
+  BandHashState();
+
+  // numRows are hash rows; pixelRowsPerRow is 4 for block-compressed formats.
+  // Every band starts dirty.
+  void Init(UINT height, UINT numRows, UINT pixelRowsPerRow);
+
+  // Pixel rows [top, bottom) were written
+  void MarkDirty(UINT top, UINT bottom);
+  void MarkAllDirty();
+  bool HasDirty() const;
+
+  // Dirty pixel rows as [top, bottom) spans, adjacent bands merged
+  void GetDirtySpans(std::vector<std::pair<UINT, UINT>> *out) const;
+
+  // Rehash the dirty bands from a full copy of the texture, clear the bits
+  void Refresh(const uint8_t *pData, UINT rowPitch, UINT rowSize);
+
+  // Content hash: seed folded with every band hash in order
+  uint64_t Combine(uint64_t seed) const;
+
+private:
+  UINT m_height;
+  UINT m_numRows;
+  UINT m_pixelRowsPerRow;
+  std::vector<uint64_t> m_bandHashes;
+  std::vector<uint8_t> m_dirty;
+};
@@ -0,0 +1,113 @@
+#include "bc_cache.h"
+
+BCCache::BCCache() : m_file(INVALID_HANDLE_VALUE), m_end(0) {}
+
+BCCache::~BCCache() { Close(); }
+
+bool BCCache::Open(const std::string &path) {
+  Close();
+  m_offsets.clear();
+
+  m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  if (!Load()) {
+    // Missing, foreign or outdated: start over
+    m_offsets.clear();
+    LARGE_INTEGER zero = {};
+    BCCacheHeader header = {BC_CACHE_MAGIC, BC_CACHE_VERSION};
+    DWORD written = 0;
+    if (!SetFilePointerEx(m_file, zero, nullptr, FILE_BEGIN) ||
+        !SetEndOfFile(m_file) ||
+        !WriteFile(m_file, &header, sizeof(header), &written, nullptr) ||
+        written != sizeof(header)) {
+      Close();
+      return false;
+    }
+    m_end = sizeof(header);
+  }
+  return true;
+}
+
+void BCCache::Close() {
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+  m_end = 0;
+}
+
+bool BCCache::Read(uint64_t key, BCCacheRecord *outRecord,
+                   std::vector<uint8_t> *outData) {
+  auto it = m_offsets.find(key);
+  if (it == m_offsets.end() || m_file == INVALID_HANDLE_VALUE)
+    return false;
+  if (!ReadAt(it->second, outRecord, sizeof(*outRecord)) ||
+      outRecord->key != key)
+    return false;
+  outData->resize((size_t)outRecord->dataSize);
+  return ReadAt(it->second + sizeof(*outRecord), outData->data(),
+                outData->size());
+}
+
+bool BCCache::Append(const BCCacheRecord &record, const uint8_t *data) {
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER pos;
+  pos.QuadPart = (LONGLONG)m_end;
+  DWORD written = 0;
+  if (!SetFilePointerEx(m_file, pos, nullptr, FILE_BEGIN) ||
+      !WriteFile(m_file, &record, sizeof(record), &written, nullptr) ||
+      written != sizeof(record))
+    return false;
+  // Payloads of a few MB at most (a 4096x4096 chain)
+  if (!WriteFile(m_file, data, (DWORD)record.dataSize, &written, nullptr) ||
+      written != record.dataSize) {
+    SetFilePointerEx(m_file, pos, nullptr, FILE_BEGIN);
+    SetEndOfFile(m_file);
+    return false;
+  }
+  m_offsets[record.key] = m_end;
+  m_end += sizeof(record) + record.dataSize;
+  return true;
+}
+
+bool BCCache::Load() {
+  LARGE_INTEGER size;
+  BCCacheHeader header = {};
+  if (!GetFileSizeEx(m_file, &size) ||
+      (uint64_t)size.QuadPart < sizeof(header) ||
+      !ReadAt(0, &header, sizeof(header)) || header.magic != BC_CACHE_MAGIC ||
+      header.version != BC_CACHE_VERSION)
+    return false;
+
+  uint64_t fileSize = (uint64_t)size.QuadPart;
+  uint64_t offset = sizeof(header);
+  BCCacheRecord record;
+  while (offset + sizeof(record) <= fileSize &&
+         ReadAt(offset, &record, sizeof(record)) &&
+         record.dataSize <= fileSize - offset - sizeof(record)) {
+    m_offsets[record.key] = offset; // Later records win
+    offset += sizeof(record) + record.dataSize;
+  }
+
+  if (offset != fileSize) {
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)offset;
+    SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN);
+    SetEndOfFile(m_file);
+  }
+  m_end = offset;
+  return true;
+}
+
+bool BCCache::ReadAt(uint64_t offset, void *out, size_t size) {
+  LARGE_INTEGER pos;
+  pos.QuadPart = (LONGLONG)offset;
+  DWORD read = 0;
+  return SetFilePointerEx(m_file, pos, nullptr, FILE_BEGIN) &&
+         ReadFile(m_file, out, (DWORD)size, &read, nullptr) &&
+         read == size;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Persistent cache of block-compressed replacements (mods/textures.bccache)
+//
+// Layout: BCCacheHeader | { BCCacheRecord | payload }[] (appended as
+// replacements are encoded). Keyed by a hash of the source pixels and the
+// encode settings, so an edited replacement simply misses and is appended
+// again. Loaded into a key -> offset map at startup; payloads are read on a
+// hit. A partial record at the end (crash mid-append) is cut off on open.
+
+constexpr uint32_t BC_CACHE_MAGIC = 0x43424643; // "CFBC"
+constexpr uint32_t BC_CACHE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct BCCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct BCCacheRecord {
+  uint64_t key;
+  uint32_t format; // DXGI_FORMAT of the payload (linear BC1/BC3/BC7)
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  uint64_t dataSize; // Tightly packed mip chain that follows the record
+};
+#pragma pack(pop)
+
+// Not thread-safe; callers serialize access.
+class BCCache {
+public:
+  BCCache();
+  ~BCCache();
+
+  // Load (or create) the cache file and keep it open for reads and appends
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return m_file != INVALID_HANDLE_VALUE; }
+
+  // Read a cached chain. Returns false on a miss or a failed read.
+  bool Read(uint64_t key, BCCacheRecord *outRecord,
+            std::vector<uint8_t> *outData);
+  // Persist an encoded chain
+  bool Append(const BCCacheRecord &record, const uint8_t *data);
+
+  size_t Size() const { return m_offsets.size(); }
+
+private:
+  bool Load();
+  bool ReadAt(uint64_t offset, void *out, size_t size);
+
+  HANDLE m_file;
+  uint64_t m_end; // Offset the next record is appended at
+  std::unordered_map<uint64_t, uint64_t> m_offsets; // key -> record offset
+};
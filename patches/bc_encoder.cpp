@@ -0,0 +1,449 @@
+#include "bc_encoder.h"
+#include "../utils/worker_pool.h"
+#include <cstring>
+
+namespace {
+// Block rows per worker pool item
+constexpr UINT BLOCK_ROWS_PER_ITEM = 4;
+
+// BC7 4-bit index interpolation weights (out of 64)
+const int BC7_WEIGHTS4[16] = {0,  4,  9,  13, 17, 21, 26, 30,
+                              34, 38, 43, 47, 51, 55, 60, 64};
+
+// A 4x4 block as RGBA texels
+struct Block {
+  uint8_t texels[16][4];
+};
+
+void LoadBlock(const uint8_t *pixels, UINT width, UINT height, bool bgra,
+               UINT blockX, UINT blockY, Block *block) {
+  int r = bgra ? 2 : 0;
+  int b = bgra ? 0 : 2;
+  for (UINT y = 0; y < 4; ++y) {
+    UINT sy = blockY * 4 + y;
+    if (sy >= height)
+      sy = height - 1;
+    for (UINT x = 0; x < 4; ++x) {
+      UINT sx = blockX * 4 + x;
+      if (sx >= width)
+        sx = width - 1;
+      const uint8_t *p = pixels + ((size_t)sy * width + sx) * 4;
+      uint8_t *t = block->texels[y * 4 + x];
+      t[0] = p[r];
+      t[1] = p[1];
+      t[2] = p[b];
+      t[3] = p[3];
+    }
+  }
+}
+
+// Principal axis of the first `channels` channels by power iteration on the
+// covariance matrix. Returns false for a (near) uniform block.
+bool PrincipalAxis(const Block &block, int channels, float axis[4]) {
+  float mean[4] = {};
+  for (int i = 0; i < 16; ++i)
+    for (int c = 0; c < channels; ++c)
+      mean[c] += block.texels[i][c];
+  for (int c = 0; c < channels; ++c)
+    mean[c] /= 16.0f;
+
+  float cov[4][4] = {};
+  for (int i = 0; i < 16; ++i) {
+    float d[4];
+    for (int c = 0; c < channels; ++c)
+      d[c] = block.texels[i][c] - mean[c];
+    for (int r = 0; r < channels; ++r)
+      for (int c = 0; c < channels; ++c)
+        cov[r][c] += d[r] * d[c];
+  }
+
+  // Start from the covariance row of the widest channel; a fixed start
+  // vector can be orthogonal to the axis when channels are anti-correlated
+  int widest = 0;
+  for (int c = 1; c < channels; ++c)
+    if (cov[c][c] > cov[widest][widest])
+      widest = c;
+  float v[4];
+  for (int c = 0; c < 4; ++c)
+    v[c] = cov[widest][c];
+  for (int iter = 0; iter < 8; ++iter) {
+    float w[4] = {};
+    float largest = 0.0f;
+    for (int r = 0; r < channels; ++r) {
+      for (int c = 0; c < channels; ++c)
+        w[r] += cov[r][c] * v[c];
+      float mag = w[r] < 0 ? -w[r] : w[r];
+      if (mag > largest)
+        largest = mag;
+    }
+    if (largest < 1e-4f)
+      return false;
+    for (int c = 0; c < channels; ++c)
+      v[c] = w[c] / largest;
+  }
+  for (int c = 0; c < 4; ++c)
+    axis[c] = c < channels ? v[c] : 0.0f;
+  return true;
+}
+
+// Indices of the texels with the lowest and highest projection on axis
+void AxisExtremes(const Block &block, const float axis[4], int *outMin,
+                  int *outMax) {
+  float lo = 0.0f, hi = 0.0f;
+  *outMin = *outMax = 0;
+  for (int i = 0; i < 16; ++i) {
+    const uint8_t *t = block.texels[i];
+    float d = t[0] * axis[0] + t[1] * axis[1] + t[2] * axis[2] +
+              t[3] * axis[3];
+    if (i == 0 || d < lo) {
+      lo = d;
+      *outMin = i;
+    }
+    if (i == 0 || d > hi) {
+      hi = d;
+      *outMax = i;
+    }
+  }
+}
+
+int ColorDistance(const uint8_t *a, const int *b, int channels) {
+  int sum = 0;
+  for (int c = 0; c < channels; ++c) {
+    int d = a[c] - b[c];
+    sum += d * d;
+  }
+  return sum;
+}
+
+// ============================================================================
+// BC1 / BC3
+// ============================================================================
+
+uint16_t Pack565(const uint8_t *rgb) {
+  return (uint16_t)((((rgb[0] * 31 + 127) / 255) << 11) |
+                    (((rgb[1] * 63 + 127) / 255) << 5) |
+                    ((rgb[2] * 31 + 127) / 255));
+}
+
+void Unpack565(uint16_t c, int *rgb) {
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four-colour BC1 block (color0 > color1), as also used by BC3
+void EncodeColorBlock(const Block &block, uint8_t *out) {
+  uint16_t c0, c1;
+  float axis[4];
+  if (PrincipalAxis(block, 3, axis)) {
+    int lo, hi;
+    AxisExtremes(block, axis, &lo, &hi);
+    c0 = Pack565(block.texels[hi]);
+    c1 = Pack565(block.texels[lo]);
+  } else {
+    c0 = c1 = Pack565(block.texels[0]);
+  }
+  if (c0 < c1) {
+    uint16_t tmp = c0;
+    c0 = c1;
+    c1 = tmp;
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][3];
+    Unpack565(c0, palette[0]);
+    Unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; ++i) {
+      int best = 0;
+      int bestDist = ColorDistance(block.texels[i], palette[0], 3);
+      for (int p = 1; p < 4; ++p) {
+        int dist = ColorDistance(block.texels[i], palette[p], 3);
+        if (dist < bestDist) {
+          bestDist = dist;
+          best = p;
+        }
+      }
+      indices |= (uint32_t)best << (i * 2);
+    }
+  }
+  memcpy(out, &c0, 2);
+  memcpy(out + 2, &c1, 2);
+  memcpy(out + 4, &indices, 4);
+}
+
+// Eight-alpha BC3 alpha block (alpha0 = max, alpha1 = min)
+void EncodeAlphaBlock(const Block &block, uint8_t *out) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; ++i) {
+    int a = block.texels[i][3];
+    if (a > a0)
+      a0 = a;
+    if (a < a1)
+      a1 = a;
+  }
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    int palette[8] = {a0, a1};
+    for (int p = 2; p < 8; ++p)
+      palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+    for (int i = 0; i < 16; ++i) {
+      int a = block.texels[i][3];
+      int best = 0;
+      int bestDist = 256;
+      for (int p = 0; p < 8; ++p) {
+        int d = a > palette[p] ? a - palette[p] : palette[p] - a;
+        if (d < bestDist) {
+          bestDist = d;
+          best = p;
+        }
+      }
+      indices |= (uint64_t)best << (i * 3);
+    }
+  }
+  out[0] = (uint8_t)a0;
+  out[1] = (uint8_t)a1;
+  for (int i = 0; i < 6; ++i)
+    out[2 + i] = (uint8_t)(indices >> (i * 8));
+}
+
+// ============================================================================
+// BC7 (mode 6: one subset, RGBA 7.7.7.7 endpoints + unique p-bit, 4-bit
+// indices)
+// ============================================================================
+
+// Quantize an endpoint to 7 bits per channel plus a shared p-bit, choosing
+// the p-bit with the lower error
+void QuantizeEndpoint(const int *e, int *q, int *pbit) {
+  int bestErr = -1;
+  for (int p = 0; p < 2; ++p) {
+    int candidate[4];
+    int err = 0;
+    for (int c = 0; c < 4; ++c) {
+      int v = (e[c] - p + 1) >> 1;
+      if (v < 0)
+        v = 0;
+      if (v > 127)
+        v = 127;
+      candidate[c] = v;
+      int d = ((v << 1) | p) - e[c];
+      err += d * d;
+    }
+    if (bestErr < 0 || err < bestErr) {
+      bestErr = err;
+      *pbit = p;
+      memcpy(q, candidate, sizeof(candidate));
+    }
+  }
+}
+
+// Quantized mode 6 endpoints and indices for one block
+struct BC7Fit {
+  int q[2][4];
+  int pbit[2];
+  int indices[16];
+  int error;
+};
+
+// Quantize the endpoints and pick the nearest palette entry per texel
+void FitBC7(const Block &block, const int e0[4], const int e1[4],
+            BC7Fit *fit) {
+  QuantizeEndpoint(e0, fit->q[0], &fit->pbit[0]);
+  QuantizeEndpoint(e1, fit->q[1], &fit->pbit[1]);
+
+  int endpoints[2][4];
+  for (int e = 0; e < 2; ++e)
+    for (int c = 0; c < 4; ++c)
+      endpoints[e][c] = (fit->q[e][c] << 1) | fit->pbit[e];
+  int palette[16][4];
+  for (int i = 0; i < 16; ++i)
+    for (int c = 0; c < 4; ++c)
+      palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * endpoints[0][c] +
+                       BC7_WEIGHTS4[i] * endpoints[1][c] + 32) >>
+                      6;
+
+  fit->error = 0;
+  for (int i = 0; i < 16; ++i) {
+    int best = 0;
+    int bestDist = ColorDistance(block.texels[i], palette[0], 4);
+    for (int p = 1; p < 16 && bestDist; ++p) {
+      int dist = ColorDistance(block.texels[i], palette[p], 4);
+      if (dist < bestDist) {
+        bestDist = dist;
+        best = p;
+      }
+    }
+    fit->indices[i] = best;
+    fit->error += bestDist;
+  }
+}
+
+// Least-squares endpoints for the weights chosen by a previous fit. Returns
+// false when every texel uses the same weight.
+bool RefitBC7Endpoints(const Block &block, const BC7Fit &fit, int e0[4],
+                       int e1[4]) {
+  float a = 0.0f, b = 0.0f, c = 0.0f;
+  float r0[4] = {}, r1[4] = {};
+  for (int i = 0; i < 16; ++i) {
+    float t = BC7_WEIGHTS4[fit.indices[i]] / 64.0f;
+    float s = 1.0f - t;
+    a += s * s;
+    b += s * t;
+    c += t * t;
+    for (int ch = 0; ch < 4; ++ch) {
+      r0[ch] += s * block.texels[i][ch];
+      r1[ch] += t * block.texels[i][ch];
+    }
+  }
+  float det = a * c - b * b;
+  if (det < 1e-3f)
+    return false;
+  for (int ch = 0; ch < 4; ++ch) {
+    float v0 = (c * r0[ch] - b * r1[ch]) / det;
+    float v1 = (a * r1[ch] - b * r0[ch]) / det;
+    e0[ch] = v0 < 0.0f ? 0 : v0 > 255.0f ? 255 : (int)(v0 + 0.5f);
+    e1[ch] = v1 < 0.0f ? 0 : v1 > 255.0f ? 255 : (int)(v1 + 0.5f);
+  }
+  return true;
+}
+
+class BitWriter {
+public:
+  explicit BitWriter(uint8_t *out) : m_out(out), m_pos(0) {
+    memset(out, 0, 16);
+  }
+  void Put(uint32_t value, int bits) {
+    for (int i = 0; i < bits; ++i, ++m_pos)
+      if (value & (1u << i))
+        m_out[m_pos >> 3] |= (uint8_t)(1u << (m_pos & 7));
+  }
+
+private:
+  uint8_t *m_out;
+  int m_pos;
+};
+
+void EncodeBC7Block(const Block &block, uint8_t *out) {
+  int lo = 0, hi = 0;
+  float axis[4];
+  if (PrincipalAxis(block, 4, axis))
+    AxisExtremes(block, axis, &lo, &hi);
+
+  int e0[4], e1[4];
+  for (int c = 0; c < 4; ++c) {
+    e0[c] = block.texels[lo][c];
+    e1[c] = block.texels[hi][c];
+  }
+  BC7Fit fit;
+  FitBC7(block, e0, e1, &fit);
+
+  // One least-squares refinement pass, kept only if it lowers the error
+  if (fit.error && RefitBC7Endpoints(block, fit, e0, e1)) {
+    BC7Fit refit;
+    FitBC7(block, e0, e1, &refit);
+    if (refit.error < fit.error)
+      fit = refit;
+  }
+
+  // The anchor (texel 0) index has an implicit zero MSB
+  if (fit.indices[0] & 8) {
+    for (int c = 0; c < 4; ++c) {
+      int tmp = fit.q[0][c];
+      fit.q[0][c] = fit.q[1][c];
+      fit.q[1][c] = tmp;
+    }
+    int tmp = fit.pbit[0];
+    fit.pbit[0] = fit.pbit[1];
+    fit.pbit[1] = tmp;
+    for (int i = 0; i < 16; ++i)
+      fit.indices[i] = 15 - fit.indices[i];
+  }
+
+  BitWriter bits(out);
+  bits.Put(1u << 6, 7); // Mode 6
+  for (int c = 0; c < 4; ++c) {
+    bits.Put(fit.q[0][c], 7);
+    bits.Put(fit.q[1][c], 7);
+  }
+  bits.Put(fit.pbit[0], 1);
+  bits.Put(fit.pbit[1], 1);
+  bits.Put(fit.indices[0], 3);
+  for (int i = 1; i < 16; ++i)
+    bits.Put(fit.indices[i], 4);
+}
+
+struct EncodeJob {
+  const uint8_t *pixels;
+  UINT width;
+  UINT height;
+  bool bgra;
+  DXGI_FORMAT format;
+  uint8_t *out;
+  UINT blocksWide;
+  UINT blocksHigh;
+  UINT blockBytes;
+};
+
+void EncodeItem(void *context, size_t index) {
+  const EncodeJob &job = *static_cast<const EncodeJob *>(context);
+  UINT first = (UINT)index * BLOCK_ROWS_PER_ITEM;
+  UINT last = first + BLOCK_ROWS_PER_ITEM;
+  if (last > job.blocksHigh)
+    last = job.blocksHigh;
+  Block block;
+  for (UINT by = first; by < last; ++by) {
+    uint8_t *out = job.out + (size_t)by * job.blocksWide * job.blockBytes;
+    for (UINT bx = 0; bx < job.blocksWide; ++bx, out += job.blockBytes) {
+      LoadBlock(job.pixels, job.width, job.height, job.bgra, bx, by, &block);
+      switch (job.format) {
+      case DXGI_FORMAT_BC1_UNORM:
+        EncodeColorBlock(block, out);
+        break;
+      case DXGI_FORMAT_BC3_UNORM:
+        EncodeAlphaBlock(block, out);
+        EncodeColorBlock(block, out + 8);
+        break;
+      default:
+        EncodeBC7Block(block, out);
+        break;
+      }
+    }
+  }
+}
+} // namespace
+
+bool IsOpaqueLevel(const uint8_t *pixels, UINT width, UINT height) {
+  size_t count = (size_t)width * height;
+  for (size_t i = 0; i < count; ++i)
+    if (pixels[i * 4 + 3] != 255)
+      return false;
+  return true;
+}
+
+bool EncodeBCLevel(const uint8_t *pixels, UINT width, UINT height, bool bgra,
+                   DXGI_FORMAT format, uint8_t *outBlocks) {
+  if (format != DXGI_FORMAT_BC1_UNORM && format != DXGI_FORMAT_BC3_UNORM &&
+      format != DXGI_FORMAT_BC7_UNORM)
+    return false;
+  if (width == 0 || height == 0)
+    return false;
+
+  EncodeJob job;
+  job.pixels = pixels;
+  job.width = width;
+  job.height = height;
+  job.bgra = bgra;
+  job.format = format;
+  job.out = outBlocks;
+  job.blocksWide = (width + 3) / 4;
+  job.blocksHigh = (height + 3) / 4;
+  job.blockBytes = format == DXGI_FORMAT_BC1_UNORM ? 8 : 16;
+  ParallelFor((job.blocksHigh + BLOCK_ROWS_PER_ITEM - 1) / BLOCK_ROWS_PER_ITEM,
+              EncodeItem, &job);
+  return true;
+}
@@ -0,0 +1,24 @@
+// BC Encoder - fast BC1/BC3/BC7 compression of 32bpp replacement textures
+#pragma once
+
+#include <d3d11.h>
+#include <cstdint>
+
+// Block-compressed output chosen for replacements (texture_replace_compress)
+enum class BCMode {
+  Off = 0,
+  BC1BC3 = 1, // BC1 for fully opaque textures, BC3 otherwise
+  BC7 = 2,
+};
+
+// True if every texel of a tightly packed 32bpp level is fully opaque
+bool IsOpaqueLevel(const uint8_t *pixels, UINT width, UINT height);
+
+// Encode a tightly packed RGBA8 (or BGRA8 when bgra) level into `format`
+// (BC1_UNORM, BC3_UNORM or BC7_UNORM) at outBlocks, sized per GetRowLayout.
+// Edge blocks of levels that aren't a multiple of 4 repeat the last texel.
+// Block rows are spread across the worker pool. Fast, single-pass encoders:
+// principal-axis endpoints for BC1/BC3 colour, min/max alpha for BC3, and
+// BC7 mode 6 only with one least-squares endpoint refit.
+bool EncodeBCLevel(const uint8_t *pixels, UINT width, UINT height, bool bgra,
+                   DXGI_FORMAT format, uint8_t *outBlocks);
@@ -0,0 +1,458 @@
+#include "call_trace.h"
+#include "../utils/hook_registry.h"
+#include "../utils/settings.h"
+#include "frame_timing.h"
+#include "resource_table.h"
+#include <Windows.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+// Written on Present, or sooner once this much is buffered
+constexpr size_t TRACE_FLUSH_BYTES = 1024 * 1024;
+// D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT
+constexpr UINT TRACE_MAX_VIEWS = 128;
+
+volatile LONG g_traceActive = 0;
+HANDLE g_traceFile = INVALID_HANDLE_VALUE;
+UINT g_traceFrames = 0;
+uint64_t g_frame = 0; // Render thread only
+
+// Records not yet written, and the textures already described. Both
+// guarded by g_traceCS; file writes are serialized by g_traceFileCS so
+// they happen outside g_traceCS.
+std::vector<uint8_t> g_traceBuffer;
+std::unordered_set<void *> g_describedTextures;
+CRITICAL_SECTION g_traceCS;
+CRITICAL_SECTION g_traceFileCS;
+
+void WriteTraceFile(const std::vector<uint8_t> &data) {
+  const uint8_t *p = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    DWORD written = 0;
+    if (!WriteFile(g_traceFile, p, (DWORD)left, &written, NULL) ||
+        written == 0)
+      return;
+    p += written;
+    left -= written;
+  }
+}
+
+void FlushTrace() {
+  std::vector<uint8_t> pending;
+  EnterCriticalSection(&g_traceFileCS);
+  EnterCriticalSection(&g_traceCS);
+  pending.swap(g_traceBuffer);
+  LeaveCriticalSection(&g_traceCS);
+  if (g_traceFile != INVALID_HANDLE_VALUE)
+    WriteTraceFile(pending);
+  LeaveCriticalSection(&g_traceFileCS);
+}
+
+// Payload is a followed by b
+void AppendRecord(TraceRecordType type, TraceStage stage, const void *a,
+                  size_t aSize, const void *b = nullptr, size_t bSize = 0) {
+  TraceRecordHeader header = {};
+  header.type = type;
+  header.stage = stage;
+  header.size = (uint32_t)(aSize + bSize);
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  header.ticks = (uint64_t)now.QuadPart;
+
+  EnterCriticalSection(&g_traceCS);
+  const uint8_t *h = (const uint8_t *)&header;
+  g_traceBuffer.insert(g_traceBuffer.end(), h, h + sizeof(header));
+  if (aSize)
+    g_traceBuffer.insert(g_traceBuffer.end(), (const uint8_t *)a,
+                         (const uint8_t *)a + aSize);
+  if (bSize)
+    g_traceBuffer.insert(g_traceBuffer.end(), (const uint8_t *)b,
+                         (const uint8_t *)b + bSize);
+  bool flush = g_traceBuffer.size() >= TRACE_FLUSH_BYTES;
+  LeaveCriticalSection(&g_traceCS);
+  if (flush)
+    FlushTrace();
+}
+
+TraceTextureDesc ToTraceDesc(const D3D11_TEXTURE2D_DESC &desc) {
+  TraceTextureDesc out;
+  out.width = desc.Width;
+  out.height = desc.Height;
+  out.mipLevels = desc.MipLevels;
+  out.arraySize = desc.ArraySize;
+  out.format = (uint32_t)desc.Format;
+  out.sampleCount = desc.SampleDesc.Count;
+  out.sampleQuality = desc.SampleDesc.Quality;
+  out.usage = (uint32_t)desc.Usage;
+  out.bindFlags = desc.BindFlags;
+  out.cpuAccessFlags = desc.CPUAccessFlags;
+  out.miscFlags = desc.MiscFlags;
+  return out;
+}
+
+// Trace id of pResource, described first if it hasn't been (or always,
+// with force: a new texture at an address that was used before)
+uint64_t DescribeTexture(ID3D11Resource *pResource, bool force = false) {
+  if (!pResource)
+    return 0;
+  EnterCriticalSection(&g_traceCS);
+  bool isNew = g_describedTextures.insert(pResource).second;
+  LeaveCriticalSection(&g_traceCS);
+
+  uint64_t id = (uint64_t)(uintptr_t)pResource;
+  if (isNew || force) {
+    TraceTexture texture = {};
+    texture.id = id;
+    D3D11_TEXTURE2D_DESC desc;
+    if (GetTexture2DDesc(pResource, &desc))
+      texture.desc = ToTraceDesc(desc);
+    AppendRecord(TRACE_TEXTURE, TRACE_STAGE_GAME, &texture, sizeof(texture));
+  }
+  return id;
+}
+
+uint64_t DescribeView(ID3D11View *pView) {
+  if (!pView)
+    return 0;
+  ID3D11Resource *pResource = nullptr;
+  pView->GetResource(&pResource);
+  uint64_t id = DescribeTexture(pResource);
+  if (pResource)
+    pResource->Release();
+  return id;
+}
+
+TraceBox ToTraceBox(const D3D11_BOX *pBox) {
+  TraceBox box = {};
+  if (pBox) {
+    box.left = pBox->left;
+    box.top = pBox->top;
+    box.front = pBox->front;
+    box.right = pBox->right;
+    box.bottom = pBox->bottom;
+    box.back = pBox->back;
+  }
+  return box;
+}
+
+void RecordShaderResources(TraceStage stage, UINT StartSlot, UINT NumViews,
+                           ID3D11ShaderResourceView *const *ppViews) {
+  uint32_t header[2] = {StartSlot, 0};
+  uint64_t ids[TRACE_MAX_VIEWS];
+  if (ppViews) {
+    header[1] = NumViews < TRACE_MAX_VIEWS ? NumViews : TRACE_MAX_VIEWS;
+    for (uint32_t i = 0; i < header[1]; ++i)
+      ids[i] = DescribeView(ppViews[i]);
+  }
+  AppendRecord(TRACE_SHADER_RESOURCES, stage, header, sizeof(header), ids,
+               sizeof(uint64_t) * header[1]);
+}
+
+void RecordViewports(TraceStage stage, UINT count,
+                     const D3D11_VIEWPORT *pViewports) {
+  uint32_t header = pViewports ? count : 0;
+  // Same layout as D3D11_VIEWPORT
+  AppendRecord(TRACE_VIEWPORTS, stage, &header, sizeof(header), pViewports,
+               sizeof(TraceViewport) * header);
+}
+
+void RecordCopyRegion(TraceStage stage, ID3D11Resource *pDstResource,
+                      UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
+                      ID3D11Resource *pSrcResource, UINT SrcSubresource,
+                      const D3D11_BOX *pSrcBox) {
+  TraceCopyRegion copy = {};
+  copy.dst = DescribeTexture(pDstResource);
+  copy.dstSubresource = DstSubresource;
+  copy.dstX = DstX;
+  copy.dstY = DstY;
+  copy.dstZ = DstZ;
+  copy.src = DescribeTexture(pSrcResource);
+  copy.srcSubresource = SrcSubresource;
+  copy.hasBox = pSrcBox != nullptr;
+  copy.box = ToTraceBox(pSrcBox);
+  AppendRecord(TRACE_COPY_REGION, stage, &copy, sizeof(copy));
+}
+
+void RecordCreateTexture(TraceStage stage, const D3D11_TEXTURE2D_DESC *pDesc,
+                         const D3D11_SUBRESOURCE_DATA *pInitialData) {
+  TraceCreateTexture create = {};
+  if (pDesc)
+    create.desc = ToTraceDesc(*pDesc);
+  create.hasInitialData = pInitialData != nullptr;
+  AppendRecord(TRACE_CREATE_TEXTURE, stage, &create, sizeof(create));
+}
+
+// Game-side handlers run first (HOOK_ORDER_TRACE_GAME); driver-side ones
+// last (HOOK_ORDER_TRACE_DRIVER), after every rewrite
+
+void Trace_PSSetShaderResources(
+    const PSSetShaderResourcesHook::Next &next, ID3D11DeviceContext *This,
+    UINT StartSlot, UINT NumViews,
+    ID3D11ShaderResourceView *const *ppShaderResourceViews) {
+  if (g_traceActive)
+    RecordShaderResources(TRACE_STAGE_GAME, StartSlot, NumViews,
+                          ppShaderResourceViews);
+  next(This, StartSlot, NumViews, ppShaderResourceViews);
+}
+
+void TraceOut_PSSetShaderResources(
+    const PSSetShaderResourcesHook::Next &next, ID3D11DeviceContext *This,
+    UINT StartSlot, UINT NumViews,
+    ID3D11ShaderResourceView *const *ppShaderResourceViews) {
+  if (g_traceActive)
+    RecordShaderResources(TRACE_STAGE_DRIVER, StartSlot, NumViews,
+                          ppShaderResourceViews);
+  next(This, StartSlot, NumViews, ppShaderResourceViews);
+}
+
+void Trace_RSSetViewports(const RSSetViewportsHook::Next &next,
+                          ID3D11DeviceContext *This, UINT NumViewports,
+                          D3D11_VIEWPORT *pViewports) {
+  if (g_traceActive)
+    RecordViewports(TRACE_STAGE_GAME, NumViewports, pViewports);
+  next(This, NumViewports, pViewports);
+}
+
+void TraceOut_RSSetViewports(const RSSetViewportsHook::Next &next,
+                             ID3D11DeviceContext *This, UINT NumViewports,
+                             D3D11_VIEWPORT *pViewports) {
+  if (g_traceActive)
+    RecordViewports(TRACE_STAGE_DRIVER, NumViewports, pViewports);
+  next(This, NumViewports, pViewports);
+}
+
+void Trace_CopySubresourceRegion(const CopySubresourceRegionHook::Next &next,
+                                 ID3D11DeviceContext *This,
+                                 ID3D11Resource *pDstResource,
+                                 UINT DstSubresource, UINT DstX, UINT DstY,
+                                 UINT DstZ, ID3D11Resource *pSrcResource,
+                                 UINT SrcSubresource,
+                                 const D3D11_BOX *pSrcBox) {
+  if (g_traceActive)
+    RecordCopyRegion(TRACE_STAGE_GAME, pDstResource, DstSubresource, DstX,
+                     DstY, DstZ, pSrcResource, SrcSubresource, pSrcBox);
+  next(This, pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource,
+       SrcSubresource, pSrcBox);
+}
+
+void TraceOut_CopySubresourceRegion(
+    const CopySubresourceRegionHook::Next &next, ID3D11DeviceContext *This,
+    ID3D11Resource *pDstResource, UINT DstSubresource, UINT DstX, UINT DstY,
+    UINT DstZ, ID3D11Resource *pSrcResource, UINT SrcSubresource,
+    const D3D11_BOX *pSrcBox) {
+  if (g_traceActive)
+    RecordCopyRegion(TRACE_STAGE_DRIVER, pDstResource, DstSubresource, DstX,
+                     DstY, DstZ, pSrcResource, SrcSubresource, pSrcBox);
+  next(This, pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource,
+       SrcSubresource, pSrcBox);
+}
+
+HRESULT Trace_CreateTexture2D(const CreateTexture2DHook::Next &next,
+                              ID3D11Device *This,
+                              const D3D11_TEXTURE2D_DESC *pDesc,
+                              const D3D11_SUBRESOURCE_DATA *pInitialData,
+                              ID3D11Texture2D **ppTexture2D) {
+  if (!g_traceActive)
+    return next(This, pDesc, pInitialData, ppTexture2D);
+
+  RecordCreateTexture(TRACE_STAGE_GAME, pDesc, pInitialData);
+  HRESULT hr = next(This, pDesc, pInitialData, ppTexture2D);
+  if (SUCCEEDED(hr) && ppTexture2D && *ppTexture2D)
+    DescribeTexture(*ppTexture2D, true);
+  return hr;
+}
+
+HRESULT TraceOut_CreateTexture2D(const CreateTexture2DHook::Next &next,
+                                 ID3D11Device *This,
+                                 const D3D11_TEXTURE2D_DESC *pDesc,
+                                 const D3D11_SUBRESOURCE_DATA *pInitialData,
+                                 ID3D11Texture2D **ppTexture2D) {
+  if (g_traceActive)
+    RecordCreateTexture(TRACE_STAGE_DRIVER, pDesc, pInitialData);
+  return next(This, pDesc, pInitialData, ppTexture2D);
+}
+
+void Trace_OMSetRenderTargets(
+    const OMSetRenderTargetsHook::Next &next, ID3D11DeviceContext *This,
+    UINT NumViews, ID3D11RenderTargetView *const *ppRenderTargetViews,
+    ID3D11DepthStencilView *pDepthStencilView) {
+  if (g_traceActive) {
+    uint32_t count = 0;
+    uint64_t ids[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+    if (ppRenderTargetViews) {
+      count = NumViews < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT
+                  ? NumViews
+                  : D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT;
+      for (uint32_t i = 0; i < count; ++i)
+        ids[i] = DescribeView(ppRenderTargetViews[i]);
+    }
+    AppendRecord(TRACE_RENDER_TARGETS, TRACE_STAGE_GAME, &count,
+                 sizeof(count), ids, sizeof(uint64_t) * count);
+  }
+  next(This, NumViews, ppRenderTargetViews, pDepthStencilView);
+}
+
+void Trace_CopyResource(const CopyResourceHook::Next &next,
+                        ID3D11DeviceContext *This,
+                        ID3D11Resource *pDstResource,
+                        ID3D11Resource *pSrcResource) {
+  if (g_traceActive) {
+    TraceCopyResource copy;
+    copy.dst = DescribeTexture(pDstResource);
+    copy.src = DescribeTexture(pSrcResource);
+    AppendRecord(TRACE_COPY_RESOURCE, TRACE_STAGE_GAME, &copy, sizeof(copy));
+  }
+  next(This, pDstResource, pSrcResource);
+}
+
+void Trace_UpdateSubresource(const UpdateSubresourceHook::Next &next,
+                             ID3D11DeviceContext *This,
+                             ID3D11Resource *pDstResource,
+                             UINT DstSubresource, const D3D11_BOX *pDstBox,
+                             const void *pSrcData, UINT SrcRowPitch,
+                             UINT SrcDepthPitch) {
+  if (g_traceActive) {
+    TraceUpdateSubresource update;
+    update.dst = DescribeTexture(pDstResource);
+    update.dstSubresource = DstSubresource;
+    update.hasBox = pDstBox != nullptr;
+    update.box = ToTraceBox(pDstBox);
+    update.rowPitch = SrcRowPitch;
+    update.depthPitch = SrcDepthPitch;
+    AppendRecord(TRACE_UPDATE_SUBRESOURCE, TRACE_STAGE_GAME, &update,
+                 sizeof(update));
+  }
+  next(This, pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch,
+       SrcDepthPitch);
+}
+
+HRESULT Trace_Map(const MapHook::Next &next, ID3D11DeviceContext *This,
+                  ID3D11Resource *pResource, UINT Subresource,
+                  D3D11_MAP MapType, UINT MapFlags,
+                  D3D11_MAPPED_SUBRESOURCE *pMappedResource) {
+  HRESULT hr =
+      next(This, pResource, Subresource, MapType, MapFlags, pMappedResource);
+  if (g_traceActive) {
+    TraceMap map;
+    map.resource = DescribeTexture(pResource);
+    map.subresource = Subresource;
+    map.mapType = (uint32_t)MapType;
+    map.mapFlags = MapFlags;
+    map.hr = (int32_t)hr;
+    AppendRecord(TRACE_MAP, TRACE_STAGE_GAME, &map, sizeof(map));
+  }
+  return hr;
+}
+
+void OnPresent() {
+  if (!g_traceActive)
+    return;
+
+  TraceFrame frame = {g_frame++};
+  AppendRecord(TRACE_FRAME, TRACE_STAGE_GAME, &frame, sizeof(frame));
+  if (g_frame < g_traceFrames) {
+    FlushTrace();
+    return;
+  }
+
+  // Handlers stay registered but record nothing from here on
+  InterlockedExchange(&g_traceActive, 0);
+  FlushTrace();
+  EnterCriticalSection(&g_traceFileCS);
+  CloseHandle(g_traceFile);
+  g_traceFile = INVALID_HANDLE_VALUE;
+  LeaveCriticalSection(&g_traceFileCS);
+  std::cout << "[Mod] Call trace: recorded " << g_frame
+            << " frames to crossfix.trace" << std::endl;
+}
+
+std::string GetTracePath() {
+  char exePath[MAX_PATH];
+  if (GetModuleFileNameA(NULL, exePath, MAX_PATH) != 0) {
+    std::string exePathStr(exePath);
+    size_t lastBackslash = exePathStr.find_last_of("\\/");
+    if (lastBackslash != std::string::npos)
+      return exePathStr.substr(0, lastBackslash + 1) + "crossfix.trace";
+  }
+  return "crossfix.trace";
+}
+} // namespace
+
+void ApplyCallTracePatch(ID3D11Device *pDevice,
+                         ID3D11DeviceContext *pContext) {
+  if (!pDevice || !pContext)
+    return;
+
+  static volatile LONG applied = 0;
+  if (InterlockedCompareExchange(&applied, 1, 0) != 0)
+    return;
+
+  Settings settings;
+  settings.Load(Settings::GetSettingsPath());
+  if (!settings.GetBool("trace_record", false))
+    return;
+  int frames = settings.GetInt("trace_record_frames", 600);
+  if (frames <= 0)
+    return;
+
+  g_traceFile = CreateFileA(GetTracePath().c_str(), GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (g_traceFile == INVALID_HANDLE_VALUE) {
+    std::cout << "[Mod] Warning: can't create crossfix.trace, call trace "
+                 "disabled"
+              << std::endl;
+    return;
+  }
+
+  InitializeCriticalSection(&g_traceCS);
+  InitializeCriticalSection(&g_traceFileCS);
+  g_traceFrames = (UINT)frames;
+
+  TraceFileHeader header = {};
+  memcpy(header.magic, "CFXTRACE", sizeof(header.magic));
+  header.version = TRACE_FILE_VERSION;
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  header.tickFrequency = (uint64_t)frequency.QuadPart;
+  const uint8_t *h = (const uint8_t *)&header;
+  g_traceBuffer.assign(h, h + sizeof(header));
+
+  if (!AddPresentCallback(pDevice, OnPresent)) {
+    CloseHandle(g_traceFile);
+    g_traceFile = INVALID_HANDLE_VALUE;
+    return;
+  }
+  InterlockedExchange(&g_traceActive, 1);
+
+  PSSetShaderResourcesHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                                     Trace_PSSetShaderResources);
+  PSSetShaderResourcesHook::Register(pContext, HOOK_ORDER_TRACE_DRIVER,
+                                     TraceOut_PSSetShaderResources);
+  RSSetViewportsHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                               Trace_RSSetViewports);
+  RSSetViewportsHook::Register(pContext, HOOK_ORDER_TRACE_DRIVER,
+                               TraceOut_RSSetViewports);
+  CopySubresourceRegionHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                                      Trace_CopySubresourceRegion);
+  CopySubresourceRegionHook::Register(pContext, HOOK_ORDER_TRACE_DRIVER,
+                                      TraceOut_CopySubresourceRegion);
+  CreateTexture2DHook::Register(pDevice, HOOK_ORDER_TRACE_GAME,
+                                Trace_CreateTexture2D);
+  CreateTexture2DHook::Register(pDevice, HOOK_ORDER_TRACE_DRIVER,
+                                TraceOut_CreateTexture2D);
+  OMSetRenderTargetsHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                                   Trace_OMSetRenderTargets);
+  CopyResourceHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                             Trace_CopyResource);
+  UpdateSubresourceHook::Register(pContext, HOOK_ORDER_TRACE_GAME,
+                                  Trace_UpdateSubresource);
+  MapHook::Register(pContext, HOOK_ORDER_TRACE_GAME, Trace_Map);
+
+  std::cout << "[Mod] Call trace: recording " << frames
+            << " frames to crossfix.trace" << std::endl;
+}
@@ -0,0 +1,141 @@
+// Call Trace - records hooked D3D11 calls to crossfix.trace
+#pragma once
+#include <cstdint>
+#include <d3d11.h>
+
+// With trace_record=1 the hooked context and device calls are written to
+// crossfix.trace next to the executable for trace_record_frames frames.
+// Calls CrossFix rewrites (viewports, copy boxes, bind-time replacements,
+// texture creation) are recorded twice: as the game made them and as they
+// were passed on to D3D, so the rewrites can be checked and replayed
+// without the game. CrossFix's own texture creations are recorded too.
+//
+// Textures are identified by address. A TRACE_TEXTURE record describes one
+// before the first record that uses it, and again after a successful
+// TRACE_CREATE_TEXTURE (the new texture may reuse a freed address).
+//
+// Layout: TraceFileHeader, then records, each a TraceRecordHeader followed
+// by `size` bytes of payload. Little-endian, no padding.
+
+constexpr uint32_t TRACE_FILE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct TraceFileHeader {
+  char magic[8]; // "CFXTRACE"
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t tickFrequency; // TraceRecordHeader::ticks per second
+};
+
+enum TraceRecordType : uint16_t {
+  TRACE_FRAME = 1,          // TraceFrame, at each Present
+  TRACE_TEXTURE,            // TraceTexture
+  TRACE_CREATE_TEXTURE,     // TraceCreateTexture
+  TRACE_VIEWPORTS,          // uint32 count, count x TraceViewport
+  TRACE_COPY_REGION,        // TraceCopyRegion
+  TRACE_COPY_RESOURCE,      // TraceCopyResource
+  TRACE_UPDATE_SUBRESOURCE, // TraceUpdateSubresource (no texel data)
+  TRACE_MAP,                // TraceMap
+  TRACE_RENDER_TARGETS,     // uint32 count, count x uint64 texture id
+  TRACE_SHADER_RESOURCES,   // uint32 startSlot, count, count x uint64 id
+};
+
+enum TraceStage : uint8_t {
+  TRACE_STAGE_GAME = 0,   // As the game (or CrossFix itself) made the call
+  TRACE_STAGE_DRIVER = 1, // As CrossFix passed it on to D3D
+};
+
+struct TraceRecordHeader {
+  uint16_t type;
+  uint8_t stage;
+  uint8_t reserved;
+  uint32_t size;
+  uint64_t ticks; // QueryPerformanceCounter
+};
+
+struct TraceFrame {
+  uint64_t frame;
+};
+
+// D3D11_TEXTURE2D_DESC; all zero for resources that aren't 2D textures
+struct TraceTextureDesc {
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  uint32_t arraySize;
+  uint32_t format;
+  uint32_t sampleCount;
+  uint32_t sampleQuality;
+  uint32_t usage;
+  uint32_t bindFlags;
+  uint32_t cpuAccessFlags;
+  uint32_t miscFlags;
+};
+
+struct TraceTexture {
+  uint64_t id;
+  TraceTextureDesc desc;
+};
+
+// The texture that was created, if any, follows as a TRACE_TEXTURE
+struct TraceCreateTexture {
+  TraceTextureDesc desc;
+  uint32_t hasInitialData;
+};
+
+struct TraceViewport {
+  float topLeftX;
+  float topLeftY;
+  float width;
+  float height;
+  float minDepth;
+  float maxDepth;
+};
+
+// D3D11_BOX
+struct TraceBox {
+  uint32_t left;
+  uint32_t top;
+  uint32_t front;
+  uint32_t right;
+  uint32_t bottom;
+  uint32_t back;
+};
+
+struct TraceCopyRegion {
+  uint64_t dst;
+  uint32_t dstSubresource;
+  uint32_t dstX;
+  uint32_t dstY;
+  uint32_t dstZ;
+  uint64_t src;
+  uint32_t srcSubresource;
+  uint32_t hasBox;
+  TraceBox box;
+};
+
+struct TraceCopyResource {
+  uint64_t dst;
+  uint64_t src;
+};
+
+struct TraceUpdateSubresource {
+  uint64_t dst;
+  uint32_t dstSubresource;
+  uint32_t hasBox;
+  TraceBox box;
+  uint32_t rowPitch;
+  uint32_t depthPitch;
+};
+
+struct TraceMap {
+  uint64_t resource;
+  uint32_t subresource;
+  uint32_t mapType;
+  uint32_t mapFlags;
+  int32_t hr;
+};
+#pragma pack(pop)
+
+// Start recording if trace_record is set
+void ApplyCallTracePatch(ID3D11Device *pDevice, ID3D11DeviceContext *pContext);
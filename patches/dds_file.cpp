@@ -0,0 +1,186 @@
+#include "dds_file.h"
+#include <cstring>
+
+namespace {
+constexpr DWORD DDSCAPS2_CUBEMAP = 0x200;
+constexpr DWORD DDSCAPS2_VOLUME = 0x200000;
+constexpr DWORD DX10_MISC_TEXTURECUBE = 0x4;
+constexpr UINT MAX_DDS_DIMENSION = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+
+// Levels in a full chain down to 1x1
+UINT GetFullMipCount(UINT width, UINT height) {
+  UINT levels = 1;
+  UINT size = width > height ? width : height;
+  while (size > 1) {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+} // namespace
+
+bool ParseDDS(const uint8_t *file, size_t size, DDSImage *outImage) {
+  if (!file || size < sizeof(DDSHeader))
+    return false;
+  DDSHeader header;
+  memcpy(&header, file, sizeof(header));
+  if (header.dwMagic != DDS_MAGIC || header.dwWidth == 0 ||
+      header.dwHeight == 0 || header.dwWidth > MAX_DDS_DIMENSION ||
+      header.dwHeight > MAX_DDS_DIMENSION ||
+      (header.dwCaps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)))
+    return false;
+
+  size_t dataOffset = sizeof(DDSHeader);
+  DXGI_FORMAT format;
+  if ((header.ddspf.dwFlags & 0x4) && // DDPF_FOURCC
+      header.ddspf.dwFourCC == DDS_FOURCC_DX10) {
+    if (size < sizeof(DDSHeader) + sizeof(DDSHeaderDX10))
+      return false;
+    DDSHeaderDX10 dx10;
+    memcpy(&dx10, file + sizeof(DDSHeader), sizeof(dx10));
+    if (dx10.resourceDimension != D3D11_RESOURCE_DIMENSION_TEXTURE2D ||
+        dx10.arraySize > 1 || (dx10.miscFlag & DX10_MISC_TEXTURECUBE))
+      return false;
+    format = static_cast<DXGI_FORMAT>(dx10.dxgiFormat);
+    dataOffset += sizeof(DDSHeaderDX10);
+  } else {
+    format = GetDDSHeaderFormat(header);
+  }
+
+  // Some writers leave the count at 0 or 1 for a single level, and older
+  // dumps declared the source's count while writing only mip 0; the caller
+  // loads whichever declared levels are actually present.
+  UINT mipLevels = header.dwMipMapCount > 1 ? header.dwMipMapCount : 1;
+  UINT fullChain = GetFullMipCount(header.dwWidth, header.dwHeight);
+  if (mipLevels > fullChain)
+    mipLevels = fullChain;
+
+  outImage->format = format;
+  outImage->width = header.dwWidth;
+  outImage->height = header.dwHeight;
+  outImage->mipLevels = mipLevels;
+  outImage->data = file + dataOffset;
+  outImage->dataSize = size - dataOffset;
+  return true;
+}
+
+DXGI_FORMAT GetDDSHeaderFormat(const DDSHeader &header) {
+  const auto &pf = header.ddspf;
+  if (pf.dwFlags & 0x4) { // DDPF_FOURCC
+    switch (pf.dwFourCC) {
+    case 0x31545844: // "DXT1"
+      return DXGI_FORMAT_BC1_UNORM;
+    case 0x33545844: // "DXT3"
+      return DXGI_FORMAT_BC2_UNORM;
+    case 0x35545844: // "DXT5"
+      return DXGI_FORMAT_BC3_UNORM;
+    default:
+      return DXGI_FORMAT_UNKNOWN;
+    }
+  }
+  if (pf.dwRGBBitCount == 32 && pf.dwRBitMask == 0x000000FF &&
+      pf.dwBBitMask == 0x00FF0000)
+    return DXGI_FORMAT_R8G8B8A8_UNORM;
+  if (pf.dwRGBBitCount == 32 && pf.dwRBitMask == 0x00FF0000 &&
+      pf.dwBBitMask == 0x000000FF)
+    return DXGI_FORMAT_B8G8R8A8_UNORM;
+  if (pf.dwRGBBitCount == 16 && pf.dwABitMask == 0xF000 &&
+      pf.dwRBitMask == 0x0F00)
+    return DXGI_FORMAT_B4G4R4A4_UNORM;
+  if (pf.dwRGBBitCount == 16 && pf.dwRBitMask == 0x00FF &&
+      pf.dwGBitMask == 0xFF00)
+    return DXGI_FORMAT_R8G8_UNORM;
+  if (pf.dwRGBBitCount == 8 && pf.dwRBitMask == 0xFF)
+    return DXGI_FORMAT_R8_UNORM;
+  return DXGI_FORMAT_UNKNOWN;
+}
+
+bool GetRowLayout(DXGI_FORMAT format, UINT width, UINT height, UINT *rowPitch,
+                  UINT *numRows) {
+  UINT bytesPerPixel = 0;
+  UINT bytesPerBlock = 0;
+
+  switch (format) {
+  case DXGI_FORMAT_R8G8B8A8_UNORM:
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case DXGI_FORMAT_B8G8R8A8_UNORM:
+  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    bytesPerPixel = 4;
+    break;
+  case DXGI_FORMAT_B4G4R4A4_UNORM:
+    bytesPerPixel = 2;
+    break;
+  case DXGI_FORMAT_R8_UNORM:
+    bytesPerPixel = 1;
+    break;
+  case DXGI_FORMAT_R8G8_UNORM:
+    bytesPerPixel = 2;
+    break;
+  case DXGI_FORMAT_BC1_UNORM:
+  case DXGI_FORMAT_BC1_UNORM_SRGB:
+    bytesPerBlock = 8;
+    break;
+  case DXGI_FORMAT_BC2_UNORM:
+  case DXGI_FORMAT_BC2_UNORM_SRGB:
+  case DXGI_FORMAT_BC3_UNORM:
+  case DXGI_FORMAT_BC3_UNORM_SRGB:
+  case DXGI_FORMAT_BC7_UNORM:
+  case DXGI_FORMAT_BC7_UNORM_SRGB:
+    bytesPerBlock = 16;
+    break;
+  default:
+    return false;
+  }
+
+  if (bytesPerBlock) {
+    *rowPitch = ((width + 3) / 4) * bytesPerBlock;
+    *numRows = (height + 3) / 4;
+  } else {
+    *rowPitch = width * bytesPerPixel;
+    *numRows = height;
+  }
+  return true;
+}
+
+DXGI_FORMAT GetLinearFormat(DXGI_FORMAT format) {
+  switch (format) {
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    return DXGI_FORMAT_R8G8B8A8_UNORM;
+  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    return DXGI_FORMAT_B8G8R8A8_UNORM;
+  case DXGI_FORMAT_BC1_UNORM_SRGB:
+    return DXGI_FORMAT_BC1_UNORM;
+  case DXGI_FORMAT_BC2_UNORM_SRGB:
+    return DXGI_FORMAT_BC2_UNORM;
+  case DXGI_FORMAT_BC3_UNORM_SRGB:
+    return DXGI_FORMAT_BC3_UNORM;
+  case DXGI_FORMAT_BC7_UNORM_SRGB:
+    return DXGI_FORMAT_BC7_UNORM;
+  default:
+    return format;
+  }
+}
+
+UINT GetMipChainLayout(const uint8_t *data, size_t dataSize,
+                       DXGI_FORMAT format, UINT width, UINT height,
+                       UINT mipLevels, D3D11_SUBRESOURCE_DATA *outLevels) {
+  if (mipLevels > D3D11_REQ_MIP_LEVELS)
+    mipLevels = D3D11_REQ_MIP_LEVELS;
+  size_t offset = 0;
+  UINT level = 0;
+  for (; level < mipLevels; ++level) {
+    UINT rowPitch, numRows;
+    if (!GetRowLayout(format, width, height, &rowPitch, &numRows))
+      return 0;
+    size_t levelSize = static_cast<size_t>(rowPitch) * numRows;
+    if (levelSize > dataSize - offset)
+      break;
+    outLevels[level].pSysMem = data + offset;
+    outLevels[level].SysMemPitch = rowPitch;
+    outLevels[level].SysMemSlicePitch = static_cast<UINT>(levelSize);
+    offset += levelSize;
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+  return level;
+}
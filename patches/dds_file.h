@@ -0,0 +1,82 @@
+// DDS File - header parsing and mip chain layout for DDS replacements
+#pragma once
+
+#include <d3d11.h>
+#include <cstddef>
+#include <cstdint>
+
+constexpr DWORD DDS_MAGIC = 0x20534444;       // "DDS "
+constexpr DWORD DDS_FOURCC_DX10 = 0x30315844; // "DX10"
+
+#pragma pack(push, 1)
+struct DDSHeader {
+  DWORD dwMagic; // "DDS "
+  DWORD dwSize;  // 124
+  DWORD dwFlags;
+  DWORD dwHeight;
+  DWORD dwWidth;
+  DWORD dwPitchOrLinearSize;
+  DWORD dwDepth;
+  DWORD dwMipMapCount;
+  DWORD dwReserved1[11];
+  struct {
+    DWORD dwSize; // 32
+    DWORD dwFlags;
+    DWORD dwFourCC;
+    DWORD dwRGBBitCount;
+    DWORD dwRBitMask;
+    DWORD dwGBitMask;
+    DWORD dwBBitMask;
+    DWORD dwABitMask;
+  } ddspf;
+  DWORD dwCaps;
+  DWORD dwCaps2;
+  DWORD dwCaps3;
+  DWORD dwCaps4;
+  DWORD dwReserved2;
+};
+
+// Follows DDSHeader when its FourCC is "DX10"
+struct DDSHeaderDX10 {
+  DWORD dxgiFormat;
+  DWORD resourceDimension; // 3 = D3D11_RESOURCE_DIMENSION_TEXTURE2D
+  DWORD miscFlag;          // 0x4 = cube map
+  DWORD arraySize;
+  DWORD miscFlags2;
+};
+#pragma pack(pop)
+
+// A parsed DDS file. Points into the caller's buffer (e.g. a mapped view).
+struct DDSImage {
+  DXGI_FORMAT format; // UNKNOWN when the header doesn't identify one
+  UINT width;
+  UINT height;
+  UINT mipLevels;      // As declared (1 if the header has no mip count)
+  const uint8_t *data; // First byte of mip 0
+  size_t dataSize;     // Bytes from mip 0 to the end of the file
+};
+
+// Parse the legacy header and, if present, the DX10 extended header. Only
+// single 2D textures are accepted (no cube maps, arrays or volumes). The
+// payload is not validated here, since its size depends on the format.
+bool ParseDDS(const uint8_t *file, size_t size, DDSImage *outImage);
+
+// Identify the DXGI format described by a legacy DDS pixel format.
+// Returns DXGI_FORMAT_UNKNOWN when the header doesn't say (e.g. the "DXI "
+// FourCC written by older dumps in place of a DX10 header for BC7).
+DXGI_FORMAT GetDDSHeaderFormat(const DDSHeader &header);
+
+// Row layout of one mip of a supported replacement format.
+// Block-compressed formats report block rows (4 pixel rows each).
+bool GetRowLayout(DXGI_FORMAT format, UINT width, UINT height, UINT *rowPitch,
+                  UINT *numRows);
+
+// Strip the _SRGB variant so formats can be compared by memory layout
+DXGI_FORMAT GetLinearFormat(DXGI_FORMAT format);
+
+// Point outLevels (D3D11_REQ_MIP_LEVELS entries) at each mip of a tightly
+// packed chain stored as `format`, for up to mipLevels levels. Returns the
+// number of levels fully present in the data; 0 if not even mip 0 is.
+UINT GetMipChainLayout(const uint8_t *data, size_t dataSize,
+                       DXGI_FORMAT format, UINT width, UINT height,
+                       UINT mipLevels, D3D11_SUBRESOURCE_DATA *outLevels);
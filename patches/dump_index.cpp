@@ -0,0 +1,163 @@
+#include "dump_index.h"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+// Every folder the dumper writes to (see InitializeDumpPath)
+const char *const DUMP_FOLDERS[] = {"BGRA4",
+                                    "BGRA8",
+                                    "RGBA8",
+                                    "BC1_DXT1",
+                                    "BC2_DXT3",
+                                    "BC3_DXT5",
+                                    "BC7",
+                                    "transparent",
+                                    "rendertargets",
+                                    "rendertargets\\transparent",
+                                    "regions",
+                                    "other"};
+
+// Parse "WIDTHxHEIGHT_<16hex>.dds"
+bool ParseDumpFilename(const char *name, DumpIndexRecord *out) {
+  char *end = nullptr;
+  unsigned long w = strtoul(name, &end, 10);
+  if (!end || *end != 'x')
+    return false;
+  unsigned long h = strtoul(end + 1, &end, 10);
+  if (!end || *end != '_')
+    return false;
+  const char *hex = end + 1;
+  uint64_t hash = 0;
+  for (int i = 0; i < 16; i++) {
+    int nibble;
+    if (hex[i] >= '0' && hex[i] <= '9')
+      nibble = hex[i] - '0';
+    else if (hex[i] >= 'a' && hex[i] <= 'f')
+      nibble = hex[i] - 'a' + 10;
+    else if (hex[i] >= 'A' && hex[i] <= 'F')
+      nibble = hex[i] - 'A' + 10;
+    else
+      return false;
+    hash = (hash << 4) | (uint64_t)nibble;
+  }
+  if (_stricmp(hex + 16, ".dds") != 0)
+    return false;
+  out->hash = hash;
+  out->width = (uint32_t)w;
+  out->height = (uint32_t)h;
+  return true;
+}
+} // namespace
+
+DumpIndex::DumpIndex() : m_file(INVALID_HANDLE_VALUE) {}
+
+DumpIndex::~DumpIndex() { Close(); }
+
+bool DumpIndex::Open(const std::string &dumpPath) {
+  Close();
+  m_hashes.Clear();
+
+  std::string indexPath = dumpPath + "\\index.bin";
+  LARGE_INTEGER recordsEnd = {};
+  bool loaded = Load(indexPath, &recordsEnd);
+
+  // Written sequentially from the end of the last whole record
+  m_file = CreateFileA(indexPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+                       nullptr, loaded ? OPEN_EXISTING : CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  if (loaded) {
+    // Drop a trailing partial record so appends stay record-aligned
+    if (!SetFilePointerEx(m_file, recordsEnd, nullptr, FILE_BEGIN) ||
+        !SetEndOfFile(m_file)) {
+      Close();
+      return false;
+    }
+  } else {
+    DumpIndexHeader header = {DUMP_INDEX_MAGIC, DUMP_INDEX_VERSION};
+    DWORD written = 0;
+    WriteFile(m_file, &header, sizeof(header), &written, nullptr);
+    Rebuild(dumpPath);
+  }
+  return true;
+}
+
+void DumpIndex::Close() {
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+}
+
+void DumpIndex::Append(uint64_t hash, uint32_t width, uint32_t height) {
+  m_hashes.Insert(hash);
+  DumpIndexRecord record = {hash, width, height};
+  WriteRecord(record);
+}
+
+bool DumpIndex::Load(const std::string &indexPath,
+                     LARGE_INTEGER *recordsEnd) {
+  HANDLE file = CreateFileA(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  DumpIndexHeader header = {};
+  DWORD read = 0;
+  bool ok = GetFileSizeEx(file, &size) &&
+            (uint64_t)size.QuadPart >= sizeof(header) &&
+            ReadFile(file, &header, sizeof(header), &read, nullptr) &&
+            read == sizeof(header) && header.magic == DUMP_INDEX_MAGIC &&
+            header.version == DUMP_INDEX_VERSION;
+  if (ok) {
+    // A trailing partial record (crash mid-append) is ignored; Open cuts it
+    size_t count = (size_t)(((uint64_t)size.QuadPart - sizeof(header)) /
+                            sizeof(DumpIndexRecord));
+    recordsEnd->QuadPart = sizeof(header) + count * sizeof(DumpIndexRecord);
+    std::vector<DumpIndexRecord> records(count);
+    ok = count == 0 ||
+         (ReadFile(file, records.data(),
+                   (DWORD)(count * sizeof(DumpIndexRecord)), &read, nullptr) &&
+          read == count * sizeof(DumpIndexRecord));
+    if (ok) {
+      m_hashes.Reserve(count);
+      for (const DumpIndexRecord &r : records)
+        m_hashes.Insert(r.hash);
+    }
+  }
+  CloseHandle(file);
+  return ok;
+}
+
+void DumpIndex::Rebuild(const std::string &dumpPath) {
+  for (const char *folder : DUMP_FOLDERS)
+    ScanFolder(dumpPath + "\\" + folder);
+}
+
+void DumpIndex::ScanFolder(const std::string &folder) {
+  WIN32_FIND_DATAA fd;
+  HANDLE hFind = FindFirstFileA((folder + "\\*.dds").c_str(), &fd);
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+    DumpIndexRecord record;
+    if (ParseDumpFilename(fd.cFileName, &record) &&
+        m_hashes.Insert(record.hash))
+      WriteRecord(record);
+  } while (FindNextFileA(hFind, &fd));
+  FindClose(hFind);
+}
+
+bool DumpIndex::WriteRecord(const DumpIndexRecord &record) {
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+  DWORD written = 0;
+  return WriteFile(m_file, &record, sizeof(record), &written, nullptr) &&
+         written == sizeof(record);
+}
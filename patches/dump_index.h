@@ -0,0 +1,57 @@
+#pragma once
+#include "../utils/flat_hash.h"
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+
+// Persistent index of dumped textures (dump/index.bin)
+//
+// Layout: DumpIndexHeader | DumpIndexRecord[] (appended as dumps land)
+// Loaded into a flat hash set at startup so the dedup check before a dump
+// is one in-memory probe instead of a file probe per dump folder. If the
+// index is missing it is rebuilt once from the filenames already in dump/.
+
+constexpr uint32_t DUMP_INDEX_MAGIC = 0x49444643; // "CFDI"
+constexpr uint32_t DUMP_INDEX_VERSION = 1;
+
+#pragma pack(push, 1)
+struct DumpIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct DumpIndexRecord {
+  uint64_t hash;
+  uint32_t width;
+  uint32_t height;
+};
+#pragma pack(pop)
+
+// Not thread-safe; callers serialize access.
+class DumpIndex {
+public:
+  DumpIndex();
+  ~DumpIndex();
+
+  // Load (or rebuild) the index for a dump directory and open it for append
+  bool Open(const std::string &dumpPath);
+  void Close();
+
+  bool Contains(uint64_t hash) const { return m_hashes.Contains(hash); }
+  // Reserve a hash before dumping. Returns false if already dumped/reserved.
+  bool Reserve(uint64_t hash) { return m_hashes.Insert(hash); }
+  // Persist a finished dump
+  void Append(uint64_t hash, uint32_t width, uint32_t height);
+
+  size_t Size() const { return m_hashes.Size(); }
+
+private:
+  // recordsEnd: offset just past the last whole record
+  bool Load(const std::string &indexPath, LARGE_INTEGER *recordsEnd);
+  void Rebuild(const std::string &dumpPath);
+  void ScanFolder(const std::string &folder);
+  bool WriteRecord(const DumpIndexRecord &record);
+
+  HANDLE m_file;
+  FlatHashSet64 m_hashes;
+};
@@ -0,0 +1,218 @@
+#include "frame_timing.h"
+#include "../utils/hook_registry.h"
+#include <Windows.h>
+#include <dxgi1_2.h>
+#include <iostream>
+#include <wrl/client.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+// Frames in flight before timing skips one rather than wait on the GPU
+constexpr UINT FRAME_QUERY_COUNT = 5;
+
+struct FrameQueries {
+  ComPtr<ID3D11Query> disjoint;
+  ComPtr<ID3D11Query> begin;
+  ComPtr<ID3D11Query> end;
+};
+
+// Owned by the render thread (the one calling Present) once published
+FrameQueries g_frameQueries[FRAME_QUERY_COUNT];
+ID3D11DeviceContext *g_timingContext = nullptr;
+UINT g_framesSubmitted = 0; // Ended; slot = count % FRAME_QUERY_COUNT
+UINT g_framesResolved = 0;
+bool g_frameOpen = false; // Slot g_framesSubmitted has begun
+
+GpuFrameTimeCallback g_callbacks[MAX_FRAME_TIME_CALLBACKS] = {};
+volatile LONG g_callbackCount = 0;
+PresentCallback g_presentCallbacks[MAX_PRESENT_CALLBACKS] = {};
+volatile LONG g_presentCallbackCount = 0;
+bool g_factoryHooked = false; // Under g_timingCS
+CRITICAL_SECTION g_timingCS;
+volatile LONG g_timingCSInitialized = 0;
+
+void InitTimingCS() {
+  if (InterlockedCompareExchange(&g_timingCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_timingCS);
+  }
+}
+
+// Close the open frame and hand finished ones to the callbacks
+void EndFrame() {
+  if (g_frameOpen) {
+    FrameQueries &q = g_frameQueries[g_framesSubmitted % FRAME_QUERY_COUNT];
+    g_timingContext->End(q.end.Get());
+    g_timingContext->End(q.disjoint.Get());
+    g_framesSubmitted++;
+    g_frameOpen = false;
+  }
+
+  while (g_framesResolved != g_framesSubmitted) {
+    FrameQueries &q = g_frameQueries[g_framesResolved % FRAME_QUERY_COUNT];
+    D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+    if (g_timingContext->GetData(q.disjoint.Get(), &disjoint, sizeof(disjoint),
+                                 D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+      break;
+    UINT64 begin = 0;
+    UINT64 end = 0;
+    bool valid =
+        !disjoint.Disjoint && disjoint.Frequency &&
+        g_timingContext->GetData(q.begin.Get(), &begin, sizeof(begin),
+                                 D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+        g_timingContext->GetData(q.end.Get(), &end, sizeof(end),
+                                 D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+        end >= begin;
+    g_framesResolved++;
+    if (!valid)
+      continue;
+
+    float gpuMs = (float)((double)(end - begin) * 1000.0 /
+                          (double)disjoint.Frequency);
+    LONG count = g_callbackCount;
+    for (LONG i = 0; i < count; ++i)
+      g_callbacks[i](gpuMs);
+  }
+}
+
+void BeginFrame() {
+  // GPU too far behind: skip this frame instead of waiting on it
+  if (g_framesSubmitted - g_framesResolved >= FRAME_QUERY_COUNT)
+    return;
+  FrameQueries &q = g_frameQueries[g_framesSubmitted % FRAME_QUERY_COUNT];
+  g_timingContext->Begin(q.disjoint.Get());
+  g_timingContext->End(q.begin.Get());
+  g_frameOpen = true;
+}
+
+HRESULT Hooked_Present(const PresentHook::Next &next, IDXGISwapChain *This,
+                       UINT SyncInterval, UINT Flags) {
+  // DXGI_PRESENT_TEST presents nothing
+  if (Flags & DXGI_PRESENT_TEST)
+    return next(This, SyncInterval, Flags);
+
+  LONG presentCount = g_presentCallbackCount;
+  for (LONG i = 0; i < presentCount; ++i)
+    g_presentCallbacks[i]();
+  if (!g_callbackCount)
+    return next(This, SyncInterval, Flags);
+
+  EndFrame();
+  HRESULT hr = next(This, SyncInterval, Flags);
+  BeginFrame();
+  return hr;
+}
+
+HRESULT Hooked_CreateSwapChain(const CreateSwapChainHook::Next &next,
+                               IDXGIFactory *This, IUnknown *pDevice,
+                               DXGI_SWAP_CHAIN_DESC *pDesc,
+                               IDXGISwapChain **ppSwapChain) {
+  HRESULT hr = next(This, pDevice, pDesc, ppSwapChain);
+  if (SUCCEEDED(hr) && ppSwapChain)
+    HookSwapChainPresent(*ppSwapChain);
+  return hr;
+}
+
+HRESULT Hooked_CreateSwapChainForHwnd(
+    const CreateSwapChainForHwndHook::Next &next, IDXGIFactory2 *This,
+    IUnknown *pDevice, HWND hWnd, const DXGI_SWAP_CHAIN_DESC1 *pDesc,
+    const DXGI_SWAP_CHAIN_FULLSCREEN_DESC *pFullscreenDesc,
+    IDXGIOutput *pRestrictToOutput, IDXGISwapChain1 **ppSwapChain) {
+  HRESULT hr = next(This, pDevice, hWnd, pDesc, pFullscreenDesc,
+                    pRestrictToOutput, ppSwapChain);
+  if (SUCCEEDED(hr) && ppSwapChain)
+    HookSwapChainPresent(*ppSwapChain);
+  return hr;
+}
+
+// Every factory object shares these vtables, so hooking the device's own
+// factory covers one the game made itself. Called under g_timingCS.
+void HookFactory(ID3D11Device *pDevice) {
+  if (g_factoryHooked)
+    return;
+  g_factoryHooked = true;
+
+  ComPtr<IDXGIDevice> pDXGIDevice;
+  ComPtr<IDXGIAdapter> pAdapter;
+  ComPtr<IDXGIFactory> pFactory;
+  if (FAILED(pDevice->QueryInterface(__uuidof(IDXGIDevice),
+                                     (void **)pDXGIDevice.GetAddressOf())) ||
+      FAILED(pDXGIDevice->GetAdapter(pAdapter.GetAddressOf())) ||
+      FAILED(pAdapter->GetParent(__uuidof(IDXGIFactory),
+                                 (void **)pFactory.GetAddressOf())))
+    return;
+
+  CreateSwapChainHook::Register(pFactory.Get(), HOOK_ORDER_FRAME_TIMING,
+                                Hooked_CreateSwapChain);
+
+  ComPtr<IDXGIFactory2> pFactory2;
+  if (SUCCEEDED(pFactory.As(&pFactory2)))
+    CreateSwapChainForHwndHook::Register(pFactory2.Get(),
+                                         HOOK_ORDER_FRAME_TIMING,
+                                         Hooked_CreateSwapChainForHwnd);
+}
+} // namespace
+
+bool AddGpuFrameTimeCallback(ID3D11Device *pDevice,
+                             ID3D11DeviceContext *pContext,
+                             GpuFrameTimeCallback callback) {
+  if (!pDevice || !pContext || !callback)
+    return false;
+
+  InitTimingCS();
+  EnterCriticalSection(&g_timingCS);
+  bool added = false;
+  if (!g_timingContext) {
+    bool created = true;
+    for (FrameQueries &q : g_frameQueries) {
+      D3D11_QUERY_DESC desc = {D3D11_QUERY_TIMESTAMP_DISJOINT, 0};
+      created = created && SUCCEEDED(pDevice->CreateQuery(
+                               &desc, q.disjoint.GetAddressOf()));
+      desc.Query = D3D11_QUERY_TIMESTAMP;
+      created = created &&
+                SUCCEEDED(pDevice->CreateQuery(&desc, q.begin.GetAddressOf()));
+      created = created &&
+                SUCCEEDED(pDevice->CreateQuery(&desc, q.end.GetAddressOf()));
+    }
+    if (created) {
+      g_timingContext = pContext;
+      HookFactory(pDevice);
+    } else {
+      std::cout << "[Mod] Warning: GPU timestamp queries unavailable, frame "
+                   "timing disabled"
+                << std::endl;
+    }
+  }
+  if (g_timingContext && g_callbackCount < MAX_FRAME_TIME_CALLBACKS) {
+    g_callbacks[g_callbackCount] = callback;
+    MemoryBarrier();
+    InterlockedIncrement(&g_callbackCount);
+    added = true;
+  }
+  LeaveCriticalSection(&g_timingCS);
+  return added;
+}
+
+bool AddPresentCallback(ID3D11Device *pDevice, PresentCallback callback) {
+  if (!pDevice || !callback)
+    return false;
+
+  InitTimingCS();
+  EnterCriticalSection(&g_timingCS);
+  bool added = false;
+  if (g_presentCallbackCount < MAX_PRESENT_CALLBACKS) {
+    HookFactory(pDevice);
+    g_presentCallbacks[g_presentCallbackCount] = callback;
+    MemoryBarrier();
+    InterlockedIncrement(&g_presentCallbackCount);
+    added = true;
+  }
+  LeaveCriticalSection(&g_timingCS);
+  return added;
+}
+
+void HookSwapChainPresent(IDXGISwapChain *pSwapChain) {
+  if (!pSwapChain || (!g_callbackCount && !g_presentCallbackCount))
+    return;
+  PresentHook::Register(pSwapChain, HOOK_ORDER_FRAME_TIMING, Hooked_Present);
+}
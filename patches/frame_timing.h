@@ -0,0 +1,27 @@
+// Frame Timing - swap chain Present hook and GPU frame time measurement
+#pragma once
+#include <d3d11.h>
+#include <dxgi.h>
+
+// Called on the render thread once a frame's GPU time is known (a few
+// frames after it was presented). Frames the driver reports as disjoint
+// (clock change, device reset) are skipped.
+typedef void (*GpuFrameTimeCallback)(float gpuMs);
+
+// Start timing frames and report each one to callback. Present is hooked
+// through the DXGI factory, so swap chains created after this are covered;
+// one created together with the device is passed to HookSwapChainPresent.
+// Up to MAX_FRAME_TIME_CALLBACKS callbacks; returns false if none is left.
+constexpr int MAX_FRAME_TIME_CALLBACKS = 4;
+bool AddGpuFrameTimeCallback(ID3D11Device *pDevice,
+                             ID3D11DeviceContext *pContext,
+                             GpuFrameTimeCallback callback);
+
+// Called on the render thread at the start of each Present, i.e. when the
+// CPU side of a frame is complete. Hooked the same way as GPU timing.
+typedef void (*PresentCallback)();
+constexpr int MAX_PRESENT_CALLBACKS = 4;
+bool AddPresentCallback(ID3D11Device *pDevice, PresentCallback callback);
+
+// Swap chain returned by D3D11CreateDeviceAndSwapChain
+void HookSwapChainPresent(IDXGISwapChain *pSwapChain);
@@ -0,0 +1,384 @@
+#include "hook_profiler.h"
+#include "../utils/hook_registry.h"
+#include "frame_timing.h"
+#include "resource_table.h"
+#include "texturedump.h"
+#include "texturereplace.h"
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <intrin.h>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+const char *const PROBE_NAMES[PROBE_COUNT] = {
+    "PSSetShaderResources", "RSSetViewports",   "CopySubresourceRegion",
+    "CreateTexture2D",      "CreateSamplerState", "CreateFileW",
+    "ReadFile",             "SetFilePointerEx", "SetFilePointer",
+    "GetFileSizeEx",        "CloseHandle",
+};
+
+// Histogram buckets; one more collects everything above
+constexpr int HISTOGRAM_BUCKETS = 100;
+constexpr double FRAME_BUCKET_MS = 1.0;
+constexpr double HOOK_BUCKET_MS = 0.1;
+
+// One per thread that has entered a probe, never freed (the thread may
+// exit while Present is reading it). The owning thread updates the
+// published counters between two increments of sequence, so a reader can
+// tell a torn copy (odd, or changed while copying) and retry.
+struct ThreadCounters {
+  volatile LONG sequence;
+  uint32_t depth[PROBE_COUNT];
+  uint64_t callStart[PROBE_COUNT];
+  uint64_t originalStart[PROBE_COUNT];
+  uint64_t pendingOriginal[PROBE_COUNT]; // Of the call still in progress
+
+  // Published
+  uint64_t calls[PROBE_COUNT];
+  uint64_t callTicks[PROBE_COUNT];
+  uint64_t originalTicks[PROBE_COUNT];
+
+  ThreadCounters *next;
+};
+
+struct Totals {
+  uint64_t calls[PROBE_COUNT];
+  uint64_t callTicks[PROBE_COUNT];
+  uint64_t originalTicks[PROBE_COUNT];
+};
+
+struct Histogram {
+  double bucketMs;
+  uint32_t counts[HISTOGRAM_BUCKETS + 1];
+};
+
+volatile LONG g_profilerEnabled = 0;
+ThreadCounters *volatile g_threads = nullptr; // Push-only list
+thread_local ThreadCounters *t_counters = nullptr;
+
+// Render thread only, after ApplyHookProfilerPatch
+HANDLE g_csvFile = INVALID_HANDLE_VALUE;
+UINT g_dumpFrames = 600;
+uint64_t g_frame = 0;
+uint64_t g_tscStart = 0; // TSC and QPC when enabled, to calibrate the TSC
+LARGE_INTEGER g_qpcStart = {};
+LARGE_INTEGER g_qpcFrequency = {};
+LARGE_INTEGER g_lastPresent = {};
+Totals g_lastFrameTotals = {};
+Totals g_lastDumpTotals = {};
+Histogram g_frameTimes = {FRAME_BUCKET_MS};
+Histogram g_hookTimes = {HOOK_BUCKET_MS};
+ResourceTableStats g_lastTableStats = {};
+
+ThreadCounters *GetThreadCounters() {
+  ThreadCounters *counters = t_counters;
+  if (counters)
+    return counters;
+
+  counters = new ThreadCounters();
+  ThreadCounters *head;
+  do {
+    head = g_threads;
+    counters->next = head;
+  } while (InterlockedCompareExchangePointer((PVOID volatile *)&g_threads,
+                                             counters, head) != head);
+  t_counters = counters;
+  return counters;
+}
+
+void ReadTotals(Totals *totals) {
+  *totals = {};
+  for (ThreadCounters *c = g_threads; c; c = c->next) {
+    Totals copy;
+    for (;;) {
+      LONG before = c->sequence;
+      MemoryBarrier();
+      memcpy(copy.calls, c->calls, sizeof(copy.calls));
+      memcpy(copy.callTicks, c->callTicks, sizeof(copy.callTicks));
+      memcpy(copy.originalTicks, c->originalTicks,
+             sizeof(copy.originalTicks));
+      MemoryBarrier();
+      if (!(before & 1) && c->sequence == before)
+        break;
+      YieldProcessor();
+    }
+    for (int i = 0; i < PROBE_COUNT; ++i) {
+      totals->calls[i] += copy.calls[i];
+      totals->callTicks[i] += copy.callTicks[i];
+      totals->originalTicks[i] += copy.originalTicks[i];
+    }
+  }
+}
+
+// CrossFix's share of the calls between two snapshots
+uint64_t SelfTicks(const Totals &from, const Totals &to, int probe) {
+  uint64_t call = to.callTicks[probe] - from.callTicks[probe];
+  uint64_t original = to.originalTicks[probe] - from.originalTicks[probe];
+  return call > original ? call - original : 0;
+}
+
+// From the TSC and QPC counts since the profiler was enabled
+double TscTicksPerMs(const LARGE_INTEGER &qpcNow, uint64_t tscNow) {
+  double ms = (double)(qpcNow.QuadPart - g_qpcStart.QuadPart) * 1000.0 /
+              (double)g_qpcFrequency.QuadPart;
+  return ms > 0.0 ? (double)(tscNow - g_tscStart) / ms : 0.0;
+}
+
+void AddToHistogram(Histogram &histogram, double ms) {
+  int bucket = (int)(ms / histogram.bucketMs);
+  if (bucket < 0)
+    bucket = 0;
+  if (bucket > HISTOGRAM_BUCKETS)
+    bucket = HISTOGRAM_BUCKETS;
+  histogram.counts[bucket]++;
+}
+
+void WriteHistogram(std::ostringstream &csv, const char *kind,
+                    Histogram &histogram) {
+  for (int i = 0; i <= HISTOGRAM_BUCKETS; ++i) {
+    if (histogram.counts[i] == 0)
+      continue;
+    csv << g_frame << ',' << kind << ',' << i * histogram.bucketMs;
+    if (i < HISTOGRAM_BUCKETS)
+      csv << '-' << (i + 1) * histogram.bucketMs;
+    else
+      csv << '+';
+    csv << ',' << histogram.counts[i] << ",,\n";
+    histogram.counts[i] = 0;
+  }
+}
+
+void WriteCsv(const std::string &text) {
+  DWORD written = 0;
+  WriteFile(g_csvFile, text.data(), (DWORD)text.size(), &written, NULL);
+}
+
+// Bind-time replacement cache, as it stands at the dump (the eviction
+// counts are totals since launch)
+void WriteReplacementCacheStats(std::ostringstream &csv) {
+  ReplacementCacheStats stats;
+  GetReplacementCacheStats(&stats);
+  const struct {
+    const char *name;
+    uint64_t value;
+  } rows[] = {
+      {"resident_bytes", stats.residentBytes},
+      {"retired_bytes", stats.retiredBytes},
+      {"peak_bytes", stats.peakBytes},
+      {"budget_bytes", stats.budgetBytes},
+      {"resident_count", stats.residentCount},
+      {"budget_evictions", stats.budgetEvictions},
+      {"destroyed_evictions", stats.destroyedEvictions},
+      {"band_mirror_bytes", stats.bandMirrorBytes},
+  };
+  for (const auto &row : rows)
+    csv << g_frame << ",replacement_cache," << row.name << ',' << row.value
+        << ",,\n";
+
+  std::cout << "[Mod] Texture replacer: "
+            << stats.residentBytes / (1024 * 1024) << " MB in "
+            << stats.residentCount << " replacement(s) resident (peak "
+            << stats.peakBytes / (1024 * 1024) << " MB), "
+            << stats.budgetEvictions << " released for budget" << std::endl;
+}
+
+// Resource table size, and lookups answered from it or by querying the
+// resource during the interval
+void WriteResourceTableStats(std::ostringstream &csv) {
+  ResourceTableStats stats;
+  GetResourceTableStats(&stats);
+  csv << g_frame << ",resource_table,tracked," << stats.trackedCount
+      << ",,\n";
+  csv << g_frame << ",resource_table,hits,"
+      << stats.hits - g_lastTableStats.hits << ",,\n";
+  csv << g_frame << ",resource_table,misses,"
+      << stats.misses - g_lastTableStats.misses << ",,\n";
+  g_lastTableStats = stats;
+}
+
+void DumpInterval(const Totals &totals, double ticksPerMs) {
+  std::ostringstream csv;
+  csv << std::fixed << std::setprecision(3);
+  double selfMs = 0.0;
+  for (int i = 0; i < PROBE_COUNT; ++i) {
+    double self = SelfTicks(g_lastDumpTotals, totals, i) / ticksPerMs;
+    double original =
+        (totals.originalTicks[i] - g_lastDumpTotals.originalTicks[i]) /
+        ticksPerMs;
+    csv << g_frame << ",hook," << PROBE_NAMES[i] << ','
+        << totals.calls[i] - g_lastDumpTotals.calls[i] << ',' << self << ','
+        << original << '\n';
+    selfMs += self;
+  }
+  csv << std::setprecision(1);
+  WriteHistogram(csv, "frame_ms", g_frameTimes);
+  WriteHistogram(csv, "hook_ms", g_hookTimes);
+  WriteResourceTableStats(csv);
+  if (IsTextureReplacementEnabled())
+    WriteReplacementCacheStats(csv);
+  WriteCsv(csv.str());
+  g_lastDumpTotals = totals;
+
+  std::cout << "[Mod] Hook profiler: " << std::fixed << std::setprecision(3)
+            << selfMs / g_dumpFrames << " ms per frame in CrossFix hooks"
+            << std::defaultfloat << std::endl;
+}
+
+void OnPresent() {
+  uint64_t tsc = __rdtsc();
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  double ticksPerMs = TscTicksPerMs(now, tsc);
+  if (ticksPerMs <= 0.0)
+    return;
+
+  Totals totals;
+  ReadTotals(&totals);
+  if (g_lastPresent.QuadPart != 0) {
+    uint64_t selfTicks = 0;
+    for (int i = 0; i < PROBE_COUNT; ++i)
+      selfTicks += SelfTicks(g_lastFrameTotals, totals, i);
+    AddToHistogram(g_hookTimes, selfTicks / ticksPerMs);
+    AddToHistogram(g_frameTimes,
+                   (double)(now.QuadPart - g_lastPresent.QuadPart) * 1000.0 /
+                       (double)g_qpcFrequency.QuadPart);
+  }
+  g_lastFrameTotals = totals;
+  g_lastPresent = now;
+
+  if (++g_frame % g_dumpFrames == 0)
+    DumpInterval(totals, ticksPerMs);
+}
+
+// Registered first and last on a slot, so the original's time can be told
+// apart from everything CrossFix does around it
+template <int Probe, typename Next> struct SlotProbe;
+
+template <int Probe, typename R, typename... Args>
+struct SlotProbe<Probe, HookNext<R, Args...>> {
+  static R Call(const HookNext<R, Args...> &next, Args... args) {
+    HookProfiler::CallScope scope(Probe);
+    return next(args...);
+  }
+
+  static R Original(const HookNext<R, Args...> &next, Args... args) {
+    HookProfiler::OriginalScope scope(Probe);
+    return next(args...);
+  }
+};
+
+template <typename Hook, int Probe> void RegisterProbe(void *object) {
+  typedef SlotProbe<Probe, typename Hook::Next> P;
+  if (!Hook::Register(object, HOOK_ORDER_PROFILE_CALL, P::Call) ||
+      !Hook::Register(object, HOOK_ORDER_PROFILE_ORIGINAL, P::Original))
+    std::cout << "[Mod] Warning: hook profiler can't time "
+              << PROBE_NAMES[Probe] << std::endl;
+}
+
+std::string GetCsvPath() {
+  char exePath[MAX_PATH];
+  if (GetModuleFileNameA(NULL, exePath, MAX_PATH) != 0) {
+    std::string exePathStr(exePath);
+    size_t lastBackslash = exePathStr.find_last_of("\\/");
+    if (lastBackslash != std::string::npos)
+      return exePathStr.substr(0, lastBackslash + 1) + "crossfix_profile.csv";
+  }
+  return "crossfix_profile.csv";
+}
+} // namespace
+
+namespace HookProfiler {
+void EnterCall(int probe) {
+  ThreadCounters *c = GetThreadCounters();
+  if (c->depth[probe]++ == 0) {
+    c->pendingOriginal[probe] = 0;
+    c->callStart[probe] = __rdtsc();
+  }
+}
+
+void LeaveCall(int probe) {
+  ThreadCounters *c = GetThreadCounters();
+  if (--c->depth[probe] != 0)
+    return;
+  uint64_t ticks = __rdtsc() - c->callStart[probe];
+  // The original's time is published with its call's, so a snapshot
+  // never holds one without the other
+  c->sequence++;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  c->calls[probe]++;
+  c->callTicks[probe] += ticks;
+  c->originalTicks[probe] += c->pendingOriginal[probe];
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  c->sequence++;
+}
+
+void EnterOriginal(int probe) {
+  ThreadCounters *c = GetThreadCounters();
+  if (c->depth[probe] == 1)
+    c->originalStart[probe] = __rdtsc();
+}
+
+void LeaveOriginal(int probe) {
+  ThreadCounters *c = GetThreadCounters();
+  if (c->depth[probe] == 1)
+    c->pendingOriginal[probe] += __rdtsc() - c->originalStart[probe];
+}
+} // namespace HookProfiler
+
+void EnableHookProfiler(int dumpFrames) {
+  if (dumpFrames <= 0)
+    return;
+  if (InterlockedCompareExchange(&g_profilerEnabled, 1, 0) != 0)
+    return;
+
+  g_dumpFrames = (UINT)dumpFrames;
+  QueryPerformanceFrequency(&g_qpcFrequency);
+  QueryPerformanceCounter(&g_qpcStart);
+  g_tscStart = __rdtsc();
+  EnableResourceTableStats();
+}
+
+bool IsHookProfilerEnabled() { return g_profilerEnabled != 0; }
+
+void ApplyHookProfilerPatch(ID3D11Device *pDevice,
+                            ID3D11DeviceContext *pContext) {
+  if (!pDevice || !pContext || !IsHookProfilerEnabled())
+    return;
+
+  static volatile LONG applied = 0;
+  if (InterlockedCompareExchange(&applied, 1, 0) != 0)
+    return;
+
+  g_csvFile = CreateFileA(GetCsvPath().c_str(), GENERIC_WRITE,
+                          FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL);
+  if (g_csvFile == INVALID_HANDLE_VALUE) {
+    std::cout << "[Mod] Warning: can't create crossfix_profile.csv, hook "
+                 "profiler disabled"
+              << std::endl;
+    return;
+  }
+  WriteCsv("frame,kind,name,count,self_ms,original_ms\n");
+
+  if (!AddPresentCallback(pDevice, OnPresent)) {
+    CloseHandle(g_csvFile);
+    g_csvFile = INVALID_HANDLE_VALUE;
+    return;
+  }
+
+  RegisterProbe<PSSetShaderResourcesHook, PROBE_PS_SET_SHADER_RESOURCES>(
+      pContext);
+  RegisterProbe<RSSetViewportsHook, PROBE_RS_SET_VIEWPORTS>(pContext);
+  RegisterProbe<CopySubresourceRegionHook, PROBE_COPY_SUBRESOURCE_REGION>(
+      pContext);
+  RegisterProbe<CreateTexture2DHook, PROBE_CREATE_TEXTURE_2D>(pDevice);
+  RegisterProbe<CreateSamplerStateHook, PROBE_CREATE_SAMPLER_STATE>(pDevice);
+
+  std::cout << "[Mod] Hook profiler: writing crossfix_profile.csv every "
+            << g_dumpFrames << " frames" << std::endl;
+}
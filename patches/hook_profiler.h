@@ -0,0 +1,94 @@
+// Hook Profiler - CPU time CrossFix's hooks add to calls and frames
+#pragma once
+#include <Windows.h>
+#include <d3d11.h>
+
+// With profile_hooks=1 each profiled hook is timed with the TSC twice: the
+// whole call, and the original function it passes the call on to. The
+// difference is what CrossFix added. Counters are per thread and summed at
+// each Present, which also feeds histograms of frame time and of CrossFix
+// time per frame. Every profile_dump_frames frames the interval is appended
+// to crossfix_profile.csv next to the executable:
+//
+//   frame,kind,name,count,self_ms,original_ms
+//   600,hook,RSSetViewports,5400,0.812,3.105  (calls, CrossFix, original)
+//   600,frame_ms,16.0-17.0,588,,              (frames in the bucket)
+//   600,hook_ms,0.1-0.2,600,,                 (CrossFix time per frame)
+//   600,resource_table,hits,81000,,           (lookups in the interval)
+//   600,replacement_cache,resident_bytes,268435456,,
+//
+// The resource_table rows are the descriptor table's size and how many
+// lookups it answered (hits) or had to query the resource for (misses).
+// The replacement_cache rows (with texture replacement on) are the bind-time
+// replacement cache's resident, peak and budget sizes and its eviction
+// counts, which are also summarized on the console.
+//
+// When profiling is off no probe is installed, so it costs nothing.
+
+enum HookProbe {
+  PROBE_PS_SET_SHADER_RESOURCES,
+  PROBE_RS_SET_VIEWPORTS,
+  PROBE_COPY_SUBRESOURCE_REGION,
+  PROBE_CREATE_TEXTURE_2D,
+  PROBE_CREATE_SAMPLER_STATE,
+  PROBE_CREATE_FILE,
+  PROBE_READ_FILE,
+  PROBE_SET_FILE_POINTER_EX,
+  PROBE_SET_FILE_POINTER,
+  PROBE_GET_FILE_SIZE_EX,
+  PROBE_CLOSE_HANDLE,
+  PROBE_COUNT
+};
+
+// Start profiling, writing the CSV every dumpFrames frames. Call before
+// the hooks to be profiled are installed (the mod loader and the device).
+void EnableHookProfiler(int dumpFrames);
+bool IsHookProfilerEnabled();
+
+// Install the D3D11 probes and the Present callback, if enabled
+void ApplyHookProfilerPatch(ID3D11Device *pDevice,
+                            ID3D11DeviceContext *pContext);
+
+namespace HookProfiler {
+// Only the outermost call of a probe on a thread is timed, so CrossFix
+// calling a hooked function from its own hook counts as self time, as does
+// time in originals reached other than through the probe's own call
+void EnterCall(int probe);
+void LeaveCall(int probe);
+void EnterOriginal(int probe);
+void LeaveOriginal(int probe);
+
+struct CallScope {
+  explicit CallScope(int probe) : probe(probe) { EnterCall(probe); }
+  ~CallScope() { LeaveCall(probe); }
+  int probe;
+};
+
+struct OriginalScope {
+  explicit OriginalScope(int probe) : probe(probe) { EnterOriginal(probe); }
+  ~OriginalScope() { LeaveOriginal(probe); }
+  int probe;
+};
+
+// Wraps an API detour: MinHook is pointed at Call, which times the detour,
+// and the detour's original pointer at Original, which times the original
+template <int Probe, typename Fn> struct FunctionProbe;
+
+template <int Probe, typename R, typename... Args>
+struct FunctionProbe<Probe, R(WINAPI *)(Args...)> {
+  typedef R(WINAPI *Fn)(Args...);
+
+  static R WINAPI Call(Args... args) {
+    CallScope scope(Probe);
+    return s_detour(args...);
+  }
+
+  static R WINAPI Original(Args... args) {
+    OriginalScope scope(Probe);
+    return s_original(args...);
+  }
+
+  static inline Fn s_detour = nullptr;
+  static inline Fn s_original = nullptr;
+};
+} // namespace HookProfiler
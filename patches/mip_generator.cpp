@@ -0,0 +1,241 @@
+#include "mip_generator.h"
+#include "../utils/worker_pool.h"
+#include <cmath>
+#include <emmintrin.h>
+
+namespace {
+// Levels with at least this many destination rows are split across the pool
+constexpr UINT PARALLEL_MIN_ROWS = 128;
+constexpr UINT ROWS_PER_ITEM = 32;
+
+// Average a 2x2 quad. Equal alphas (the common, opaque case) reduce to a
+// plain average; otherwise colour is weighted by alpha.
+void AverageQuad(const uint8_t *p0, const uint8_t *p1, const uint8_t *p2,
+                 const uint8_t *p3, uint8_t *out) {
+  UINT alpha = p0[3] + p1[3] + p2[3] + p3[3];
+  if (p0[3] == p1[3] && p0[3] == p2[3] && p0[3] == p3[3]) {
+    for (int c = 0; c < 4; ++c)
+      out[c] = (uint8_t)((p0[c] + p1[c] + p2[c] + p3[c] + 2) >> 2);
+    return;
+  }
+  for (int c = 0; c < 3; ++c)
+    out[c] = (uint8_t)((p0[c] * p0[3] + p1[c] * p1[3] + p2[c] * p2[3] +
+                        p3[c] * p3[3] + alpha / 2) /
+                       alpha);
+  out[3] = (uint8_t)((alpha + 2) >> 2);
+}
+
+// Downsample destination rows [rowBegin, rowEnd). Odd source sizes drop the
+// last column/row, except that a 1-texel dimension is reused for both taps.
+void DownsampleRows(const uint8_t *src, UINT srcWidth, UINT srcHeight,
+                    uint8_t *dst, UINT dstWidth, UINT rowBegin, UINT rowEnd) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  size_t srcPitch = (size_t)srcWidth * 4;
+  UINT stepX = srcWidth > 1 ? 1 : 0;
+  for (UINT y = rowBegin; y < rowEnd; ++y) {
+    const uint8_t *row0 = src + (size_t)(y * 2) * srcPitch;
+    const uint8_t *row1 = srcHeight > 1 ? row0 + srcPitch : row0;
+    uint8_t *out = dst + (size_t)y * dstWidth * 4;
+
+    UINT x = 0;
+    if (stepX) {
+      // Two destination texels (4x2 source texels) per iteration
+      for (; (x + 2) * 2 <= srcWidth && x + 2 <= dstWidth; x += 2) {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+        __m128i a0 = _mm_srli_epi32(r0, 24);
+        __m128i a1 = _mm_srli_epi32(r1, 24);
+        __m128i sameAlpha = _mm_and_si128(
+            _mm_cmpeq_epi32(a0, a1),
+            _mm_cmpeq_epi32(a0,
+                            _mm_shuffle_epi32(a0, _MM_SHUFFLE(2, 3, 0, 1))));
+        if (_mm_movemask_epi8(sameAlpha) != 0xFFFF) {
+          AverageQuad(row0 + x * 8, row0 + x * 8 + 4, row1 + x * 8,
+                      row1 + x * 8 + 4, out + x * 4);
+          AverageQuad(row0 + x * 8 + 8, row0 + x * 8 + 12, row1 + x * 8 + 8,
+                      row1 + x * 8 + 12, out + x * 4 + 4);
+          continue;
+        }
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero),
+                                   _mm_unpacklo_epi8(r1, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero),
+                                   _mm_unpackhi_epi8(r1, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_unpacklo_epi64(lo, hi);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        _mm_storel_epi64((__m128i *)(out + x * 4), _mm_packus_epi16(sum, sum));
+      }
+    }
+    for (; x < dstWidth; ++x) {
+      const uint8_t *p0 = row0 + (size_t)x * 8;
+      const uint8_t *p1 = row1 + (size_t)x * 8;
+      AverageQuad(p0, p0 + stepX * 4, p1, p1 + stepX * 4, out + x * 4);
+    }
+  }
+}
+
+// Kaiser-windowed sinc over two destination texels each side (alpha 4):
+// eight source taps, 2x-3 to 2x+4, centred between source texels 2x and 2x+1
+constexpr int KAISER_TAPS = 8;
+constexpr double KAISER_WIDTH = 2.0;
+constexpr double KAISER_ALPHA = 4.0;
+
+// Zeroth-order modified Bessel function of the first kind
+double BesselI0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= x / (2.0 * k);
+    sum += term * term;
+  }
+  return sum;
+}
+
+struct KaiserWeights {
+  float w[KAISER_TAPS];
+
+  KaiserWeights() {
+    const double PI = 3.14159265358979323846;
+    double total = 0.0;
+    double taps[KAISER_TAPS];
+    for (int j = 0; j < KAISER_TAPS; ++j) {
+      // Source texel centre to destination centre, in destination texels
+      double t = (j - 3.5) / 2.0;
+      double r = t / KAISER_WIDTH;
+      double sinc = std::sin(PI * t) / (PI * t);
+      taps[j] = sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0 - r * r)) /
+                BesselI0(KAISER_ALPHA);
+      total += taps[j];
+    }
+    for (int j = 0; j < KAISER_TAPS; ++j)
+      w[j] = (float)(taps[j] / total);
+  }
+};
+
+const KaiserWeights g_kaiser;
+
+// Per source texel: alpha-weighted colour, alpha, then plain colour
+constexpr int KAISER_CHANNELS = 7;
+
+inline UINT ClampTap(int i, UINT size) {
+  return i < 0 ? 0 : (UINT)i >= size ? size - 1 : (UINT)i;
+}
+
+inline uint8_t ToByte(float v) {
+  return v <= 0.0f ? 0 : v >= 255.0f ? 255 : (uint8_t)(v + 0.5f);
+}
+
+// Kaiser-filter destination rows [rowBegin, rowEnd): a vertical pass into
+// `column` (srcWidth * KAISER_CHANNELS floats), then a horizontal one. Taps
+// are clamped to the edges, so odd sizes keep their last row/column and a
+// 1-texel dimension passes through. Colour is alpha-weighted, falling back
+// to the plain filter where the result is transparent.
+void KaiserRows(const uint8_t *src, UINT srcWidth, UINT srcHeight,
+                uint8_t *dst, UINT dstWidth, UINT rowBegin, UINT rowEnd,
+                float *column) {
+  const float *w = g_kaiser.w;
+  size_t srcPitch = (size_t)srcWidth * 4;
+  for (UINT y = rowBegin; y < rowEnd; ++y) {
+    const uint8_t *rows[KAISER_TAPS];
+    for (int j = 0; j < KAISER_TAPS; ++j)
+      rows[j] = src + ClampTap((int)(y * 2) - 3 + j, srcHeight) * srcPitch;
+    for (UINT x = 0; x < srcWidth; ++x) {
+      float sum[KAISER_CHANNELS] = {};
+      for (int j = 0; j < KAISER_TAPS; ++j) {
+        const uint8_t *p = rows[j] + x * 4;
+        float wa = w[j] * p[3];
+        for (int c = 0; c < 3; ++c) {
+          sum[c] += wa * p[c];
+          sum[4 + c] += w[j] * p[c];
+        }
+        sum[3] += wa;
+      }
+      for (int c = 0; c < KAISER_CHANNELS; ++c)
+        column[x * KAISER_CHANNELS + c] = sum[c];
+    }
+
+    uint8_t *out = dst + (size_t)y * dstWidth * 4;
+    for (UINT x = 0; x < dstWidth; ++x) {
+      float sum[KAISER_CHANNELS] = {};
+      for (int j = 0; j < KAISER_TAPS; ++j) {
+        const float *p =
+            column + ClampTap((int)(x * 2) - 3 + j, srcWidth) * KAISER_CHANNELS;
+        for (int c = 0; c < KAISER_CHANNELS; ++c)
+          sum[c] += w[j] * p[c];
+      }
+      // Below half a step the alpha rounds to 0 anyway
+      bool weighted = sum[3] >= 0.5f;
+      for (int c = 0; c < 3; ++c)
+        out[x * 4 + c] = ToByte(weighted ? sum[c] / sum[3] : sum[4 + c]);
+      out[x * 4 + 3] = ToByte(sum[3]);
+    }
+  }
+}
+
+struct DownsampleJob {
+  const uint8_t *src;
+  UINT srcWidth;
+  UINT srcHeight;
+  uint8_t *dst;
+  UINT dstWidth;
+  UINT dstHeight;
+  MipFilter filter;
+};
+
+void DownsampleRange(const DownsampleJob &job, UINT begin, UINT end) {
+  if (job.filter == MipFilter::Kaiser) {
+    std::vector<float> column((size_t)job.srcWidth * KAISER_CHANNELS);
+    KaiserRows(job.src, job.srcWidth, job.srcHeight, job.dst, job.dstWidth,
+               begin, end, column.data());
+  } else {
+    DownsampleRows(job.src, job.srcWidth, job.srcHeight, job.dst,
+                   job.dstWidth, begin, end);
+  }
+}
+
+void DownsampleItem(void *context, size_t index) {
+  const DownsampleJob &job = *static_cast<const DownsampleJob *>(context);
+  UINT begin = (UINT)index * ROWS_PER_ITEM;
+  UINT end = begin + ROWS_PER_ITEM;
+  if (end > job.dstHeight)
+    end = job.dstHeight;
+  DownsampleRange(job, begin, end);
+}
+} // namespace
+
+UINT GenerateMipChain(const uint8_t *top, UINT width, UINT height,
+                      UINT maxLevels, MipFilter filter,
+                      std::vector<uint8_t> *outLevels) {
+  // Size everything up front so level pointers stay valid
+  size_t base = outLevels->size();
+  size_t total = 0;
+  UINT levels = 0;
+  for (UINT w = width, h = height; (w > 1 || h > 1) && levels + 1 < maxLevels;
+       ++levels) {
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+    total += (size_t)w * h * 4;
+  }
+  if (levels == 0)
+    return 0;
+  outLevels->resize(base + total);
+
+  const uint8_t *src = top;
+  uint8_t *dst = outLevels->data() + base;
+  UINT w = width, h = height;
+  for (UINT level = 0; level < levels; ++level) {
+    DownsampleJob job = {src, w, h, dst, w > 1 ? w / 2 : 1, h > 1 ? h / 2 : 1,
+                         filter};
+    if (job.dstHeight >= PARALLEL_MIN_ROWS)
+      ParallelFor((job.dstHeight + ROWS_PER_ITEM - 1) / ROWS_PER_ITEM,
+                  DownsampleItem, &job);
+    else
+      DownsampleRange(job, 0, job.dstHeight);
+    src = dst;
+    dst += (size_t)job.dstWidth * job.dstHeight * 4;
+    w = job.dstWidth;
+    h = job.dstHeight;
+  }
+  return levels;
+}
@@ -0,0 +1,22 @@
+// Mip Generator - CPU mip chains for replacements that ship without them
+#pragma once
+
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+
+// Downsampling filter (texture_replace_mip_filter)
+enum class MipFilter {
+  Box,    // 2x2 average
+  Kaiser, // 8x8 Kaiser-windowed sinc: sharper, at about 10x the cost
+};
+
+// Generate the levels below a 32bpp RGBA8/BGRA8 top mip (tightly packed,
+// alpha in the fourth byte), each from the one above, down to 1x1 or until
+// maxLevels levels in total. Colour is alpha-weighted where the source
+// texels' alpha differs, so transparent texels don't darken edges.
+// The levels are appended tightly packed to outLevels (which must not hold
+// `top` itself); returns how many were generated (0 for a 1x1 top mip).
+UINT GenerateMipChain(const uint8_t *top, UINT width, UINT height,
+                      UINT maxLevels, MipFilter filter,
+                      std::vector<uint8_t> *outLevels);
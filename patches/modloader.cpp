@@ -1,4 +1,5 @@
 #include "modloader.h"
+#include "hook_profiler.h"
 #include "virtual_hd.h"
 #include <MinHook.h>
 #include <Windows.h>
@@ -321,10 +322,25 @@ static BOOL WINAPI HookedCloseHandle(HANDLE hObject) {
 // ============================================================================
 // Hook helper
 // ============================================================================
-static bool CreateHookHelper(LPCWSTR moduleName, LPCSTR procName, LPVOID detour,
-                             LPVOID *original) {
-  MH_STATUS status = MH_CreateHookApi(moduleName, procName, detour, original);
-  return (status == MH_OK);
+// With the hook profiler on, MinHook gets a probe that times the detour,
+// and original a probe that times the real function
+template <int Probe, typename Fn>
+static bool CreateHookHelper(LPCWSTR moduleName, LPCSTR procName, Fn detour,
+                             Fn *original) {
+  if (!IsHookProfilerEnabled()) {
+    MH_STATUS status = MH_CreateHookApi(moduleName, procName, (LPVOID)detour,
+                                        (LPVOID *)original);
+    return (status == MH_OK);
+  }
+
+  typedef HookProfiler::FunctionProbe<Probe, Fn> P;
+  P::s_detour = detour;
+  MH_STATUS status = MH_CreateHookApi(moduleName, procName, (LPVOID)&P::Call,
+                                      (LPVOID *)&P::s_original);
+  if (status != MH_OK)
+    return false;
+  *original = &P::Original;
+  return true;
 }
 
 // ============================================================================
@@ -902,21 +918,19 @@ bool InitModLoader(const std::string &exePath) {
     return false;
 
   bool allOk = true;
-  allOk &= CreateHookHelper(L"kernel32", "CreateFileW",
-                            (LPVOID)HookedCreateFileW, (LPVOID *)&oCreateFileW);
-  allOk &= CreateHookHelper(L"kernel32", "ReadFile", (LPVOID)HookedReadFile,
-                            (LPVOID *)&oReadFile);
-  allOk &= CreateHookHelper(L"kernel32", "SetFilePointerEx",
-                            (LPVOID)HookedSetFilePointerEx,
-                            (LPVOID *)&oSetFilePointerEx);
-  allOk &= CreateHookHelper(L"kernel32", "SetFilePointer",
-                            (LPVOID)HookedSetFilePointer,
-                            (LPVOID *)&oSetFilePointer);
-  allOk &=
-      CreateHookHelper(L"kernel32", "GetFileSizeEx",
-                       (LPVOID)HookedGetFileSizeEx, (LPVOID *)&oGetFileSizeEx);
-  allOk &= CreateHookHelper(L"kernel32", "CloseHandle",
-                            (LPVOID)HookedCloseHandle, (LPVOID *)&oCloseHandle);
+  allOk &= CreateHookHelper<PROBE_CREATE_FILE>(
+      L"kernel32", "CreateFileW", HookedCreateFileW, &oCreateFileW);
+  allOk &= CreateHookHelper<PROBE_READ_FILE>(L"kernel32", "ReadFile",
+                                             HookedReadFile, &oReadFile);
+  allOk &= CreateHookHelper<PROBE_SET_FILE_POINTER_EX>(
+      L"kernel32", "SetFilePointerEx", HookedSetFilePointerEx,
+      &oSetFilePointerEx);
+  allOk &= CreateHookHelper<PROBE_SET_FILE_POINTER>(
+      L"kernel32", "SetFilePointer", HookedSetFilePointer, &oSetFilePointer);
+  allOk &= CreateHookHelper<PROBE_GET_FILE_SIZE_EX>(
+      L"kernel32", "GetFileSizeEx", HookedGetFileSizeEx, &oGetFileSizeEx);
+  allOk &= CreateHookHelper<PROBE_CLOSE_HANDLE>(
+      L"kernel32", "CloseHandle", HookedCloseHandle, &oCloseHandle);
 
   if (!allOk) {
     MH_Uninitialize();
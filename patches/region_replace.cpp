@@ -0,0 +1,321 @@
+#define NOMINMAX
+#include "region_replace.h"
+#include "../utils/flat_hash.h"
+#include "texturereplace.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <wrl/client.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+UINT g_regionScale = 2;
+
+struct RegionComposite {
+  ComPtr<ID3D11Texture2D> texture; // Created once a tile has a replacement
+  ComPtr<ID3D11ShaderResourceView> srv;
+  UINT scale;
+  UINT tilesX;
+  UINT tilesY;
+  std::vector<uint64_t> tileHashes;
+  std::vector<uint8_t> tileReplaced;
+  UINT replacedCount;
+};
+std::unordered_map<void *, RegionComposite> g_composites;
+
+// Loaded region replacements, keyed by tile hash and format. Kept for the
+// session: tiles move around the atlas and come back.
+std::unordered_map<uint64_t, ComPtr<ID3D11Texture2D>> g_regionTextures;
+
+CRITICAL_SECTION g_compositeCS;
+volatile LONG g_compositeCSInitialized = 0;
+
+void InitCompositeCS() {
+  if (InterlockedCompareExchange(&g_compositeCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_compositeCS);
+  }
+}
+
+// Caller holds g_compositeCS. Returns nullptr if the tile has no usable
+// replacement at exactly tile size x scale.
+ID3D11Texture2D *GetRegionTexture(ID3D11Device *pDevice,
+                                  const D3D11_TEXTURE2D_DESC &desc,
+                                  UINT tileWidth, UINT tileHeight,
+                                  uint64_t tileHash, UINT scale) {
+  uint64_t key = tileHash ^ FlatHashMix((uint64_t)desc.Format);
+  auto it = g_regionTextures.find(key);
+  if (it != g_regionTextures.end())
+    return it->second.Get();
+
+  D3D11_TEXTURE2D_DESC tileDesc = {};
+  tileDesc.Width = tileWidth;
+  tileDesc.Height = tileHeight;
+  tileDesc.MipLevels = 1;
+  tileDesc.ArraySize = 1;
+  tileDesc.Format = desc.Format;
+  tileDesc.SampleDesc.Count = 1;
+  tileDesc.Usage = D3D11_USAGE_DEFAULT;
+  tileDesc.BindFlags = 0; // Only ever a copy source (also skips mip generation)
+
+  ComPtr<ID3D11Texture2D> texture;
+  if (LoadRegionReplacement(pDevice, &tileDesc, tileHash,
+                            texture.GetAddressOf())) {
+    D3D11_TEXTURE2D_DESC loaded;
+    texture->GetDesc(&loaded);
+    if (loaded.Width != tileWidth * scale ||
+        loaded.Height != tileHeight * scale || loaded.Format != desc.Format) {
+      std::cout << "Region replacement " << tileWidth << "x" << tileHeight
+                << " skipped - must be " << tileWidth * scale << "x"
+                << tileHeight * scale << std::endl;
+      texture.Reset();
+    }
+  }
+  // Failures are cached too, so a bad file is reported once
+  g_regionTextures[key] = texture;
+  return texture.Get();
+}
+
+// Caller holds g_compositeCS
+bool CreateComposite(ID3D11Device *pDevice, const D3D11_TEXTURE2D_DESC &desc,
+                     RegionComposite *composite) {
+  D3D11_TEXTURE2D_DESC compositeDesc = {};
+  compositeDesc.Width = desc.Width * composite->scale;
+  compositeDesc.Height = desc.Height * composite->scale;
+  compositeDesc.MipLevels = 1;
+  compositeDesc.ArraySize = 1;
+  compositeDesc.Format = desc.Format;
+  compositeDesc.SampleDesc.Count = 1;
+  compositeDesc.Usage = D3D11_USAGE_DEFAULT;
+  compositeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  if (compositeDesc.Width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+      compositeDesc.Height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+    return false;
+
+  HRESULT hr = pDevice->CreateTexture2D(&compositeDesc, nullptr,
+                                        composite->texture.GetAddressOf());
+  if (FAILED(hr))
+    return false;
+
+  D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+  srvDesc.Format = desc.Format;
+  srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+  srvDesc.Texture2D.MipLevels = 1;
+  hr = pDevice->CreateShaderResourceView(composite->texture.Get(), &srvDesc,
+                                         composite->srv.GetAddressOf());
+  if (FAILED(hr)) {
+    composite->texture.Reset();
+    return false;
+  }
+  return true;
+}
+
+// Rebuild tiles [firstX, endX) of one tile row of the composite: the
+// original pixels upscaled (nearest), then the replaced tiles on top. Caller
+// holds g_compositeCS.
+void RebuildTileSpan(ID3D11DeviceContext *pContext, ID3D11Device *pDevice,
+                     const D3D11_TEXTURE2D_DESC &desc,
+                     const D3D11_MAPPED_SUBRESOURCE &mapped,
+                     UINT bytesPerPixel, RegionComposite *composite,
+                     UINT tileY, UINT firstX, UINT endX,
+                     std::vector<uint8_t> *scratch) {
+  UINT scale = composite->scale;
+  UINT top = tileY * REGION_TILE_SIZE;
+  UINT bottom = std::min(top + REGION_TILE_SIZE, desc.Height);
+  UINT left = firstX * REGION_TILE_SIZE;
+  UINT right = std::min(endX * REGION_TILE_SIZE, desc.Width);
+  UINT dstPitch = (right - left) * scale * bytesPerPixel;
+  scratch->resize(static_cast<size_t>(dstPitch) * (bottom - top) * scale);
+
+  const uint8_t *src = static_cast<const uint8_t *>(mapped.pData);
+  for (UINT y = top; y < bottom; ++y) {
+    const uint8_t *srcRow = src + static_cast<size_t>(y) * mapped.RowPitch;
+    uint8_t *dstRow =
+        scratch->data() + static_cast<size_t>(y - top) * scale * dstPitch;
+    for (UINT x = left; x < right; ++x) {
+      for (UINT s = 0; s < scale; ++s)
+        memcpy(dstRow +
+                   (static_cast<size_t>(x - left) * scale + s) * bytesPerPixel,
+               srcRow + static_cast<size_t>(x) * bytesPerPixel, bytesPerPixel);
+    }
+    for (UINT s = 1; s < scale; ++s)
+      memcpy(dstRow + static_cast<size_t>(s) * dstPitch, dstRow, dstPitch);
+  }
+
+  D3D11_BOX box = {left * scale, top * scale, 0,
+                   right * scale, bottom * scale, 1};
+  pContext->UpdateSubresource(composite->texture.Get(), 0, &box,
+                              scratch->data(), dstPitch, 0);
+
+  for (UINT tileX = firstX; tileX < endX; ++tileX) {
+    size_t tile = static_cast<size_t>(tileY) * composite->tilesX + tileX;
+    if (!composite->tileReplaced[tile])
+      continue;
+    UINT tileLeft = tileX * REGION_TILE_SIZE;
+    UINT tileWidth = std::min(REGION_TILE_SIZE, desc.Width - tileLeft);
+    ID3D11Texture2D *replacement =
+        GetRegionTexture(pDevice, desc, tileWidth, bottom - top,
+                         composite->tileHashes[tile], scale);
+    if (replacement)
+      pContext->CopySubresourceRegion(composite->texture.Get(), 0,
+                                      tileLeft * scale, top * scale, 0,
+                                      replacement, 0, nullptr);
+  }
+}
+} // namespace
+
+uint64_t HashRegionTile(const uint8_t *pTile, UINT rowPitch,
+                        UINT bytesPerPixel, UINT tileWidth, UINT tileHeight) {
+  uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+  UINT rowSize = tileWidth * bytesPerPixel;
+  for (UINT y = 0; y < tileHeight; ++y) {
+    const uint8_t *row = pTile + static_cast<size_t>(y) * rowPitch;
+    for (UINT i = 0; i < rowSize; ++i) {
+      hash ^= row[i];
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+UINT GetRegionBytesPerPixel(DXGI_FORMAT format) {
+  switch (format) {
+  case DXGI_FORMAT_R8G8B8A8_UNORM:
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case DXGI_FORMAT_B8G8R8A8_UNORM:
+  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    return 4;
+  case DXGI_FORMAT_B4G4R4A4_UNORM:
+  case DXGI_FORMAT_R8G8_UNORM:
+    return 2;
+  case DXGI_FORMAT_R8_UNORM:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+void SetRegionCompositeScale(UINT scale) {
+  g_regionScale = std::min(std::max(scale, 1u), 4u);
+}
+
+bool UpdateRegionComposite(ID3D11DeviceContext *pContext,
+                           ID3D11Device *pDevice, void *pTexture,
+                           const D3D11_TEXTURE2D_DESC &desc,
+                           const D3D11_MAPPED_SUBRESOURCE &mapped,
+                           const std::vector<std::pair<UINT, UINT>> &dirtyRows,
+                           ID3D11ShaderResourceView **ppSRV) {
+  *ppSRV = nullptr;
+  UINT bytesPerPixel = GetRegionBytesPerPixel(desc.Format);
+  if (!bytesPerPixel || !mapped.pData)
+    return false;
+
+  InitCompositeCS();
+  EnterCriticalSection(&g_compositeCS);
+
+  auto it = g_composites.find(pTexture);
+  bool created = it == g_composites.end();
+  if (created) {
+    RegionComposite fresh = {};
+    fresh.scale = g_regionScale;
+    fresh.tilesX = (desc.Width + REGION_TILE_SIZE - 1) / REGION_TILE_SIZE;
+    fresh.tilesY = (desc.Height + REGION_TILE_SIZE - 1) / REGION_TILE_SIZE;
+    fresh.tileHashes.assign(static_cast<size_t>(fresh.tilesX) * fresh.tilesY,
+                            0);
+    fresh.tileReplaced.assign(fresh.tileHashes.size(), 0);
+    it = g_composites.emplace(pTexture, std::move(fresh)).first;
+  }
+  RegionComposite &composite = it->second;
+
+  // Tile rows touched since the last call
+  std::vector<uint8_t> rowDirty(composite.tilesY, created ? 1 : 0);
+  for (const auto &rows : dirtyRows) {
+    if (rows.first >= rows.second || rows.first >= desc.Height)
+      continue;
+    UINT last = (std::min(rows.second, desc.Height) - 1) / REGION_TILE_SIZE;
+    for (UINT ty = rows.first / REGION_TILE_SIZE; ty <= last; ++ty)
+      rowDirty[ty] = 1;
+  }
+
+  // Tiles whose content changed; a written row often changes only a few
+  std::vector<uint8_t> tileDirty(composite.tileHashes.size(), 0);
+  const uint8_t *src = static_cast<const uint8_t *>(mapped.pData);
+  for (UINT ty = 0; ty < composite.tilesY; ++ty) {
+    if (!rowDirty[ty])
+      continue;
+    UINT top = ty * REGION_TILE_SIZE;
+    UINT tileHeight = std::min(REGION_TILE_SIZE, desc.Height - top);
+    for (UINT tx = 0; tx < composite.tilesX; ++tx) {
+      UINT left = tx * REGION_TILE_SIZE;
+      UINT tileWidth = std::min(REGION_TILE_SIZE, desc.Width - left);
+      size_t tile = static_cast<size_t>(ty) * composite.tilesX + tx;
+      uint64_t hash = HashRegionTile(
+          src + static_cast<size_t>(top) * mapped.RowPitch +
+              static_cast<size_t>(left) * bytesPerPixel,
+          mapped.RowPitch, bytesPerPixel, tileWidth, tileHeight);
+      if (!created && hash == composite.tileHashes[tile])
+        continue;
+      tileDirty[tile] = 1;
+      uint8_t replaced =
+          HasRegionReplacement(tileWidth, tileHeight, hash) ? 1 : 0;
+      composite.replacedCount += replaced;
+      composite.replacedCount -= composite.tileReplaced[tile];
+      composite.tileHashes[tile] = hash;
+      composite.tileReplaced[tile] = replaced;
+    }
+  }
+
+  bool ok = false;
+  if (composite.replacedCount > 0) {
+    // First replaced tile: build the whole composite
+    bool rebuildAll = false;
+    if (!composite.texture) {
+      rebuildAll = CreateComposite(pDevice, desc, &composite);
+      if (rebuildAll)
+        std::cout << "[Mod] Region composite: " << desc.Width << "x"
+                  << desc.Height << " x" << composite.scale << std::endl;
+    }
+    if (composite.texture) {
+      // Runs of changed tiles are upscaled and uploaded together
+      std::vector<uint8_t> scratch;
+      for (UINT ty = 0; ty < composite.tilesY; ++ty) {
+        if (!rebuildAll && !rowDirty[ty])
+          continue;
+        const uint8_t *dirty =
+            tileDirty.data() + static_cast<size_t>(ty) * composite.tilesX;
+        UINT tx = 0;
+        while (tx < composite.tilesX) {
+          if (!rebuildAll && !dirty[tx]) {
+            ++tx;
+            continue;
+          }
+          UINT end = tx + 1;
+          while (end < composite.tilesX && (rebuildAll || dirty[end]))
+            ++end;
+          RebuildTileSpan(pContext, pDevice, desc, mapped, bytesPerPixel,
+                          &composite, ty, tx, end, &scratch);
+          tx = end;
+        }
+      }
+      *ppSRV = composite.srv.Get();
+      (*ppSRV)->AddRef();
+      ok = true;
+    }
+  } else if (composite.texture) {
+    // Not kept up to date while nothing is replaced; rebuilt on next match
+    composite.srv.Reset();
+    composite.texture.Reset();
+  }
+
+  LeaveCriticalSection(&g_compositeCS);
+  return ok;
+}
+
+void ReleaseRegionComposite(void *pTexture) {
+  InitCompositeCS();
+  EnterCriticalSection(&g_compositeCS);
+  g_composites.erase(pTexture);
+  LeaveCriticalSection(&g_compositeCS);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <d3d11.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Region replacement for atlas textures (emulator VRAM pages)
+//
+// Band-hashed textures (band_hash.h) hold many sprites, so their whole-texture
+// hash changes constantly. They are also split into REGION_TILE_SIZE-pixel
+// tiles, each hashed on its own. Replacements in mods/textures/regions/ are
+// named like whole-texture ones (64x64_<hash>.png) and matched per tile; the
+// matches are composited into an upscaled copy of the atlas that is bound in
+// place of the original. Only tiles in rows written since the last check
+// whose hash changed are rebuilt.
+
+constexpr UINT REGION_TILE_SIZE = 64;
+
+// FNV-1a over a tile's pixel rows (tiles on the right/bottom edge are clipped)
+uint64_t HashRegionTile(const uint8_t *pTile, UINT rowPitch,
+                        UINT bytesPerPixel, UINT tileWidth, UINT tileHeight);
+
+// Bytes per pixel for formats tiles can be cut from, 0 if unsupported
+UINT GetRegionBytesPerPixel(DXGI_FORMAT format);
+
+// Upscale factor of the composite (texture_region_scale, 1-4)
+void SetRegionCompositeScale(UINT scale);
+
+// Update pTexture's tile hashes and composite from its mapped staging mirror.
+// dirtyRows are the pixel rows changed since the last call ([top, bottom)).
+// Returns true with an AddRef'd SRV of the composite while at least one tile
+// has a replacement; false binds the original.
+bool UpdateRegionComposite(ID3D11DeviceContext *pContext,
+                           ID3D11Device *pDevice, void *pTexture,
+                           const D3D11_TEXTURE2D_DESC &desc,
+                           const D3D11_MAPPED_SUBRESOURCE &mapped,
+                           const std::vector<std::pair<UINT, UINT>> &dirtyRows,
+                           ID3D11ShaderResourceView **ppSRV);
+
+// Drop the composite of a destroyed texture
+void ReleaseRegionComposite(void *pTexture);
@@ -0,0 +1,202 @@
+#include "resource_table.h"
+#include "../utils/flat_hash.h"
+#include <Windows.h>
+#include <unordered_set>
+
+namespace {
+// Attached to a resource as private data and released by D3D when the
+// resource is destroyed. Holds the descriptor the table points at, so an
+// entry lives exactly as long as its resource.
+class ResourceDescEntry : public IUnknown {
+public:
+  ResourceDescEntry(void *pResource, bool isTexture2D,
+                    const D3D11_TEXTURE2D_DESC &desc,
+                    ResourceDestroyedCallback onDestroyed)
+      : m_refCount(1), m_resource(pResource), m_armed(false),
+        m_isTexture2D(isTexture2D), m_desc(desc), m_onDestroyed(onDestroyed) {}
+
+  void Arm() { m_armed = true; }
+  // Caller holds g_resourceTableCS
+  void SetOnDestroyed(ResourceDestroyedCallback onDestroyed) {
+    m_onDestroyed = onDestroyed;
+  }
+  bool IsTexture2D() const { return m_isTexture2D; }
+  const D3D11_TEXTURE2D_DESC &GetDesc() const { return m_desc; }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void **ppvObject) override {
+    if (!ppvObject)
+      return E_POINTER;
+    if (riid == __uuidof(IUnknown)) {
+      *ppvObject = static_cast<IUnknown *>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override {
+    return (ULONG)InterlockedIncrement(&m_refCount);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override;
+
+private:
+  volatile LONG m_refCount;
+  void *m_resource;
+  bool m_armed;
+  bool m_isTexture2D;
+  D3D11_TEXTURE2D_DESC m_desc;
+  ResourceDestroyedCallback m_onDestroyed;
+};
+
+// {5A0E7C93-2B4D-4E81-9F36-C81D4A7B20E5}
+const GUID GUID_CrossFixResourceDesc = {
+    0x5a0e7c93,
+    0x2b4d,
+    0x4e81,
+    {0x9f, 0x36, 0xc8, 0x1d, 0x4a, 0x7b, 0x20, 0xe5}};
+
+// Resource ptr -> ResourceDescEntry. Readers hold a reference to the
+// resource they look up, so its entry can't be destroyed under them.
+constexpr size_t RESOURCE_TABLE_CAPACITY = 16384;
+SeqlockPointerMap g_resourceTable(RESOURCE_TABLE_CAPACITY);
+// Resources carrying an entry, whether or not the table had room for it.
+// Guards table writes too.
+std::unordered_set<void *> g_trackedResources;
+CRITICAL_SECTION g_resourceTableCS;
+volatile LONG g_resourceTableCSInitialized = 0;
+
+bool g_countLookups = false; // Set once, before the hooks go in
+volatile LONG g_tableHits = 0;
+volatile LONG g_tableMisses = 0;
+
+void InitResourceTableCS() {
+  if (InterlockedCompareExchange(&g_resourceTableCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_resourceTableCS);
+  }
+}
+
+ULONG STDMETHODCALLTYPE ResourceDescEntry::Release() {
+  LONG count = InterlockedDecrement(&m_refCount);
+  if (count == 0) {
+    if (m_armed) {
+      InitResourceTableCS();
+      EnterCriticalSection(&g_resourceTableCS);
+      g_resourceTable.Erase(m_resource);
+      g_trackedResources.erase(m_resource);
+      ResourceDestroyedCallback onDestroyed = m_onDestroyed;
+      LeaveCriticalSection(&g_resourceTableCS);
+      if (onDestroyed)
+        onDestroyed(m_resource);
+    }
+    delete this;
+  }
+  return (ULONG)count;
+}
+
+// Give an already attached entry its destroy callback. The entry is found
+// through the resource's private data, since a full table may not hold it.
+void SetDestroyedCallback(ID3D11Resource *pResource,
+                          ResourceDestroyedCallback onDestroyed) {
+  IUnknown *unknown = nullptr;
+  UINT size = sizeof(unknown);
+  if (FAILED(pResource->GetPrivateData(GUID_CrossFixResourceDesc, &size,
+                                       &unknown)) ||
+      !unknown)
+    return;
+  EnterCriticalSection(&g_resourceTableCS);
+  static_cast<ResourceDescEntry *>(unknown)->SetOnDestroyed(onDestroyed);
+  LeaveCriticalSection(&g_resourceTableCS);
+  unknown->Release();
+}
+
+// Attach an entry once per resource. SetPrivateDataInterface is called
+// outside our lock: D3D releases entries (taking the lock) from inside its
+// own destruction path.
+void TrackResource(ID3D11Resource *pResource, bool isTexture2D,
+                   const D3D11_TEXTURE2D_DESC &desc,
+                   ResourceDestroyedCallback onDestroyed = nullptr) {
+  InitResourceTableCS();
+  EnterCriticalSection(&g_resourceTableCS);
+  bool isNew = g_trackedResources.insert(pResource).second;
+  LeaveCriticalSection(&g_resourceTableCS);
+  if (!isNew) {
+    // Seen earlier, e.g. by a hook that ran inside the creating call
+    if (onDestroyed)
+      SetDestroyedCallback(pResource, onDestroyed);
+    return;
+  }
+
+  ResourceDescEntry *entry =
+      new ResourceDescEntry(pResource, isTexture2D, desc, onDestroyed);
+  if (SUCCEEDED(pResource->SetPrivateDataInterface(GUID_CrossFixResourceDesc,
+                                                   entry))) {
+    entry->Arm();
+    EnterCriticalSection(&g_resourceTableCS);
+    // A full table only means more queries
+    g_resourceTable.Insert(pResource, entry);
+    LeaveCriticalSection(&g_resourceTableCS);
+  } else {
+    EnterCriticalSection(&g_resourceTableCS);
+    g_trackedResources.erase(pResource);
+    LeaveCriticalSection(&g_resourceTableCS);
+  }
+  entry->Release(); // Resource holds its own reference
+}
+
+} // namespace
+
+void TrackTexture2D(ID3D11Texture2D *pTexture,
+                    ResourceDestroyedCallback onDestroyed) {
+  if (!pTexture)
+    return;
+  D3D11_TEXTURE2D_DESC desc;
+  pTexture->GetDesc(&desc);
+  TrackResource(pTexture, true, desc, onDestroyed);
+}
+
+bool GetTexture2DDesc(ID3D11Resource *pResource, D3D11_TEXTURE2D_DESC *pDesc) {
+  if (!pResource)
+    return false;
+
+  void *value = nullptr;
+  if (g_resourceTable.Find(pResource, &value)) {
+    if (g_countLookups)
+      InterlockedIncrement(&g_tableHits);
+    const ResourceDescEntry *entry =
+        static_cast<const ResourceDescEntry *>(value);
+    if (!entry->IsTexture2D())
+      return false;
+    *pDesc = entry->GetDesc();
+    return true;
+  }
+
+  if (g_countLookups)
+    InterlockedIncrement(&g_tableMisses);
+  D3D11_RESOURCE_DIMENSION dim = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+  pResource->GetType(&dim);
+  bool isTexture2D = dim == D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+  D3D11_TEXTURE2D_DESC desc = {};
+  // ID3D11Texture2D shares its ID3D11Resource base's address
+  if (isTexture2D)
+    static_cast<ID3D11Texture2D *>(pResource)->GetDesc(&desc);
+  TrackResource(pResource, isTexture2D, desc);
+  if (isTexture2D)
+    *pDesc = desc;
+  return isTexture2D;
+}
+
+void EnableResourceTableStats() { g_countLookups = true; }
+
+void GetResourceTableStats(ResourceTableStats *pStats) {
+  if (!pStats)
+    return;
+  InitResourceTableCS();
+  EnterCriticalSection(&g_resourceTableCS);
+  pStats->trackedCount = (uint32_t)g_trackedResources.size();
+  LeaveCriticalSection(&g_resourceTableCS);
+  pStats->hits = (uint32_t)g_tableHits;
+  pStats->misses = (uint32_t)g_tableMisses;
+}
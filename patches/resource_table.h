@@ -0,0 +1,37 @@
+// Resource Table - pointer-keyed side table of resource descriptors
+#pragma once
+#include <d3d11.h>
+#include <cstdint>
+
+// Hooks that only need a resource's type and size (copy boxes, viewport
+// scaling, bind-time checks) read it from here instead of calling
+// QueryInterface/GetDesc/Release on every call. Entries are filled when a
+// texture is created through our CreateTexture2D hook, or on first sight
+// for resources created before the hooks went in, and evicted when the
+// resource is destroyed (private data lifetime tracker).
+
+// Called with the resource pointer as the resource is being destroyed
+typedef void (*ResourceDestroyedCallback)(void *pResource);
+
+// Record a texture created by one of our hooks. onDestroyed (optional)
+// replaces the entry's callback if the texture is tracked already (there
+// is one per resource).
+void TrackTexture2D(ID3D11Texture2D *pTexture,
+                    ResourceDestroyedCallback onDestroyed = nullptr);
+
+// True with *pDesc filled if pResource is a 2D texture. Lock-free once the
+// resource is tracked; otherwise queries and tracks it. The caller must hold
+// a reference to pResource for the duration of the call.
+bool GetTexture2DDesc(ID3D11Resource *pResource, D3D11_TEXTURE2D_DESC *pDesc);
+
+// Lookups are only counted after EnableResourceTableStats (the hook
+// profiler turns it on and reports them per dump), so lookups don't
+// contend on shared counters otherwise
+void EnableResourceTableStats();
+
+struct ResourceTableStats {
+  uint32_t trackedCount;
+  uint32_t hits;   // Answered from the table, since enabled
+  uint32_t misses; // Had to query the resource, since enabled
+};
+void GetResourceTableStats(ResourceTableStats *pStats);
@@ -0,0 +1,216 @@
+#include "room_preload.h"
+#include "../utils/flat_hash.h"
+#include "texturereplace.h"
+#include <Windows.h>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+struct RoomReplacement {
+  uint64_t hash;
+  UINT width;
+  UINT height;
+  DXGI_FORMAT format;
+};
+
+volatile LONG g_preloadEnabled = 0;
+// Guards everything below
+CRITICAL_SECTION g_roomCS;
+
+std::unordered_map<uint64_t, std::vector<RoomReplacement>> g_roomReplacements;
+FlatHashSet64 g_learnedKeys; // Keyed by LearnedKey()
+HANDLE g_roomFile = INVALID_HANDLE_VALUE;
+uint64_t g_currentRoom = 0;
+// Bumped on every room change so a running preload can stop early
+volatile LONG g_roomGeneration = 0;
+ID3D11Device *g_preloadDevice = nullptr; // Held for the session
+HANDLE g_preloadEvent = nullptr;
+
+uint64_t HashRoomName(const char *name) {
+  uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+  for (; *name; ++name) {
+    hash ^= (uint8_t)*name;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline uint64_t LearnedKey(uint64_t room, uint64_t hash, UINT width,
+                           UINT height) {
+  return FlatHashMix(room ^ FlatHashMix(hash ^ (((uint64_t)width << 32) |
+                                                height)));
+}
+
+// Caller holds g_roomCS. Returns true if the pair wasn't known yet.
+bool AddRoomReplacement(const RoomPreloadRecord &record) {
+  if (!g_learnedKeys.Insert(LearnedKey(record.room, record.hash, record.width,
+                                       record.height)))
+    return false;
+  g_roomReplacements[record.room].push_back(
+      {record.hash, record.width, record.height,
+       static_cast<DXGI_FORMAT>(record.format)});
+  return true;
+}
+
+// Caller holds g_roomCS
+void LoadRoomRecords(const std::string &roomsPath) {
+  g_roomFile = CreateFileA(roomsPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (g_roomFile == INVALID_HANDLE_VALUE)
+    return;
+
+  RoomPreloadHeader header = {};
+  DWORD read = 0;
+  bool valid = ReadFile(g_roomFile, &header, sizeof(header), &read, nullptr) &&
+               read == sizeof(header) && header.magic == ROOM_PRELOAD_MAGIC &&
+               header.version == ROOM_PRELOAD_VERSION;
+  if (!valid) {
+    // Missing or outdated: start over
+    CloseHandle(g_roomFile);
+    g_roomFile = CreateFileA(roomsPath.c_str(), FILE_APPEND_DATA,
+                             FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (g_roomFile == INVALID_HANDLE_VALUE)
+      return;
+    header = {ROOM_PRELOAD_MAGIC, ROOM_PRELOAD_VERSION};
+    DWORD written = 0;
+    WriteFile(g_roomFile, &header, sizeof(header), &written, nullptr);
+    return;
+  }
+
+  RoomPreloadRecord record;
+  uint64_t records = 0;
+  while (ReadFile(g_roomFile, &record, sizeof(record), &read, nullptr) &&
+         read == sizeof(record)) {
+    AddRoomReplacement(record);
+    records++;
+  }
+
+  // Cut a trailing partial record (crash mid-append) so new records are
+  // written from the end of the last whole one
+  LARGE_INTEGER end;
+  end.QuadPart = sizeof(header) + records * sizeof(record);
+  if (!SetFilePointerEx(g_roomFile, end, nullptr, FILE_BEGIN) ||
+      !SetEndOfFile(g_roomFile)) {
+    CloseHandle(g_roomFile);
+    g_roomFile = INVALID_HANDLE_VALUE;
+  }
+}
+
+DWORD WINAPI PreloadThread(LPVOID) {
+  std::vector<RoomReplacement> pending;
+  for (;;) {
+    WaitForSingleObject(g_preloadEvent, INFINITE);
+
+    EnterCriticalSection(&g_roomCS);
+    LONG generation = g_roomGeneration;
+    ID3D11Device *device = g_preloadDevice;
+    auto it = g_roomReplacements.find(g_currentRoom);
+    if (it != g_roomReplacements.end())
+      pending = it->second;
+    else
+      pending.clear();
+    LeaveCriticalSection(&g_roomCS);
+
+    // Whatever the last room preloaded and never bound may go again
+    UnpinPreloadedReplacements();
+    if (!device)
+      continue;
+
+    size_t loaded = 0;
+    for (const RoomReplacement &r : pending) {
+      if (g_roomGeneration != generation)
+        break; // Left the room already
+      // Bind-time replacements only need the original's size and format
+      D3D11_TEXTURE2D_DESC desc = {};
+      desc.Width = r.width;
+      desc.Height = r.height;
+      desc.MipLevels = 1;
+      desc.ArraySize = 1;
+      desc.Format = r.format;
+      desc.SampleDesc.Count = 1;
+      desc.Usage = D3D11_USAGE_DEFAULT;
+      desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+      if (PreloadReplacementSRV(device, &desc, r.hash))
+        loaded++;
+    }
+#ifdef _DEBUG
+    if (loaded)
+      std::cout << "[Mod] Preloaded " << loaded << "/" << pending.size()
+                << " replacement(s) for the new room" << std::endl;
+#endif
+  }
+  return 0;
+}
+} // namespace
+
+void InitRoomPreload(const std::string &roomsPath) {
+  if (g_preloadEnabled)
+    return;
+  InitializeCriticalSection(&g_roomCS);
+  EnterCriticalSection(&g_roomCS);
+  LoadRoomRecords(roomsPath);
+  size_t rooms = g_roomReplacements.size();
+  LeaveCriticalSection(&g_roomCS);
+
+  g_preloadEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  HANDLE thread = g_preloadEvent ? CreateThread(nullptr, 0, PreloadThread,
+                                                nullptr, 0, nullptr)
+                                 : nullptr;
+  if (!thread) {
+    std::cout << "[Mod] Failed to start the room preload thread" << std::endl;
+    return;
+  }
+  SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+  CloseHandle(thread);
+  InterlockedExchange(&g_preloadEnabled, 1);
+  std::cout << "[Mod] Room preload: " << rooms
+            << " room(s) in mods/textures.rooms" << std::endl;
+}
+
+void NotifyRoomLoaded(const char *roomName) {
+  if (!g_preloadEnabled || !roomName)
+    return;
+  uint64_t room = HashRoomName(roomName);
+  EnterCriticalSection(&g_roomCS);
+  bool changed = room != g_currentRoom;
+  if (changed) {
+    g_currentRoom = room;
+    InterlockedIncrement(&g_roomGeneration);
+  }
+  LeaveCriticalSection(&g_roomCS);
+  if (changed)
+    SetEvent(g_preloadEvent);
+}
+
+void RecordRoomReplacement(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pDesc,
+                           uint64_t contentHash) {
+  if (!g_preloadEnabled)
+    return;
+  EnterCriticalSection(&g_roomCS);
+  if (!g_preloadDevice) {
+    // Preloads create textures from another thread
+    if (pDevice->GetCreationFlags() & D3D11_CREATE_DEVICE_SINGLETHREADED) {
+      InterlockedExchange(&g_preloadEnabled, 0);
+      LeaveCriticalSection(&g_roomCS);
+      std::cout << "[Mod] Room preload disabled: single-threaded device"
+                << std::endl;
+      return;
+    }
+    g_preloadDevice = pDevice;
+    g_preloadDevice->AddRef();
+  }
+
+  if (g_currentRoom) {
+    RoomPreloadRecord record = {g_currentRoom, contentHash, pDesc->Width,
+                                pDesc->Height, (uint32_t)pDesc->Format, 0};
+    if (AddRoomReplacement(record) && g_roomFile != INVALID_HANDLE_VALUE) {
+      DWORD written = 0;
+      WriteFile(g_roomFile, &record, sizeof(record), &written, nullptr);
+    }
+  }
+  LeaveCriticalSection(&g_roomCS);
+}
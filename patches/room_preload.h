@@ -0,0 +1,44 @@
+// Room Preload - load a room's replacement textures before its first draw
+#pragma once
+#include <d3d11.h>
+#include <cstdint>
+#include <string>
+
+// Persistent room -> replacement map (mods/textures.rooms)
+//
+// Layout: RoomPreloadHeader | RoomPreloadRecord[] (appended as learned)
+// Every bind-time replacement is recorded against the room that was loaded
+// last. When a room is entered again its learned replacements are loaded on
+// a background thread (PreloadReplacementSRV), so the first bind finds them
+// already resident.
+
+constexpr uint32_t ROOM_PRELOAD_MAGIC = 0x50524643; // "CFRP"
+constexpr uint32_t ROOM_PRELOAD_VERSION = 1;
+
+#pragma pack(push, 1)
+struct RoomPreloadHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct RoomPreloadRecord {
+  uint64_t room; // Hash of the room file name (without extension)
+  uint64_t hash; // Content hash of the original texture
+  uint32_t width;
+  uint32_t height;
+  uint32_t format; // DXGI_FORMAT of the original texture
+  uint32_t reserved;
+};
+#pragma pack(pop)
+
+// Load the learned map and start the preload thread
+void InitRoomPreload(const std::string &roomsPath);
+
+// Room file loaded (2D background hook, once per layer). Starts a preload
+// when the room differs from the last one; cheap otherwise.
+void NotifyRoomLoaded(const char *roomName);
+
+// A bind-time replacement matched while in the current room
+void RecordRoomReplacement(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pDesc,
+                           uint64_t contentHash);
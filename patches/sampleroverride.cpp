@@ -1,33 +1,23 @@
 #include "sampleroverride.h"
-#include "../utils/memory.h"
+#include "../utils/hook_registry.h"
 #include "../utils/settings.h"
 #include <Windows.h>
 #include <iostream>
 
 namespace {
-typedef HRESULT(STDMETHODCALLTYPE *CreateSamplerState_t)(
-    ID3D11Device *, const D3D11_SAMPLER_DESC *, ID3D11SamplerState **);
-
-volatile CreateSamplerState_t Original_CreateSamplerState = nullptr;
-volatile LONG g_samplerHookReady = 0;
-} // namespace
-
-HRESULT STDMETHODCALLTYPE
-Hooked_CreateSamplerState(ID3D11Device *This, const D3D11_SAMPLER_DESC *pDesc,
-                          ID3D11SamplerState **ppSamplerState) {
-  MemoryBarrier();
-  CreateSamplerState_t pOriginal = Original_CreateSamplerState;
-
-  if (!pOriginal)
-    return E_FAIL;
-  if (!g_samplerHookReady || !pDesc)
-    return pOriginal(This, pDesc, ppSamplerState);
+HRESULT Hooked_CreateSamplerState(const CreateSamplerStateHook::Next &next,
+                                  ID3D11Device *This,
+                                  const D3D11_SAMPLER_DESC *pDesc,
+                                  ID3D11SamplerState **ppSamplerState) {
+  if (!pDesc)
+    return next(This, pDesc, ppSamplerState);
 
   D3D11_SAMPLER_DESC newDesc = *pDesc;
   newDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
 
-  return pOriginal(This, &newDesc, ppSamplerState);
+  return next(This, &newDesc, ppSamplerState);
 }
+} // namespace
 
 void ApplySamplerOverridePatch(ID3D11Device *pDevice) {
   if (!pDevice)
@@ -47,14 +37,8 @@ void ApplySamplerOverridePatch(ID3D11Device *pDevice) {
     if (!forcePoint)
       return;
 
-    void **deviceVtable = *(void ***)pDevice;
-    if (!deviceVtable)
-      return;
-
-    InstallVtableHook(deviceVtable, 50, 23,
-                      (void *)Hooked_CreateSamplerState,
-                      (volatile void **)&Original_CreateSamplerState,
-                      &g_samplerHookReady);
+    CreateSamplerStateHook::Register(pDevice, HOOK_ORDER_SAMPLER_OVERRIDE,
+                                     Hooked_CreateSamplerState);
 
     Sleep(1);
   } catch (...) {
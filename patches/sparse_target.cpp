@@ -0,0 +1,354 @@
+#include "sparse_target.h"
+#include "../utils/flat_hash.h"
+#include "resource_table.h"
+#include <Windows.h>
+#include <d3d11_2.h>
+#include <iostream>
+#include <vector>
+#include <wrl/client.h>
+
+using Microsoft::WRL::ComPtr;
+
+struct SparseTarget {
+  ID3D11Texture2D *texture; // Not owned; nullptr once destroyed
+  UINT widthInTiles;
+  UINT heightInTiles;
+  UINT tileWidth; // In texels
+  UINT tileHeight;
+  std::vector<UINT> poolTiles; // Per tile (row-major): pool index or UNMAPPED
+  UINT mappedCount;
+  // Tile rect [left, right) x [top, bottom) known to be mapped, so repeated
+  // viewports skip the lock. Seqlock: odd while being written.
+  volatile LONG verifiedSeq;
+  volatile UINT verifiedLeft;
+  volatile UINT verifiedTop;
+  volatile UINT verifiedRight;
+  volatile UINT verifiedBottom;
+  volatile LONG fullyMapped;
+};
+
+namespace {
+constexpr UINT UNMAPPED = 0xFFFFFFFF;
+constexpr UINT TILE_SIZE = D3D11_2_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+constexpr UINT INITIAL_POOL_TILES = 64; // 4 MB
+
+ID3D11Device2 *g_sparseDevice = nullptr;         // Held for the session
+ID3D11DeviceContext2 *g_sparseContext = nullptr; // Immediate, held
+ComPtr<ID3D11Buffer> g_tilePool;
+UINT g_poolTiles = 0;          // Pool size in tiles
+UINT g_poolTilesUsed = 0;      // High-water mark; below it, see g_freeTiles
+std::vector<UINT> g_freeTiles; // Released by destroyed targets
+
+// Sparse targets are never freed (a destroyed one just loses its texture),
+// so a pointer cached on a view or in a hook's shadow never dangles
+SeqlockPointerMap g_sparseTargets(64);
+
+// Bookkeeping above; taken by the destroy callback, so no D3D calls while
+// holding it
+CRITICAL_SECTION g_sparseCS;
+// Serializes tile mapping (held across the D3D calls)
+CRITICAL_SECTION g_sparseMapCS;
+volatile LONG g_sparseCSInitialized = 0;
+
+void InitSparseCS() {
+  if (InterlockedCompareExchange(&g_sparseCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_sparseCS);
+    InitializeCriticalSection(&g_sparseMapCS);
+  }
+}
+
+void OnSparseTargetDestroyed(void *pTexture) {
+  EnterCriticalSection(&g_sparseCS);
+  void *value = nullptr;
+  if (g_sparseTargets.Find(pTexture, &value)) {
+    SparseTarget *target = static_cast<SparseTarget *>(value);
+    for (UINT &poolTile : target->poolTiles) {
+      if (poolTile != UNMAPPED)
+        g_freeTiles.push_back(poolTile);
+      poolTile = UNMAPPED;
+    }
+    target->mappedCount = 0;
+    target->texture = nullptr;
+    g_sparseTargets.Erase(pTexture);
+  }
+  LeaveCriticalSection(&g_sparseCS);
+}
+
+bool IsVerified(const SparseTarget *target, UINT left, UINT top, UINT right,
+                UINT bottom) {
+  LONG seq = target->verifiedSeq;
+  if (seq & 1)
+    return false;
+  bool inside = left >= target->verifiedLeft && top >= target->verifiedTop &&
+                right <= target->verifiedRight &&
+                bottom <= target->verifiedBottom;
+  MemoryBarrier();
+  return inside && target->verifiedSeq == seq;
+}
+
+// Caller holds g_sparseMapCS
+void SetVerified(SparseTarget *target, UINT left, UINT top, UINT right,
+                 UINT bottom) {
+  InterlockedIncrement(&target->verifiedSeq);
+  target->verifiedLeft = left;
+  target->verifiedTop = top;
+  target->verifiedRight = right;
+  target->verifiedBottom = bottom;
+  InterlockedIncrement(&target->verifiedSeq);
+}
+
+// Map every unmapped tile of the tile rect (only those mapped in `like`,
+// if given). Caller holds g_sparseMapCS and a reference to the texture.
+bool MapTiles(SparseTarget *target, ID3D11DeviceContext *pContext, UINT left,
+              UINT top, UINT right, UINT bottom, const SparseTarget *like) {
+  // Allocate pool tiles up front, under the bookkeeping lock
+  std::vector<UINT> newTiles; // Tile index in the target
+  std::vector<UINT> poolOffsets;
+  UINT poolTilesNeeded = 0;
+  EnterCriticalSection(&g_sparseCS);
+  ID3D11Texture2D *texture = target->texture;
+  if (texture) {
+    for (UINT y = top; y < bottom; ++y) {
+      for (UINT x = left; x < right; ++x) {
+        UINT index = y * target->widthInTiles + x;
+        if (target->poolTiles[index] != UNMAPPED)
+          continue;
+        if (like && like->poolTiles[index] == UNMAPPED)
+          continue;
+        UINT poolTile;
+        if (!g_freeTiles.empty()) {
+          poolTile = g_freeTiles.back();
+          g_freeTiles.pop_back();
+        } else {
+          poolTile = g_poolTilesUsed++;
+        }
+        target->poolTiles[index] = poolTile;
+        newTiles.push_back(index);
+        poolOffsets.push_back(poolTile);
+      }
+    }
+    target->mappedCount += (UINT)newTiles.size();
+    poolTilesNeeded = g_poolTilesUsed;
+  }
+  LeaveCriticalSection(&g_sparseCS);
+  if (!texture)
+    return false;
+  if (newTiles.empty())
+    return true;
+
+  // Only the immediate context grows the pool; any context may map
+  if (poolTilesNeeded > g_poolTiles) {
+    UINT newSize = g_poolTiles;
+    while (newSize < poolTilesNeeded)
+      newSize *= 2;
+    if (FAILED(g_sparseContext->ResizeTilePool(g_tilePool.Get(),
+                                               (UINT64)newSize * TILE_SIZE))) {
+      std::cout << "[Mod] Warning: sparse upscale tile pool could not grow "
+                   "to "
+                << (newSize / 16) << " MB" << std::endl;
+      // Give the tiles back; drawing there is lost
+      EnterCriticalSection(&g_sparseCS);
+      for (size_t i = 0; i < newTiles.size(); ++i) {
+        target->poolTiles[newTiles[i]] = UNMAPPED;
+        // Tiles past the pool were the last ones taken from the high-water
+        // mark; the rest came from the free list
+        if (poolOffsets[i] >= g_poolTiles)
+          g_poolTilesUsed--;
+        else
+          g_freeTiles.push_back(poolOffsets[i]);
+      }
+      target->mappedCount -= (UINT)newTiles.size();
+      LeaveCriticalSection(&g_sparseCS);
+      return false;
+    }
+    g_poolTiles = newSize;
+  }
+
+  ComPtr<ID3D11DeviceContext2> pContext2;
+  if (pContext == g_sparseContext)
+    pContext2 = g_sparseContext;
+  else if (FAILED(pContext->QueryInterface(
+               __uuidof(ID3D11DeviceContext2),
+               (void **)pContext2.GetAddressOf())))
+    return false;
+
+  size_t count = newTiles.size();
+  std::vector<D3D11_TILED_RESOURCE_COORDINATE> coords(count);
+  std::vector<D3D11_TILE_REGION_SIZE> sizes(count);
+  std::vector<UINT> rangeCounts(count, 1);
+  std::vector<D3D11_RECT> rects(count);
+  for (size_t i = 0; i < count; ++i) {
+    UINT x = newTiles[i] % target->widthInTiles;
+    UINT y = newTiles[i] / target->widthInTiles;
+    coords[i] = {x, y, 0, 0};
+    sizes[i] = {};
+    sizes[i].NumTiles = 1;
+    rects[i].left = (LONG)(x * target->tileWidth);
+    rects[i].top = (LONG)(y * target->tileHeight);
+    rects[i].right = rects[i].left + (LONG)target->tileWidth;
+    rects[i].bottom = rects[i].top + (LONG)target->tileHeight;
+  }
+  pContext2->UpdateTileMappings(texture, (UINT)count, coords.data(),
+                                sizes.data(), g_tilePool.Get(), (UINT)count,
+                                nullptr, poolOffsets.data(),
+                                rangeCounts.data(), 0);
+
+  // Pool memory starts out undefined
+  ComPtr<ID3D11RenderTargetView> rtv;
+  if (SUCCEEDED(g_sparseDevice->CreateRenderTargetView(texture, nullptr,
+                                                       rtv.GetAddressOf()))) {
+    const FLOAT zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    pContext2->ClearView(rtv.Get(), zero, rects.data(), (UINT)count);
+  }
+
+  if (target->mappedCount == target->widthInTiles * target->heightInTiles)
+    InterlockedExchange(&target->fullyMapped, 1);
+
+#ifdef _DEBUG
+  std::cout << "[Mod] Sparse upscale: " << target->mappedCount << "/"
+            << target->widthInTiles * target->heightInTiles
+            << " tiles mapped, pool " << (g_poolTiles / 16) << " MB"
+            << std::endl;
+#endif
+  return true;
+}
+} // namespace
+
+bool InitSparseTargets(ID3D11Device *pDevice, ID3D11DeviceContext *pContext) {
+  if (!pDevice || !pContext)
+    return false;
+  InitSparseCS();
+  if (g_tilePool)
+    return true;
+
+  D3D11_FEATURE_DATA_D3D11_OPTIONS1 options = {};
+  if (FAILED(pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS1,
+                                          &options, sizeof(options))) ||
+      options.TiledResourcesTier < D3D11_TILED_RESOURCES_TIER_2)
+    return false;
+
+  ComPtr<ID3D11Device2> pDevice2;
+  ComPtr<ID3D11DeviceContext2> pContext2;
+  if (FAILED(pDevice->QueryInterface(__uuidof(ID3D11Device2),
+                                     (void **)pDevice2.GetAddressOf())) ||
+      FAILED(pContext->QueryInterface(__uuidof(ID3D11DeviceContext2),
+                                      (void **)pContext2.GetAddressOf())))
+    return false;
+
+  D3D11_BUFFER_DESC poolDesc = {};
+  poolDesc.ByteWidth = INITIAL_POOL_TILES * TILE_SIZE;
+  poolDesc.Usage = D3D11_USAGE_DEFAULT;
+  poolDesc.MiscFlags = D3D11_RESOURCE_MISC_TILE_POOL;
+  if (FAILED(pDevice->CreateBuffer(&poolDesc, nullptr,
+                                   g_tilePool.GetAddressOf())))
+    return false;
+
+  g_poolTiles = INITIAL_POOL_TILES;
+  g_sparseDevice = pDevice2.Detach();
+  g_sparseContext = pContext2.Detach();
+  return true;
+}
+
+bool CreateSparseTarget(ID3D11Device *pDevice, const D3D11_TEXTURE2D_DESC &desc,
+                        ID3D11Texture2D **ppTexture) {
+  if (!g_tilePool || !ppTexture || desc.MipLevels != 1 ||
+      desc.ArraySize != 1 || desc.SampleDesc.Count != 1 ||
+      desc.Usage != D3D11_USAGE_DEFAULT || desc.CPUAccessFlags ||
+      desc.MiscFlags)
+    return false;
+
+  D3D11_TEXTURE2D_DESC tiledDesc = desc;
+  tiledDesc.MiscFlags = D3D11_RESOURCE_MISC_TILED;
+  ID3D11Texture2D *texture = nullptr;
+  if (FAILED(pDevice->CreateTexture2D(&tiledDesc, nullptr, &texture)))
+    return false;
+
+  UINT totalTiles = 0;
+  D3D11_PACKED_MIP_DESC packedMips = {};
+  D3D11_TILE_SHAPE tileShape = {};
+  UINT subresourceCount = 1;
+  D3D11_SUBRESOURCE_TILING tiling = {};
+  g_sparseDevice->GetResourceTiling(texture, &totalTiles, &packedMips,
+                                    &tileShape, &subresourceCount, 0,
+                                    &tiling);
+  if (!tiling.WidthInTiles || !tiling.HeightInTiles ||
+      !tileShape.WidthInTexels || !tileShape.HeightInTexels) {
+    texture->Release();
+    return false;
+  }
+
+  SparseTarget *target = new SparseTarget();
+  target->texture = texture;
+  target->widthInTiles = tiling.WidthInTiles;
+  target->heightInTiles = tiling.HeightInTiles;
+  target->tileWidth = tileShape.WidthInTexels;
+  target->tileHeight = tileShape.HeightInTexels;
+  target->poolTiles.assign(target->widthInTiles * target->heightInTiles,
+                           UNMAPPED);
+  target->mappedCount = 0;
+  target->verifiedSeq = 0;
+  target->fullyMapped = 0;
+
+  EnterCriticalSection(&g_sparseCS);
+  bool published = g_sparseTargets.Insert(texture, target);
+  LeaveCriticalSection(&g_sparseCS);
+  if (!published) {
+    // Table full: fall back to a regular target
+    delete target;
+    texture->Release();
+    return false;
+  }
+  TrackTexture2D(texture, OnSparseTargetDestroyed);
+
+  std::cout << "[Mod] Sparse upscale target: " << desc.Width << "x"
+            << desc.Height << ", " << target->widthInTiles << "x"
+            << target->heightInTiles << " tiles mapped on use" << std::endl;
+  *ppTexture = texture;
+  return true;
+}
+
+SparseTarget *FindSparseTarget(const void *pTexture) {
+  void *value = nullptr;
+  if (!g_sparseTargets.Find(pTexture, &value))
+    return nullptr;
+  return static_cast<SparseTarget *>(value);
+}
+
+void TouchSparseRect(SparseTarget *target, ID3D11DeviceContext *pContext,
+                     UINT left, UINT top, UINT right, UINT bottom) {
+  if (!target || !pContext || target->fullyMapped || right <= left ||
+      bottom <= top)
+    return;
+
+  UINT tileLeft = left / target->tileWidth;
+  UINT tileTop = top / target->tileHeight;
+  UINT tileRight = (right + target->tileWidth - 1) / target->tileWidth;
+  UINT tileBottom = (bottom + target->tileHeight - 1) / target->tileHeight;
+  if (tileRight > target->widthInTiles)
+    tileRight = target->widthInTiles;
+  if (tileBottom > target->heightInTiles)
+    tileBottom = target->heightInTiles;
+  if (tileLeft >= tileRight || tileTop >= tileBottom)
+    return;
+  if (IsVerified(target, tileLeft, tileTop, tileRight, tileBottom))
+    return;
+
+  EnterCriticalSection(&g_sparseMapCS);
+  if (MapTiles(target, pContext, tileLeft, tileTop, tileRight, tileBottom,
+               nullptr))
+    SetVerified(target, tileLeft, tileTop, tileRight, tileBottom);
+  LeaveCriticalSection(&g_sparseMapCS);
+}
+
+void TouchSparseCopy(SparseTarget *dst, const SparseTarget *src,
+                     ID3D11DeviceContext *pContext) {
+  if (!dst || !pContext || dst->fullyMapped)
+    return;
+  bool sameGrid = src && src->widthInTiles == dst->widthInTiles &&
+                  src->heightInTiles == dst->heightInTiles;
+
+  EnterCriticalSection(&g_sparseMapCS);
+  MapTiles(dst, pContext, 0, 0, dst->widthInTiles, dst->heightInTiles,
+           sameGrid ? src : nullptr);
+  LeaveCriticalSection(&g_sparseMapCS);
+}
@@ -0,0 +1,37 @@
+// Sparse Target - upscaled render targets backed only where they are used
+#pragma once
+#include <d3d11.h>
+
+// The game draws into a small display area of its 4096x2048 emulator target
+// plus a few scratch regions. With upscale_sparse the upscaled target is a
+// tiled resource (D3D11.2, tiled resources tier 2) and 64 KB tiles from a
+// shared pool are mapped only under the rectangles that viewports, copies
+// and UpdateSubresource boxes touch. Writes without a known extent (UAV
+// binds, clears to a non-zero value) map every tile. Texel coordinates
+// don't change, so shaders sampling the target need no remapping; unmapped
+// tiles read as zero and drop writes.
+struct SparseTarget;
+
+// True if the device supports sparse targets. pContext is the immediate
+// context, which grows the tile pool.
+bool InitSparseTargets(ID3D11Device *pDevice, ID3D11DeviceContext *pContext);
+
+// Create a tiled texture for desc (already at the upscaled size). Returns
+// false, having created nothing, if desc can't be tiled.
+bool CreateSparseTarget(ID3D11Device *pDevice, const D3D11_TEXTURE2D_DESC &desc,
+                        ID3D11Texture2D **ppTexture);
+
+// Lock-free; nullptr if pTexture isn't a live sparse target. The caller
+// must hold a reference to pTexture.
+SparseTarget *FindSparseTarget(const void *pTexture);
+
+// Map the tiles under texels [left, right) x [top, bottom) before pContext
+// writes there. New tiles are cleared to zero, which is what they read as
+// before. Lock-free when they are mapped already.
+void TouchSparseRect(SparseTarget *target, ID3D11DeviceContext *pContext,
+                     UINT left, UINT top, UINT right, UINT bottom);
+
+// Whole-resource copy into dst: maps the tiles src has mapped, or all of
+// them when src (nullptr) isn't a sparse target of the same size
+void TouchSparseCopy(SparseTarget *dst, const SparseTarget *src,
+                     ID3D11DeviceContext *pContext);
@@ -0,0 +1,90 @@
+#include "texture_filter.h"
+#include <cstdlib>
+
+// Check if format is dumpable
+bool IsDumpableFormat(DXGI_FORMAT format) {
+  switch (format) {
+  case DXGI_FORMAT_R8G8B8A8_UNORM:
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case DXGI_FORMAT_B8G8R8A8_UNORM:
+  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+  case DXGI_FORMAT_B4G4R4A4_UNORM:
+  case DXGI_FORMAT_R8_UNORM:
+  case DXGI_FORMAT_R8G8_UNORM:
+  // Compressed formats
+  case DXGI_FORMAT_BC1_UNORM: // DXT1
+  case DXGI_FORMAT_BC1_UNORM_SRGB:
+  case DXGI_FORMAT_BC2_UNORM: // DXT3
+  case DXGI_FORMAT_BC2_UNORM_SRGB:
+  case DXGI_FORMAT_BC3_UNORM: // DXT5
+  case DXGI_FORMAT_BC3_UNORM_SRGB:
+  case DXGI_FORMAT_BC7_UNORM:
+  case DXGI_FORMAT_BC7_UNORM_SRGB:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool ParseReplacementFilename(const std::string &filename, uint32_t *outW,
+                              uint32_t *outH, uint64_t *outHash) {
+  const char *p = filename.c_str();
+  char *end = nullptr;
+  unsigned long w = strtoul(p, &end, 10);
+  if (end == p || *end != 'x')
+    return false;
+  p = end + 1;
+  unsigned long h = strtoul(p, &end, 10);
+  if (end == p || *end != '_')
+    return false;
+  if (w == 0 || h == 0)
+    return false;
+  size_t pos = filename.find('_');
+  if (pos == std::string::npos || filename.size() < pos + 17)
+    return false;
+  // Accept .dds or .png extension
+  bool isDds = filename.size() >= 4 &&
+               filename.compare(filename.size() - 4, 4, ".dds") == 0;
+  bool isPng = filename.size() >= 4 &&
+               filename.compare(filename.size() - 4, 4, ".png") == 0;
+  if (!isDds && !isPng)
+    return false;
+  const char *hex = filename.c_str() + pos + 1;
+  uint64_t hash = 0;
+  for (int i = 0; i < 16 && hex[i]; i++) {
+    int nibble = 0;
+    if (hex[i] >= '0' && hex[i] <= '9')
+      nibble = hex[i] - '0';
+    else if (hex[i] >= 'a' && hex[i] <= 'f')
+      nibble = hex[i] - 'a' + 10;
+    else if (hex[i] >= 'A' && hex[i] <= 'F')
+      nibble = hex[i] - 'A' + 10;
+    else
+      return false;
+    hash = (hash << 4) | nibble;
+  }
+  *outW = (uint32_t)w;
+  *outH = (uint32_t)h;
+  *outHash = hash;
+  return true;
+}
+
+BindSkip GetBindSkip(const BindFilter &filter, uint32_t width,
+                     uint32_t height, DXGI_FORMAT format, bool renderTarget,
+                     bool regionCandidate) {
+  // Huge framebuffers, and blank at creation
+  if (filter.upscaledWidth && width == filter.upscaledWidth &&
+      height == filter.upscaledHeight && renderTarget)
+    return BIND_SKIP_UPSCALED_TARGET;
+
+  if (width < 4 || height < 4 || !IsDumpableFormat(format))
+    return BIND_SKIP_UNSUPPORTED;
+
+  // Dimension pre-filter: if no replacement file exists at these dimensions,
+  // skip the expensive staging copy entirely. This eliminates the vast
+  // majority of GPU staging work.
+  if (filter.replaceEnabled && !filter.dumpEnabled && !regionCandidate &&
+      !filter.hasReplacementAtSize(width, height))
+    return BIND_SKIP_NO_REPLACEMENT;
+  return BIND_SKIP_NONE;
+}
@@ -0,0 +1,41 @@
+// Texture Filter - descriptor and filename checks for dumping and replacing
+#pragma once
+#include <cstdint>
+#include <dxgiformat.h>
+#include <string>
+
+// Decisions made from a texture's descriptor alone, with no Win32 or D3D11
+// dependency beyond the format enum, so the trace replayer
+// (tests/trace_replay.cpp) makes the same ones off Windows.
+
+// Formats textures are dumped and replaced in
+bool IsDumpableFormat(DXGI_FORMAT format);
+
+// Parse "WxH_<16hex>.dds" or "WxH_<16hex>.png" filename.
+bool ParseReplacementFilename(const std::string &filename, uint32_t *outW,
+                              uint32_t *outH, uint64_t *outHash);
+
+// Why PSSetShaderResources never has to stage a bound texture. Any reason
+// but BIND_SKIP_NONE holds until the texture is destroyed, whatever is
+// written to it.
+enum BindSkip {
+  BIND_SKIP_NONE,            // Stage and hash it
+  BIND_SKIP_UPSCALED_TARGET, // Upscaled render target, no useful content
+  BIND_SKIP_UNSUPPORTED,     // Smaller than 4x4, or not a dumpable format
+  BIND_SKIP_NO_REPLACEMENT,  // Replacing only, and no file at its size
+};
+
+struct BindFilter {
+  bool dumpEnabled;
+  bool replaceEnabled;
+  uint32_t upscaledWidth; // 0 without upscale
+  uint32_t upscaledHeight;
+  // Any replacement file at this size (HasReplacementAtDimensions)
+  bool (*hasReplacementAtSize)(uint32_t width, uint32_t height);
+};
+
+// regionCandidate: the texture can take region replacements
+// (region_replace.h), so its size alone doesn't rule it out
+BindSkip GetBindSkip(const BindFilter &filter, uint32_t width,
+                     uint32_t height, DXGI_FORMAT format, bool renderTarget,
+                     bool regionCandidate);
@@ -0,0 +1,250 @@
+#define NOMINMAX
+#include "texture_pack.h"
+#include "band_hash.h"
+#include <algorithm>
+#include <tuple>
+
+static constexpr uint64_t PAYLOAD_ALIGNMENT = 16;
+
+static bool EntryLess(const PackEntry &a, const PackEntry &b) {
+  return std::tie(a.width, a.height, a.hash) <
+         std::tie(b.width, b.height, b.hash);
+}
+
+// ============================================================================
+// TexturePack (reader)
+// ============================================================================
+
+TexturePack::TexturePack()
+    : m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_indexView(nullptr),
+      m_index(nullptr), m_entryCount(0), m_fileSize(0), m_source() {}
+
+TexturePack::~TexturePack() { Close(); }
+
+bool TexturePack::Open(const std::string &path) {
+  Close();
+
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size) ||
+      (uint64_t)size.QuadPart < sizeof(PackHeader)) {
+    Close();
+    return false;
+  }
+  m_fileSize = (uint64_t)size.QuadPart;
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_mapping) {
+    Close();
+    return false;
+  }
+
+  // Header is read through a small view; the index gets its own view below
+  const PackHeader *header = (const PackHeader *)MapViewOfFile(
+      m_mapping, FILE_MAP_READ, 0, 0, sizeof(PackHeader));
+  if (!header) {
+    Close();
+    return false;
+  }
+  PackHeader hdr = *header;
+  UnmapViewOfFile(header);
+
+  uint64_t indexSize = (uint64_t)hdr.entryCount * sizeof(PackEntry);
+  if (hdr.magic != TEXTURE_PACK_MAGIC || hdr.version != TEXTURE_PACK_VERSION ||
+      hdr.entryCount == 0 || hdr.indexOffset + indexSize > m_fileSize) {
+    Close();
+    return false;
+  }
+
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  uint64_t granularity = si.dwAllocationGranularity;
+  uint64_t viewStart = hdr.indexOffset - (hdr.indexOffset % granularity);
+  size_t viewSize = (size_t)(hdr.indexOffset - viewStart + indexSize);
+
+  m_indexView =
+      MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(viewStart >> 32),
+                    (DWORD)(viewStart & 0xFFFFFFFF), viewSize);
+  if (!m_indexView) {
+    Close();
+    return false;
+  }
+
+  m_index = (const PackEntry *)((const uint8_t *)m_indexView +
+                                (hdr.indexOffset - viewStart));
+  m_entryCount = hdr.entryCount;
+  m_source = hdr.source;
+  return true;
+}
+
+void TexturePack::Close() {
+  if (m_indexView)
+    UnmapViewOfFile(m_indexView);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+  m_mapping = nullptr;
+  m_indexView = nullptr;
+  m_index = nullptr;
+  m_entryCount = 0;
+  m_fileSize = 0;
+  m_source = PackSource();
+}
+
+const uint8_t *TexturePack::MapPayload(const PackEntry &entry,
+                                       void **outView) const {
+  if (!m_mapping || !outView || entry.dataSize == 0 ||
+      entry.dataOffset + entry.dataSize > m_fileSize)
+    return nullptr;
+
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  uint64_t granularity = si.dwAllocationGranularity;
+  uint64_t viewStart = entry.dataOffset - (entry.dataOffset % granularity);
+  size_t viewSize = (size_t)(entry.dataOffset - viewStart + entry.dataSize);
+
+  void *view = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(viewStart >> 32),
+                             (DWORD)(viewStart & 0xFFFFFFFF), viewSize);
+  if (!view)
+    return nullptr;
+
+  *outView = view;
+  return (const uint8_t *)view + (entry.dataOffset - viewStart);
+}
+
+void TexturePack::UnmapPayload(void *view) {
+  if (view)
+    UnmapViewOfFile(view);
+}
+
+// ============================================================================
+// TexturePackWriter
+// ============================================================================
+
+TexturePackWriter::TexturePackWriter()
+    : m_source(), m_file(INVALID_HANDLE_VALUE), m_offset(0),
+      m_sharedPayloads(0) {}
+
+TexturePackWriter::~TexturePackWriter() {
+  if (m_file != INVALID_HANDLE_VALUE) {
+    CloseHandle(m_file);
+    DeleteFileA(m_tempPath.c_str());
+  }
+}
+
+bool TexturePackWriter::Write(const void *data, size_t size) {
+  const uint8_t *src = (const uint8_t *)data;
+  while (size > 0) {
+    DWORD chunk = (DWORD)std::min<size_t>(size, 0x10000000);
+    DWORD written = 0;
+    if (!WriteFile(m_file, src, chunk, &written, nullptr) || written != chunk)
+      return false;
+    src += chunk;
+    size -= chunk;
+    m_offset += chunk;
+  }
+  return true;
+}
+
+bool TexturePackWriter::Begin(const std::string &path,
+                              const PackSource &source) {
+  m_path = path;
+  m_tempPath = path + ".tmp";
+  m_source = source;
+  m_entries.clear();
+  m_payloads.clear();
+  m_sharedPayloads = 0;
+  m_offset = 0;
+
+  m_file = CreateFileA(m_tempPath.c_str(), GENERIC_WRITE, 0, nullptr,
+                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  // Placeholder header, rewritten in Finish()
+  PackHeader header = {};
+  return Write(&header, sizeof(header));
+}
+
+bool TexturePackWriter::Add(const PackEntry &entry, const void *data,
+                            size_t size) {
+  if (m_file == INVALID_HANDLE_VALUE || !data || size == 0)
+    return false;
+
+  PackEntry stored = entry;
+  uint64_t digest = 0;
+  bool hashed = HashBuffer(static_cast<const uint8_t *>(data), size, 0,
+                           &digest);
+  if (hashed) {
+    auto it = m_payloads.find(digest);
+    if (it != m_payloads.end() && it->second.size == size) {
+      stored.dataOffset = it->second.offset;
+      stored.dataSize = size;
+      m_entries.push_back(stored);
+      m_sharedPayloads++;
+      return true;
+    }
+  }
+
+  static const uint8_t padding[PAYLOAD_ALIGNMENT] = {};
+  uint64_t pad = (PAYLOAD_ALIGNMENT - (m_offset % PAYLOAD_ALIGNMENT)) %
+                 PAYLOAD_ALIGNMENT;
+  if (pad && !Write(padding, (size_t)pad))
+    return false;
+
+  stored.dataOffset = m_offset;
+  stored.dataSize = size;
+  if (!Write(data, size))
+    return false;
+
+  if (hashed)
+    m_payloads[digest] = {stored.dataOffset, stored.dataSize};
+  m_entries.push_back(stored);
+  return true;
+}
+
+bool TexturePackWriter::Finish() {
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  std::sort(m_entries.begin(), m_entries.end(), EntryLess);
+  // Duplicate keys (same hash as .png and .dds) - keep the first
+  m_entries.erase(std::unique(m_entries.begin(), m_entries.end(),
+                              [](const PackEntry &a, const PackEntry &b) {
+                                return !EntryLess(a, b) && !EntryLess(b, a);
+                              }),
+                  m_entries.end());
+
+  PackHeader header = {};
+  header.magic = TEXTURE_PACK_MAGIC;
+  header.version = TEXTURE_PACK_VERSION;
+  header.entryCount = (uint32_t)m_entries.size();
+  header.indexOffset = m_offset;
+  header.source = m_source;
+
+  bool ok = m_entries.empty() ||
+            Write(m_entries.data(), m_entries.size() * sizeof(PackEntry));
+  if (ok) {
+    LARGE_INTEGER zero = {};
+    DWORD written = 0;
+    ok = SetFilePointerEx(m_file, zero, nullptr, FILE_BEGIN) &&
+         WriteFile(m_file, &header, sizeof(header), &written, nullptr) &&
+         written == sizeof(header);
+  }
+
+  CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+
+  if (!ok || m_entries.empty()) {
+    DeleteFileA(m_tempPath.c_str());
+    return false;
+  }
+  return MoveFileExA(m_tempPath.c_str(), m_path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING) != 0;
+}
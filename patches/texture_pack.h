@@ -0,0 +1,127 @@
+#pragma once
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compiled texture pack (mods/textures.pack)
+//
+// Layout: PackHeader | payloads (16-byte aligned) | PackEntry[entryCount]
+// Entries are sorted by (width, height, hash); the replacer loads them into
+// its in-memory index (ReplacementIndex) when the pack is opened. Payloads
+// are stored already converted to the entry's DXGI format and can be handed
+// to CreateTexture2D straight from the mapping. Identical payloads are stored
+// once; their entries share a dataOffset. The header records what the pack
+// was compiled from, so a pack older than the loose folder isn't used.
+
+constexpr uint32_t TEXTURE_PACK_MAGIC = 0x50544643; // "CFTP"
+constexpr uint32_t TEXTURE_PACK_VERSION = 2;
+
+// Mips were generated for HD replacements (texture_replace_mipmaps)
+constexpr uint32_t PACK_SOURCE_MIPS = 1;
+// ...with the Kaiser filter (texture_replace_mip_filter=kaiser)
+constexpr uint32_t PACK_SOURCE_KAISER = 2;
+
+#pragma pack(push, 1)
+// The loose files a pack was compiled from and the settings baked into it
+struct PackSource {
+  uint32_t fileCount;   // Replacement files, plus aliases.txt
+  uint32_t flags;       // PACK_SOURCE_*
+  uint64_t newestWrite; // Latest last-write FILETIME among them
+  uint64_t nameDigest;  // Sum of their name hashes, to catch renames
+};
+
+struct PackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+  uint64_t indexOffset;
+  PackSource source;
+};
+
+struct PackEntry {
+  uint32_t width;      // Original texture width (lookup key)
+  uint32_t height;     // Original texture height (lookup key)
+  uint64_t hash;       // Original texture content hash (lookup key)
+  uint32_t format;     // DXGI_FORMAT of payload (UNKNOWN = raw, use target's)
+  uint32_t dataWidth;  // Replacement width (HD replacements differ from key)
+  uint32_t dataHeight; // Replacement height
+  uint32_t rowPitch;   // 0 = derive from the target format at load time
+  uint32_t mipLevels;
+  uint32_t reserved;
+  uint64_t dataOffset; // Absolute file offset of the payload
+  uint64_t dataSize;
+};
+#pragma pack(pop)
+
+inline bool SamePackSource(const PackSource &a, const PackSource &b) {
+  return a.fileCount == b.fileCount && a.flags == b.flags &&
+         a.newestWrite == b.newestWrite && a.nameDigest == b.nameDigest;
+}
+
+// Read-only, memory-mapped pack. The index stays mapped for the session;
+// payloads are mapped on demand so large packs fit a 32-bit address space.
+class TexturePack {
+public:
+  TexturePack();
+  ~TexturePack();
+
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return m_index != nullptr; }
+
+  uint32_t GetEntryCount() const { return m_entryCount; }
+  const PackEntry &GetEntry(uint32_t i) const { return m_index[i]; }
+  const PackSource &GetSource() const { return m_source; }
+
+  // Map an entry's payload. Returns pointer to the first payload byte and a
+  // view handle for UnmapPayload, or nullptr on failure.
+  const uint8_t *MapPayload(const PackEntry &entry, void **outView) const;
+  static void UnmapPayload(void *view);
+
+private:
+  HANDLE m_file;
+  HANDLE m_mapping;
+  void *m_indexView;
+  const PackEntry *m_index;
+  uint32_t m_entryCount;
+  uint64_t m_fileSize;
+  PackSource m_source;
+};
+
+// Streams payloads to disk and writes the sorted index on Finish().
+// Writes to "<path>.tmp" and swaps it in, so a failed build keeps the old pack.
+class TexturePackWriter {
+public:
+  TexturePackWriter();
+  ~TexturePackWriter();
+
+  // source goes into the header
+  bool Begin(const std::string &path, const PackSource &source);
+  // entry.dataOffset/dataSize are filled in by the writer. A payload whose
+  // bytes were already added is not written again.
+  bool Add(const PackEntry &entry, const void *data, size_t size);
+  bool Finish();
+  size_t GetEntryCount() const { return m_entries.size(); }
+  // Entries that reused an earlier entry's payload
+  size_t GetSharedPayloadCount() const { return m_sharedPayloads; }
+
+private:
+  struct StoredPayload {
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  bool Write(const void *data, size_t size);
+
+  std::string m_path;
+  std::string m_tempPath;
+  PackSource m_source;
+  HANDLE m_file;
+  uint64_t m_offset;
+  std::vector<PackEntry> m_entries;
+  std::unordered_map<uint64_t, StoredPayload> m_payloads; // By content hash
+  size_t m_sharedPayloads;
+};
@@ -0,0 +1,169 @@
+#include "texture_scan.h"
+#include <cstring>
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere; GCC and Clang need the function
+// marked
+#if defined(__GNUC__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+typedef void (*ScanRowsFn)(const uint8_t *, uint32_t, uint32_t, uint32_t,
+                           uint64_t *, PixelScan *);
+
+inline uint64_t HashBytes(const uint8_t *data, uint32_t size, uint64_t hash) {
+  for (uint32_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Bytes [i, size) of a row, one at a time
+inline void ScanTail(const uint8_t *row, uint32_t i, uint32_t size,
+                     PixelScan *scan) {
+  for (; i < size; ++i) {
+    uint32_t shift = (i & 3) * 8;
+    uint32_t b = (uint32_t)row[i] << shift;
+    uint32_t mask = scan->alphaMask & (0xFFu << shift);
+    scan->alphaSet |= b & mask;
+    scan->alphaClear |= ~b & mask;
+    scan->diff |= (b ^ scan->firstPixel) & (0xFFu << shift);
+  }
+}
+
+// OR of the four 32-bit lanes
+inline uint32_t FoldLanes(__m128i v) {
+  v = _mm_or_si128(v, _mm_srli_si128(v, 8));
+  v = _mm_or_si128(v, _mm_srli_si128(v, 4));
+  return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+ScanRowsFn SelectScanRows() {
+  return HasAVX2() ? ScanPixelRowsAVX2 : ScanPixelRowsSSE2;
+}
+
+const ScanRowsFn g_scanRows = SelectScanRows();
+} // namespace
+
+PixelScan MakePixelScan(const uint8_t *pData, uint32_t bytesPerPixel,
+                        uint32_t alphaMask) {
+  PixelScan scan = {};
+  scan.alphaMask = alphaMask;
+  memcpy(&scan.firstPixel, pData, bytesPerPixel);
+  if (bytesPerPixel == 1)
+    scan.firstPixel *= 0x01010101;
+  else if (bytesPerPixel == 2)
+    scan.firstPixel |= scan.firstPixel << 16;
+  return scan;
+}
+
+void ScanPixelRows(const uint8_t *pData, uint32_t rowPitch, uint32_t rowSize,
+                   uint32_t numRows, uint64_t *hash, PixelScan *scan) {
+  g_scanRows(pData, rowPitch, rowSize, numRows, hash, scan);
+}
+
+void ScanPixelRowsScalar(const uint8_t *pData, uint32_t rowPitch,
+                         uint32_t rowSize, uint32_t numRows, uint64_t *hash,
+                         PixelScan *scan) {
+  for (uint32_t r = 0; r < numRows; ++r) {
+    const uint8_t *row = pData + static_cast<size_t>(r) * rowPitch;
+    if (hash)
+      *hash = HashBytes(row, rowSize, *hash);
+    if (scan)
+      ScanTail(row, 0, rowSize, scan);
+  }
+}
+
+// SSE2 is the x86 baseline for this DLL
+void ScanPixelRowsSSE2(const uint8_t *pData, uint32_t rowPitch,
+                       uint32_t rowSize, uint32_t numRows, uint64_t *hash,
+                       PixelScan *scan) {
+  if (!scan) {
+    ScanPixelRowsScalar(pData, rowPitch, rowSize, numRows, hash, nullptr);
+    return;
+  }
+  __m128i mask = _mm_set1_epi32((int)scan->alphaMask);
+  __m128i first = _mm_set1_epi32((int)scan->firstPixel);
+  __m128i set = _mm_setzero_si128();
+  __m128i clear = _mm_setzero_si128();
+  __m128i diff = _mm_setzero_si128();
+  for (uint32_t r = 0; r < numRows; ++r) {
+    const uint8_t *row = pData + static_cast<size_t>(r) * rowPitch;
+    if (hash)
+      *hash = HashBytes(row, rowSize, *hash);
+    uint32_t i = 0;
+    for (; i + 16 <= rowSize; i += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+      set = _mm_or_si128(set, _mm_and_si128(v, mask));
+      clear = _mm_or_si128(clear, _mm_andnot_si128(v, mask));
+      diff = _mm_or_si128(diff, _mm_xor_si128(v, first));
+    }
+    ScanTail(row, i, rowSize, scan);
+  }
+  scan->alphaSet |= FoldLanes(set);
+  scan->alphaClear |= FoldLanes(clear);
+  scan->diff |= FoldLanes(diff);
+}
+
+TARGET_AVX2 void ScanPixelRowsAVX2(const uint8_t *pData, uint32_t rowPitch,
+                                   uint32_t rowSize, uint32_t numRows,
+                                   uint64_t *hash, PixelScan *scan) {
+  if (!scan) {
+    ScanPixelRowsScalar(pData, rowPitch, rowSize, numRows, hash, nullptr);
+    return;
+  }
+  __m256i mask = _mm256_set1_epi32((int)scan->alphaMask);
+  __m256i first = _mm256_set1_epi32((int)scan->firstPixel);
+  __m256i set = _mm256_setzero_si256();
+  __m256i clear = _mm256_setzero_si256();
+  __m256i diff = _mm256_setzero_si256();
+  for (uint32_t r = 0; r < numRows; ++r) {
+    const uint8_t *row = pData + static_cast<size_t>(r) * rowPitch;
+    if (hash)
+      *hash = HashBytes(row, rowSize, *hash);
+    uint32_t i = 0;
+    for (; i + 32 <= rowSize; i += 32) {
+      __m256i v =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+      set = _mm256_or_si256(set, _mm256_and_si256(v, mask));
+      clear = _mm256_or_si256(clear, _mm256_andnot_si256(v, mask));
+      diff = _mm256_or_si256(diff, _mm256_xor_si256(v, first));
+    }
+    ScanTail(row, i, rowSize, scan);
+  }
+  scan->alphaSet |= FoldLanes(_mm_or_si128(_mm256_castsi256_si128(set),
+                                           _mm256_extracti128_si256(set, 1)));
+  scan->alphaClear |=
+      FoldLanes(_mm_or_si128(_mm256_castsi256_si128(clear),
+                             _mm256_extracti128_si256(clear, 1)));
+  scan->diff |= FoldLanes(_mm_or_si128(_mm256_castsi256_si128(diff),
+                                       _mm256_extracti128_si256(diff, 1)));
+}
+
+// AVX2 needs the CPU flag and the OS saving the YMM registers (OSXSAVE, then
+// XCR0 bits 1 and 2)
+bool HasAVX2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  const int OSXSAVE_AVX = (1 << 27) | (1 << 28);
+  if ((info[2] & OSXSAVE_AVX) != OSXSAVE_AVX || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init(); // Called during static initialization
+  return __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,44 @@
+// Texture Scan - the row walk behind HashTextureData and ScanTextureData
+#pragma once
+#include <cstdint>
+
+// FNV-1a hashing and alpha / solid-colour classification of pixel rows, with
+// no Win32 or D3D11 dependency so the tests (tests/texture_scan_test.cpp)
+// check every kernel off Windows. The caller validates the layout and
+// guards against faulting reads.
+
+// Alpha and first-pixel patterns for classification, and the bits seen.
+// Rows start on a pixel and pixels are 1, 2 or 4 bytes, so byte i of a row
+// lines up with byte (i & 3) of a repeating 32-bit pattern; the results
+// keep that byte order.
+struct PixelScan {
+  uint32_t alphaMask;  // Alpha bits of the pattern, 0 if the format has none
+  uint32_t firstPixel; // First pixel, repeated to 4 bytes
+  uint32_t alphaSet;   // Alpha bits set in some pixel
+  uint32_t alphaClear; // Alpha bits clear in some pixel
+  uint32_t diff;       // Bits that differ from the first pixel somewhere
+};
+
+// firstPixel is the first bytesPerPixel bytes of pData
+PixelScan MakePixelScan(const uint8_t *pData, uint32_t bytesPerPixel,
+                        uint32_t alphaMask);
+
+// Walk numRows rows of rowSize bytes, rowPitch apart: continue the FNV-1a
+// hash in *hash (if given) and accumulate the bits into *scan (if given).
+// Each row is hashed and classified while it is still in cache. Uses AVX2
+// when the CPU has it (checked once), SSE2 otherwise.
+void ScanPixelRows(const uint8_t *pData, uint32_t rowPitch, uint32_t rowSize,
+                   uint32_t numRows, uint64_t *hash, PixelScan *scan);
+
+// The kernels ScanPixelRows picks from, for the tests and benchmarks. The
+// AVX2 one must only run where HasAVX2() is true.
+void ScanPixelRowsScalar(const uint8_t *pData, uint32_t rowPitch,
+                         uint32_t rowSize, uint32_t numRows, uint64_t *hash,
+                         PixelScan *scan);
+void ScanPixelRowsSSE2(const uint8_t *pData, uint32_t rowPitch,
+                       uint32_t rowSize, uint32_t numRows, uint64_t *hash,
+                       PixelScan *scan);
+void ScanPixelRowsAVX2(const uint8_t *pData, uint32_t rowPitch,
+                       uint32_t rowSize, uint32_t numRows, uint64_t *hash,
+                       PixelScan *scan);
+bool HasAVX2();
@@ -1,16 +1,28 @@
 #include "texturedump.h"
-#include "../utils/memory.h"
+#include "../utils/flat_hash.h"
+#include "../utils/hook_registry.h"
 #include "../utils/settings.h"
+#include "band_hash.h"
+#include "dds_file.h"
+#include "dump_index.h"
+#include "frame_timing.h"
+#include "region_replace.h"
+#include "resource_table.h"
+#include "texture_filter.h"
+#include "texture_scan.h"
 #include "texturereplace.h"
 #include "upscale4k.h"
 #include <Windows.h>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <set>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include <wrl/client.h>
 
 using Microsoft::WRL::ComPtr;
@@ -21,7 +33,9 @@ bool g_settingsLoaded = false;
 std::string g_dumpPath;
 CRITICAL_SECTION g_dumpCS;
 volatile LONG g_dumpCSInitialized = 0;
-std::set<uint64_t> g_recentDumps;
+// Hashes dumped this or a previous session (dump/index.bin). Guarded by
+// g_dumpCS.
+DumpIndex g_dumpIndex;
 
 void InitDumpCS() {
   if (InterlockedCompareExchange(&g_dumpCSInitialized, 1, 0) == 0) {
@@ -141,32 +155,29 @@ void InitializeDumpPath() {
   CreateDirectoryA((g_dumpPath + "\\transparent").c_str(), NULL);
   CreateDirectoryA((g_dumpPath + "\\rendertargets").c_str(), NULL);
   CreateDirectoryA((g_dumpPath + "\\rendertargets\\transparent").c_str(), NULL);
+  CreateDirectoryA((g_dumpPath + "\\regions").c_str(), NULL);
   CreateDirectoryA((g_dumpPath + "\\other").c_str(), NULL);
+
+  if (g_dumpIndex.Open(g_dumpPath))
+    std::cout << "[Mod] Dump index: " << g_dumpIndex.Size()
+              << " texture(s) already dumped" << std::endl;
 }
 
-// Check if format is dumpable
-bool IsDumpableFormat(DXGI_FORMAT format) {
-  switch (format) {
-  case DXGI_FORMAT_R8G8B8A8_UNORM:
-  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-  case DXGI_FORMAT_B8G8R8A8_UNORM:
-  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-  case DXGI_FORMAT_B4G4R4A4_UNORM:
-  case DXGI_FORMAT_R8_UNORM:
-  case DXGI_FORMAT_R8G8_UNORM:
-  // Compressed formats
-  case DXGI_FORMAT_BC1_UNORM: // DXT1
-  case DXGI_FORMAT_BC1_UNORM_SRGB:
-  case DXGI_FORMAT_BC2_UNORM: // DXT3
-  case DXGI_FORMAT_BC2_UNORM_SRGB:
-  case DXGI_FORMAT_BC3_UNORM: // DXT5
-  case DXGI_FORMAT_BC3_UNORM_SRGB:
-  case DXGI_FORMAT_BC7_UNORM:
-  case DXGI_FORMAT_BC7_UNORM_SRGB:
-    return true;
-  default:
-    return false;
-  }
+// Claim a hash for dumping. Returns false if it was already dumped.
+bool ReserveDump(uint64_t hash) {
+  InitDumpCS();
+  EnterCriticalSection(&g_dumpCS);
+  bool reserved = g_dumpIndex.Reserve(hash);
+  LeaveCriticalSection(&g_dumpCS);
+  return reserved;
+}
+
+// Record a finished dump so later sessions skip it
+void RecordDump(uint64_t hash, UINT width, UINT height) {
+  InitDumpCS();
+  EnterCriticalSection(&g_dumpCS);
+  g_dumpIndex.Append(hash, width, height);
+  LeaveCriticalSection(&g_dumpCS);
 }
 
 // Save texture as DDS, returns transparency status via out parameter
@@ -288,7 +299,7 @@ bool SaveTextureAsDDS(ID3D11Texture2D *pTexture,
   ddsHeader.dwHeight = pDesc->Height;
   ddsHeader.dwWidth = pDesc->Width;
   ddsHeader.dwPitchOrLinearSize = mapped.RowPitch;
-  ddsHeader.dwMipMapCount = pDesc->MipLevels > 1 ? pDesc->MipLevels : 0;
+  ddsHeader.dwMipMapCount = 0; // Only mip 0 is written
   ddsHeader.ddspf.dwSize = 32;
 
   // Set pixel format based on DXGI format
@@ -363,12 +374,9 @@ bool SaveTextureAsDDS(ID3D11Texture2D *pTexture,
     break;
   case DXGI_FORMAT_BC7_UNORM:
   case DXGI_FORMAT_BC7_UNORM_SRGB:
-    ddsHeader.ddspf.dwFlags = 0x4; // DDPF_FOURCC
-    ddsHeader.ddspf.dwFourCC =
-        0x20495844; // "DX10" - BC7 requires DX10 extended header
-    // Note: BC7 technically needs a DDS_HEADER_DXT10 extension, but many tools
-    // accept this
-    ddsHeader.dwFlags |= 0x80000; // DDSD_LINEARSIZE
+    ddsHeader.ddspf.dwFlags = 0x4;               // DDPF_FOURCC
+    ddsHeader.ddspf.dwFourCC = DDS_FOURCC_DX10; // BC7 needs the DX10 header
+    ddsHeader.dwFlags |= 0x80000;               // DDSD_LINEARSIZE
     ddsHeader.dwPitchOrLinearSize =
         ((pDesc->Width + 3) / 4) * ((pDesc->Height + 3) / 4) * 16;
     break;
@@ -380,6 +388,11 @@ bool SaveTextureAsDDS(ID3D11Texture2D *pTexture,
   ddsHeader.dwCaps = 0x1000; // DDSCAPS_TEXTURE
 
   file.write(reinterpret_cast<const char *>(&ddsHeader), sizeof(ddsHeader));
+  if (ddsHeader.ddspf.dwFourCC == DDS_FOURCC_DX10) {
+    DDSHeaderDX10 dx10 = {static_cast<DWORD>(pDesc->Format),
+                          D3D11_RESOURCE_DIMENSION_TEXTURE2D, 0, 1, 0};
+    file.write(reinterpret_cast<const char *>(&dx10), sizeof(dx10));
+  }
 
   // Write pixel data
   bool writeSuccess = true;
@@ -524,7 +537,7 @@ bool SaveDDSFromInitialData(const D3D11_TEXTURE2D_DESC *pDesc,
   ddsHeader.dwFlags = 0x1 | 0x2 | 0x4 | 0x1000;
   ddsHeader.dwHeight = pDesc->Height;
   ddsHeader.dwWidth = pDesc->Width;
-  ddsHeader.dwMipMapCount = pDesc->MipLevels > 1 ? pDesc->MipLevels : 0;
+  ddsHeader.dwMipMapCount = 0; // Only mip 0 is written
   ddsHeader.ddspf.dwSize = 32;
 
   // Calculate bytes per pixel / block info
@@ -602,7 +615,7 @@ bool SaveDDSFromInitialData(const D3D11_TEXTURE2D_DESC *pDesc,
   case DXGI_FORMAT_BC7_UNORM:
   case DXGI_FORMAT_BC7_UNORM_SRGB:
     ddsHeader.ddspf.dwFlags = 0x4;
-    ddsHeader.ddspf.dwFourCC = 0x20495844; // "DX10"
+    ddsHeader.ddspf.dwFourCC = DDS_FOURCC_DX10;
     ddsHeader.dwFlags |= 0x80000;
     isBlockCompressed = true;
     bytesPerBlock = 16;
@@ -623,6 +636,11 @@ bool SaveDDSFromInitialData(const D3D11_TEXTURE2D_DESC *pDesc,
   ddsHeader.dwCaps = 0x1000; // DDSCAPS_TEXTURE
 
   file.write(reinterpret_cast<const char *>(&ddsHeader), sizeof(ddsHeader));
+  if (ddsHeader.ddspf.dwFourCC == DDS_FOURCC_DX10) {
+    DDSHeaderDX10 dx10 = {static_cast<DWORD>(pDesc->Format),
+                          D3D11_RESOURCE_DIMENSION_TEXTURE2D, 0, 1, 0};
+    file.write(reinterpret_cast<const char *>(&dx10), sizeof(dx10));
+  }
 
   // Write pixel data from pInitialData (CPU memory)
   bool writeSuccess = true;
@@ -661,15 +679,8 @@ bool SaveDDSFromInitialData(const D3D11_TEXTURE2D_DESC *pDesc,
   return writeSuccess;
 }
 
-} // namespace
-
-// Shared hash core - works with both pInitialData (CPU) and staging map (GPU)
-// Hashes only content-identifying desc fields + all pixel data row-by-row
-uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
-                         UINT rowPitch) {
-  if (!pDesc)
-    return 0;
-
+// FNV-1a over the content-identifying desc fields (seed for both hashes)
+uint64_t HashDescFields(const D3D11_TEXTURE2D_DESC *pDesc) {
   uint64_t hash = 14695981039346656037ULL; // FNV offset basis
 
   auto mixField = [&hash](uint32_t val) {
@@ -685,9 +696,15 @@ uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
   mixField(static_cast<uint32_t>(pDesc->Format));
   mixField(pDesc->MipLevels);
   mixField(pDesc->ArraySize);
+  return hash;
+}
 
+// Bytes per row (or block row) and row count of mip 0. Returns false if the
+// data can't be hashed safely.
+bool GetHashRowLayout(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
+                      UINT rowPitch, UINT *outRowSize, UINT *outNumRows) {
   if (!pData || rowPitch == 0 || pDesc->Width == 0 || pDesc->Height == 0)
-    return hash;
+    return false;
 
   UINT bytesPerPixel = 0;
   UINT bytesPerBlock = 0;
@@ -735,7 +752,7 @@ uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
   }
 
   if (bytesPerPixel == 0 && bytesPerBlock == 0)
-    return hash;
+    return false;
 
   UINT actualRowSize;
   UINT numRows;
@@ -748,7 +765,7 @@ uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
   }
 
   if (rowPitch < actualRowSize)
-    return hash;
+    return false;
 
   size_t dataSize =
       (numRows <= 1)
@@ -756,18 +773,168 @@ uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
           : static_cast<size_t>(rowPitch) * (numRows - 1) + actualRowSize;
 
   if (dataSize == 0 || dataSize >= 256 * 1024 * 1024)
-    return hash;
+    return false;
 
   if (IsBadReadPtr(pData, dataSize))
+    return false;
+
+  *outRowSize = actualRowSize;
+  *outNumRows = numRows;
+  return true;
+}
+
+// Per-format 4-byte patterns for ScanTextureData. Rows start on a pixel and
+// pixels are 1, 2 or 4 bytes, so byte i of a row lines up with byte (i & 3)
+// of a repeating 32-bit pattern.
+bool GetScanPattern(DXGI_FORMAT format, UINT *outBytesPerPixel,
+                    uint32_t *outAlphaMask) {
+  switch (format) {
+  case DXGI_FORMAT_R8G8B8A8_UNORM:
+  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+  case DXGI_FORMAT_B8G8R8A8_UNORM:
+  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    *outBytesPerPixel = 4;
+    *outAlphaMask = 0xFF000000;
+    return true;
+  case DXGI_FORMAT_B4G4R4A4_UNORM:
+    *outBytesPerPixel = 2;
+    *outAlphaMask = 0xF000F000;
+    return true;
+  case DXGI_FORMAT_R8G8_UNORM:
+    *outBytesPerPixel = 2;
+    *outAlphaMask = 0;
+    return true;
+  case DXGI_FORMAT_R8_UNORM:
+    *outBytesPerPixel = 1;
+    *outAlphaMask = 0;
+    return true;
+  default:
+    return false; // Block-compressed / float: hash only
+  }
+}
+
+// Shared row walk behind HashTextureData and ScanTextureData. Hashes the
+// desc fields + all pixel data row-by-row; band-hashed sizes (band_hash.h)
+// hash each band separately and fold the band hashes in order.
+TextureScanResult ScanRows(const D3D11_TEXTURE2D_DESC *pDesc,
+                           const void *pData, UINT rowPitch, bool classify) {
+  TextureScanResult result = {};
+  result.alpha = TextureAlpha::Unknown;
+  if (!pDesc)
+    return result;
+
+  result.hash = HashDescFields(pDesc);
+
+  UINT actualRowSize, numRows;
+  if (!GetHashRowLayout(pDesc, pData, rowPitch, &actualRowSize, &numRows))
+    return result;
+
+  UINT bytesPerPixel = 0;
+  uint32_t alphaMask = 0;
+  classify =
+      classify && GetScanPattern(pDesc->Format, &bytesPerPixel, &alphaMask);
+  bool banded = UsesBandHash(pDesc->Width, pDesc->Height);
+
+  uint64_t hash = result.hash;
+  bool completed = false;
+  PixelScan scan = {};
+  __try {
+    const uint8_t *srcData = static_cast<const uint8_t *>(pData);
+    if (classify)
+      scan = MakePixelScan(srcData, bytesPerPixel, alphaMask);
+
+    for (UINT row = 0; row < numRows; row += BAND_HASH_ROWS) {
+      UINT rows = numRows - row < BAND_HASH_ROWS ? numRows - row
+                                                 : BAND_HASH_ROWS;
+      const uint8_t *bandData = srcData + static_cast<size_t>(row) * rowPitch;
+      PixelScan *bandScan = classify ? &scan : nullptr;
+      if (banded) {
+        uint64_t bandHash = 14695981039346656037ULL; // FNV offset basis
+        ScanPixelRows(bandData, rowPitch, actualRowSize, rows, &bandHash,
+                      bandScan);
+        hash = CombineBandHash(hash, bandHash);
+      } else {
+        ScanPixelRows(bandData, rowPitch, actualRowSize, rows, &hash,
+                      bandScan);
+      }
+    }
+    completed = true;
+  } __except (EXCEPTION_EXECUTE_HANDLER) {
+  }
+
+  result.hash = hash;
+  if (!completed || !classify)
+    return result;
+
+  result.solidColor = scan.diff == 0;
+  if (alphaMask != 0) {
+    if (scan.alphaSet == 0)
+      result.alpha = TextureAlpha::Transparent;
+    else if (scan.alphaClear == 0)
+      result.alpha = TextureAlpha::Opaque;
+    else
+      result.alpha = TextureAlpha::Mixed;
+  }
+  return result;
+}
+} // namespace
+
+
+// Shared hash core - works with both pInitialData (CPU) and staging map (GPU)
+uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
+                         UINT rowPitch) {
+  // Band-hashed sizes split the bands across the worker pool; a fault falls
+  // back to the serial walk, which stops where the data ends
+  UINT actualRowSize, numRows;
+  uint64_t hash;
+  if (pDesc && UsesBandHash(pDesc->Width, pDesc->Height) &&
+      GetHashRowLayout(pDesc, pData, rowPitch, &actualRowSize, &numRows) &&
+      HashBandsCombined(static_cast<const uint8_t *>(pData), rowPitch,
+                        actualRowSize, numRows, HashDescFields(pDesc), &hash))
+    return hash;
+  return ScanRows(pDesc, pData, rowPitch, false).hash;
+}
+
+// Sampled fingerprint: FINGERPRINT_ROWS evenly spaced rows (block rows for
+// BC formats), FINGERPRINT_CHUNKS evenly spaced 16-byte chunks per row.
+// Touches at most 512 bytes regardless of texture size.
+uint64_t FingerprintTextureData(const D3D11_TEXTURE2D_DESC *pDesc,
+                                const void *pData, UINT rowPitch) {
+  constexpr UINT FINGERPRINT_ROWS = 8;
+  constexpr UINT FINGERPRINT_CHUNKS = 4;
+  constexpr UINT CHUNK_BYTES = 16;
+
+  if (!pDesc)
+    return 0;
+
+  uint64_t hash = HashDescFields(pDesc);
+
+  UINT actualRowSize, numRows;
+  if (!GetHashRowLayout(pDesc, pData, rowPitch, &actualRowSize, &numRows))
     return hash;
 
+  UINT rows = numRows < FINGERPRINT_ROWS ? numRows : FINGERPRINT_ROWS;
+  UINT chunks = actualRowSize < FINGERPRINT_CHUNKS * CHUNK_BYTES
+                    ? 1
+                    : FINGERPRINT_CHUNKS;
+  UINT chunkBytes = chunks == 1 ? actualRowSize : CHUNK_BYTES;
+
   __try {
     const uint8_t *srcData = static_cast<const uint8_t *>(pData);
-    for (UINT row = 0; row < numRows; ++row) {
+    for (UINT r = 0; r < rows; ++r) {
+      UINT row =
+          rows > 1 ? (UINT)((uint64_t)r * (numRows - 1) / (rows - 1)) : 0;
       const uint8_t *rowData = srcData + static_cast<size_t>(row) * rowPitch;
-      for (UINT i = 0; i < actualRowSize; ++i) {
-        hash ^= rowData[i];
-        hash *= 1099511628211ULL;
+      for (UINT c = 0; c < chunks; ++c) {
+        UINT offset =
+            chunks > 1
+                ? (UINT)((uint64_t)c * (actualRowSize - chunkBytes) /
+                         (chunks - 1))
+                : 0;
+        for (UINT i = 0; i < chunkBytes; ++i) {
+          hash ^= rowData[offset + i];
+          hash *= 1099511628211ULL;
+        }
       }
     }
   } __except (EXCEPTION_EXECUTE_HANDLER) {
@@ -776,6 +943,13 @@ uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc, const void *pData,
   return hash;
 }
 
+// Single pass over the rows: content hash (identical to HashTextureData) plus
+// alpha/solid-colour classification of each band while it is still in cache.
+TextureScanResult ScanTextureData(const D3D11_TEXTURE2D_DESC *pDesc,
+                                  const void *pData, UINT rowPitch) {
+  return ScanRows(pDesc, pData, rowPitch, true);
+}
+
 // Thin wrapper for CreateTexture2D path (uses pInitialData)
 uint64_t HashTexture(const D3D11_TEXTURE2D_DESC *pDesc,
                      const D3D11_SUBRESOURCE_DATA *pInitialData) {
@@ -826,21 +1000,19 @@ void DumpTexture2D(ID3D11Device *pDevice, ID3D11DeviceContext *pContext,
   if (!isRenderTarget && !hasInitialData)
     return;
 
-  // Calculate content-based hash
-  uint64_t hash = HashTexture(pDesc, pInitialData);
-
-  // Thread-safe duplicate check
-  InitDumpCS();
-  EnterCriticalSection(&g_dumpCS);
-  bool alreadyDumped = g_recentDumps.find(hash) != g_recentDumps.end();
-  if (!alreadyDumped) {
-    if (g_recentDumps.size() > 10000)
-      g_recentDumps.clear();
-    g_recentDumps.insert(hash);
+  // Content hash; for CPU-side data the same pass classifies alpha
+  uint64_t hash;
+  TextureScanResult scan = {};
+  if (hasInitialData) {
+    scan = ScanTextureData(pDesc, pInitialData->pSysMem,
+                           pInitialData->SysMemPitch);
+    hash = scan.hash;
+  } else {
+    hash = HashTexture(pDesc, pInitialData);
   }
-  LeaveCriticalSection(&g_dumpCS);
 
-  if (alreadyDumped)
+  // Thread-safe duplicate check (covers previous sessions too)
+  if (!ReserveDump(hash))
     return;
 
   // Generate filename: WIDTHxHEIGHT_HASH.dds
@@ -849,18 +1021,6 @@ void DumpTexture2D(ID3D11Device *pDevice, ID3D11DeviceContext *pContext,
            << std::hex << std::setfill('0') << std::setw(16) << hash << ".dds";
   std::string filenameStr = filename.str();
 
-  // Check if file already exists on disk (persisted from previous session)
-  std::string foldersToCheck[] = {
-      "BGRA4",    "BGRA8", "RGBA8",       "BC1_DXT1",      "BC2_DXT3",
-      "BC3_DXT5", "BC7",   "transparent", "rendertargets", "other"};
-  for (const auto &folder : foldersToCheck) {
-    std::string checkPath = g_dumpPath + "\\" + folder + "\\" + filenameStr;
-    DWORD attrs = GetFileAttributesA(checkPath.c_str());
-    if (attrs != INVALID_FILE_ATTRIBUTES) {
-      return; // Already on disk
-    }
-  }
-
   try {
     if (isRenderTarget) {
       // Render targets go to rendertargets\ folder via GPU staging copy
@@ -868,6 +1028,7 @@ void DumpTexture2D(ID3D11Device *pDevice, ID3D11DeviceContext *pContext,
       bool isTransparent = false;
       if (pTexture &&
           SaveTextureAsDDS(pTexture, pDesc, rtPath, &isTransparent)) {
+        RecordDump(hash, pDesc->Width, pDesc->Height);
         if (isTransparent) {
           std::string finalPath =
               g_dumpPath + "\\rendertargets\\transparent\\" + filenameStr;
@@ -881,21 +1042,16 @@ void DumpTexture2D(ID3D11Device *pDevice, ID3D11DeviceContext *pContext,
       }
     } else {
       // Regular textures: write DDS from pInitialData (CPU-side, no staging)
-      std::string formatFolder = GetFormatFolderName(pDesc->Format);
-      std::string tempPath =
-          g_dumpPath + "\\" + formatFolder + "\\" + filenameStr;
-      bool isTransparent = false;
-      if (SaveDDSFromInitialData(pDesc, pInitialData, tempPath,
-                                 &isTransparent)) {
-        if (isTransparent) {
-          std::string finalPath = g_dumpPath + "\\transparent\\" + filenameStr;
-          MoveFileA(tempPath.c_str(), finalPath.c_str());
-          std::cout << "Dumped transparent: " << pDesc->Width << "x"
-                    << pDesc->Height << " " << filenameStr << std::endl;
-        } else {
-          std::cout << "Dumped: " << pDesc->Width << "x" << pDesc->Height << " "
-                    << filenameStr << std::endl;
-        }
+      bool isTransparent = scan.alpha == TextureAlpha::Transparent;
+      std::string folder =
+          isTransparent ? "transparent" : GetFormatFolderName(pDesc->Format);
+      std::string path = g_dumpPath + "\\" + folder + "\\" + filenameStr;
+      if (SaveDDSFromInitialData(pDesc, pInitialData, path, nullptr)) {
+        RecordDump(hash, pDesc->Width, pDesc->Height);
+        std::cout << "Dumped" << (isTransparent ? " transparent" : "")
+                  << (scan.solidColor ? " (solid)" : "") << ": "
+                  << pDesc->Width << "x" << pDesc->Height << " "
+                  << filenameStr << std::endl;
       }
     }
   } catch (...) {
@@ -910,11 +1066,6 @@ void DumpTexture2D(ID3D11Device *pDevice, ID3D11DeviceContext *pContext,
 // UpdateSubresource/Map, which CreateTexture2D misses.
 
 namespace {
-typedef void(STDMETHODCALLTYPE *PSSetShaderResources_t)(
-    ID3D11DeviceContext *, UINT, UINT, ID3D11ShaderResourceView *const *);
-
-volatile PSSetShaderResources_t Original_PSSetShaderResources = nullptr;
-volatile LONG g_psSetSRHookReady = 0;
 volatile LONG g_dumpHooksApplied = 0;
 
 // Pointer-based dedup: skip staging for textures we've already processed
@@ -928,19 +1079,83 @@ void InitSeenTexturesCS() {
   }
 }
 
-// Replacement SRV cache: original texture ptr -> replacement SRV
-std::unordered_map<void *, ComPtr<ID3D11ShaderResourceView>>
-    g_replacementSRVCache;
-// Negative replacement cache: texture ptr -> (retry count, last check time).
-// Textures get re-checked up to MAX_RETRIES times (spaced by RETRY_INTERVAL_MS)
-// to handle the PS1 emulator filling texture content after initial bind.
-constexpr int REPLACE_MAX_RETRIES = 5;
-constexpr DWORD REPLACE_RETRY_INTERVAL_MS = 500;
-struct NoReplacementInfo {
-  int retryCount;
-  DWORD lastCheckTime;
+// Replacement SRV cache: original texture ptr -> replacement SRV.
+// Least recently bound entries are evicted when the resident size of the
+// replacement textures goes over texture_replace_budget_mb.
+struct ReplacementCacheEntry {
+  ComPtr<ID3D11ShaderResourceView> srv;
+  uint64_t bytes;
+  uint64_t hash; // Content hash the replacement was matched on
+  bool dirty;    // Original written since; re-hash before the next bind
+};
+std::unordered_map<void *, ReplacementCacheEntry> g_replacementSRVCache;
+// Cache entries per replacement view. Identical replacement files share one
+// view (LoadReplacementSRV), which is charged to the budget only once.
+std::unordered_map<ID3D11ShaderResourceView *, uint32_t> g_replacementSRVUsers;
+uint64_t g_replacementBudgetBytes = 0; // 0 = unlimited
+ReplacementCacheStats g_replacementStats = {};
+// Negative replacement cache: texture ptr -> why it has no replacement.
+// Ineligible (size, format, nothing at these dimensions) doesn't depend on
+// content and lasts until the texture is destroyed. NoMatch is dropped when
+// the texture is written (see MarkTextureDirty), which is how we pick up the
+// PS1 emulator filling texture content after the initial bind.
+enum class NoReplacement { Ineligible, NoMatch };
+std::unordered_map<void *, NoReplacement> g_checkedNoReplacement;
+// Textures carrying a TextureLifetimeTracker
+std::unordered_set<void *> g_trackedTextures;
+
+// Lock-free bind-time fast path: texture ptr -> replacement SRV, nullptr
+// when the texture needs no work until it is written (no match / already
+// dumped), or BIND_SKIP_ALWAYS when it never needs work. Mirrors the locked
+// caches above and the seen set; written only under their locks.
+constexpr size_t BIND_CACHE_CAPACITY = 16384;
+ID3D11ShaderResourceView *const BIND_SKIP_ALWAYS =
+    reinterpret_cast<ID3D11ShaderResourceView *>(2);
+SeqlockPointerMap g_bindCache(BIND_CACHE_CAPACITY);
+volatile LONG g_bindCacheOverflow = 0; // Some verdicts live only in the maps
+CRITICAL_SECTION g_bindCacheWriteCS;
+volatile LONG g_bindCacheWriteCSInitialized = 0;
+
+// SRVs removed from the replacement cache. The bind hook reads raw
+// pointers from g_bindCache without a lock, so a view can be removed (e.g.
+// by a texture destroyed on another thread) while a bind that fetched it is
+// still running. Binds are immediate-context calls, which this assumes the
+// game makes from the thread that presents: once RETIRED_SRV_GRACE_FRAMES
+// Presents have passed, no bind can still hold a retired pointer (D3D keeps
+// its own reference on what was bound). Without a Present callback the grace
+// is RETIRED_SRV_GRACE_MS instead. A retired view's memory stays in
+// residentBytes until it is released.
+constexpr UINT RETIRED_SRV_GRACE_FRAMES = 2;
+constexpr DWORD RETIRED_SRV_GRACE_MS = 1000;
+struct RetiredSRV {
+  ComPtr<ID3D11ShaderResourceView> srv;
+  uint64_t bytes; // Still charged to residentBytes (0 if another entry
+                  // shares the view)
+  DWORD retireTime;
+  LONG retireFrame;
 };
-std::unordered_map<void *, NoReplacementInfo> g_checkedNoReplacement;
+std::vector<RetiredSRV> g_retiredSRVs;
+volatile LONG g_presentCount = 0;
+bool g_hasFrameClock = false; // OnPresent is registered
+
+// Band-hashed textures (band_hash.h) seen at bind time: band hashes plus a
+// staging mirror, so a re-check copies and rehashes only the written bands.
+// A mirror is as large as its texture (32 MB for the 4096x2048 VRAM), so
+// one left unused for BAND_MIRROR_IDLE_FRAMES is released; the next check
+// then starts over with a full copy.
+constexpr LONG BAND_MIRROR_IDLE_FRAMES = 600;
+struct BandTextureState {
+  BandHashState bands;
+  ComPtr<ID3D11Texture2D> staging; // Contents as of the last check
+  uint64_t stagingBytes;
+  LONG lastUsedFrame;
+};
+std::unordered_map<void *, BandTextureState> g_bandStates;
+uint64_t g_bandMirrorBytes = 0; // Under g_bandStateCS
+volatile LONG g_bandStateCount = 0; // Lets writes skip the lock when empty
+CRITICAL_SECTION g_bandStateCS;
+volatile LONG g_bandStateCSInitialized = 0;
+
 CRITICAL_SECTION g_replacementCacheCS;
 volatile LONG g_replacementCacheCSInitialized = 0;
 
@@ -950,6 +1165,473 @@ void InitReplacementCacheCS() {
   }
 }
 
+void InitBandStateCS() {
+  if (InterlockedCompareExchange(&g_bandStateCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_bandStateCS);
+  }
+}
+
+void InitBindCacheWriteCS() {
+  if (InterlockedCompareExchange(&g_bindCacheWriteCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_bindCacheWriteCS);
+  }
+}
+
+// Publish a fast-path result (srv == nullptr: skip this texture)
+void PublishBindCache(void *pTexture, ID3D11ShaderResourceView *srv) {
+  InitBindCacheWriteCS();
+  EnterCriticalSection(&g_bindCacheWriteCS);
+  // A full table only means more slow-path lookups
+  if (!g_bindCache.Insert(pTexture, srv, GetTickCount()))
+    InterlockedExchange(&g_bindCacheOverflow, 1);
+  LeaveCriticalSection(&g_bindCacheWriteCS);
+}
+
+void UnpublishBindCache(void *pTexture) {
+  InitBindCacheWriteCS();
+  EnterCriticalSection(&g_bindCacheWriteCS);
+  g_bindCache.Erase(pTexture);
+  LeaveCriticalSection(&g_bindCacheWriteCS);
+}
+
+// Caller holds g_replacementCacheCS. SRVs past their grace are moved to
+// *released so the final Release happens outside the lock.
+void DrainRetiredSRVs(std::vector<ComPtr<ID3D11ShaderResourceView>> *released) {
+  DWORD now = GetTickCount();
+  LONG frame = g_presentCount;
+  size_t kept = 0;
+  for (size_t i = 0; i < g_retiredSRVs.size(); ++i) {
+    RetiredSRV &retired = g_retiredSRVs[i];
+    bool expired =
+        g_hasFrameClock
+            ? (ULONG)(frame - retired.retireFrame) >= RETIRED_SRV_GRACE_FRAMES
+            : now - retired.retireTime >= RETIRED_SRV_GRACE_MS;
+    if (expired) {
+      released->push_back(retired.srv);
+      g_replacementStats.residentBytes -= retired.bytes;
+      g_replacementStats.retiredBytes -= retired.bytes;
+    } else {
+      g_retiredSRVs[kept++] = retired;
+    }
+  }
+  g_retiredSRVs.resize(kept);
+}
+
+// Caller holds g_replacementCacheCS
+void RemoveReplacementEntry(
+    std::unordered_map<void *, ReplacementCacheEntry>::iterator it) {
+  UnpublishBindCache(it->first);
+  uint64_t bytes = 0;
+  auto users = g_replacementSRVUsers.find(it->second.srv.Get());
+  if (users != g_replacementSRVUsers.end() && --users->second == 0) {
+    g_replacementSRVUsers.erase(users);
+    bytes = it->second.bytes;
+    g_replacementStats.retiredBytes += bytes;
+    g_replacementStats.residentCount--;
+  }
+  g_retiredSRVs.push_back(
+      {it->second.srv, bytes, GetTickCount(), g_presentCount});
+  g_replacementSRVCache.erase(it);
+}
+
+// Approximate video memory used by a texture (all mips and array slices)
+uint64_t GetTextureMemorySize(const D3D11_TEXTURE2D_DESC &desc) {
+  UINT blockBytes = 0; // Bytes per 4x4 block for BC formats
+  UINT pixelBytes = 4;
+  switch (desc.Format) {
+  case DXGI_FORMAT_BC1_UNORM:
+  case DXGI_FORMAT_BC1_UNORM_SRGB:
+    blockBytes = 8;
+    break;
+  case DXGI_FORMAT_BC2_UNORM:
+  case DXGI_FORMAT_BC2_UNORM_SRGB:
+  case DXGI_FORMAT_BC3_UNORM:
+  case DXGI_FORMAT_BC3_UNORM_SRGB:
+  case DXGI_FORMAT_BC7_UNORM:
+  case DXGI_FORMAT_BC7_UNORM_SRGB:
+    blockBytes = 16;
+    break;
+  case DXGI_FORMAT_B4G4R4A4_UNORM:
+  case DXGI_FORMAT_R8G8_UNORM:
+    pixelBytes = 2;
+    break;
+  case DXGI_FORMAT_R8_UNORM:
+    pixelBytes = 1;
+    break;
+  default:
+    break;
+  }
+
+  uint64_t total = 0;
+  UINT w = desc.Width, h = desc.Height;
+  UINT mips = desc.MipLevels ? desc.MipLevels : 1;
+  for (UINT mip = 0; mip < mips; ++mip) {
+    if (blockBytes)
+      total += (uint64_t)((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+    else
+      total += (uint64_t)w * h * pixelBytes;
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  return total * (desc.ArraySize ? desc.ArraySize : 1);
+}
+
+// Called when a tracked texture is destroyed: drop every cache entry keyed
+// by its address so a new texture allocated there starts clean.
+void OnTrackedTextureDestroyed(void *pTexture) {
+  InitReplacementCacheCS();
+  EnterCriticalSection(&g_replacementCacheCS);
+  auto it = g_replacementSRVCache.find(pTexture);
+  if (it != g_replacementSRVCache.end()) {
+    RemoveReplacementEntry(it);
+    g_replacementStats.destroyedEvictions++;
+  } else {
+    UnpublishBindCache(pTexture);
+  }
+  g_checkedNoReplacement.erase(pTexture);
+  g_trackedTextures.erase(pTexture);
+  LeaveCriticalSection(&g_replacementCacheCS);
+
+  InitSeenTexturesCS();
+  EnterCriticalSection(&g_seenTexturesCS);
+  g_seenTexturePointers.erase(pTexture);
+  LeaveCriticalSection(&g_seenTexturesCS);
+
+  if (g_bandStateCount) {
+    InitBandStateCS();
+    EnterCriticalSection(&g_bandStateCS);
+    auto it = g_bandStates.find(pTexture);
+    if (it != g_bandStates.end()) {
+      g_bandMirrorBytes -= it->second.stagingBytes;
+      g_bandStates.erase(it);
+      InterlockedDecrement(&g_bandStateCount);
+    }
+    LeaveCriticalSection(&g_bandStateCS);
+    ReleaseRegionComposite(pTexture);
+  }
+}
+
+// Drop content-dependent verdicts for a written texture. Positive entries
+// keep their SRV so a rewrite with identical content skips the reload.
+void InvalidateTexture(void *pTexture) {
+  bool keepFastPath = false;
+  InitReplacementCacheCS();
+  EnterCriticalSection(&g_replacementCacheCS);
+  auto it = g_replacementSRVCache.find(pTexture);
+  if (it != g_replacementSRVCache.end())
+    it->second.dirty = true;
+  auto noRep = g_checkedNoReplacement.find(pTexture);
+  if (noRep != g_checkedNoReplacement.end()) {
+    if (noRep->second == NoReplacement::Ineligible)
+      keepFastPath = true;
+    else
+      g_checkedNoReplacement.erase(noRep);
+  }
+  LeaveCriticalSection(&g_replacementCacheCS);
+
+  InitSeenTexturesCS();
+  EnterCriticalSection(&g_seenTexturesCS);
+  g_seenTexturePointers.erase(pTexture);
+  LeaveCriticalSection(&g_seenTexturesCS);
+
+  if (!keepFastPath)
+    UnpublishBindCache(pTexture);
+}
+
+// Called after the immediate context writes to a resource, so re-hashing
+// happens exactly when content changes. Cheap for everything we don't
+// track: buffers are filtered by type, and textures with no verdict (or
+// one that doesn't depend on content) are answered by the lock-free table.
+// Rows [top, bottom) of the subresource were written; only mip 0 of the
+// first slice is hashed, so band tracking ignores other subresources.
+void MarkTextureDirty(ID3D11Resource *pResource, UINT subresource = 0,
+                      UINT top = 0, UINT bottom = UINT_MAX) {
+  if (!pResource)
+    return;
+  D3D11_RESOURCE_DIMENSION dim = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+  pResource->GetType(&dim);
+  if (dim != D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+    return;
+
+  // Band dirty bits accumulate across writes, so they are recorded even
+  // when the texture is already waiting for a re-check
+  if (g_bandStateCount && subresource == 0) {
+    InitBandStateCS();
+    EnterCriticalSection(&g_bandStateCS);
+    auto it = g_bandStates.find(pResource);
+    if (it != g_bandStates.end())
+      it->second.bands.MarkDirty(top, bottom);
+    LeaveCriticalSection(&g_bandStateCS);
+  }
+
+  // ID3D11Texture2D shares its ID3D11Resource base's address, which is what
+  // the caches are keyed on
+  void *cached = nullptr;
+  bool absent = false;
+  if (g_bindCache.Find(pResource, &cached, 0, &absent)) {
+    if (cached == BIND_SKIP_ALWAYS)
+      return;
+  } else if (absent && !g_bindCacheOverflow) {
+    return; // Never bound, or already dirty
+  }
+  InvalidateTexture(pResource);
+}
+
+// Attached to original textures as private data. D3D releases it when the
+// texture is destroyed, which is our cue to evict the texture's entries.
+class TextureLifetimeTracker : public IUnknown {
+public:
+  explicit TextureLifetimeTracker(void *pTexture)
+      : m_refCount(1), m_texture(pTexture), m_armed(false) {}
+
+  void Arm() { m_armed = true; }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid,
+                                           void **ppvObject) override {
+    if (!ppvObject)
+      return E_POINTER;
+    if (riid == __uuidof(IUnknown)) {
+      *ppvObject = static_cast<IUnknown *>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  ULONG STDMETHODCALLTYPE AddRef() override {
+    return (ULONG)InterlockedIncrement(&m_refCount);
+  }
+
+  ULONG STDMETHODCALLTYPE Release() override {
+    LONG count = InterlockedDecrement(&m_refCount);
+    if (count == 0) {
+      if (m_armed)
+        OnTrackedTextureDestroyed(m_texture);
+      delete this;
+    }
+    return (ULONG)count;
+  }
+
+private:
+  volatile LONG m_refCount;
+  void *m_texture;
+  bool m_armed;
+};
+
+// {7C3F9A21-5E84-4B6D-A1C2-93D08E4F6B15}
+const GUID GUID_CrossFixTextureTracker = {
+    0x7c3f9a21,
+    0x5e84,
+    0x4b6d,
+    {0xa1, 0xc2, 0x93, 0xd0, 0x8e, 0x4f, 0x6b, 0x15}};
+
+// Attach a lifetime tracker once per texture (call outside the cache lock)
+void TrackTextureLifetime(ID3D11Texture2D *pTexture) {
+  InitReplacementCacheCS();
+  EnterCriticalSection(&g_replacementCacheCS);
+  bool isNew = g_trackedTextures.insert(pTexture).second;
+  LeaveCriticalSection(&g_replacementCacheCS);
+  if (!isNew)
+    return;
+
+  TextureLifetimeTracker *tracker = new TextureLifetimeTracker(pTexture);
+  if (SUCCEEDED(pTexture->SetPrivateDataInterface(GUID_CrossFixTextureTracker,
+                                                  tracker))) {
+    tracker->Arm();
+  } else {
+    EnterCriticalSection(&g_replacementCacheCS);
+    g_trackedTextures.erase(pTexture);
+    LeaveCriticalSection(&g_replacementCacheCS);
+  }
+  tracker->Release(); // Texture holds its own reference
+}
+
+// Dump the tiles of a band-hashed texture to dump/regions so they can be
+// replaced one by one (region_replace.h). Uniform tiles are skipped.
+void DumpRegionTiles(const D3D11_TEXTURE2D_DESC &desc,
+                     const D3D11_MAPPED_SUBRESOURCE &mapped) {
+  UINT bytesPerPixel = GetRegionBytesPerPixel(desc.Format);
+  if (!bytesPerPixel)
+    return;
+
+  const uint8_t *src = static_cast<const uint8_t *>(mapped.pData);
+  UINT dumped = 0;
+  for (UINT top = 0; top < desc.Height; top += REGION_TILE_SIZE) {
+    UINT tileHeight = desc.Height - top < REGION_TILE_SIZE ? desc.Height - top
+                                                           : REGION_TILE_SIZE;
+    for (UINT left = 0; left < desc.Width; left += REGION_TILE_SIZE) {
+      UINT tileWidth = desc.Width - left < REGION_TILE_SIZE ? desc.Width - left
+                                                            : REGION_TILE_SIZE;
+      const uint8_t *tile = src + static_cast<size_t>(top) * mapped.RowPitch +
+                            static_cast<size_t>(left) * bytesPerPixel;
+
+      D3D11_TEXTURE2D_DESC tileDesc = desc;
+      tileDesc.Width = tileWidth;
+      tileDesc.Height = tileHeight;
+      tileDesc.MipLevels = 1;
+      tileDesc.ArraySize = 1;
+      TextureScanResult scan =
+          ScanTextureData(&tileDesc, tile, mapped.RowPitch);
+      if (scan.solidColor || scan.alpha == TextureAlpha::Transparent)
+        continue;
+
+      uint64_t hash = HashRegionTile(tile, mapped.RowPitch, bytesPerPixel,
+                                     tileWidth, tileHeight);
+      if (!ReserveDump(hash))
+        continue;
+
+      std::ostringstream filename;
+      filename << std::dec << tileWidth << "x" << tileHeight << "_" << std::hex
+               << std::setfill('0') << std::setw(16) << hash << ".dds";
+      std::string filepath = g_dumpPath + "\\regions\\" + filename.str();
+
+      D3D11_SUBRESOURCE_DATA tileData = {};
+      tileData.pSysMem = tile;
+      tileData.SysMemPitch = mapped.RowPitch;
+      if (SaveDDSFromInitialData(&tileDesc, &tileData, filepath, nullptr)) {
+        RecordDump(hash, tileWidth, tileHeight);
+        dumped++;
+      }
+    }
+  }
+  if (dumped)
+    std::cout << "Dumped " << dumped << " region tile(s) of " << desc.Width
+              << "x" << desc.Height << std::endl;
+}
+
+// Bring the staging mirror of a band-hashed texture up to date and return
+// its content hash (same value as HashTextureData). Only bands written since
+// the last call are copied and rehashed; the first call copies everything.
+// outSpans receives the pixel rows that were refreshed.
+bool StageBandHashedTexture(ID3D11DeviceContext *pContext,
+                            ID3D11Device *pDevice, ID3D11Texture2D *pTexture,
+                            const D3D11_TEXTURE2D_DESC &desc,
+                            ID3D11Texture2D **outStaging, uint64_t *outHash,
+                            std::vector<std::pair<UINT, UINT>> *outSpans) {
+  InitBandStateCS();
+  EnterCriticalSection(&g_bandStateCS);
+  bool created = false;
+  auto it = g_bandStates.find(pTexture);
+  if (it == g_bandStates.end() || !it->second.staging) {
+    D3D11_TEXTURE2D_DESC stagingDesc = desc;
+    stagingDesc.Usage = D3D11_USAGE_STAGING;
+    stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    stagingDesc.BindFlags = 0;
+    stagingDesc.MiscFlags = 0;
+    stagingDesc.MipLevels = 1;
+    stagingDesc.ArraySize = 1;
+
+    ComPtr<ID3D11Texture2D> staging;
+    HRESULT hr = pDevice->CreateTexture2D(&stagingDesc, nullptr, &staging);
+    if (FAILED(hr) || !staging) {
+      LeaveCriticalSection(&g_bandStateCS);
+      return false;
+    }
+    if (it == g_bandStates.end()) {
+      it = g_bandStates.emplace(pTexture, BandTextureState()).first;
+      InterlockedIncrement(&g_bandStateCount);
+    }
+    it->second.staging = staging;
+    it->second.stagingBytes = GetTextureMemorySize(stagingDesc);
+    g_bandMirrorBytes += it->second.stagingBytes;
+    created = true;
+  }
+  BandTextureState &state = it->second;
+  state.lastUsedFrame = g_presentCount;
+
+  // Our CopySubresourceRegion hook sees these; the mirror isn't tracked
+  std::vector<std::pair<UINT, UINT>> &spans = *outSpans;
+  spans.clear();
+  if (created)
+    spans.push_back(std::make_pair(0u, desc.Height));
+  else
+    state.bands.GetDirtySpans(&spans);
+  for (const auto &span : spans) {
+    D3D11_BOX box = {0, span.first, 0, desc.Width, span.second, 1};
+    pContext->CopySubresourceRegion(state.staging.Get(), 0, 0, span.first, 0,
+                                    pTexture, 0, &box);
+  }
+  pContext->Flush();
+
+  bool ok = false;
+  D3D11_MAPPED_SUBRESOURCE mapped = {};
+  HRESULT hr =
+      pContext->Map(state.staging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+  if (SUCCEEDED(hr) && mapped.pData) {
+    UINT rowSize, numRows;
+    if (GetHashRowLayout(&desc, mapped.pData, mapped.RowPitch, &rowSize,
+                         &numRows)) {
+      if (created)
+        state.bands.Init(desc.Height, numRows, numRows < desc.Height ? 4 : 1);
+      state.bands.Refresh(static_cast<const uint8_t *>(mapped.pData),
+                          mapped.RowPitch, rowSize);
+      *outHash = state.bands.Combine(HashDescFields(&desc));
+      ok = true;
+    }
+    pContext->Unmap(state.staging.Get(), 0);
+  }
+
+  if (ok) {
+    *outStaging = state.staging.Get();
+    (*outStaging)->AddRef();
+  } else {
+    // Start over with a full copy next time
+    g_bandMirrorBytes -= state.stagingBytes;
+    g_bandStates.erase(it);
+    InterlockedDecrement(&g_bandStateCount);
+  }
+  LeaveCriticalSection(&g_bandStateCS);
+  return ok;
+}
+
+// Insert a replacement SRV and evict least recently bound entries while over
+// budget. Caller holds g_replacementCacheCS.
+void InsertReplacementSRV(void *pTexture,
+                          const ComPtr<ID3D11ShaderResourceView> &srv,
+                          uint64_t bytes, uint64_t hash) {
+  auto it = g_replacementSRVCache.find(pTexture);
+  if (it != g_replacementSRVCache.end())
+    RemoveReplacementEntry(it);
+
+  g_replacementSRVCache[pTexture] = {srv, bytes, hash, false};
+  if (g_replacementSRVUsers[srv.Get()]++ == 0) {
+    g_replacementStats.residentBytes += bytes;
+    g_replacementStats.residentCount++;
+  }
+
+  // Never evict the entry just inserted, even if it alone exceeds the budget.
+  // Retired views are on their way out and can't be evicted again.
+  while (g_replacementBudgetBytes &&
+         g_replacementStats.residentBytes - g_replacementStats.retiredBytes >
+             g_replacementBudgetBytes &&
+         g_replacementSRVCache.size() > 1) {
+    // Oldest bind stamp from the fast path (0 = not in the fast table)
+    auto victim = g_replacementSRVCache.end();
+    DWORD now = GetTickCount();
+    DWORD victimAge = 0;
+    InitBindCacheWriteCS();
+    EnterCriticalSection(&g_bindCacheWriteCS);
+    for (auto e = g_replacementSRVCache.begin();
+         e != g_replacementSRVCache.end(); ++e) {
+      if (e->first == pTexture)
+        continue;
+      DWORD lastUsed = g_bindCache.GetLastUsed(e->first);
+      DWORD age = lastUsed ? now - lastUsed : 0xFFFFFFFF;
+      if (victim == g_replacementSRVCache.end() || age > victimAge) {
+        victim = e;
+        victimAge = age;
+      }
+    }
+    LeaveCriticalSection(&g_bindCacheWriteCS);
+    RemoveReplacementEntry(victim);
+    g_replacementStats.budgetEvictions++;
+  }
+
+  if (g_replacementStats.residentBytes > g_replacementStats.peakBytes)
+    g_replacementStats.peakBytes = g_replacementStats.residentBytes;
+}
+
 // Dump a texture from GPU via staging copy + content hash
 void DumpTextureFromGPU(ID3D11DeviceContext *pContext,
                         ID3D11Texture2D *pTexture,
@@ -975,9 +1657,8 @@ void DumpTextureFromGPU(ID3D11DeviceContext *pContext,
   if (FAILED(hr) || !pStaging)
     return;
 
-  // Use CopyResource instead of CopySubresourceRegion to avoid going through
-  // the hooked CopySubresourceRegion vtable entry (which has an extra BOOL
-  // parameter that causes stack corruption on x86 __stdcall).
+  // Whole-resource copy; the staging texture isn't tracked, so the dirty
+  // mark from the CopyResource hook is a lock-free no-op.
   pContext->CopyResource(pStaging.Get(), pTexture);
   pContext->Flush();
 
@@ -986,21 +1667,13 @@ void DumpTextureFromGPU(ID3D11DeviceContext *pContext,
   if (FAILED(hr) || !mapped.pData)
     return;
 
-  // Hash from actual GPU content
-  uint64_t hash = HashTextureData(pDesc, mapped.pData, mapped.RowPitch);
+  // Hash and alpha classification from actual GPU content in one pass
+  TextureScanResult scan =
+      ScanTextureData(pDesc, mapped.pData, mapped.RowPitch);
+  uint64_t hash = scan.hash;
 
-  // Check content-hash dedup
-  InitDumpCS();
-  EnterCriticalSection(&g_dumpCS);
-  bool alreadyDumped = g_recentDumps.count(hash) > 0;
-  if (!alreadyDumped) {
-    if (g_recentDumps.size() > 10000)
-      g_recentDumps.clear();
-    g_recentDumps.insert(hash);
-  }
-  LeaveCriticalSection(&g_dumpCS);
-
-  if (alreadyDumped) {
+  // Check content-hash dedup (covers previous sessions too)
+  if (!ReserveDump(hash)) {
     pContext->Unmap(pStaging.Get(), 0);
     return;
   }
@@ -1011,23 +1684,9 @@ void DumpTextureFromGPU(ID3D11DeviceContext *pContext,
            << std::hex << std::setfill('0') << std::setw(16) << hash << ".dds";
   std::string filenameStr = filename.str();
 
-  // Check if already on disk
   bool isRT = (pDesc->BindFlags & D3D11_BIND_RENDER_TARGET) != 0;
-  std::string foldersToCheck[] = {
-      "BGRA4",    "BGRA8", "RGBA8",       "BC1_DXT1",      "BC2_DXT3",
-      "BC3_DXT5", "BC7",   "transparent", "rendertargets", "other"};
-  for (const auto &folder : foldersToCheck) {
-    std::string checkPath = g_dumpPath + "\\" + folder + "\\" + filenameStr;
-    if (GetFileAttributesA(checkPath.c_str()) != INVALID_FILE_ATTRIBUTES) {
-      pContext->Unmap(pStaging.Get(), 0);
-      return;
-    }
-  }
 
-  // Check transparency
-  bool isTransparent =
-      IsFullyTransparent(mapped.pData, pDesc->Width, pDesc->Height,
-                         mapped.RowPitch, pDesc->Format);
+  bool isTransparent = scan.alpha == TextureAlpha::Transparent;
 
   // Determine folder
   std::string folder;
@@ -1048,26 +1707,22 @@ void DumpTextureFromGPU(ID3D11DeviceContext *pContext,
   tempData.pSysMem = mapped.pData;
   tempData.SysMemPitch = mapped.RowPitch;
 
-  bool isTransparentUnused = false;
-  if (SaveDDSFromInitialData(&writeDesc, &tempData, filepath,
-                             &isTransparentUnused)) {
-    std::cout << "Dumped" << (isRT ? " RT" : "") << ": " << pDesc->Width << "x"
-              << pDesc->Height << " " << filenameStr << std::endl;
+  if (SaveDDSFromInitialData(&writeDesc, &tempData, filepath, nullptr)) {
+    RecordDump(hash, pDesc->Width, pDesc->Height);
+    std::cout << "Dumped" << (isRT ? " RT" : "")
+              << (scan.solidColor ? " (solid)" : "") << ": " << pDesc->Width
+              << "x" << pDesc->Height << " " << filenameStr << std::endl;
   }
 
   pContext->Unmap(pStaging.Get(), 0);
 }
 
-void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
-    ID3D11DeviceContext *This, UINT StartSlot, UINT NumViews,
+void Hooked_PSSetShaderResources(
+    const PSSetShaderResourcesHook::Next &next, ID3D11DeviceContext *This,
+    UINT StartSlot, UINT NumViews,
     ID3D11ShaderResourceView *const *ppShaderResourceViews) {
-  MemoryBarrier();
-  PSSetShaderResources_t pOriginal = Original_PSSetShaderResources;
-
-  if (!pOriginal)
-    return;
-  if (!g_psSetSRHookReady || !ppShaderResourceViews || NumViews == 0) {
-    pOriginal(This, StartSlot, NumViews, ppShaderResourceViews);
+  if (!ppShaderResourceViews || NumViews == 0) {
+    next(This, StartSlot, NumViews, ppShaderResourceViews);
     return;
   }
 
@@ -1078,26 +1733,17 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
       IsTextureDumpEnabled() && !IsUpscaleActive() && !replaceEnabled;
 
   if (!dumpEnabled && !replaceEnabled) {
-    pOriginal(This, StartSlot, NumViews, ppShaderResourceViews);
+    next(This, StartSlot, NumViews, ppShaderResourceViews);
     return;
   }
 
-  // Periodically clear the dump pointer dedup set so textures get re-staged.
-  // The PS1 emulator reuses texture objects with different content, and
-  // destroyed textures may get reallocated at the same address.
-  // Content hash dedup (g_recentDumps) prevents duplicate disk writes.
-  if (dumpEnabled) {
-    static DWORD g_lastDumpClearTime = 0;
-    DWORD now = GetTickCount();
-    if (now - g_lastDumpClearTime > 2000) {
-      InitSeenTexturesCS();
-      EnterCriticalSection(&g_seenTexturesCS);
-      g_seenTexturePointers.clear();
-      LeaveCriticalSection(&g_seenTexturesCS);
-      g_lastDumpClearTime = now;
-    }
-  }
-  // Replacement uses per-texture retry instead of bulk clear (see below).
+  // The PS1 emulator reuses texture objects with different content. Writes
+  // through the context hooks below mark textures dirty, and destroyed
+  // textures are evicted by their lifetime tracker, so every verdict cached
+  // here stays valid until one of those happens. Content hash dedup
+  // (g_dumpIndex) prevents duplicate disk writes.
+
+  DWORD bindStamp = GetTickCount();
 
   // Prepare modified SRV array for replacement swaps (D3D11 max = 128)
   ID3D11ShaderResourceView *modSRVs[128];
@@ -1118,23 +1764,38 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
     if (!pResource)
       continue;
 
-    ID3D11Texture2D *pTexture = nullptr;
-    HRESULT hr = pResource->QueryInterface(__uuidof(ID3D11Texture2D),
-                                           (void **)&pTexture);
-    pResource->Release();
-    if (FAILED(hr) || !pTexture)
+    // The resource table answers for textures it has seen, so the fast
+    // path below needs no QueryInterface
+    D3D11_TEXTURE2D_DESC desc;
+    if (!GetTexture2DDesc(pResource, &desc)) {
+      pResource->Release();
       continue;
+    }
+    // Takes over GetResource's reference
+    ID3D11Texture2D *pTexture = static_cast<ID3D11Texture2D *>(pResource);
+
+    // Fast path (no locks): replaced, or known to need no work
+    void *cached = nullptr;
+    if (g_bindCache.Find(pTexture, &cached, bindStamp)) {
+      if (cached && cached != BIND_SKIP_ALWAYS && replaceEnabled) {
+        modSRVs[i] = static_cast<ID3D11ShaderResourceView *>(cached);
+        anyReplaced = true;
+      }
+      pTexture->Release();
+      continue;
+    }
 
     bool needsProcessing = false;
 
     if (replaceEnabled) {
-      // Fast path: check replacement cache
+      // Slow path: authoritative caches
       InitReplacementCacheCS();
       EnterCriticalSection(&g_replacementCacheCS);
       auto cacheIt = g_replacementSRVCache.find(pTexture);
-      if (cacheIt != g_replacementSRVCache.end()) {
-        modSRVs[i] = cacheIt->second.Get();
+      if (cacheIt != g_replacementSRVCache.end() && !cacheIt->second.dirty) {
+        modSRVs[i] = cacheIt->second.srv.Get();
         anyReplaced = true;
+        PublishBindCache(pTexture, cacheIt->second.srv.Get());
         LeaveCriticalSection(&g_replacementCacheCS);
         pTexture->Release();
         continue;
@@ -1142,15 +1803,11 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
       bool checked = false;
       auto noRepIt = g_checkedNoReplacement.find(pTexture);
       if (noRepIt != g_checkedNoReplacement.end()) {
-        if (noRepIt->second.retryCount >= REPLACE_MAX_RETRIES) {
-          checked = true; // Exhausted retries, permanently skip
-        } else {
-          DWORD now = GetTickCount();
-          if (now - noRepIt->second.lastCheckTime < REPLACE_RETRY_INTERVAL_MS) {
-            checked = true; // Too soon to retry
-          }
-          // else: enough time passed, re-check this texture
-        }
+        checked = true; // Not written since it was checked
+        PublishBindCache(pTexture,
+                         noRepIt->second == NoReplacement::Ineligible
+                             ? BIND_SKIP_ALWAYS
+                             : nullptr);
       }
       LeaveCriticalSection(&g_replacementCacheCS);
 
@@ -1165,10 +1822,13 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
       bool seen = g_seenTexturePointers.count(pTexture) > 0;
       if (!seen)
         g_seenTexturePointers.insert(pTexture);
+      PublishBindCache(pTexture, nullptr);
       LeaveCriticalSection(&g_seenTexturesCS);
 
-      if (!seen)
+      if (!seen) {
+        TrackTextureLifetime(pTexture);
         needsProcessing = true;
+      }
     }
 
     if (!needsProcessing) {
@@ -1176,57 +1836,49 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
       continue;
     }
 
-    // First encounter - stage, hash, dump, and/or replace
-    D3D11_TEXTURE2D_DESC desc;
-    pTexture->GetDesc(&desc);
+    // First encounter (or first bind since a write) - stage, hash, dump,
+    // and/or replace
 
-    // Helper: mark texture as permanently having no replacement
+    // Helper: mark texture as never having a replacement, whatever it holds
     auto markNoReplacementPermanent = [&]() {
       if (replaceEnabled) {
         InitReplacementCacheCS();
         EnterCriticalSection(&g_replacementCacheCS);
-        g_checkedNoReplacement[pTexture] = {REPLACE_MAX_RETRIES,
-                                            GetTickCount()};
+        g_checkedNoReplacement[pTexture] = NoReplacement::Ineligible;
+        PublishBindCache(pTexture, BIND_SKIP_ALWAYS);
         LeaveCriticalSection(&g_replacementCacheCS);
+        TrackTextureLifetime(pTexture);
       }
     };
 
-    // Helper: increment retry count for texture (will be re-checked later)
+    // Helper: no replacement for the current content (re-checked when the
+    // texture is next written)
     auto markNoReplacementRetry = [&]() {
       if (replaceEnabled) {
         InitReplacementCacheCS();
         EnterCriticalSection(&g_replacementCacheCS);
-        auto it = g_checkedNoReplacement.find(pTexture);
-        if (it != g_checkedNoReplacement.end()) {
-          it->second.retryCount++;
-          it->second.lastCheckTime = GetTickCount();
-        } else {
-          g_checkedNoReplacement[pTexture] = {1, GetTickCount()};
-        }
+        g_checkedNoReplacement[pTexture] = NoReplacement::NoMatch;
+        PublishBindCache(pTexture, nullptr);
         LeaveCriticalSection(&g_replacementCacheCS);
+        TrackTextureLifetime(pTexture);
       }
     };
 
-    // Skip upscaled render targets - huge framebuffers, no useful content
-    if (IsUpscaleActive() && desc.Width == (UINT)GetUpscaledWidth() &&
-        desc.Height == (UINT)GetUpscaledHeight() &&
-        (desc.BindFlags & D3D11_BIND_RENDER_TARGET)) {
-      markNoReplacementPermanent();
-      pTexture->Release();
-      continue;
-    }
-
-    if (desc.Width < 4 || desc.Height < 4 || !IsDumpableFormat(desc.Format)) {
-      markNoReplacementPermanent();
-      pTexture->Release();
-      continue;
+    // Never staged, whatever the texture holds: upscaled render targets,
+    // unsupported formats and sizes without replacements (texture_filter.h)
+    bool bandHashed = UsesBandHash(desc.Width, desc.Height);
+    bool regionCandidate = replaceEnabled && bandHashed &&
+                           HasRegionReplacements() &&
+                           GetRegionBytesPerPixel(desc.Format) != 0;
+    BindFilter filter = {dumpEnabled, replaceEnabled, 0, 0,
+                         HasReplacementAtDimensions};
+    if (IsUpscaleActive()) {
+      filter.upscaledWidth = (UINT)GetUpscaledWidth();
+      filter.upscaledHeight = (UINT)GetUpscaledHeight();
     }
-
-    // Dimension pre-filter: if no replacement file exists at these dimensions,
-    // skip the expensive staging copy entirely. This eliminates the vast
-    // majority of GPU staging work.
-    if (replaceEnabled && !dumpEnabled &&
-        !HasReplacementAtDimensions(desc.Width, desc.Height)) {
+    if (GetBindSkip(filter, desc.Width, desc.Height, desc.Format,
+                    (desc.BindFlags & D3D11_BIND_RENDER_TARGET) != 0,
+                    regionCandidate) != BIND_SKIP_NONE) {
       markNoReplacementPermanent();
       pTexture->Release();
       continue;
@@ -1240,120 +1892,228 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
         continue;
       }
 
-      // Create staging texture (shared for dump + replace)
-      D3D11_TEXTURE2D_DESC stagingDesc = desc;
-      stagingDesc.Usage = D3D11_USAGE_STAGING;
-      stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-      stagingDesc.BindFlags = 0;
-      stagingDesc.MiscFlags = 0;
-      stagingDesc.MipLevels = 1;
-
+      // Create staging texture (shared for dump + replace). Band-hashed
+      // textures keep a persistent one that only receives written bands.
       ComPtr<ID3D11Texture2D> pStaging;
-      hr = pDevice->CreateTexture2D(&stagingDesc, nullptr, &pStaging);
-      if (FAILED(hr) || !pStaging) {
-        markNoReplacementRetry();
-        pTexture->Release();
-        continue;
-      }
+      uint64_t bandHash = 0;
+      std::vector<std::pair<UINT, UINT>> bandSpans;
+      if (bandHashed) {
+        if (!StageBandHashedTexture(This, pDevice.Get(), pTexture, desc,
+                                    pStaging.GetAddressOf(), &bandHash,
+                                    &bandSpans)) {
+          markNoReplacementRetry();
+          pTexture->Release();
+          continue;
+        }
+      } else {
+        D3D11_TEXTURE2D_DESC stagingDesc = desc;
+        stagingDesc.Usage = D3D11_USAGE_STAGING;
+        stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        stagingDesc.BindFlags = 0;
+        stagingDesc.MiscFlags = 0;
+        stagingDesc.MipLevels = 1;
+
+        HRESULT hr =
+            pDevice->CreateTexture2D(&stagingDesc, nullptr, &pStaging);
+        if (FAILED(hr) || !pStaging) {
+          markNoReplacementRetry();
+          pTexture->Release();
+          continue;
+        }
 
-      // Use CopyResource instead of CopySubresourceRegion to avoid going
-      // through the hooked CopySubresourceRegion vtable entry (extra BOOL
-      // parameter causes stack corruption on x86 __stdcall).
-      This->CopyResource(pStaging.Get(), pTexture);
-      This->Flush();
+        // Whole-resource copy; the staging texture isn't tracked, so the
+        // dirty mark from the CopyResource hook is a lock-free no-op.
+        This->CopyResource(pStaging.Get(), pTexture);
+        This->Flush();
+      }
 
       D3D11_MAPPED_SUBRESOURCE mapped = {};
-      hr = This->Map(pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+      HRESULT hr = This->Map(pStaging.Get(), 0, D3D11_MAP_READ, 0, &mapped);
       if (FAILED(hr) || !mapped.pData) {
         markNoReplacementRetry();
         pTexture->Release();
         continue;
       }
 
-      // Content hash from GPU data
-      uint64_t hash = HashTextureData(&desc, mapped.pData, mapped.RowPitch);
+      // Sampled fingerprint first: when it rules out every replacement at
+      // this size, the full hash is only needed for dumping
+      uint64_t fingerprint = 0;
+      if (replaceEnabled) {
+        fingerprint =
+            FingerprintTextureData(&desc, mapped.pData, mapped.RowPitch);
+        if (!dumpEnabled && !regionCandidate &&
+            !MayHaveReplacement(desc.Width, desc.Height, fingerprint)) {
+          This->Unmap(pStaging.Get(), 0);
+          // A replacement loaded for earlier content can't match either
+          InitReplacementCacheCS();
+          EnterCriticalSection(&g_replacementCacheCS);
+          auto cacheIt = g_replacementSRVCache.find(pTexture);
+          if (cacheIt != g_replacementSRVCache.end())
+            RemoveReplacementEntry(cacheIt);
+          LeaveCriticalSection(&g_replacementCacheCS);
+          markNoReplacementRetry();
+          pTexture->Release();
+          continue;
+        }
+      }
+
+      // Content hash from GPU data; dumping also needs the alpha class,
+      // taken in the same pass (band-hashed textures classify only when
+      // actually dumped)
+      TextureScanResult scan = {};
+      if (bandHashed)
+        scan.hash = bandHash;
+      else if (dumpEnabled)
+        scan = ScanTextureData(&desc, mapped.pData, mapped.RowPitch);
+      else
+        scan.hash = HashTextureData(&desc, mapped.pData, mapped.RowPitch);
+      uint64_t hash = scan.hash;
 
       // Dump if enabled
-      if (dumpEnabled) {
-        InitDumpCS();
-        EnterCriticalSection(&g_dumpCS);
-        bool alreadyDumped = g_recentDumps.count(hash) > 0;
-        if (!alreadyDumped) {
-          if (g_recentDumps.size() > 10000)
-            g_recentDumps.clear();
-          g_recentDumps.insert(hash);
+      if (dumpEnabled && ReserveDump(hash)) {
+        if (bandHashed)
+          scan = ScanTextureData(&desc, mapped.pData, mapped.RowPitch);
+
+        std::ostringstream filename;
+        filename << std::dec << desc.Width << "x" << desc.Height << "_"
+                 << std::hex << std::setfill('0') << std::setw(16) << hash
+                 << ".dds";
+        std::string filenameStr = filename.str();
+
+        bool isRT = (desc.BindFlags & D3D11_BIND_RENDER_TARGET) != 0;
+        bool isTransparent = scan.alpha == TextureAlpha::Transparent;
+
+        std::string folder;
+        if (isRT)
+          folder =
+              isTransparent ? "rendertargets\\transparent" : "rendertargets";
+        else if (isTransparent)
+          folder = "transparent";
+        else
+          folder = GetFormatFolderName(desc.Format);
+
+        std::string filepath = g_dumpPath + "\\" + folder + "\\" + filenameStr;
+
+        D3D11_TEXTURE2D_DESC writeDesc = desc;
+        writeDesc.MipLevels = 1;
+
+        D3D11_SUBRESOURCE_DATA tempData = {};
+        tempData.pSysMem = mapped.pData;
+        tempData.SysMemPitch = mapped.RowPitch;
+
+        if (SaveDDSFromInitialData(&writeDesc, &tempData, filepath, nullptr)) {
+          RecordDump(hash, desc.Width, desc.Height);
+          std::cout << "Dumped" << (isRT ? " RT" : "")
+                    << (scan.solidColor ? " (solid)" : "") << ": "
+                    << desc.Width << "x" << desc.Height << " " << filenameStr
+                    << std::endl;
         }
-        LeaveCriticalSection(&g_dumpCS);
-
-        if (!alreadyDumped) {
-          std::ostringstream filename;
-          filename << std::dec << desc.Width << "x" << desc.Height << "_"
-                   << std::hex << std::setfill('0') << std::setw(16) << hash
-                   << ".dds";
-          std::string filenameStr = filename.str();
-
-          // Check if already on disk
-          bool onDisk = false;
-          std::string foldersToCheck[] = {
-              "BGRA4",    "BGRA8", "RGBA8",       "BC1_DXT1",      "BC2_DXT3",
-              "BC3_DXT5", "BC7",   "transparent", "rendertargets", "other"};
-          for (const auto &folder : foldersToCheck) {
-            std::string checkPath =
-                g_dumpPath + "\\" + folder + "\\" + filenameStr;
-            if (GetFileAttributesA(checkPath.c_str()) !=
-                INVALID_FILE_ATTRIBUTES) {
-              onDisk = true;
-              break;
+        if (bandHashed)
+          DumpRegionTiles(desc, mapped);
+      }
+
+      // Atlas textures: tiles with region replacements are composited into
+      // an upscaled copy that is bound instead (see region_replace.h)
+      if (regionCandidate) {
+        ComPtr<ID3D11ShaderResourceView> pCompositeSRV;
+        if (UpdateRegionComposite(This, pDevice.Get(), pTexture, desc, mapped,
+                                  bandSpans, pCompositeSRV.GetAddressOf())) {
+          std::vector<ComPtr<ID3D11ShaderResourceView>> released;
+          InitReplacementCacheCS();
+          EnterCriticalSection(&g_replacementCacheCS);
+          auto cacheIt = g_replacementSRVCache.find(pTexture);
+          if (cacheIt != g_replacementSRVCache.end() &&
+              cacheIt->second.srv.Get() == pCompositeSRV.Get()) {
+            // Same composite, updated in place
+            cacheIt->second.hash = hash;
+            cacheIt->second.dirty = false;
+          } else {
+            uint64_t bytes = (uint64_t)desc.Width * desc.Height *
+                             GetRegionBytesPerPixel(desc.Format);
+            ComPtr<ID3D11Resource> pCompositeRes;
+            ComPtr<ID3D11Texture2D> pCompositeTex;
+            pCompositeSRV->GetResource(pCompositeRes.GetAddressOf());
+            if (pCompositeRes && SUCCEEDED(pCompositeRes.As(&pCompositeTex))) {
+              D3D11_TEXTURE2D_DESC compositeDesc;
+              pCompositeTex->GetDesc(&compositeDesc);
+              bytes = GetTextureMemorySize(compositeDesc);
             }
+            InsertReplacementSRV(pTexture, pCompositeSRV, bytes, hash);
           }
+          PublishBindCache(pTexture, pCompositeSRV.Get());
+          g_checkedNoReplacement.erase(pTexture);
+          DrainRetiredSRVs(&released);
+          LeaveCriticalSection(&g_replacementCacheCS);
+          TrackTextureLifetime(pTexture);
+          modSRVs[i] = pCompositeSRV.Get();
+          anyReplaced = true;
 
-          if (!onDisk) {
-            bool isRT = (desc.BindFlags & D3D11_BIND_RENDER_TARGET) != 0;
-            bool isTransparent =
-                IsFullyTransparent(mapped.pData, desc.Width, desc.Height,
-                                   mapped.RowPitch, desc.Format);
-
-            std::string folder;
-            if (isRT)
-              folder = isTransparent ? "rendertargets\\transparent"
-                                     : "rendertargets";
-            else if (isTransparent)
-              folder = "transparent";
-            else
-              folder = GetFormatFolderName(desc.Format);
-
-            std::string filepath =
-                g_dumpPath + "\\" + folder + "\\" + filenameStr;
-
-            D3D11_TEXTURE2D_DESC writeDesc = desc;
-            writeDesc.MipLevels = 1;
-
-            D3D11_SUBRESOURCE_DATA tempData = {};
-            tempData.pSysMem = mapped.pData;
-            tempData.SysMemPitch = mapped.RowPitch;
-
-            bool unused = false;
-            if (SaveDDSFromInitialData(&writeDesc, &tempData, filepath,
-                                       &unused)) {
-              std::cout << "Dumped" << (isRT ? " RT" : "") << ": " << desc.Width
-                        << "x" << desc.Height << " " << filenameStr
-                        << std::endl;
-            }
+          This->Unmap(pStaging.Get(), 0);
+          pTexture->Release();
+          continue;
+        }
+      }
+
+      // Rewritten with the same content: keep the loaded replacement
+      bool reused = false;
+      if (replaceEnabled) {
+        InitReplacementCacheCS();
+        EnterCriticalSection(&g_replacementCacheCS);
+        auto cacheIt = g_replacementSRVCache.find(pTexture);
+        if (cacheIt != g_replacementSRVCache.end()) {
+          if (cacheIt->second.hash == hash) {
+            cacheIt->second.dirty = false;
+            modSRVs[i] = cacheIt->second.srv.Get();
+            anyReplaced = true;
+            PublishBindCache(pTexture, cacheIt->second.srv.Get());
+            reused = true;
+          } else {
+            RemoveReplacementEntry(cacheIt);
           }
         }
+        LeaveCriticalSection(&g_replacementCacheCS);
       }
 
       // Try replacement if enabled
-      if (replaceEnabled) {
+      if (replaceEnabled && !reused) {
         ComPtr<ID3D11ShaderResourceView> pReplaceSRV;
         if (LoadReplacementSRV(pDevice.Get(), &desc, hash,
                                pReplaceSRV.GetAddressOf())) {
-          // Matched! Move to positive cache (permanent).
+          RecordReplacementFingerprint(desc.Width, desc.Height, hash,
+                                       fingerprint);
+          // Matched! Move to positive cache (until the original texture is
+          // destroyed or the entry is evicted for budget).
+          uint64_t bytes = 0;
+          {
+            ComPtr<ID3D11Resource> pReplaceRes;
+            ComPtr<ID3D11Texture2D> pReplaceTex;
+            pReplaceSRV->GetResource(pReplaceRes.GetAddressOf());
+            if (pReplaceRes &&
+                SUCCEEDED(pReplaceRes.As(&pReplaceTex)) && pReplaceTex) {
+              D3D11_TEXTURE2D_DESC replaceDesc;
+              pReplaceTex->GetDesc(&replaceDesc);
+              bytes = GetTextureMemorySize(replaceDesc);
+            }
+          }
+
+          std::vector<ComPtr<ID3D11ShaderResourceView>> released;
           InitReplacementCacheCS();
           EnterCriticalSection(&g_replacementCacheCS);
-          g_replacementSRVCache[pTexture] = pReplaceSRV;
+#ifdef _DEBUG
+          uint32_t evictionsBefore = g_replacementStats.budgetEvictions;
+#endif
+          InsertReplacementSRV(pTexture, pReplaceSRV, bytes, hash);
+          PublishBindCache(pTexture, pReplaceSRV.Get());
           g_checkedNoReplacement.erase(pTexture); // Remove from negative cache
+          DrainRetiredSRVs(&released);
+#ifdef _DEBUG
+          if (g_replacementStats.budgetEvictions != evictionsBefore)
+            std::cout << "Replacement cache over budget, released "
+                      << (g_replacementStats.budgetEvictions - evictionsBefore)
+                      << " texture(s)" << std::endl;
+#endif
           LeaveCriticalSection(&g_replacementCacheCS);
+          TrackTextureLifetime(pTexture);
           modSRVs[i] = pReplaceSRV.Get();
           anyReplaced = true;
         } else {
@@ -1370,10 +2130,246 @@ void STDMETHODCALLTYPE Hooked_PSSetShaderResources(
   }
 
   if (replaceEnabled && anyReplaced) {
-    pOriginal(This, StartSlot, safeNumViews, modSRVs);
+    next(This, StartSlot, safeNumViews, modSRVs);
   } else {
-    pOriginal(This, StartSlot, NumViews, ppShaderResourceViews);
+    next(This, StartSlot, NumViews, ppShaderResourceViews);
+  }
+}
+
+// Release band staging mirrors that haven't been checked for a while. The
+// band state stays, so the next check makes a new mirror with a full copy.
+void ReleaseIdleBandMirrors(LONG frame,
+                            std::vector<ComPtr<ID3D11Texture2D>> *released) {
+  InitBandStateCS();
+  EnterCriticalSection(&g_bandStateCS);
+  for (auto &entry : g_bandStates) {
+    BandTextureState &state = entry.second;
+    if (state.staging &&
+        frame - state.lastUsedFrame >= BAND_MIRROR_IDLE_FRAMES) {
+      released->push_back(std::move(state.staging));
+      g_bandMirrorBytes -= state.stagingBytes;
+      state.stagingBytes = 0;
+    }
+  }
+  LeaveCriticalSection(&g_bandStateCS);
+}
+
+// Frame clock for retired SRVs, which are released here as well as when
+// replacements are inserted, so they don't linger once binds stop. Also
+// drops idle band staging mirrors every 60 frames.
+void OnPresent() {
+  LONG frame = InterlockedIncrement(&g_presentCount);
+  std::vector<ComPtr<ID3D11ShaderResourceView>> released;
+  InitReplacementCacheCS();
+  EnterCriticalSection(&g_replacementCacheCS);
+  if (!g_retiredSRVs.empty())
+    DrainRetiredSRVs(&released);
+  LeaveCriticalSection(&g_replacementCacheCS);
+
+  std::vector<ComPtr<ID3D11Texture2D>> mirrors;
+  if (frame % 60 == 0 && g_bandStateCount)
+    ReleaseIdleBandMirrors(frame, &mirrors);
+}
+
+// ============================================================================
+// Write hooks - dirty tracking for bind-time verdicts
+// ============================================================================
+// Every way the immediate context can change a texture's content marks it
+// dirty: Map for writing, UpdateSubresource, CopyResource,
+// CopySubresourceRegion, ResolveSubresource, clears, and binding it as a
+// render target or UAV (draws and dispatches). Mip generation only writes
+// the lower mips, which aren't hashed. Draws can't reach past the
+// viewports, so for band-hashed render targets only the rows under the
+// viewports set while they are bound are marked.
+
+void MarkViewDirty(ID3D11View *pView, UINT top = 0, UINT bottom = UINT_MAX) {
+  if (!pView)
+    return;
+  ID3D11Resource *pResource = nullptr;
+  pView->GetResource(&pResource);
+  if (pResource) {
+    MarkTextureDirty(pResource, 0, top, bottom);
+    pResource->Release();
+  }
+}
+
+// Pixel rows [top, bottom) the viewports cover; every row if there are none
+void GetViewportRows(const D3D11_VIEWPORT *vps, UINT count, UINT *top,
+                     UINT *bottom) {
+  *top = 0;
+  *bottom = UINT_MAX;
+  if (count == 0)
+    return;
+  float minY = vps[0].TopLeftY, maxY = vps[0].TopLeftY + vps[0].Height;
+  for (UINT i = 1; i < count; ++i) {
+    minY = (std::min)(minY, vps[i].TopLeftY);
+    maxY = (std::max)(maxY, vps[i].TopLeftY + vps[i].Height);
   }
+  *top = (UINT)(std::max)(0.0f, std::floor(minY));
+  *bottom = (UINT)(std::max)(0.0f, std::ceil(maxY));
+}
+
+// Rows under the viewports already set. These may have been upscaled for
+// an earlier target, which only widens the span.
+void GetCurrentViewportRows(ID3D11DeviceContext *pContext, UINT *top,
+                            UINT *bottom) {
+  UINT count = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+  D3D11_VIEWPORT vps[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+  pContext->RSGetViewports(&count, vps);
+  GetViewportRows(vps, count, top, bottom);
+}
+
+void MarkRenderTargetsDirty(ID3D11DeviceContext *pContext, UINT NumViews,
+                            ID3D11RenderTargetView *const *ppViews) {
+  UINT top = 0, bottom = UINT_MAX;
+  if (g_bandStateCount)
+    GetCurrentViewportRows(pContext, &top, &bottom);
+  for (UINT i = 0; i < NumViews; ++i)
+    MarkViewDirty(ppViews[i], top, bottom);
+}
+
+HRESULT Hooked_Map(const MapHook::Next &next, ID3D11DeviceContext *This,
+                   ID3D11Resource *pResource, UINT Subresource,
+                   D3D11_MAP MapType, UINT MapFlags,
+                   D3D11_MAPPED_SUBRESOURCE *pMappedResource) {
+  HRESULT hr =
+      next(This, pResource, Subresource, MapType, MapFlags, pMappedResource);
+  // Content lands before Unmap, which always precedes the next bind
+  if (SUCCEEDED(hr) && MapType != D3D11_MAP_READ)
+    MarkTextureDirty(pResource, Subresource);
+  return hr;
+}
+
+void Hooked_OMSetRenderTargets(
+    const OMSetRenderTargetsHook::Next &next, ID3D11DeviceContext *This,
+    UINT NumViews, ID3D11RenderTargetView *const *ppRenderTargetViews,
+    ID3D11DepthStencilView *pDepthStencilView) {
+  next(This, NumViews, ppRenderTargetViews, pDepthStencilView);
+  if (!ppRenderTargetViews)
+    return;
+  MarkRenderTargetsDirty(This, NumViews, ppRenderTargetViews);
+}
+
+void Hooked_OMSetRenderTargetsAndUAVs(
+    const OMSetRenderTargetsAndUAVsHook::Next &next, ID3D11DeviceContext *This,
+    UINT NumRTVs, ID3D11RenderTargetView *const *ppRenderTargetViews,
+    ID3D11DepthStencilView *pDepthStencilView, UINT UAVStartSlot,
+    UINT NumUAVs, ID3D11UnorderedAccessView *const *ppUnorderedAccessViews,
+    const UINT *pUAVInitialCounts) {
+  next(This, NumRTVs, ppRenderTargetViews, pDepthStencilView, UAVStartSlot,
+       NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+  // The KEEP values leave views bound earlier (already marked) in place
+  if (NumRTVs != D3D11_KEEP_RENDER_TARGETS_AND_DEPTH_STENCIL &&
+      ppRenderTargetViews)
+    MarkRenderTargetsDirty(This, NumRTVs, ppRenderTargetViews);
+  if (NumUAVs != D3D11_KEEP_UNORDERED_ACCESS_VIEWS && ppUnorderedAccessViews) {
+    for (UINT i = 0; i < NumUAVs; ++i)
+      MarkViewDirty(ppUnorderedAccessViews[i]);
+  }
+}
+
+// New viewports reach new rows of the render targets still bound. Only
+// band-hashed targets care which rows, so nothing to do without them.
+void Hooked_RSSetViewports(const RSSetViewportsHook::Next &next,
+                           ID3D11DeviceContext *This, UINT NumViewports,
+                           D3D11_VIEWPORT *pViewports) {
+  if (g_bandStateCount) {
+    ID3D11RenderTargetView *rtvs[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+    This->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, rtvs,
+                             nullptr);
+    UINT top, bottom;
+    GetViewportRows(pViewports, pViewports ? NumViewports : 0, &top, &bottom);
+    for (ID3D11RenderTargetView *rtv : rtvs) {
+      if (rtv) {
+        MarkViewDirty(rtv, top, bottom);
+        rtv->Release();
+      }
+    }
+  }
+  next(This, NumViewports, pViewports);
+}
+
+void Hooked_CSSetUnorderedAccessViews(
+    const CSSetUnorderedAccessViewsHook::Next &next, ID3D11DeviceContext *This,
+    UINT StartSlot, UINT NumUAVs,
+    ID3D11UnorderedAccessView *const *ppUnorderedAccessViews,
+    const UINT *pUAVInitialCounts) {
+  next(This, StartSlot, NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+  if (!ppUnorderedAccessViews)
+    return;
+  for (UINT i = 0; i < NumUAVs; ++i)
+    MarkViewDirty(ppUnorderedAccessViews[i]);
+}
+
+void Hooked_ClearRenderTargetView(const ClearRenderTargetViewHook::Next &next,
+                                  ID3D11DeviceContext *This,
+                                  ID3D11RenderTargetView *pRenderTargetView,
+                                  const FLOAT *ColorRGBA) {
+  next(This, pRenderTargetView, ColorRGBA);
+  MarkViewDirty(pRenderTargetView);
+}
+
+void Hooked_ClearUnorderedAccessViewUint(
+    const ClearUnorderedAccessViewUintHook::Next &next,
+    ID3D11DeviceContext *This, ID3D11UnorderedAccessView *pUnorderedAccessView,
+    const UINT *Values) {
+  next(This, pUnorderedAccessView, Values);
+  MarkViewDirty(pUnorderedAccessView);
+}
+
+void Hooked_ClearUnorderedAccessViewFloat(
+    const ClearUnorderedAccessViewFloatHook::Next &next,
+    ID3D11DeviceContext *This, ID3D11UnorderedAccessView *pUnorderedAccessView,
+    const FLOAT *Values) {
+  next(This, pUnorderedAccessView, Values);
+  MarkViewDirty(pUnorderedAccessView);
+}
+
+void Hooked_ResolveSubresource(const ResolveSubresourceHook::Next &next,
+                               ID3D11DeviceContext *This,
+                               ID3D11Resource *pDstResource,
+                               UINT DstSubresource,
+                               ID3D11Resource *pSrcResource,
+                               UINT SrcSubresource, DXGI_FORMAT Format) {
+  next(This, pDstResource, DstSubresource, pSrcResource, SrcSubresource,
+       Format);
+  MarkTextureDirty(pDstResource, DstSubresource);
+}
+
+void Hooked_CopySubresourceRegion(const CopySubresourceRegionHook::Next &next,
+                                  ID3D11DeviceContext *This,
+                                  ID3D11Resource *pDstResource,
+                                  UINT DstSubresource, UINT DstX, UINT DstY,
+                                  UINT DstZ, ID3D11Resource *pSrcResource,
+                                  UINT SrcSubresource,
+                                  const D3D11_BOX *pSrcBox) {
+  next(This, pDstResource, DstSubresource, DstX, DstY, DstZ, pSrcResource,
+       SrcSubresource, pSrcBox);
+  UINT bottom = pSrcBox ? DstY + (pSrcBox->bottom - pSrcBox->top) : UINT_MAX;
+  MarkTextureDirty(pDstResource, DstSubresource, DstY, bottom);
+}
+
+void Hooked_CopyResource(const CopyResourceHook::Next &next,
+                         ID3D11DeviceContext *This,
+                         ID3D11Resource *pDstResource,
+                         ID3D11Resource *pSrcResource) {
+  next(This, pDstResource, pSrcResource);
+  MarkTextureDirty(pDstResource);
+}
+
+void Hooked_UpdateSubresource(const UpdateSubresourceHook::Next &next,
+                              ID3D11DeviceContext *This,
+                              ID3D11Resource *pDstResource,
+                              UINT DstSubresource, const D3D11_BOX *pDstBox,
+                              const void *pSrcData, UINT SrcRowPitch,
+                              UINT SrcDepthPitch) {
+  next(This, pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch,
+       SrcDepthPitch);
+  if (pDstBox)
+    MarkTextureDirty(pDstResource, DstSubresource, pDstBox->top,
+                     pDstBox->bottom);
+  else
+    MarkTextureDirty(pDstResource, DstSubresource);
 }
 } // namespace
 
@@ -1393,13 +2389,54 @@ void ApplyTextureDumpHooks(ID3D11Device *pDevice,
   if (!dumpEnabled && !replaceEnabled)
     return;
 
-  void **contextVtable = *(void ***)pContext;
-  if (!contextVtable)
-    return;
-
-  // PSSetShaderResources = context vtable index 8
-  InstallVtableHook(contextVtable, 50, 8, (void *)Hooked_PSSetShaderResources,
-                    (volatile void **)&Original_PSSetShaderResources,
-                    &g_psSetSRHookReady);
+  int budgetMB = settings.GetInt("texture_replace_budget_mb", 512);
+  g_replacementBudgetBytes =
+      budgetMB > 0 ? (uint64_t)budgetMB * 1024 * 1024 : 0;
+  g_replacementStats.budgetBytes = g_replacementBudgetBytes;
+  SetRegionCompositeScale((UINT)settings.GetInt("texture_region_scale", 2));
+  g_hasFrameClock = AddPresentCallback(pDevice, OnPresent);
+
+  PSSetShaderResourcesHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                     Hooked_PSSetShaderResources);
+
+  // Dirty tracking. Runs ahead of the upscale handlers, so it sees the
+  // game's own coordinates.
+  MapHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP, Hooked_Map);
+  OMSetRenderTargetsHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                   Hooked_OMSetRenderTargets);
+  CopySubresourceRegionHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                      Hooked_CopySubresourceRegion);
+  CopyResourceHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                             Hooked_CopyResource);
+  UpdateSubresourceHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                  Hooked_UpdateSubresource);
+  OMSetRenderTargetsAndUAVsHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                          Hooked_OMSetRenderTargetsAndUAVs);
+  RSSetViewportsHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                               Hooked_RSSetViewports);
+  CSSetUnorderedAccessViewsHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                          Hooked_CSSetUnorderedAccessViews);
+  ClearRenderTargetViewHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                      Hooked_ClearRenderTargetView);
+  ClearUnorderedAccessViewUintHook::Register(
+      pContext, HOOK_ORDER_TEXTURE_DUMP, Hooked_ClearUnorderedAccessViewUint);
+  ClearUnorderedAccessViewFloatHook::Register(
+      pContext, HOOK_ORDER_TEXTURE_DUMP, Hooked_ClearUnorderedAccessViewFloat);
+  ResolveSubresourceHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+                                   Hooked_ResolveSubresource);
   Sleep(1);
 }
+
+void GetReplacementCacheStats(ReplacementCacheStats *pStats) {
+  if (!pStats)
+    return;
+  InitReplacementCacheCS();
+  EnterCriticalSection(&g_replacementCacheCS);
+  *pStats = g_replacementStats;
+  LeaveCriticalSection(&g_replacementCacheCS);
+
+  InitBandStateCS();
+  EnterCriticalSection(&g_bandStateCS);
+  pStats->bandMirrorBytes = g_bandMirrorBytes;
+  LeaveCriticalSection(&g_bandStateCS);
+}
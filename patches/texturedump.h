@@ -16,6 +16,39 @@ uint64_t HashTexture(const D3D11_TEXTURE2D_DESC *pDesc,
 uint64_t HashTextureData(const D3D11_TEXTURE2D_DESC *pDesc,
                          const void *pData, UINT rowPitch);
 
+// Cheap sampled fingerprint (a few rows/chunks) used to reject replacement
+// candidates before paying for HashTextureData
+uint64_t FingerprintTextureData(const D3D11_TEXTURE2D_DESC *pDesc,
+                                const void *pData, UINT rowPitch);
+
+// Alpha classification of a scanned texture (Unknown for formats without a
+// classifiable alpha channel, e.g. BC or R8)
+enum class TextureAlpha { Unknown, Transparent, Opaque, Mixed };
+
+struct TextureScanResult {
+  uint64_t hash; // Same value as HashTextureData
+  TextureAlpha alpha;
+  bool solidColor; // Every pixel equal (uncompressed formats only)
+};
+
+// Hash + classify in a single pass over the rows
+TextureScanResult ScanTextureData(const D3D11_TEXTURE2D_DESC *pDesc,
+                                  const void *pData, UINT rowPitch);
+
 // Install PSSetShaderResources hook for runtime texture dumping
 void ApplyTextureDumpHooks(ID3D11Device *pDevice,
                            ID3D11DeviceContext *pContext);
+
+// Bind-time replacement cache counters (replacement textures held by the
+// PSSetShaderResources hook), reported by the hook profiler
+struct ReplacementCacheStats {
+  uint64_t residentBytes; // Including retiredBytes
+  uint64_t retiredBytes;  // Released, waiting for in-flight binds to finish
+  uint64_t peakBytes;
+  uint64_t budgetBytes; // 0 = unlimited
+  uint32_t residentCount;
+  uint32_t budgetEvictions;    // Released to stay under budget
+  uint32_t destroyedEvictions; // Released because the original was destroyed
+  uint64_t bandMirrorBytes;    // Staging mirrors of band-hashed textures
+};
+void GetReplacementCacheStats(ReplacementCacheStats *pStats);
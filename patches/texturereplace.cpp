@@ -1,15 +1,29 @@
 #include "texturereplace.h"
+#include "../utils/flat_hash.h"
+#include "../utils/mapped_file.h"
+#include "../utils/png_decoder.h"
+#include "../utils/replacement_index.h"
 #include "../utils/settings.h"
+#include "band_hash.h"
+#include "bc_cache.h"
+#include "bc_encoder.h"
+#include "dds_file.h"
+#include "mip_generator.h"
+#include "room_preload.h"
+#include "texture_filter.h"
+#include "texture_pack.h"
 #include "texturedump.h" // For HashTexture
 #include <Windows.h>
+#include <algorithm>
+#include <cctype>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <map>
-#include <set>
+#include <iterator>
 #include <sstream>
 #include <string>
-#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <wincodec.h>
 #include <wrl/client.h>
@@ -18,20 +32,176 @@
 
 using Microsoft::WRL::ComPtr;
 
-// Files that failed to load this session - skip so we don't retry every texture
-static std::set<std::string> g_failedReplacementFiles;
-
 namespace {
 bool g_textureReplaceEnabled = false;
 bool g_settingsLoaded = false;
 std::string g_modsPath;
 bool g_cacheBuilt = false;
-// Exact lookup: (width, height, hash) -> full path
-std::map<std::tuple<UINT, UINT, uint64_t>, std::string> g_replacementByHash;
-// Fallback for render targets: (width, height) -> list of paths (WxH_*.dds)
-std::map<std::pair<UINT, UINT>, std::vector<std::string>> g_replacementBySize;
-// Quick dimension check: set of (width, height) that have any replacement file
-std::set<std::pair<UINT, UINT>> g_replacementDimensions;
+// Generate mips for HD replacements that don't ship any
+bool g_generateMips = true;
+MipFilter g_mipFilter = MipFilter::Box;
+// Block-compress 32bpp bind-time replacements on load
+BCMode g_compressMode = BCMode::Off;
+
+// Replacement IDs: index into g_replacementFiles, or into the compiled pack's
+// index when PACK_ID_BIT is set.
+constexpr uint32_t PACK_ID_BIT = 0x80000000u;
+
+struct ReplacementFile {
+  UINT width;
+  UINT height;
+  uint64_t hash;
+  std::string path;
+};
+
+ReplacementIndex g_replacementIndex;
+std::vector<ReplacementFile> g_replacementFiles;
+// Quick dimension check: packed (width << 32 | height) with any replacement
+FlatHashSet64 g_replacementDimensions;
+// Load failures this session, per ID - skip so we don't retry every texture.
+// Set (InterlockedExchange) and read (plain load) by the render thread and
+// the room preloader without a lock. Only resized by ResetFailedFlags.
+std::vector<LONG> g_failedFiles;
+// Content digest of each file (0 = not computed yet), per ID
+std::vector<uint64_t> g_fileDigests;
+std::vector<LONG> g_failedPackEntries;
+// Region replacements (mods/textures/regions), matched per atlas tile by
+// region_replace. Always loose files, also when a pack is in use.
+ReplacementIndex g_regionIndex;
+std::vector<ReplacementFile> g_regionFiles;
+std::vector<uint8_t> g_failedRegions;
+// Compiled pack (mods/textures.pack). When open, replaces the loose-file scan.
+TexturePack g_texturePack;
+std::string g_texturePackPath;
+
+// Bind-time replacement views by replacement content digest, target format
+// and original size (GetReplacementDigest), so the same image shipped under
+// several names or aliases is uploaded once. Entries only the table still
+// references are pruned before the next load, unless pinned by a room
+// preload (room_preload.h).
+struct SharedReplacementSRV {
+  ComPtr<ID3D11ShaderResourceView> srv;
+  bool pinned;
+};
+std::unordered_map<uint64_t, SharedReplacementSRV> g_sharedReplacementSRVs;
+// Keys being loaded outside the lock. A thread wanting one of them waits on
+// g_sharedSRVLoaded instead of loading it a second time.
+std::unordered_set<uint64_t> g_loadingSharedKeys;
+CONDITION_VARIABLE g_sharedSRVLoaded = CONDITION_VARIABLE_INIT;
+CRITICAL_SECTION g_sharedSRVCS;
+volatile LONG g_sharedSRVCSInitialized = 0;
+
+void InitSharedSRVCS() {
+  if (InterlockedCompareExchange(&g_sharedSRVCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_sharedSRVCS);
+  }
+}
+
+// Block-compressed replacements encoded on earlier runs
+// (mods/textures.bccache, next to the pack). Loads can come from the
+// CreateTexture2D and bind-time paths at once.
+BCCache g_bcCache;
+std::string g_bcCachePath;
+CRITICAL_SECTION g_bcCacheCS;
+volatile LONG g_bcCacheCSInitialized = 0;
+// Bump when the encoder's output changes so stale entries miss
+constexpr uint64_t BC_ENCODER_VERSION = 1;
+
+void InitBCCacheCS() {
+  if (InterlockedCompareExchange(&g_bcCacheCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_bcCacheCS);
+  }
+}
+
+// Sampled fingerprints of original textures (FingerprintTextureData), learned
+// the first time a replacement matches by full hash and persisted to
+// mods/textures.fingerprints. Once every replacement at a size has one, a
+// texture whose fingerprint matches none of them is rejected without the
+// full hash.
+constexpr uint32_t FINGERPRINT_FILE_MAGIC = 0x50464643; // "CFFP"
+constexpr uint32_t FINGERPRINT_FILE_VERSION = 1;
+
+#pragma pack(push, 1)
+struct FingerprintFileHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct FingerprintRecord {
+  uint64_t hash;
+  uint32_t width;
+  uint32_t height;
+  uint64_t fingerprint;
+};
+#pragma pack(pop)
+
+struct DimensionFingerprints {
+  uint32_t unlearned; // Replacements at this size without a fingerprint yet
+  std::vector<uint64_t> fingerprints;
+};
+std::unordered_map<uint64_t, DimensionFingerprints> g_dimensionFingerprints;
+FlatHashSet64 g_learnedFingerprints; // Keyed by FingerprintKey()
+// What MayHaveReplacement reads, without the lock: the fingerprints of the
+// sizes with none unlearned. Never changed once published; a new one is
+// swapped in when another size completes. Fingerprints are only ever added,
+// so that is at most once per size, and replaced ones are kept in
+// g_retiredFingerprintFilters for readers still holding them.
+struct FingerprintFilter {
+  FlatHashSet64 completeDimensions; // DimensionKey()
+  FlatHashSet64 fingerprints;       // FingerprintKey(width, height, fp)
+};
+FingerprintFilter *volatile g_fingerprintFilter = nullptr;
+std::vector<FingerprintFilter *> g_retiredFingerprintFilters;
+std::string g_fingerprintPath;
+HANDLE g_fingerprintFile = INVALID_HANDLE_VALUE;
+// Learning happens on both the CreateTexture2D and bind-time paths
+CRITICAL_SECTION g_fingerprintCS;
+volatile LONG g_fingerprintCSInitialized = 0;
+
+void InitFingerprintCS() {
+  if (InterlockedCompareExchange(&g_fingerprintCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_fingerprintCS);
+  }
+}
+
+inline uint64_t DimensionKey(UINT width, UINT height) {
+  return ((uint64_t)width << 32) | height;
+}
+
+inline uint64_t FingerprintKey(UINT width, UINT height, uint64_t hash) {
+  return hash ^ FlatHashMix(DimensionKey(width, height));
+}
+
+inline volatile LONG *FailedFlag(uint32_t id) {
+  return (id & PACK_ID_BIT) ? &g_failedPackEntries[id & ~PACK_ID_BIT]
+                            : &g_failedFiles[id];
+}
+
+bool IsReplacementFailed(uint32_t id) { return *FailedFlag(id) != 0; }
+
+void MarkReplacementFailed(uint32_t id) {
+  InterlockedExchange(FailedFlag(id), 1);
+}
+
+// One cleared flag per replacement file or pack entry. Called while the
+// cache is built, before the new index is looked up; the lock only keeps
+// the resize apart from a room preload left over from a previous build.
+void ResetFailedFlags() {
+  InitSharedSRVCS();
+  EnterCriticalSection(&g_sharedSRVCS);
+  g_failedFiles.assign(g_replacementFiles.size(), 0);
+  g_failedPackEntries.assign(
+      g_texturePack.IsOpen() ? g_texturePack.GetEntryCount() : 0, 0);
+  LeaveCriticalSection(&g_sharedSRVCS);
+}
+
+// Returns INVALID_REPLACEMENT_ID if there is no (usable) replacement
+uint32_t FindReplacementId(UINT width, UINT height, uint64_t hash) {
+  uint32_t id = g_replacementIndex.Find(width, height, hash);
+  if (id == INVALID_REPLACEMENT_ID || IsReplacementFailed(id))
+    return INVALID_REPLACEMENT_ID;
+  return id;
+}
 
 // Initialize mods path
 void InitializeModsPath() {
@@ -55,44 +225,10 @@ void InitializeModsPath() {
   CreateDirectoryA(
       (g_modsPath.substr(0, g_modsPath.find_last_of("\\"))).c_str(), NULL);
   CreateDirectoryA(g_modsPath.c_str(), NULL);
-}
 
-// Parse "WxH_<16hex>.dds" or "WxH_<16hex>.png" filename.
-bool ParseReplacementFilename(const std::string &filename, UINT *outW,
-                              UINT *outH, uint64_t *outHash) {
-  unsigned int w = 0, h = 0;
-  if (sscanf_s(filename.c_str(), "%ux%u_", &w, &h) != 2)
-    return false;
-  if (w == 0 || h == 0)
-    return false;
-  size_t pos = filename.find('_');
-  if (pos == std::string::npos || filename.size() < pos + 17)
-    return false;
-  // Accept .dds or .png extension
-  bool isDds = filename.size() >= 4 &&
-               filename.compare(filename.size() - 4, 4, ".dds") == 0;
-  bool isPng = filename.size() >= 4 &&
-               filename.compare(filename.size() - 4, 4, ".png") == 0;
-  if (!isDds && !isPng)
-    return false;
-  const char *hex = filename.c_str() + pos + 1;
-  uint64_t hash = 0;
-  for (int i = 0; i < 16 && hex[i]; i++) {
-    int nibble = 0;
-    if (hex[i] >= '0' && hex[i] <= '9')
-      nibble = hex[i] - '0';
-    else if (hex[i] >= 'a' && hex[i] <= 'f')
-      nibble = hex[i] - 'a' + 10;
-    else if (hex[i] >= 'A' && hex[i] <= 'F')
-      nibble = hex[i] - 'A' + 10;
-    else
-      return false;
-    hash = (hash << 4) | nibble;
-  }
-  *outW = w;
-  *outH = h;
-  *outHash = hash;
-  return true;
+  g_texturePackPath = g_modsPath + ".pack"; // mods\textures.pack
+  g_fingerprintPath = g_modsPath + ".fingerprints";
+  g_bcCachePath = g_modsPath + ".bccache";
 }
 
 void ScanReplacementFiles(const std::string &pattern) {
@@ -106,188 +242,379 @@ void ScanReplacementFiles(const std::string &pattern) {
     UINT w, h;
     uint64_t hash;
     if (ParseReplacementFilename(fd.cFileName, &w, &h, &hash)) {
-      std::string fullPath = g_modsPath + "\\" + fd.cFileName;
-      g_replacementByHash[{w, h, hash}] = fullPath;
-      g_replacementDimensions.insert({w, h});
+      // Later scans overwrite earlier ones (.png wins over .dds)
+      uint32_t id = (uint32_t)g_replacementFiles.size();
+      g_replacementFiles.push_back(
+          {w, h, hash, g_modsPath + "\\" + fd.cFileName});
+      g_fileDigests.push_back(0);
+      g_replacementIndex.Insert(w, h, hash, id);
+      g_replacementDimensions.Insert(DimensionKey(w, h));
     }
   } while (FindNextFileA(hFind, &fd));
   FindClose(hFind);
 }
 
-void BuildReplacementCache() {
-  if (g_cacheBuilt || g_modsPath.empty())
-    return;
-  g_cacheBuilt = true;
-  ScanReplacementFiles(g_modsPath + "\\*.dds");
-  ScanReplacementFiles(g_modsPath + "\\*.png");
-  std::cout << "[Mod] Texture replacer enabled, with cache: "
-            << g_replacementByHash.size() << " file(s) in mods/textures"
-            << std::endl;
+std::string TrimAliasField(const std::string &s) {
+  size_t first = s.find_first_not_of(" \t\r");
+  if (first == std::string::npos)
+    return "";
+  size_t last = s.find_last_not_of(" \t\r");
+  return s.substr(first, last - first + 1);
 }
 
-// Simple DDS header structure (minimal for reading)
-#pragma pack(push, 1)
-struct DDSHeader {
-  DWORD dwMagic; // "DDS "
-  DWORD dwSize;  // 124
-  DWORD dwFlags;
-  DWORD dwHeight;
-  DWORD dwWidth;
-  DWORD dwPitchOrLinearSize;
-  DWORD dwDepth;
-  DWORD dwMipMapCount;
-  DWORD dwReserved1[11];
-  struct {
-    DWORD dwSize; // 32
-    DWORD dwFlags;
-    DWORD dwFourCC;
-    DWORD dwRGBBitCount;
-    DWORD dwRBitMask;
-    DWORD dwGBitMask;
-    DWORD dwBBitMask;
-    DWORD dwABitMask;
-  } ddspf;
-  DWORD dwCaps;
-  DWORD dwCaps2;
-  DWORD dwCaps3;
-  DWORD dwCaps4;
-  DWORD dwReserved2;
-};
-#pragma pack(pop)
+// ASCII lowercase; bytes of UTF-8 names pass through unchanged
+void LowerAliasName(std::string *s) {
+  std::transform(s->begin(), s->end(), s->begin(), [](unsigned char c) {
+    return (char)std::tolower(c);
+  });
+}
 
-// Load DDS file and create texture
-bool LoadDDSTexture(ID3D11Device *pDevice, const std::string &filepath,
-                    const D3D11_TEXTURE2D_DESC *pOriginalDesc,
-                    ID3D11Texture2D **ppTexture2D) {
-  std::ifstream file(filepath, std::ios::binary);
-  if (!file.is_open())
-    return false;
+// mods/textures/aliases.txt: "<dump filename> = <replacement filename>" per
+// line ('#' starts a comment). The dumped texture is replaced by an existing
+// file, so a pack reusing one image for several textures ships it once.
+// Real files win over aliases with the same key.
+void LoadReplacementAliases() {
+  std::ifstream file(g_modsPath + "\\aliases.txt");
+  if (!file)
+    return;
 
-  DDSHeader header;
-  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  std::unordered_map<std::string, uint32_t> idsByName;
+  for (size_t i = 0; i < g_replacementFiles.size(); ++i) {
+    const std::string &path = g_replacementFiles[i].path;
+    std::string name = path.substr(path.find_last_of("\\/") + 1);
+    LowerAliasName(&name);
+    idsByName[name] = (uint32_t)i;
+  }
 
-  if (header.dwMagic != 0x20534444) { // "DDS "
-    file.close();
-    return false;
+  size_t added = 0, unresolved = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.resize(comment);
+    size_t eq = line.find('=');
+    if (eq == std::string::npos)
+      continue;
+    std::string alias = TrimAliasField(line.substr(0, eq));
+    std::string target = TrimAliasField(line.substr(eq + 1));
+    LowerAliasName(&target);
+
+    UINT w, h;
+    uint64_t hash;
+    auto it = idsByName.find(target);
+    if (!ParseReplacementFilename(alias, &w, &h, &hash) ||
+        it == idsByName.end()) {
+      unresolved++;
+      continue;
+    }
+    if (g_replacementIndex.Find(w, h, hash) != INVALID_REPLACEMENT_ID)
+      continue;
+    uint32_t id = (uint32_t)g_replacementFiles.size();
+    g_replacementFiles.push_back({w, h, hash,
+                                  g_replacementFiles[it->second].path});
+    g_fileDigests.push_back(0);
+    g_replacementIndex.Insert(w, h, hash, id);
+    g_replacementDimensions.Insert(DimensionKey(w, h));
+    added++;
   }
 
-  // Determine format and bytes per pixel
-  DXGI_FORMAT format = pOriginalDesc->Format;
-  UINT bytesPerPixel = 0;
-  bool isBlockCompressed = false;
-  UINT bytesPerBlock = 0;
+  std::cout << "[Mod] Texture aliases: " << added << " from aliases.txt";
+  if (unresolved)
+    std::cout << ", " << unresolved << " unresolved";
+  std::cout << std::endl;
+}
+
+void ScanRegionFiles(const std::string &pattern) {
+  std::string folder = g_modsPath + "\\regions\\";
+  WIN32_FIND_DATAA fd;
+  HANDLE hFind = FindFirstFileA((folder + pattern).c_str(), &fd);
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
+  do {
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+    UINT w, h;
+    uint64_t hash;
+    if (ParseReplacementFilename(fd.cFileName, &w, &h, &hash)) {
+      uint32_t id = (uint32_t)g_regionFiles.size();
+      g_regionFiles.push_back({w, h, hash, folder + fd.cFileName});
+      g_failedRegions.push_back(0);
+      g_regionIndex.Insert(w, h, hash, id);
+    }
+  } while (FindNextFileA(hFind, &fd));
+  FindClose(hFind);
+}
+
+// Resolve the format a replacement stored as `stored` is created in for a
+// target of `target`. UNKNOWN (untagged DDS, e.g. older BC7 dumps) means the
+// data is already in the target's layout; the target's sRGB-ness is kept
+// when the layouts match. Any other format is only accepted with
+// allowFormatChange, i.e. for bind-time replacements whose view takes the
+// replacement's own format. *outSwizzle reports an RGBA8 <-> BGRA8 mismatch,
+// which is fixed up on load instead.
+bool ResolveReplacementFormat(DXGI_FORMAT stored, DXGI_FORMAT target,
+                              bool allowFormatChange, DXGI_FORMAT *outFormat,
+                              bool *outSwizzle) {
+  *outSwizzle = false;
+  DXGI_FORMAT storedLinear = GetLinearFormat(stored);
+  DXGI_FORMAT targetLinear = GetLinearFormat(target);
+  if (stored == DXGI_FORMAT_UNKNOWN || storedLinear == targetLinear) {
+    *outFormat = target;
+    return true;
+  }
+  if ((storedLinear == DXGI_FORMAT_R8G8B8A8_UNORM &&
+       targetLinear == DXGI_FORMAT_B8G8R8A8_UNORM) ||
+      (storedLinear == DXGI_FORMAT_B8G8R8A8_UNORM &&
+       targetLinear == DXGI_FORMAT_R8G8B8A8_UNORM)) {
+    *outFormat = target;
+    *outSwizzle = true;
+    return true;
+  }
+  UINT unusedPitch, unusedRows;
+  if (!allowFormatChange ||
+      !GetRowLayout(stored, 1, 1, &unusedPitch, &unusedRows))
+    return false;
+  *outFormat = stored;
+  return true;
+}
 
+DXGI_FORMAT GetSRGBFormat(DXGI_FORMAT format) {
   switch (format) {
-  case DXGI_FORMAT_R8G8B8A8_UNORM:
-  case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-  case DXGI_FORMAT_B8G8R8A8_UNORM:
-  case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-    bytesPerPixel = 4;
-    break;
-  case DXGI_FORMAT_B4G4R4A4_UNORM:
-    bytesPerPixel = 2;
-    break;
-  case DXGI_FORMAT_R8_UNORM:
-    bytesPerPixel = 1;
-    break;
-  case DXGI_FORMAT_R8G8_UNORM:
-    bytesPerPixel = 2;
-    break;
   case DXGI_FORMAT_BC1_UNORM:
-  case DXGI_FORMAT_BC1_UNORM_SRGB:
-    isBlockCompressed = true;
-    bytesPerBlock = 8;
-    break;
-  case DXGI_FORMAT_BC2_UNORM:
-  case DXGI_FORMAT_BC2_UNORM_SRGB:
+    return DXGI_FORMAT_BC1_UNORM_SRGB;
   case DXGI_FORMAT_BC3_UNORM:
-  case DXGI_FORMAT_BC3_UNORM_SRGB:
+    return DXGI_FORMAT_BC3_UNORM_SRGB;
   case DXGI_FORMAT_BC7_UNORM:
-  case DXGI_FORMAT_BC7_UNORM_SRGB:
-    isBlockCompressed = true;
-    bytesPerBlock = 16;
-    break;
+    return DXGI_FORMAT_BC7_UNORM_SRGB;
   default:
-    std::cout << "Replacement skipped - unsupported texture format: "
-              << static_cast<unsigned>(format) << " (" << pOriginalDesc->Width
-              << "x" << pOriginalDesc->Height << ")" << std::endl;
-    file.close();
-    return false;
+    return format;
   }
+}
 
-  // Calculate data size (first mip only - we create texture with one level)
-  size_t dataSize;
-  UINT rowPitch;
+// Cache key for a 32bpp top mip plus everything else that shapes its
+// encoded chain. 0 if the data couldn't be hashed.
+uint64_t GetBCCacheKey(const uint8_t *top, UINT width, UINT height,
+                       UINT levelCount, bool generateMips, bool bgra) {
+  uint64_t settings = ((uint64_t)levelCount << 32) |
+                      ((uint64_t)g_compressMode << 8) |
+                      (generateMips ? ((uint64_t)g_mipFilter << 16) | 2 : 0) |
+                      (bgra ? 1 : 0);
+  uint64_t seed = FlatHashMix(DimensionKey(width, height)) ^
+                  FlatHashMix(settings ^ (BC_ENCODER_VERSION << 48));
+  uint64_t hash = 0;
+  if (!HashBandsCombined(top, width * 4, width * 4, height, seed, &hash))
+    return 0;
+  return hash;
+}
 
-  if (isBlockCompressed) {
-    UINT blocksWide = (header.dwWidth + 3) / 4;
-    UINT blocksHigh = (header.dwHeight + 3) / 4;
-    rowPitch = blocksWide * bytesPerBlock;
-    dataSize = rowPitch * blocksHigh;
-  } else {
-    rowPitch = header.dwWidth * bytesPerPixel;
-    dataSize = rowPitch * header.dwHeight;
+// Encode every level of a tightly packed 32bpp chain into one tightly packed
+// bcFormat chain
+bool EncodeReplacementLevels(const D3D11_SUBRESOURCE_DATA *levels,
+                             UINT levelCount, UINT width, UINT height,
+                             bool bgra, DXGI_FORMAT bcFormat,
+                             std::vector<uint8_t> *outBlocks) {
+  size_t total = 0;
+  for (UINT i = 0; i < levelCount; ++i) {
+    UINT pitch, rows;
+    if (!GetRowLayout(bcFormat, std::max(width >> i, 1u),
+                      std::max(height >> i, 1u), &pitch, &rows))
+      return false;
+    total += (size_t)pitch * rows;
+  }
+  try {
+    outBlocks->resize(total);
+  } catch (const std::bad_alloc &) {
+    return false;
   }
 
-  // Check file has enough bytes (avoids "Failed to read complete" when file is
-  // different format, has only mips, or is truncated)
-  const size_t headerSize = sizeof(header);
-  file.seekg(0, std::ios::end);
-  const size_t totalSize = static_cast<size_t>(file.tellg());
-  file.seekg(static_cast<std::streamoff>(headerSize), std::ios::beg);
-  if (totalSize <= headerSize || (totalSize - headerSize) < dataSize) {
-    file.close();
-    return false; // File too small for this format (e.g. different DDS format)
+  size_t offset = 0;
+  for (UINT i = 0; i < levelCount; ++i) {
+    UINT w = std::max(width >> i, 1u), h = std::max(height >> i, 1u);
+    UINT pitch, rows;
+    GetRowLayout(bcFormat, w, h, &pitch, &rows);
+    if (!EncodeBCLevel(static_cast<const uint8_t *>(levels[i].pSysMem), w, h,
+                       bgra, bcFormat, outBlocks->data() + offset))
+      return false;
+    offset += (size_t)pitch * rows;
   }
+  return true;
+}
 
-  // Read pixel data
-  std::vector<uint8_t> pixelData(dataSize);
-  file.read(reinterpret_cast<char *>(pixelData.data()), dataSize);
-  file.close();
+// Create a replacement texture from a tightly packed mip chain (a mapped DDS
+// payload or pack entry), uploading straight from `data`. Loads as many of
+// the mipLevels levels as are present.
+bool CreateReplacementTexture(ID3D11Device *pDevice,
+                              const D3D11_TEXTURE2D_DESC *pOriginalDesc,
+                              DXGI_FORMAT stored, UINT width, UINT height,
+                              UINT mipLevels, const uint8_t *data,
+                              size_t dataSize, bool allowFormatChange,
+                              ID3D11Texture2D **ppTexture2D) {
+  DXGI_FORMAT format;
+  bool swizzle;
+  if (!ResolveReplacementFormat(stored, pOriginalDesc->Format,
+                                allowFormatChange, &format, &swizzle))
+    return false;
 
-  if (file.gcount() != static_cast<std::streamsize>(dataSize)) {
-    return false; // Truncated read - skip (caller may blacklist)
+  // Bind-time replacements are created as immutable shader resources, so
+  // they can always have mips. A texture created in place of the game's
+  // keeps the game's desc, and dynamic, staging, CPU-accessible or
+  // misc-flagged (shared, cube, GenerateMips) textures can't take a chain
+  // the game didn't ask for: only the top level of the data is uploaded.
+  bool canTakeMips =
+      allowFormatChange ||
+      ((pOriginalDesc->Usage == D3D11_USAGE_DEFAULT ||
+        pOriginalDesc->Usage == D3D11_USAGE_IMMUTABLE) &&
+       pOriginalDesc->CPUAccessFlags == 0 && pOriginalDesc->MiscFlags == 0);
+  if (!canTakeMips)
+    mipLevels = 1;
+
+  D3D11_SUBRESOURCE_DATA levels[D3D11_REQ_MIP_LEVELS];
+  UINT levelCount = GetMipChainLayout(data, dataSize, format, width, height,
+                                      mipLevels, levels);
+  if (levelCount == 0)
+    return false;
+
+  std::vector<uint8_t> swizzled;
+  if (swizzle) {
+    const uint8_t *last =
+        static_cast<const uint8_t *>(levels[levelCount - 1].pSysMem);
+    swizzled.assign(data, last + levels[levelCount - 1].SysMemSlicePitch);
+    for (size_t i = 0; i + 3 < swizzled.size(); i += 4)
+      std::swap(swizzled[i], swizzled[i + 2]);
+    for (UINT i = 0; i < levelCount; ++i)
+      levels[i].pSysMem =
+          swizzled.data() + (static_cast<const uint8_t *>(levels[i].pSysMem) -
+                             data);
   }
 
-  // Create texture at the file's own dimensions (supports HD replacements)
-  D3D11_TEXTURE2D_DESC createDesc = *pOriginalDesc;
-  createDesc.Width = header.dwWidth;
-  createDesc.Height = header.dwHeight;
-  createDesc.MipLevels = 1;
+  DXGI_FORMAT linear = GetLinearFormat(format);
+  bool is32bpp = linear == DXGI_FORMAT_R8G8B8A8_UNORM ||
+                 linear == DXGI_FORMAT_B8G8R8A8_UNORM;
+  bool bgra = linear == DXGI_FORMAT_B8G8R8A8_UNORM;
+  const uint8_t *top = static_cast<const uint8_t *>(levels[0].pSysMem);
+
+  // An HD replacement without mips aliases when drawn at native size
+  bool generateMips =
+      g_generateMips && canTakeMips && is32bpp && levelCount == 1 &&
+      mipLevels <= 1 &&
+      (pOriginalDesc->BindFlags & D3D11_BIND_SHADER_RESOURCE) &&
+      (width > pOriginalDesc->Width || height > pOriginalDesc->Height);
+
+  // Bind-time replacements are sampled through their own view, so they can
+  // be block-compressed. The cache is keyed on the source pixels; a hit
+  // skips both mip generation and encoding.
+  bool compress = allowFormatChange && g_compressMode != BCMode::Off &&
+                  is32bpp && width % 4 == 0 && height % 4 == 0;
+  uint64_t cacheKey = 0;
+  BCCacheRecord encoded = {};
+  std::vector<uint8_t> blocks;
+  bool compressed = false;
+  if (compress) {
+    cacheKey = GetBCCacheKey(top, width, height, levelCount, generateMips,
+                             bgra);
+    if (cacheKey) {
+      InitBCCacheCS();
+      EnterCriticalSection(&g_bcCacheCS);
+      compressed = g_bcCache.Read(cacheKey, &encoded, &blocks) &&
+                   encoded.width == width && encoded.height == height;
+      LeaveCriticalSection(&g_bcCacheCS);
+    }
+  }
 
-  D3D11_SUBRESOURCE_DATA initData;
-  initData.pSysMem = pixelData.data();
-  initData.SysMemPitch = rowPitch;
-  initData.SysMemSlicePitch = 0;
+  std::vector<uint8_t> generated;
+  if (generateMips && !compressed) {
+    UINT extra = GenerateMipChain(top, width, height, D3D11_REQ_MIP_LEVELS,
+                                  g_mipFilter, &generated);
+    if (extra)
+      levelCount += GetMipChainLayout(
+          generated.data(), generated.size(), format, width > 1 ? width / 2 : 1,
+          height > 1 ? height / 2 : 1, extra, levels + 1);
+  }
 
-  HRESULT hr = pDevice->CreateTexture2D(&createDesc, &initData, ppTexture2D);
-  if (FAILED(hr)) {
-    std::cout << "Failed to create replacement texture from " << filepath
-              << std::endl;
-    return false;
+  if (compress && !compressed) {
+    DXGI_FORMAT bcFormat = g_compressMode == BCMode::BC7
+                               ? DXGI_FORMAT_BC7_UNORM
+                           : IsOpaqueLevel(top, width, height)
+                               ? DXGI_FORMAT_BC1_UNORM
+                               : DXGI_FORMAT_BC3_UNORM;
+    compressed = EncodeReplacementLevels(levels, levelCount, width, height,
+                                         bgra, bcFormat, &blocks);
+    if (compressed) {
+      encoded = {cacheKey, (uint32_t)bcFormat, width, height, levelCount,
+                 (uint64_t)blocks.size()};
+      if (cacheKey) {
+        EnterCriticalSection(&g_bcCacheCS);
+        g_bcCache.Append(encoded, blocks.data());
+        LeaveCriticalSection(&g_bcCacheCS);
+      }
+    }
   }
 
-  return true;
+  if (compressed) {
+    DXGI_FORMAT bcFormat = static_cast<DXGI_FORMAT>(encoded.format);
+    levelCount = GetMipChainLayout(blocks.data(), blocks.size(), bcFormat,
+                                   width, height, encoded.mipLevels, levels);
+    if (levelCount == 0)
+      return false;
+    format = linear != format ? GetSRGBFormat(bcFormat) : bcFormat;
+  }
+
+  // Create at the data's own dimensions (supports HD replacements)
+  D3D11_TEXTURE2D_DESC createDesc = *pOriginalDesc;
+  createDesc.Width = width;
+  createDesc.Height = height;
+  createDesc.MipLevels = levelCount;
+  if (allowFormatChange) {
+    // Only ever sampled through its own view; block-compressed formats
+    // can't be render targets
+    createDesc.Format = format;
+    createDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    createDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    createDesc.CPUAccessFlags = 0;
+    createDesc.MiscFlags = 0;
+  }
+
+  HRESULT hr = pDevice->CreateTexture2D(&createDesc, levels, ppTexture2D);
+  return SUCCEEDED(hr);
 }
 
-// Load PNG via Windows Imaging Component (WIC)
-// Supports BGRA8 and RGBA8 original formats
-bool LoadPNGTexture(ID3D11Device *pDevice, const std::string &filepath,
+// Load a DDS file (legacy or DX10 header, full mip chain) and create the
+// texture straight from the mapped file
+bool LoadDDSTexture(ID3D11Device *pDevice, const std::string &filepath,
                     const D3D11_TEXTURE2D_DESC *pOriginalDesc,
-                    ID3D11Texture2D **ppTexture2D) {
+                    bool allowFormatChange, ID3D11Texture2D **ppTexture2D) {
   DXGI_FORMAT format = pOriginalDesc->Format;
-  bool isBGRA = (format == DXGI_FORMAT_B8G8R8A8_UNORM ||
-                 format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
-  bool isRGBA = (format == DXGI_FORMAT_R8G8B8A8_UNORM ||
-                 format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+  UINT unusedPitch, unusedRows;
+  if (!GetRowLayout(format, 1, 1, &unusedPitch, &unusedRows)) {
+    std::cout << "Replacement skipped - unsupported texture format: "
+              << static_cast<unsigned>(format) << " (" << pOriginalDesc->Width
+              << "x" << pOriginalDesc->Height << ")" << std::endl;
+    return false;
+  }
 
-  if (!isBGRA && !isRGBA) {
-    std::cout << "PNG replacement skipped - unsupported format "
-              << static_cast<unsigned>(format) << " for " << filepath
+  MappedFile file;
+  DDSImage image;
+  if (!file.Open(filepath) ||
+      !ParseDDS(file.GetData(), file.GetSize(), &image))
+    return false;
+
+  if (!CreateReplacementTexture(pDevice, pOriginalDesc, image.format,
+                                image.width, image.height, image.mipLevels,
+                                image.data, image.dataSize, allowFormatChange,
+                                ppTexture2D)) {
+    std::cout << "Failed to create replacement texture from " << filepath
               << std::endl;
     return false;
   }
 
+  return true;
+}
+
+// Decode PNG via Windows Imaging Component (WIC) into 32bpp BGRA or RGBA.
+// Only used for files the in-tree decoder declines (e.g. interlaced).
+bool DecodePNGPixelsWIC(const std::string &filepath, bool isBGRA,
+                        UINT *outWidth, UINT *outHeight,
+                        std::vector<uint8_t> *outPixels) {
   // Convert path to wide string for WIC
   int wlen = MultiByteToWideChar(CP_ACP, 0, filepath.c_str(), -1, nullptr, 0);
   if (wlen <= 0)
@@ -350,9 +677,9 @@ bool LoadPNGTexture(ID3D11Device *pDevice, const std::string &filepath,
 
   UINT rowPitch = width * 4;
   UINT imageSize = rowPitch * height;
-  std::vector<uint8_t> pixels(imageSize);
+  outPixels->resize(imageSize);
 
-  hr = pConverter->CopyPixels(nullptr, rowPitch, imageSize, pixels.data());
+  hr = pConverter->CopyPixels(nullptr, rowPitch, imageSize, outPixels->data());
   if (FAILED(hr)) {
     if (SUCCEEDED(hrCo) || hrCo == S_FALSE)
       CoUninitialize();
@@ -362,18 +689,58 @@ bool LoadPNGTexture(ID3D11Device *pDevice, const std::string &filepath,
   if (SUCCEEDED(hrCo) || hrCo == S_FALSE)
     CoUninitialize();
 
-  // Create texture at the PNG's own dimensions (supports HD replacements)
-  D3D11_TEXTURE2D_DESC createDesc = *pOriginalDesc;
-  createDesc.Width = width;
-  createDesc.Height = height;
-  createDesc.MipLevels = 1;
+  *outWidth = width;
+  *outHeight = height;
+  return true;
+}
 
-  D3D11_SUBRESOURCE_DATA initData = {};
-  initData.pSysMem = pixels.data();
-  initData.SysMemPitch = rowPitch;
+// Decode PNG into 32bpp BGRA or RGBA rows
+bool DecodePNGPixels(const std::string &filepath, bool isBGRA, UINT *outWidth,
+                     UINT *outHeight, std::vector<uint8_t> *outPixels) {
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file.is_open())
+    return false;
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+  file.close();
 
-  hr = pDevice->CreateTexture2D(&createDesc, &initData, ppTexture2D);
-  if (FAILED(hr)) {
+  uint32_t width, height;
+  if (DecodePng(data.data(), data.size(), isBGRA, &width, &height,
+                outPixels)) {
+    *outWidth = width;
+    *outHeight = height;
+    return true;
+  }
+  return DecodePNGPixelsWIC(filepath, isBGRA, outWidth, outHeight, outPixels);
+}
+
+// Load PNG replacement
+// Supports BGRA8 and RGBA8 original formats
+bool LoadPNGTexture(ID3D11Device *pDevice, const std::string &filepath,
+                    const D3D11_TEXTURE2D_DESC *pOriginalDesc,
+                    bool allowFormatChange, ID3D11Texture2D **ppTexture2D) {
+  DXGI_FORMAT format = pOriginalDesc->Format;
+  bool isBGRA = (format == DXGI_FORMAT_B8G8R8A8_UNORM ||
+                 format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+  bool isRGBA = (format == DXGI_FORMAT_R8G8B8A8_UNORM ||
+                 format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+  if (!isBGRA && !isRGBA) {
+    std::cout << "PNG replacement skipped - unsupported format "
+              << static_cast<unsigned>(format) << " for " << filepath
+              << std::endl;
+    return false;
+  }
+
+  UINT width, height;
+  std::vector<uint8_t> pixels;
+  if (!DecodePNGPixels(filepath, isBGRA, &width, &height, &pixels))
+    return false;
+
+  // Decoded in the target's channel order, at the PNG's own dimensions
+  if (!CreateReplacementTexture(pDevice, pOriginalDesc, format, width, height,
+                                1, pixels.data(), pixels.size(),
+                                allowFormatChange, ppTexture2D)) {
     std::cout << "Failed to create PNG replacement texture from " << filepath
               << std::endl;
     return false;
@@ -382,6 +749,390 @@ bool LoadPNGTexture(ID3D11Device *pDevice, const std::string &filepath,
   return true;
 }
 
+// Create a replacement texture straight from a pack entry's mapped payload.
+// The payload is already in the entry's format (a mip chain for DDS-sourced
+// entries); the only conversion ever done here is an RGBA8 <-> BGRA8 swizzle
+// when a PNG-sourced entry is bound to a texture of the other channel order.
+bool LoadPackTexture(ID3D11Device *pDevice, const PackEntry &entry,
+                     const D3D11_TEXTURE2D_DESC *pOriginalDesc,
+                     bool allowFormatChange, ID3D11Texture2D **ppTexture2D) {
+  void *view = nullptr;
+  const uint8_t *payload = g_texturePack.MapPayload(entry, &view);
+  if (!payload)
+    return false;
+
+  bool created = CreateReplacementTexture(
+      pDevice, pOriginalDesc, static_cast<DXGI_FORMAT>(entry.format),
+      entry.dataWidth, entry.dataHeight,
+      entry.mipLevels ? entry.mipLevels : 1, payload,
+      static_cast<size_t>(entry.dataSize), allowFormatChange, ppTexture2D);
+  TexturePack::UnmapPayload(view);
+  return created;
+}
+
+// What a pack compiled from mods/textures now would record: the
+// replacement files and aliases.txt, and the settings baked into entries
+PackSource ScanPackSource() {
+  PackSource source = {};
+  if (g_generateMips) {
+    source.flags = PACK_SOURCE_MIPS;
+    if (g_mipFilter == MipFilter::Kaiser)
+      source.flags |= PACK_SOURCE_KAISER;
+  }
+  WIN32_FIND_DATAA fd;
+  HANDLE hFind = FindFirstFileA((g_modsPath + "\\*").c_str(), &fd);
+  if (hFind == INVALID_HANDLE_VALUE)
+    return source;
+  do {
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+    UINT w, h;
+    uint64_t hash;
+    if (!ParseReplacementFilename(fd.cFileName, &w, &h, &hash) &&
+        _stricmp(fd.cFileName, "aliases.txt") != 0)
+      continue;
+    uint64_t written =
+        ((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32) |
+        fd.ftLastWriteTime.dwLowDateTime;
+    uint64_t nameHash = 0;
+    HashBuffer((const uint8_t *)fd.cFileName, strlen(fd.cFileName), 0,
+               &nameHash);
+    source.fileCount++;
+    source.newestWrite = (std::max)(source.newestWrite, written);
+    source.nameDigest += nameHash;
+  } while (FindNextFileA(hFind, &fd));
+  FindClose(hFind);
+  return source;
+}
+
+// Compile every loose replacement file into mods/textures.pack. PNGs are
+// decoded once here (stored as RGBA8); DDS mip chains are copied as-is with
+// their header format, or untagged when the header doesn't identify one.
+void CompileTexturePack() {
+  TexturePackWriter writer;
+  if (!writer.Begin(g_texturePackPath, ScanPackSource())) {
+    std::cout << "[Mod] Failed to create " << g_texturePackPath << std::endl;
+    return;
+  }
+
+  size_t skipped = 0;
+  for (size_t i = 0; i < g_replacementFiles.size(); ++i) {
+    const ReplacementFile &rf = g_replacementFiles[i];
+    // Skip files shadowed by a later one with the same key
+    if (g_replacementIndex.Find(rf.width, rf.height, rf.hash) != i)
+      continue;
+    const std::string &filepath = rf.path;
+    PackEntry entry = {};
+    entry.width = rf.width;
+    entry.height = rf.height;
+    entry.hash = rf.hash;
+    entry.mipLevels = 1;
+
+    std::vector<uint8_t> pixels;
+    MappedFile file;
+    const uint8_t *payload = nullptr;
+    size_t payloadSize = 0;
+    if (filepath.size() >= 4 &&
+        filepath.compare(filepath.size() - 4, 4, ".png") == 0) {
+      // Left at 0 when decoding fails; the entry is then skipped
+      UINT w = 0, h = 0;
+      if (DecodePNGPixels(filepath, false, &w, &h, &pixels)) {
+        // Bake mips into the pack so loading it costs nothing extra. A
+        // texture that can't take them gets only the top level at load.
+        if (g_generateMips && (w > rf.width || h > rf.height)) {
+          std::vector<uint8_t> mips;
+          entry.mipLevels +=
+              GenerateMipChain(pixels.data(), w, h, D3D11_REQ_MIP_LEVELS,
+                               g_mipFilter, &mips);
+          pixels.insert(pixels.end(), mips.begin(), mips.end());
+        }
+        payload = pixels.data();
+        payloadSize = pixels.size();
+      }
+      entry.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+      entry.dataWidth = w;
+      entry.dataHeight = h;
+      entry.rowPitch = w * 4;
+    } else {
+      DDSImage image;
+      if (file.Open(filepath) &&
+          ParseDDS(file.GetData(), file.GetSize(), &image)) {
+        D3D11_SUBRESOURCE_DATA levels[D3D11_REQ_MIP_LEVELS];
+        UINT levelCount =
+            image.format == DXGI_FORMAT_UNKNOWN
+                ? 0
+                : GetMipChainLayout(image.data, image.dataSize, image.format,
+                                    image.width, image.height,
+                                    image.mipLevels, levels);
+        entry.format = levelCount ? image.format : DXGI_FORMAT_UNKNOWN;
+        entry.dataWidth = image.width;
+        entry.dataHeight = image.height;
+        entry.mipLevels = image.mipLevels;
+        // Untagged: keep everything after the header, sized at load time
+        payload = image.data;
+        payloadSize = image.dataSize;
+        if (levelCount) {
+          // Keep the levels that are present, nothing after them
+          entry.rowPitch = levels[0].SysMemPitch;
+          entry.mipLevels = levelCount;
+          payloadSize = static_cast<const uint8_t *>(
+                            levels[levelCount - 1].pSysMem) +
+                        levels[levelCount - 1].SysMemSlicePitch - image.data;
+        }
+      }
+    }
+
+    // DDS payloads are written straight from the mapped file
+    if (!payload || payloadSize == 0 ||
+        !writer.Add(entry, payload, payloadSize))
+      skipped++;
+  }
+
+  if (writer.Finish()) {
+    std::cout << "[Mod] Compiled texture pack: " << writer.GetEntryCount()
+              << " texture(s)";
+    if (writer.GetSharedPayloadCount())
+      std::cout << ", " << writer.GetSharedPayloadCount()
+                << " sharing another's data";
+    if (skipped)
+      std::cout << ", " << skipped << " skipped";
+    std::cout << std::endl;
+  } else {
+    std::cout << "[Mod] Failed to compile texture pack" << std::endl;
+  }
+}
+
+// Point the index at the pack's entries, dropping any loose-file entries
+void IndexTexturePack() {
+  uint32_t count = g_texturePack.GetEntryCount();
+  g_replacementIndex = ReplacementIndex();
+  g_replacementDimensions.Clear();
+  g_replacementFiles.clear();
+  g_fileDigests.clear();
+  ResetFailedFlags();
+  g_replacementIndex.Reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const PackEntry &e = g_texturePack.GetEntry(i);
+    g_replacementIndex.Insert(e.width, e.height, e.hash, i | PACK_ID_BIT);
+    g_replacementDimensions.Insert(DimensionKey(e.width, e.height));
+  }
+}
+
+// Load a replacement by ID, sized for origDesc. allowFormatChange lets a DDS
+// in another format (e.g. BC7 for an RGBA8 original) keep its own format.
+bool LoadReplacementById(ID3D11Device *device, uint32_t id,
+                         const D3D11_TEXTURE2D_DESC *origDesc,
+                         bool allowFormatChange, ID3D11Texture2D **ppTexture) {
+  if (id & PACK_ID_BIT)
+    return LoadPackTexture(device, g_texturePack.GetEntry(id & ~PACK_ID_BIT),
+                           origDesc, allowFormatChange, ppTexture);
+
+  // Choose loader by file extension
+  const std::string &filepath = g_replacementFiles[id].path;
+  if (filepath.size() >= 4 &&
+      filepath.compare(filepath.size() - 4, 4, ".png") == 0)
+    return LoadPNGTexture(device, filepath, origDesc, allowFormatChange,
+                          ppTexture);
+  return LoadDDSTexture(device, filepath, origDesc, allowFormatChange,
+                        ppTexture);
+}
+
+// Digest of a replacement's own content, so identical files loaded under
+// different keys can share a texture. Pack entries with identical payloads
+// share an offset (TexturePackWriter), which identifies them for free; loose
+// files are hashed once. Caller holds g_sharedSRVCS.
+bool GetReplacementDigest(uint32_t id, uint64_t *outDigest) {
+  if (id & PACK_ID_BIT) {
+    const PackEntry &e = g_texturePack.GetEntry(id & ~PACK_ID_BIT);
+    *outDigest = FlatHashMix(e.dataOffset) ^
+                 FlatHashMix(((uint64_t)e.format << 48) ^
+                             ((uint64_t)e.dataWidth << 24) ^ e.dataHeight ^
+                             ((uint64_t)e.mipLevels << 56));
+    return true;
+  }
+  if (!g_fileDigests[id]) {
+    MappedFile file;
+    uint64_t digest = 0;
+    if (!file.Open(g_replacementFiles[id].path) ||
+        !HashBuffer(file.GetData(), file.GetSize(), 0, &digest))
+      return false;
+    g_fileDigests[id] = digest ? digest : 1; // 0 means not computed
+  }
+  *outDigest = g_fileDigests[id];
+  return true;
+}
+
+// Drop shared views that nothing but the table holds any more (their
+// originals were destroyed or evicted for budget) and no preload pinned.
+// Caller holds g_sharedSRVCS.
+void PruneSharedReplacementSRVs() {
+  for (auto it = g_sharedReplacementSRVs.begin();
+       it != g_sharedReplacementSRVs.end();) {
+    ID3D11ShaderResourceView *srv = it->second.srv.Get();
+    srv->AddRef();
+    if (srv->Release() == 1 && !it->second.pinned)
+      it = g_sharedReplacementSRVs.erase(it);
+    else
+      ++it;
+  }
+}
+
+// Caller holds g_fingerprintCS. Returns true if this replacement had no
+// fingerprint yet; *completed is set if it was the last one at its size.
+bool AddFingerprint(UINT width, UINT height, uint64_t hash,
+                    uint64_t fingerprint, bool *completed) {
+  *completed = false;
+  if (g_replacementIndex.Find(width, height, hash) == INVALID_REPLACEMENT_ID)
+    return false;
+  if (!g_learnedFingerprints.Insert(FingerprintKey(width, height, hash)))
+    return false;
+  DimensionFingerprints &dims =
+      g_dimensionFingerprints[DimensionKey(width, height)];
+  if (dims.unlearned > 0)
+    *completed = --dims.unlearned == 0;
+  dims.fingerprints.push_back(fingerprint);
+  return true;
+}
+
+// Caller holds g_fingerprintCS
+void PublishFingerprintFilter() {
+  FingerprintFilter *filter = new FingerprintFilter();
+  for (const auto &entry : g_dimensionFingerprints) {
+    if (entry.second.unlearned > 0)
+      continue;
+    UINT width = (UINT)(entry.first >> 32), height = (UINT)entry.first;
+    filter->completeDimensions.Insert(entry.first);
+    for (uint64_t fingerprint : entry.second.fingerprints)
+      filter->fingerprints.Insert(FingerprintKey(width, height, fingerprint));
+  }
+  FingerprintFilter *old = (FingerprintFilter *)InterlockedExchangePointer(
+      (PVOID volatile *)&g_fingerprintFilter, filter);
+  if (old)
+    g_retiredFingerprintFilters.push_back(old);
+}
+
+// Count replacements per size, then apply fingerprints learned in earlier
+// sessions
+void LoadFingerprintsLocked() {
+  g_dimensionFingerprints.clear();
+  g_learnedFingerprints.Clear();
+  if (g_texturePack.IsOpen()) {
+    for (uint32_t i = 0; i < g_texturePack.GetEntryCount(); ++i) {
+      const PackEntry &e = g_texturePack.GetEntry(i);
+      g_dimensionFingerprints[DimensionKey(e.width, e.height)].unlearned++;
+    }
+  } else {
+    for (size_t i = 0; i < g_replacementFiles.size(); ++i) {
+      const ReplacementFile &rf = g_replacementFiles[i];
+      // Files shadowed by a later one with the same key don't count
+      if (g_replacementIndex.Find(rf.width, rf.height, rf.hash) == i)
+        g_dimensionFingerprints[DimensionKey(rf.width, rf.height)].unlearned++;
+    }
+  }
+
+  std::ifstream file(g_fingerprintPath, std::ios::binary);
+  FingerprintFileHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != FINGERPRINT_FILE_MAGIC ||
+      header.version != FINGERPRINT_FILE_VERSION)
+    return;
+  FingerprintRecord record;
+  bool completed;
+  while (file.read(reinterpret_cast<char *>(&record), sizeof(record)))
+    AddFingerprint(record.width, record.height, record.hash,
+                   record.fingerprint, &completed);
+}
+
+void LoadFingerprints() {
+  InitFingerprintCS();
+  EnterCriticalSection(&g_fingerprintCS);
+  LoadFingerprintsLocked();
+  PublishFingerprintFilter();
+  LeaveCriticalSection(&g_fingerprintCS);
+}
+
+// Caller holds g_fingerprintCS
+void AppendFingerprint(const FingerprintRecord &record) {
+  if (g_fingerprintFile == INVALID_HANDLE_VALUE) {
+    g_fingerprintFile = CreateFileA(g_fingerprintPath.c_str(), FILE_APPEND_DATA,
+                                    FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (g_fingerprintFile == INVALID_HANDLE_VALUE)
+      return;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(g_fingerprintFile, &size) && size.QuadPart == 0) {
+      FingerprintFileHeader header = {FINGERPRINT_FILE_MAGIC,
+                                      FINGERPRINT_FILE_VERSION};
+      DWORD written = 0;
+      WriteFile(g_fingerprintFile, &header, sizeof(header), &written, nullptr);
+    }
+  }
+  DWORD written = 0;
+  WriteFile(g_fingerprintFile, &record, sizeof(record), &written, nullptr);
+}
+
+const char *GetReplacementName(uint32_t id) {
+  if (id & PACK_ID_BIT)
+    return "textures.pack";
+  const std::string &filepath = g_replacementFiles[id].path;
+  size_t nameStart = filepath.find_last_of("\\/");
+  return filepath.c_str() +
+         (nameStart != std::string::npos ? nameStart + 1 : 0);
+}
+
+void BuildReplacementCache(bool compilePack) {
+  if (g_cacheBuilt || g_modsPath.empty())
+    return;
+  g_cacheBuilt = true;
+
+  ScanRegionFiles("*.dds");
+  ScanRegionFiles("*.png");
+  if (!g_regionFiles.empty())
+    std::cout << "[Mod] Region replacements: " << g_regionIndex.Size()
+              << " tile(s) in mods/textures/regions" << std::endl;
+
+  // A compiled pack replaces the per-file scan entirely, unless files were
+  // added, changed or removed, or settings baked into it changed, since
+  if (!compilePack && g_texturePack.Open(g_texturePackPath) &&
+      !SamePackSource(g_texturePack.GetSource(), ScanPackSource())) {
+    std::cout << "[Mod] Warning: mods/textures.pack is out of date, using "
+                 "the files in mods/textures (set texture_pack_build=1 to "
+                 "rebuild it)"
+              << std::endl;
+    g_texturePack.Close();
+  }
+  if (!compilePack && g_texturePack.IsOpen()) {
+    IndexTexturePack();
+    LoadFingerprints();
+    std::cout << "[Mod] Texture replacer enabled, with pack: "
+              << g_texturePack.GetEntryCount()
+              << " texture(s) in mods/textures.pack" << std::endl;
+    return;
+  }
+
+  ScanReplacementFiles(g_modsPath + "\\*.dds");
+  ScanReplacementFiles(g_modsPath + "\\*.png");
+  LoadReplacementAliases();
+  ResetFailedFlags();
+
+  if (compilePack && !g_replacementFiles.empty()) {
+    CompileTexturePack();
+    if (g_texturePack.Open(g_texturePackPath)) {
+      IndexTexturePack();
+      LoadFingerprints();
+      std::cout << "[Mod] Texture replacer enabled, with pack: "
+                << g_texturePack.GetEntryCount()
+                << " texture(s) in mods/textures.pack" << std::endl;
+      return;
+    }
+  }
+
+  LoadFingerprints();
+  std::cout << "[Mod] Texture replacer enabled, with cache: "
+            << g_replacementIndex.Size() << " file(s) in mods/textures"
+            << std::endl;
+}
+
 bool IsReplacementFormatSupported(DXGI_FORMAT format) {
   switch (format) {
   case DXGI_FORMAT_R8G8B8A8_UNORM:
@@ -423,10 +1174,31 @@ bool IsTextureReplacementEnabled() {
   }
 
   g_textureReplaceEnabled = settings.GetBool("texture_replace_enabled", false);
+  g_generateMips = settings.GetBool("texture_replace_mipmaps", true);
+  std::string mipFilter =
+      settings.GetString("texture_replace_mip_filter", "box");
+  g_mipFilter = mipFilter == "kaiser" ? MipFilter::Kaiser : MipFilter::Box;
+  if (mipFilter != "kaiser" && mipFilter != "box")
+    std::cout << "[Mod] Unknown texture_replace_mip_filter '" << mipFilter
+              << "', using box" << std::endl;
+  int compressMode = settings.GetInt("texture_replace_compress", 0);
+  g_compressMode = compressMode == 2   ? BCMode::BC7
+                   : compressMode == 1 ? BCMode::BC1BC3
+                                       : BCMode::Off;
 
   if (g_textureReplaceEnabled) {
     InitializeModsPath();
-    BuildReplacementCache();
+    if (g_compressMode != BCMode::Off && g_bcCache.Open(g_bcCachePath))
+      std::cout << "[Mod] Compressed replacement cache: " << g_bcCache.Size()
+                << " texture(s) in mods/textures.bccache" << std::endl;
+    bool buildPack = settings.GetBool("texture_pack_build", false);
+    BuildReplacementCache(buildPack);
+    if (settings.GetBool("texture_replace_preload", true))
+      InitRoomPreload(g_modsPath + ".rooms");
+    // One-shot: don't rebuild the pack on every launch
+    if (buildPack && g_texturePack.IsOpen())
+      settings.UpdateFile(Settings::GetSettingsPath(), "texture_pack_build",
+                          "0");
   }
 
   return g_textureReplaceEnabled;
@@ -442,79 +1214,49 @@ bool TryLoadReplacementTexture(ID3D11Device *pDevice,
     return false; // Avoid trying files we can't load for this format
 
   UINT w = pDesc->Width, h = pDesc->Height;
-  uint64_t hash = HashTexture(pDesc, pInitialData);
-
-  // Exact lookup from preloaded cache
-  auto it = g_replacementByHash.find({w, h, hash});
-  if (it != g_replacementByHash.end()) {
-    const std::string &filepath = it->second;
-    if (g_failedReplacementFiles.count(filepath))
-      return false;
-
-    bool loaded = false;
-    // Choose loader by file extension
-    if (filepath.size() >= 4 &&
-        filepath.compare(filepath.size() - 4, 4, ".png") == 0) {
-      loaded = LoadPNGTexture(pDevice, filepath, pDesc, ppTexture2D);
-    } else {
-      loaded = LoadDDSTexture(pDevice, filepath, pDesc, ppTexture2D);
-    }
-
-    if (loaded) {
-      size_t nameStart = filepath.find_last_of("\\/");
-      std::string name = (nameStart != std::string::npos)
-                             ? filepath.substr(nameStart + 1)
-                             : filepath;
-      std::cout << "Replaced texture: " << name << std::endl;
-      return true;
-    }
-    g_failedReplacementFiles.insert(filepath);
-  }
-
-  return false;
-}
+  // Cheap dimension prefilter: most textures have no replacement, and this
+  // avoids hashing their contents at all
+  if (!g_replacementDimensions.Contains(DimensionKey(w, h)))
+    return false;
 
-std::string FindReplacementPath(UINT width, UINT height, uint64_t contentHash) {
-  if (!IsTextureReplacementEnabled())
-    return "";
-  auto it = g_replacementByHash.find({width, height, contentHash});
-  if (it != g_replacementByHash.end()) {
-    if (!g_failedReplacementFiles.count(it->second))
-      return it->second;
+  const void *pData = nullptr;
+  UINT rowPitch = 0;
+  if (pInitialData && pInitialData->pSysMem && pInitialData->SysMemPitch > 0) {
+    pData = pInitialData->pSysMem;
+    rowPitch = pInitialData->SysMemPitch;
   }
-  return "";
-}
 
-bool LoadReplacementSRV(ID3D11Device *pDevice,
-                        const D3D11_TEXTURE2D_DESC *pDesc, uint64_t contentHash,
-                        ID3D11ShaderResourceView **ppSRV) {
-  if (!pDevice || !pDesc || !ppSRV)
+  // Second prefilter: sampled fingerprint before the full hash
+  uint64_t fingerprint = FingerprintTextureData(pDesc, pData, rowPitch);
+  if (!MayHaveReplacement(w, h, fingerprint))
     return false;
-  *ppSRV = nullptr;
 
-  std::string path =
-      FindReplacementPath(pDesc->Width, pDesc->Height, contentHash);
-  if (path.empty())
+  uint64_t hash = HashTexture(pDesc, pInitialData);
+  uint32_t id = FindReplacementId(w, h, hash);
+  if (id == INVALID_REPLACEMENT_ID)
     return false;
+  RecordReplacementFingerprint(w, h, hash, fingerprint);
 
-  D3D11_TEXTURE2D_DESC createDesc = *pDesc;
-  createDesc.MipLevels = 1;
-
-  ComPtr<ID3D11Texture2D> pReplaceTex;
-  bool loaded = false;
-
-  if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0) {
-    loaded =
-        LoadPNGTexture(pDevice, path, &createDesc, pReplaceTex.GetAddressOf());
-  } else {
-    loaded =
-        LoadDDSTexture(pDevice, path, &createDesc, pReplaceTex.GetAddressOf());
+  // The game keeps using this texture under its own desc, so the format
+  // must not change
+  if (LoadReplacementById(pDevice, id, pDesc, false, ppTexture2D)) {
+    std::cout << "Replaced texture: " << GetReplacementName(id) << std::endl;
+    return true;
   }
+  MarkReplacementFailed(id);
+  return false;
+}
 
-  if (!loaded || !pReplaceTex) {
-    g_failedReplacementFiles.insert(path);
+namespace {
+// Load replacement id as an immutable texture and create its view
+bool CreateReplacementSRV(ID3D11Device *pDevice, uint32_t id,
+                          const D3D11_TEXTURE2D_DESC *pDesc,
+                          ID3D11ShaderResourceView **ppSRV) {
+  ComPtr<ID3D11Texture2D> pReplaceTex;
+  if (!LoadReplacementById(pDevice, id, pDesc, true,
+                           pReplaceTex.GetAddressOf()) ||
+      !pReplaceTex)
     return false;
-  }
 
   // Query actual replacement texture desc (may differ from original for HD
   // replacements)
@@ -525,24 +1267,170 @@ bool LoadReplacementSRV(ID3D11Device *pDevice,
   srvDesc.Format = replaceDesc.Format;
   srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
   srvDesc.Texture2D.MostDetailedMip = 0;
-  srvDesc.Texture2D.MipLevels = 1;
+  srvDesc.Texture2D.MipLevels = replaceDesc.MipLevels;
 
   HRESULT hr =
       pDevice->CreateShaderResourceView(pReplaceTex.Get(), &srvDesc, ppSRV);
-  if (FAILED(hr)) {
-    g_failedReplacementFiles.insert(path);
+  return SUCCEEDED(hr);
+}
+
+// Bind-time load shared by LoadReplacementSRV and PreloadReplacementSRV.
+// Preloaded views stay in the shared table (pinned) until the next room
+// change, even before anything binds them.
+bool LoadSharedReplacementSRV(ID3D11Device *pDevice,
+                              const D3D11_TEXTURE2D_DESC *pDesc,
+                              uint64_t contentHash, bool preload,
+                              ID3D11ShaderResourceView **ppSRV) {
+  *ppSRV = nullptr;
+  if (!IsTextureReplacementEnabled())
+    return false;
+  uint32_t id = FindReplacementId(pDesc->Width, pDesc->Height, contentHash);
+  if (id == INVALID_REPLACEMENT_ID)
     return false;
+
+  // Identical content loaded for the same target shape: share its view
+  uint64_t sharedKey = 0;
+  InitSharedSRVCS();
+  EnterCriticalSection(&g_sharedSRVCS);
+  uint64_t digest;
+  if (GetReplacementDigest(id, &digest)) {
+    sharedKey = digest ^ FlatHashMix(((uint64_t)pDesc->Format << 48) ^
+                                     DimensionKey(pDesc->Width, pDesc->Height));
+    // The room preloader and the render thread can both want it
+    while (g_loadingSharedKeys.count(sharedKey))
+      SleepConditionVariableCS(&g_sharedSRVLoaded, &g_sharedSRVCS, INFINITE);
+    auto it = g_sharedReplacementSRVs.find(sharedKey);
+    if (it != g_sharedReplacementSRVs.end()) {
+      *ppSRV = it->second.srv.Get();
+      (*ppSRV)->AddRef();
+      it->second.pinned = preload;
+    } else if (IsReplacementFailed(id)) {
+      LeaveCriticalSection(&g_sharedSRVCS);
+      return false; // The other thread's load failed
+    } else {
+      g_loadingSharedKeys.insert(sharedKey);
+    }
+  }
+  PruneSharedReplacementSRVs();
+  LeaveCriticalSection(&g_sharedSRVCS);
+  if (*ppSRV) {
+#ifdef _DEBUG
+    if (!preload)
+      std::cout << "Replaced texture (bind-time, shared): "
+                << GetReplacementName(id) << std::endl;
+#endif
+    return true;
   }
 
-  size_t nameStart = path.find_last_of("\\/");
-  std::string name =
-      (nameStart != std::string::npos) ? path.substr(nameStart + 1) : path;
+  bool loaded = CreateReplacementSRV(pDevice, id, pDesc, ppSRV);
+  if (!loaded)
+    MarkReplacementFailed(id);
+  if (sharedKey) {
+    EnterCriticalSection(&g_sharedSRVCS);
+    if (loaded)
+      g_sharedReplacementSRVs.emplace(sharedKey,
+                                      SharedReplacementSRV{*ppSRV, preload});
+    g_loadingSharedKeys.erase(sharedKey);
+    LeaveCriticalSection(&g_sharedSRVCS);
+    WakeAllConditionVariable(&g_sharedSRVLoaded);
+  }
+  if (!loaded)
+    return false;
+
 #ifdef _DEBUG
-  std::cout << "Replaced texture (bind-time): " << name << std::endl;
+  std::cout << (preload ? "Preloaded texture: "
+                        : "Replaced texture (bind-time): ")
+            << GetReplacementName(id) << std::endl;
 #endif
   return true;
 }
+} // namespace
+
+bool LoadReplacementSRV(ID3D11Device *pDevice,
+                        const D3D11_TEXTURE2D_DESC *pDesc, uint64_t contentHash,
+                        ID3D11ShaderResourceView **ppSRV) {
+  if (!pDevice || !pDesc || !ppSRV)
+    return false;
+  if (!LoadSharedReplacementSRV(pDevice, pDesc, contentHash, false, ppSRV))
+    return false;
+  RecordRoomReplacement(pDevice, pDesc, contentHash);
+  return true;
+}
+
+bool PreloadReplacementSRV(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pDesc,
+                           uint64_t contentHash) {
+  if (!pDevice || !pDesc)
+    return false;
+  ComPtr<ID3D11ShaderResourceView> srv;
+  return LoadSharedReplacementSRV(pDevice, pDesc, contentHash, true,
+                                  srv.GetAddressOf());
+}
+
+void UnpinPreloadedReplacements() {
+  InitSharedSRVCS();
+  EnterCriticalSection(&g_sharedSRVCS);
+  for (auto &entry : g_sharedReplacementSRVs)
+    entry.second.pinned = false;
+  LeaveCriticalSection(&g_sharedSRVCS);
+}
 
 bool HasReplacementAtDimensions(UINT width, UINT height) {
-  return g_replacementDimensions.count({width, height}) > 0;
+  return g_replacementDimensions.Contains(DimensionKey(width, height));
+}
+
+bool MayHaveReplacement(UINT width, UINT height, uint64_t fingerprint) {
+  if (!g_replacementDimensions.Contains(DimensionKey(width, height)))
+    return false;
+  const FingerprintFilter *filter = g_fingerprintFilter;
+  if (!filter || !filter->completeDimensions.Contains(
+                     DimensionKey(width, height)))
+    return true;
+  return filter->fingerprints.Contains(
+      FingerprintKey(width, height, fingerprint));
+}
+
+void RecordReplacementFingerprint(UINT width, UINT height, uint64_t hash,
+                                  uint64_t fingerprint) {
+  InitFingerprintCS();
+  EnterCriticalSection(&g_fingerprintCS);
+  bool completed;
+  if (AddFingerprint(width, height, hash, fingerprint, &completed))
+    AppendFingerprint({hash, width, height, fingerprint});
+  if (completed)
+    PublishFingerprintFilter();
+  LeaveCriticalSection(&g_fingerprintCS);
+}
+
+bool HasRegionReplacements() {
+  return IsTextureReplacementEnabled() && g_regionIndex.Size() > 0;
+}
+
+bool HasRegionReplacement(UINT width, UINT height, uint64_t tileHash) {
+  uint32_t id = g_regionIndex.Find(width, height, tileHash);
+  return id != INVALID_REPLACEMENT_ID && !g_failedRegions[id];
+}
+
+bool LoadRegionReplacement(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pTileDesc,
+                           uint64_t tileHash, ID3D11Texture2D **ppTexture) {
+  if (!pDevice || !pTileDesc || !ppTexture)
+    return false;
+  *ppTexture = nullptr;
+  uint32_t id = g_regionIndex.Find(pTileDesc->Width, pTileDesc->Height,
+                                   tileHash);
+  if (id == INVALID_REPLACEMENT_ID || g_failedRegions[id])
+    return false;
+
+  const std::string &filepath = g_regionFiles[id].path;
+  bool loaded =
+      filepath.size() >= 4 &&
+              filepath.compare(filepath.size() - 4, 4, ".png") == 0
+          ? LoadPNGTexture(pDevice, filepath, pTileDesc, false, ppTexture)
+          : LoadDDSTexture(pDevice, filepath, pTileDesc, false, ppTexture);
+  if (!loaded || !*ppTexture) {
+    g_failedRegions[id] = 1;
+    return false;
+  }
+  return true;
 }
@@ -12,10 +12,6 @@ bool TryLoadReplacementTexture(ID3D11Device *pDevice,
 // Check if texture replacement is enabled
 bool IsTextureReplacementEnabled();
 
-// Look up replacement by content hash (for PSSetShaderResources path)
-// Returns filepath or empty string if no replacement found
-std::string FindReplacementPath(UINT width, UINT height, uint64_t contentHash);
-
 // Load replacement texture and create SRV for bind-time replacement
 // Used by PSSetShaderResources hook to swap textures at bind time
 bool LoadReplacementSRV(ID3D11Device *pDevice,
@@ -23,6 +19,37 @@ bool LoadReplacementSRV(ID3D11Device *pDevice,
                         uint64_t contentHash,
                         ID3D11ShaderResourceView **ppSRV);
 
+// Load a bind-time replacement ahead of its first bind (room_preload.h) and
+// keep it resident until UnpinPreloadedReplacements, so the bind that
+// follows finds it in the shared table. Safe to call from a worker thread.
+bool PreloadReplacementSRV(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pDesc,
+                           uint64_t contentHash);
+
+// Let preloaded replacements nothing has bound be released again
+void UnpinPreloadedReplacements();
+
 // Quick check: does any replacement file exist at these dimensions?
 // Used to skip expensive staging for textures that can't possibly match.
 bool HasReplacementAtDimensions(UINT width, UINT height);
+
+// Two-stage lookup: false when no replacement at these dimensions can match
+// a texture with this sampled fingerprint (FingerprintTextureData), so the
+// full hash can be skipped. True until every replacement at the size has a
+// learned fingerprint.
+bool MayHaveReplacement(UINT width, UINT height, uint64_t fingerprint);
+
+// Remember the fingerprint of an original whose full hash matched a
+// replacement (persisted to mods/textures.fingerprints)
+void RecordReplacementFingerprint(UINT width, UINT height, uint64_t hash,
+                                  uint64_t fingerprint);
+
+// Region replacements (mods/textures/regions/WxH_<hash>.png|dds) for atlas
+// tiles; tileHash is HashRegionTile (region_replace.h)
+bool HasRegionReplacements();
+bool HasRegionReplacement(UINT width, UINT height, uint64_t tileHash);
+
+// Load a region replacement in the tile's format, at the file's own size
+bool LoadRegionReplacement(ID3D11Device *pDevice,
+                           const D3D11_TEXTURE2D_DESC *pTileDesc,
+                           uint64_t tileHash, ID3D11Texture2D **ppTexture);
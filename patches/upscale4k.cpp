@@ -2,13 +2,16 @@
 
 #define NOMINMAX
 #include "upscale4k.h"
-#include "../utils/memory.h"
+#include "../utils/hook_registry.h"
 #include "../utils/settings.h"
-#include "../utils/viewport_utils.h"
+#include "frame_timing.h"
+#include "resource_table.h"
+#include "sparse_target.h"
 #include "texturereplace.h"
-#include "widescreen.h"
+#include "upscale_rewrite.h"
 #include <Windows.h>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -21,254 +24,414 @@ static bool g_upscaleActive = false;
 static HANDLE g_setupCompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
 namespace {
-constexpr float BaseWidth = 4096.0f;
-constexpr float BaseHeight = 2048.0f;
-
-static float g_ResMultiplier = 4.0f;
-static float g_NewWidth = BaseWidth * 4.0f;
-static float g_NewHeight = BaseHeight * 4.0f;
-
-typedef void(STDMETHODCALLTYPE *RSSetViewports_t)(ID3D11DeviceContext *, UINT,
-                                                  const D3D11_VIEWPORT *);
-typedef void(STDMETHODCALLTYPE *CopySubresourceRegion_t)(
-    ID3D11DeviceContext *, ID3D11Resource *, UINT, UINT, UINT, UINT,
-    ID3D11Resource *, UINT, const D3D11_BOX *, BOOL);
-typedef HRESULT(STDMETHODCALLTYPE *CreateTexture2D_t)(
-    ID3D11Device *, const D3D11_TEXTURE2D_DESC *,
-    const D3D11_SUBRESOURCE_DATA *, ID3D11Texture2D **);
-
-// Win32 primitives for thread-safe access (avoids C++ runtime initialization
-// issues)
-volatile RSSetViewports_t Original_RSSetViewports = nullptr;
-volatile CopySubresourceRegion_t Original_CopySubresourceRegion = nullptr;
-volatile CreateTexture2D_t Original_CreateTexture2D = nullptr;
-
-volatile LONG g_viewportsHookReady = 0;
-volatile LONG g_copyHookReady = 0;
-volatile LONG g_createTextureHookReady = 0;
-
-inline bool IsColorFormat(DXGI_FORMAT format) {
-  return format == DXGI_FORMAT_R8G8B8A8_UNORM ||
-         format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB ||
-         format == DXGI_FORMAT_B8G8R8A8_UNORM ||
-         format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
-         format == DXGI_FORMAT_R16G16B16A16_FLOAT ||
-         format == DXGI_FORMAT_R32G32B32A32_FLOAT;
+// Upscaled render target size (upscale_rewrite.h)
+UpscaleSize g_size = GetUpscaleSize(UPSCALE_MAX_SCALE);
+
+// Dynamic scale (upscale_dynamic). The upscaled targets are created once and
+// keep their content across frames, so their size can't change under the
+// game. Instead GPU frame time is measured at this session's scale, and the
+// scale it can afford within the configured bounds is saved for next launch.
+struct DynamicScaleState {
+  float current; // This session's scale
+  float minScale;
+  float maxScale;
+  float targetMs;
+  float saved;    // Last value written to upscale_scale
+  float proposed; // Previous window's proposal; two in a row are saved
+  double sumMs;
+  UINT frames;
+};
+DynamicScaleState g_dynamic = {};
+constexpr UINT DYNAMIC_WINDOW_FRAMES = 300;
+constexpr float DYNAMIC_SCALE_STEP = 0.25f;
+// Scale up only while the predicted frame time stays under this fraction of
+// the target, so the saved scale doesn't flip back and forth
+constexpr float DYNAMIC_HEADROOM = 0.85f;
+
+// Shadow of the first render target bound by OMSetRenderTargets, so the
+// viewport hook doesn't query the pipeline on every call: the context
+// pointer with bit 0 set if the target is upscaled, in one aligned word so
+// it is read and written atomically. A viewport call on any other context
+// (or after OMSetRenderTargetsAndUnorderedAccessViews, which clears it)
+// falls back to querying the bound target.
+volatile LONG_PTR g_renderTargetShadow = 0;
+constexpr LONG_PTR SHADOW_UPSCALED_BIT = 1;
+// Sparse target behind the shadowed view, if any. Written alongside the
+// shadow; sparse targets are never freed, so a stale read only maps tiles.
+SparseTarget *volatile g_shadowSparseTarget = nullptr;
+
+// Upscaled targets are tiled resources backed on use (upscale_sparse)
+bool g_sparseEnabled = false;
+
+// {3B8E1D52-9C47-4F0A-B6E3-5D2A71C48F90}
+const GUID GUID_CrossFixUpscaledRT = {
+    0x3b8e1d52,
+    0x9c47,
+    0x4f0a,
+    {0xb6, 0xe3, 0x5d, 0x2a, 0x71, 0xc4, 0x8f, 0x90}};
+
+struct RenderTargetInfo {
+  SparseTarget *sparse; // Set if the texture is a sparse upscaled target
+  BYTE upscaled;        // The texture has the upscaled render target size
+};
+
+RenderTargetInfo QueryRenderTargetInfo(ID3D11RenderTargetView *rtv) {
+  RenderTargetInfo info = {};
+  ID3D11Resource *pRes = nullptr;
+  rtv->GetResource(&pRes);
+  if (pRes) {
+    D3D11_TEXTURE2D_DESC texDesc;
+    if (GetTexture2DDesc(pRes, &texDesc))
+      info.upscaled = IsUpscaledSize(g_size, texDesc.Width, texDesc.Height);
+    if (info.upscaled && g_sparseEnabled)
+      info.sparse = FindSparseTarget(pRes);
+    pRes->Release();
+  }
+  return info;
+}
+
+// Same, cached on the view itself (private data lives and dies with it)
+RenderTargetInfo GetRenderTargetInfo(ID3D11RenderTargetView *rtv) {
+  RenderTargetInfo info = {};
+  UINT size = sizeof(info);
+  if (SUCCEEDED(rtv->GetPrivateData(GUID_CrossFixUpscaledRT, &size, &info)) &&
+      size == sizeof(info))
+    return info;
+  info = QueryRenderTargetInfo(rtv);
+  rtv->SetPrivateData(GUID_CrossFixUpscaledRT, sizeof(info), &info);
+  return info;
+}
+
+// Sparse target a view is of, if any
+SparseTarget *FindViewSparseTarget(ID3D11View *pView) {
+  if (!pView)
+    return nullptr;
+  ID3D11Resource *pRes = nullptr;
+  pView->GetResource(&pRes);
+  if (!pRes)
+    return nullptr;
+  SparseTarget *sparse = FindSparseTarget(pRes);
+  pRes->Release();
+  return sparse;
+}
+
+// Writes whose extent isn't known (UAVs, clears) map the whole target.
+// Clearing to zero needs nothing: unmapped tiles already read as zero.
+template <typename T> bool IsZeroClear(const T *values) {
+  return !values ||
+         (values[0] == 0 && values[1] == 0 && values[2] == 0 && values[3] == 0);
 }
-} // namespace
 
-void STDMETHODCALLTYPE Hooked_RSSetViewports(ID3D11DeviceContext *This,
-                                             UINT NumViewports,
-                                             const D3D11_VIEWPORT *pViewports) {
-  MemoryBarrier();
-  RSSetViewports_t pOriginal = Original_RSSetViewports;
+void TouchSparseView(ID3D11View *pView, ID3D11DeviceContext *pContext) {
+  SparseTarget *sparse = FindViewSparseTarget(pView);
+  if (sparse)
+    TouchSparseCopy(sparse, nullptr, pContext);
+}
+
+// Upscaled texel rect covered by viewports, rounded outwards
+void TouchViewports(SparseTarget *sparse, ID3D11DeviceContext *pContext,
+                    const D3D11_VIEWPORT *vps, UINT count) {
+  float left = 32767.0f, top = 32767.0f, right = 0.0f, bottom = 0.0f;
+  for (UINT i = 0; i < count; ++i) {
+    left = std::min(left, vps[i].TopLeftX);
+    top = std::min(top, vps[i].TopLeftY);
+    right = std::max(right, vps[i].TopLeftX + vps[i].Width);
+    bottom = std::max(bottom, vps[i].TopLeftY + vps[i].Height);
+  }
+  TouchSparseRect(sparse, pContext, (UINT)std::max(0.0f, std::floor(left)),
+                  (UINT)std::max(0.0f, std::floor(top)),
+                  (UINT)std::max(0.0f, std::ceil(right)),
+                  (UINT)std::max(0.0f, std::ceil(bottom)));
+}
+
+std::string FormatScale(float scale) {
+  std::ostringstream oss;
+  oss << scale;
+  return oss.str();
+}
 
-  if (!pOriginal)
+// Frame time callback for the dynamic scale. GPU time is taken to grow with
+// the pixel count, i.e. with the square of the scale.
+void OnGpuFrameTime(float gpuMs) {
+  g_dynamic.sumMs += gpuMs;
+  if (++g_dynamic.frames < DYNAMIC_WINDOW_FRAMES)
     return;
-  if (!pViewports || NumViewports == 0 || !g_viewportsHookReady) {
-    pOriginal(This, NumViewports, pViewports);
+  float averageMs = static_cast<float>(g_dynamic.sumMs / g_dynamic.frames);
+  g_dynamic.sumMs = 0.0;
+  g_dynamic.frames = 0;
+  if (averageMs <= 0.0f)
     return;
+
+  float next = g_dynamic.current;
+  float budgetMs = 0.0f;
+  if (averageMs > g_dynamic.targetMs)
+    budgetMs = g_dynamic.targetMs;
+  else if (averageMs < g_dynamic.targetMs * DYNAMIC_HEADROOM)
+    budgetMs = g_dynamic.targetMs * DYNAMIC_HEADROOM;
+  if (budgetMs > 0.0f) {
+    float affordable = g_dynamic.current * std::sqrt(budgetMs / averageMs);
+    next = std::floor(affordable / DYNAMIC_SCALE_STEP) * DYNAMIC_SCALE_STEP;
+    if (averageMs < g_dynamic.targetMs)
+      next = std::max(next, g_dynamic.current);
   }
+  next = std::clamp(next, g_dynamic.minScale, g_dynamic.maxScale);
 
-  // Allocate a small buffer on stack for modified viewports
-  D3D11_VIEWPORT vps[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-  UINT count = ViewportUtils::CopyViewportsToBuffer(
-      vps, D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE, pViewports,
-      NumViewports);
-
-  // Apply viewport widescreen fix FIRST (before upscaling)
-  // Only apply if we're actually in widescreen mode
-  // Use tolerance to account for floating-point precision
-  // Ratio should be < 1.0 for widescreen (e.g., 0.75 for 16:9)
-  float ratio = GetCurrentWidescreenRatio();
-  const float WIDESCREEN_THRESHOLD = 0.99f;
-  if (ratio < WIDESCREEN_THRESHOLD) {
-    ViewportUtils::ApplyViewportWidescreenFix(vps, count, ratio);
+  bool stable = next == g_dynamic.proposed;
+  g_dynamic.proposed = next;
+  if (!stable || next == g_dynamic.saved)
+    return;
+
+  Settings settings;
+  if (settings.UpdateFile(Settings::GetSettingsPath(), "upscale_scale",
+                          FormatScale(next))) {
+    g_dynamic.saved = next;
+    std::cout << "[Mod] GPU frame time " << averageMs << " ms at "
+              << g_dynamic.current << "x upscale (target "
+              << g_dynamic.targetMs << " ms), using " << next
+              << "x from next launch" << std::endl;
   }
+}
+} // namespace
 
-  // Check render target once per call
-  bool isUpscaledTarget = false;
-  ID3D11RenderTargetView *rtv = nullptr;
-  This->OMGetRenderTargets(1, &rtv, nullptr);
-  if (rtv) {
-    ID3D11Resource *pRes = nullptr;
-    rtv->GetResource(&pRes);
-    if (pRes) {
-      ID3D11Texture2D *pTex = nullptr;
-      pRes->QueryInterface(__uuidof(ID3D11Texture2D), (void **)&pTex);
-      if (pTex) {
-        D3D11_TEXTURE2D_DESC texDesc;
-        pTex->GetDesc(&texDesc);
-        if (texDesc.Width == (UINT)g_NewWidth &&
-            texDesc.Height == (UINT)g_NewHeight) {
-          isUpscaledTarget = true;
-        }
-        pTex->Release();
-      }
-      pRes->Release();
-    }
-    rtv->Release();
+void Hooked_OMSetRenderTargets(
+    const OMSetRenderTargetsHook::Next &next, ID3D11DeviceContext *This,
+    UINT NumViews, ID3D11RenderTargetView *const *ppRenderTargetViews,
+    ID3D11DepthStencilView *pDepthStencilView) {
+  next(This, NumViews, ppRenderTargetViews, pDepthStencilView);
+
+  RenderTargetInfo info = {};
+  if (NumViews > 0 && ppRenderTargetViews && ppRenderTargetViews[0])
+    info = GetRenderTargetInfo(ppRenderTargetViews[0]);
+  g_shadowSparseTarget = info.sparse;
+  g_renderTargetShadow =
+      (LONG_PTR)This | (info.upscaled ? SHADOW_UPSCALED_BIT : 0);
+}
+
+void Hooked_OMSetRenderTargetsAndUAVs(
+    const OMSetRenderTargetsAndUAVsHook::Next &next, ID3D11DeviceContext *This,
+    UINT NumRTVs, ID3D11RenderTargetView *const *ppRenderTargetViews,
+    ID3D11DepthStencilView *pDepthStencilView, UINT UAVStartSlot,
+    UINT NumUAVs, ID3D11UnorderedAccessView *const *ppUnorderedAccessViews,
+    const UINT *pUAVInitialCounts) {
+  next(This, NumRTVs, ppRenderTargetViews, pDepthStencilView, UAVStartSlot,
+       NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+  // May keep the current targets; not worth decoding, just stop trusting
+  // the shadow until the next OMSetRenderTargets
+  g_renderTargetShadow = 0;
+  // A sparse target bound as a UAV can be written anywhere
+  if (g_sparseEnabled && NumUAVs != D3D11_KEEP_UNORDERED_ACCESS_VIEWS &&
+      ppUnorderedAccessViews) {
+    for (UINT i = 0; i < NumUAVs; ++i)
+      TouchSparseView(ppUnorderedAccessViews[i], This);
   }
+}
 
-  for (UINT i = 0; i < count; ++i) {
-    // Apply 4K Upscale logic if rendering to upscaled target
-    if (isUpscaledTarget) {
-      float left_ndc = 2.0f * (vps[i].TopLeftX / BaseWidth) - 1.0f;
-      float top_ndc = 2.0f * (vps[i].TopLeftY / BaseHeight) - 1.0f;
-
-      vps[i].TopLeftX = (left_ndc * g_NewWidth + g_NewWidth) / 2.0f;
-      vps[i].TopLeftY = (top_ndc * g_NewHeight + g_NewHeight) / 2.0f;
-      vps[i].Width *= g_ResMultiplier;
-      vps[i].Height *= g_ResMultiplier;
-
-      vps[i].TopLeftX = std::min(vps[i].TopLeftX, 32767.0f);
-      vps[i].TopLeftY = std::min(vps[i].TopLeftY, 32767.0f);
-      vps[i].Width = std::min(vps[i].Width, 32767.0f);
-      vps[i].Height = std::min(vps[i].Height, 32767.0f);
-    }
+// The hooks below are installed with upscale_sparse only: writes that don't
+// go through a viewport or a copy need their tiles mapped too
+
+void Hooked_CSSetUnorderedAccessViews(
+    const CSSetUnorderedAccessViewsHook::Next &next, ID3D11DeviceContext *This,
+    UINT StartSlot, UINT NumUAVs,
+    ID3D11UnorderedAccessView *const *ppUnorderedAccessViews,
+    const UINT *pUAVInitialCounts) {
+  if (ppUnorderedAccessViews) {
+    for (UINT i = 0; i < NumUAVs; ++i)
+      TouchSparseView(ppUnorderedAccessViews[i], This);
   }
+  next(This, StartSlot, NumUAVs, ppUnorderedAccessViews, pUAVInitialCounts);
+}
 
-  pOriginal(This, count, vps);
+void Hooked_ClearRenderTargetView(const ClearRenderTargetViewHook::Next &next,
+                                  ID3D11DeviceContext *This,
+                                  ID3D11RenderTargetView *pRenderTargetView,
+                                  const FLOAT *ColorRGBA) {
+  if (!IsZeroClear(ColorRGBA))
+    TouchSparseView(pRenderTargetView, This);
+  next(This, pRenderTargetView, ColorRGBA);
 }
 
-void STDMETHODCALLTYPE Hooked_CopySubresourceRegion(
-    ID3D11DeviceContext *This, ID3D11Resource *pDstResource,
-    UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ,
-    ID3D11Resource *pSrcResource, UINT SrcSubresource, const D3D11_BOX *pSrcBox,
-    BOOL bWrapped) {
-  MemoryBarrier();
-  CopySubresourceRegion_t pOriginal = Original_CopySubresourceRegion;
+void Hooked_ClearUnorderedAccessViewUint(
+    const ClearUnorderedAccessViewUintHook::Next &next,
+    ID3D11DeviceContext *This, ID3D11UnorderedAccessView *pUnorderedAccessView,
+    const UINT *Values) {
+  if (!IsZeroClear(Values))
+    TouchSparseView(pUnorderedAccessView, This);
+  next(This, pUnorderedAccessView, Values);
+}
 
-  if (!pOriginal)
-    return;
-  if (!g_copyHookReady) {
-    pOriginal(This, pDstResource, DstSubresource, DstX, DstY, DstZ,
-              pSrcResource, SrcSubresource, pSrcBox, bWrapped);
+void Hooked_ClearUnorderedAccessViewFloat(
+    const ClearUnorderedAccessViewFloatHook::Next &next,
+    ID3D11DeviceContext *This, ID3D11UnorderedAccessView *pUnorderedAccessView,
+    const FLOAT *Values) {
+  if (!IsZeroClear(Values))
+    TouchSparseView(pUnorderedAccessView, This);
+  next(This, pUnorderedAccessView, Values);
+}
+
+void Hooked_UpdateSubresource(const UpdateSubresourceHook::Next &next,
+                              ID3D11DeviceContext *This,
+                              ID3D11Resource *pDstResource,
+                              UINT DstSubresource, const D3D11_BOX *pDstBox,
+                              const void *pSrcData, UINT SrcRowPitch,
+                              UINT SrcDepthPitch) {
+  SparseTarget *sparse = pDstResource ? FindSparseTarget(pDstResource)
+                                      : nullptr;
+  if (sparse && pDstBox)
+    TouchSparseRect(sparse, This, pDstBox->left, pDstBox->top,
+                    pDstBox->right, pDstBox->bottom);
+  else if (sparse)
+    TouchSparseCopy(sparse, nullptr, This);
+  next(This, pDstResource, DstSubresource, pDstBox, pSrcData, SrcRowPitch,
+       SrcDepthPitch);
+}
+
+// The widescreen fix (HOOK_ORDER_VIEWPORT_FIX) has already adjusted vps
+void Hooked_RSSetViewports(const RSSetViewportsHook::Next &next,
+                           ID3D11DeviceContext *This, UINT count,
+                           D3D11_VIEWPORT *vps) {
+  if (!vps || count == 0) {
+    next(This, count, vps);
     return;
   }
 
+  // Check render target once per call: the shadowed state when it is for
+  // this context, otherwise the bound target
+  bool isUpscaledTarget = false;
+  SparseTarget *sparse = nullptr;
+  LONG_PTR shadow = g_renderTargetShadow;
+  if ((shadow & ~SHADOW_UPSCALED_BIT) == (LONG_PTR)This) {
+    isUpscaledTarget = (shadow & SHADOW_UPSCALED_BIT) != 0;
+    sparse = g_shadowSparseTarget;
+  } else {
+    ID3D11RenderTargetView *rtv = nullptr;
+    This->OMGetRenderTargets(1, &rtv, nullptr);
+    if (rtv) {
+      RenderTargetInfo info = GetRenderTargetInfo(rtv);
+      isUpscaledTarget = info.upscaled != 0;
+      sparse = info.sparse;
+      rtv->Release();
+    }
+  }
+
+  if (isUpscaledTarget)
+    UpscaleViewports(g_size, vps, count);
+
+  // Back the area draws can reach before they are issued
+  if (sparse && isUpscaledTarget)
+    TouchViewports(sparse, This, vps, count);
+
+  next(This, count, vps);
+}
+
+void Hooked_CopySubresourceRegion(const CopySubresourceRegionHook::Next &next,
+                                  ID3D11DeviceContext *This,
+                                  ID3D11Resource *pDstResource,
+                                  UINT DstSubresource, UINT DstX, UINT DstY,
+                                  UINT DstZ, ID3D11Resource *pSrcResource,
+                                  UINT SrcSubresource,
+                                  const D3D11_BOX *pSrcBox) {
   D3D11_BOX newBox = {};
   const D3D11_BOX *pActualSrcBox = pSrcBox;
   UINT ActualDstX = DstX;
   UINT ActualDstY = DstY;
 
   if (pSrcResource && pDstResource) {
-    ID3D11Texture2D *pSrcTex = nullptr;
-    ID3D11Texture2D *pDstTex = nullptr;
-
-    pSrcResource->QueryInterface(__uuidof(ID3D11Texture2D), (void **)&pSrcTex);
-    pDstResource->QueryInterface(__uuidof(ID3D11Texture2D), (void **)&pDstTex);
-
-    if (pSrcTex && pDstTex) {
-      D3D11_TEXTURE2D_DESC srcDesc = {};
-      D3D11_TEXTURE2D_DESC dstDesc = {};
-      pSrcTex->GetDesc(&srcDesc);
-      pDstTex->GetDesc(&dstDesc);
-
-      if (srcDesc.Width == (UINT)g_NewWidth &&
-          srcDesc.Height == (UINT)g_NewHeight && pSrcBox &&
-          dstDesc.Width == (UINT)g_NewWidth &&
-          dstDesc.Height == (UINT)g_NewHeight) {
-
-        newBox = *pSrcBox;
-
-        float HalfWidth = g_NewWidth / 2.0f;
-        float HalfHeight = g_NewHeight / 2.0f;
-
-        float left_ndc =
-            2.0f *
-                (static_cast<float>(std::clamp((UINT)newBox.left, 0U, 4096U)) /
-                 4096.0f) -
-            1.0f;
-        float top_ndc =
-            2.0f *
-                (static_cast<float>(std::clamp((UINT)newBox.top, 0U, 2048U)) /
-                 2048.0f) -
-            1.0f;
-        float right_ndc =
-            2.0f *
-                (static_cast<float>(std::clamp((UINT)newBox.right, 0U, 4096U)) /
-                 4096.0f) -
-            1.0f;
-        float bottom_ndc = 2.0f * (static_cast<float>(std::clamp(
-                                       (UINT)newBox.bottom, 0U, 2048U)) /
-                                   2048.0f) -
-                           1.0f;
-
-        newBox.left =
-            static_cast<UINT>(std::max(0.0f, left_ndc * HalfWidth + HalfWidth));
-        newBox.top = static_cast<UINT>(
-            std::max(0.0f, top_ndc * HalfHeight + HalfHeight));
-        newBox.right = static_cast<UINT>(
-            std::max(0.0f, right_ndc * HalfWidth + HalfWidth));
-        newBox.bottom = static_cast<UINT>(
-            std::max(0.0f, bottom_ndc * HalfHeight + HalfHeight));
-
-        ActualDstX = DstX * (UINT)g_ResMultiplier;
-        ActualDstY = DstY * (UINT)g_ResMultiplier;
-
-        pActualSrcBox = &newBox;
-      } else if (pSrcBox && (pSrcBox->right > srcDesc.Width ||
-                             pSrcBox->bottom > srcDesc.Height)) {
-        newBox = *pSrcBox;
-        newBox.right = std::min(srcDesc.Width, newBox.right);
-        newBox.bottom = std::min(srcDesc.Height, newBox.bottom);
+    // Descriptors come from the resource table, so a steady-state copy
+    // makes no COM calls of its own
+    D3D11_TEXTURE2D_DESC srcDesc = {};
+    D3D11_TEXTURE2D_DESC dstDesc = {};
+
+    if (GetTexture2DDesc(pSrcResource, &srcDesc) &&
+        GetTexture2DDesc(pDstResource, &dstDesc)) {
+      if (RewriteCopyRegion(g_size, srcDesc.Width, srcDesc.Height,
+                            dstDesc.Width, dstDesc.Height, pSrcBox,
+                            &ActualDstX, &ActualDstY, &newBox))
         pActualSrcBox = &newBox;
+
+      SparseTarget *sparse =
+          g_sparseEnabled ? FindSparseTarget(pDstResource) : nullptr;
+      if (sparse) {
+        // Without a box the whole source subresource is copied; mip 0's
+        // size bounds any of them
+        UINT copyWidth = srcDesc.Width;
+        UINT copyHeight = srcDesc.Height;
+        if (pActualSrcBox) {
+          copyWidth = pActualSrcBox->right - pActualSrcBox->left;
+          copyHeight = pActualSrcBox->bottom - pActualSrcBox->top;
+        }
+        TouchSparseRect(sparse, This, ActualDstX, ActualDstY,
+                        ActualDstX + copyWidth, ActualDstY + copyHeight);
       }
     }
-
-    if (pSrcTex)
-      pSrcTex->Release();
-    if (pDstTex)
-      pDstTex->Release();
   }
 
-  pOriginal(This, pDstResource, DstSubresource, ActualDstX, ActualDstY, DstZ,
-            pSrcResource, SrcSubresource, pActualSrcBox, bWrapped);
+  next(This, pDstResource, DstSubresource, ActualDstX, ActualDstY, DstZ,
+       pSrcResource, SrcSubresource, pActualSrcBox);
 }
 
 // Re-entrancy guard: internal CreateTexture2D calls (replacement loading,
 // staging texture creation) must bypass the hook to avoid recursive processing
 static thread_local bool g_inCreateTexture2D = false;
 
-HRESULT STDMETHODCALLTYPE Hooked_CreateTexture2D(
-    ID3D11Device *This, const D3D11_TEXTURE2D_DESC *pDesc,
-    const D3D11_SUBRESOURCE_DATA *pInitialData, ID3D11Texture2D **ppTexture2D) {
-  MemoryBarrier();
-  CreateTexture2D_t pOriginal = Original_CreateTexture2D;
+// Installed with upscale_sparse only: a whole-resource copy into a sparse
+// target needs the tiles the source has content in
+void Hooked_CopyResource(const CopyResourceHook::Next &next,
+                         ID3D11DeviceContext *This,
+                         ID3D11Resource *pDstResource,
+                         ID3D11Resource *pSrcResource) {
+  if (pDstResource && pSrcResource) {
+    SparseTarget *dst = FindSparseTarget(pDstResource);
+    if (dst)
+      TouchSparseCopy(dst, FindSparseTarget(pSrcResource), This);
+  }
+  next(This, pDstResource, pSrcResource);
+}
 
-  if (!pOriginal)
-    return E_FAIL;
-  if (!g_createTextureHookReady || g_inCreateTexture2D)
-    return pOriginal(This, pDesc, pInitialData, ppTexture2D);
+HRESULT Hooked_CreateTexture2D(const CreateTexture2DHook::Next &next,
+                               ID3D11Device *This,
+                               const D3D11_TEXTURE2D_DESC *pDesc,
+                               const D3D11_SUBRESOURCE_DATA *pInitialData,
+                               ID3D11Texture2D **ppTexture2D) {
+  if (g_inCreateTexture2D)
+    return next(This, pDesc, pInitialData, ppTexture2D);
 
   g_inCreateTexture2D = true;
 
   HRESULT hr;
-  bool isUpscaleTarget = pDesc && pDesc->Width == (UINT)BaseWidth &&
-                         pDesc->Height == (UINT)BaseHeight &&
-                         (pDesc->BindFlags & D3D11_BIND_RENDER_TARGET) &&
-                         IsColorFormat(pDesc->Format) && !pInitialData;
+  bool isUpscaleTarget =
+      pDesc &&
+      IsUpscaleTarget(pDesc->Width, pDesc->Height,
+                      (pDesc->BindFlags & D3D11_BIND_RENDER_TARGET) != 0,
+                      pDesc->Format, pInitialData != nullptr);
 
   if (isUpscaleTarget) {
     // Render target at base resolution: upscale it. No replacement for RTs
     // (they are blank framebuffers at creation time).
     D3D11_TEXTURE2D_DESC newDesc = *pDesc;
-    newDesc.Width = (UINT)g_NewWidth;
-    newDesc.Height = (UINT)g_NewHeight;
-    hr = pOriginal(This, &newDesc, pInitialData, ppTexture2D);
+    newDesc.Width = (UINT)g_size.width;
+    newDesc.Height = (UINT)g_size.height;
+    if (ppTexture2D && g_sparseEnabled &&
+        CreateSparseTarget(This, newDesc, ppTexture2D))
+      hr = S_OK;
+    else
+      hr = next(This, &newDesc, pInitialData, ppTexture2D);
     // Don't dump upscaled RTs - they have no content yet
+    if (SUCCEEDED(hr) && ppTexture2D)
+      TrackTexture2D(*ppTexture2D);
   } else {
     // Non-render-target: try replacement first, then original creation
     if (pDesc && ppTexture2D &&
         TryLoadReplacementTexture(This, pDesc, pInitialData, ppTexture2D)) {
+      TrackTexture2D(*ppTexture2D);
       g_inCreateTexture2D = false;
       return S_OK;
     }
 
-    hr = pOriginal(This, pDesc, pInitialData, ppTexture2D);
+    hr = next(This, pDesc, pInitialData, ppTexture2D);
     // No dump here: this hook is only active when upscale is enabled, and
     // dumping is suppressed when upscale or replacement is active.
+    if (SUCCEEDED(hr) && ppTexture2D)
+      TrackTexture2D(*ppTexture2D);
   }
 
   g_inCreateTexture2D = false;
@@ -307,28 +470,30 @@ void RunFirstTimeSetup() {
   std::cout << "  2 - 2x - Fastest, lower quality" << std::endl;
   std::cout << "  3 - 3x - Balanced" << std::endl;
   std::cout << "  4 - 4x - Best quality, most demanding" << std::endl;
+  std::cout << "  (fractional scales such as 1.5 or 2.5 also work)"
+            << std::endl;
   std::cout << std::endl;
   std::cout << "You can change this later in settings.ini" << std::endl;
   std::cout << std::endl;
-  std::cout << "Enter scale (1/2/3/4) [Enter = off]: ";
+  std::cout << "Enter scale (1-4) [Enter = off]: ";
 
   std::string line;
   std::getline(std::cin, line);
-  int scaleChoice = 0;
+  float scaleChoice = 0.0f;
   if (!line.empty()) {
     std::istringstream iss(line);
     iss >> scaleChoice;
   }
-  int scale;
-  if (scaleChoice >= 1 && scaleChoice <= 4) {
+  float scale;
+  if (scaleChoice >= 1.0f && scaleChoice <= UPSCALE_MAX_SCALE) {
     scale = scaleChoice;
   } else {
     if (!line.empty())
       std::cout << "Invalid choice, using 1 (off)" << std::endl;
-    scale = 1;
+    scale = 1.0f;
   }
 
-  settings.UpdateFile(settingsPath, "upscale_scale", std::to_string(scale));
+  settings.UpdateFile(settingsPath, "upscale_scale", FormatScale(scale));
   settings.UpdateFile(settingsPath, "upscale_setup_completed", "1");
 
   std::cout << std::endl;
@@ -361,40 +526,68 @@ void ApplyUpscale4KPatch(ID3D11Device *pDevice, ID3D11DeviceContext *pContext) {
     if (settings.GetBool("texture_dump_enabled", false))
       return;
 
-    int scale = settings.GetInt("upscale_scale", 1);
-
-    if (scale < 1)
-      scale = 1;
-    if (scale > 4)
-      scale = 4;
-
-    if (scale == 1)
-      return;
-
-    g_ResMultiplier = static_cast<float>(scale);
-    g_NewWidth = BaseWidth * g_ResMultiplier;
-    g_NewHeight = BaseHeight * g_ResMultiplier;
-
-    void **contextVtable = *(void ***)pContext;
-    void **deviceVtable = *(void ***)pDevice;
+    float scale =
+        std::clamp(settings.GetFloat("upscale_scale", 1.0f), 1.0f,
+                   UPSCALE_MAX_SCALE);
+
+    // Measured even when off, so the dynamic scale can turn upscaling on
+    if (settings.GetBool("upscale_dynamic", false)) {
+      g_dynamic.current = scale;
+      g_dynamic.minScale =
+          std::clamp(settings.GetFloat("upscale_dynamic_min", 1.0f), 1.0f,
+                     UPSCALE_MAX_SCALE);
+      g_dynamic.maxScale = std::clamp(
+          settings.GetFloat("upscale_dynamic_max", UPSCALE_MAX_SCALE),
+          g_dynamic.minScale, UPSCALE_MAX_SCALE);
+      g_dynamic.targetMs =
+          std::max(1.0f, settings.GetFloat("upscale_dynamic_target_ms", 10.0f));
+      g_dynamic.saved = scale;
+      g_dynamic.proposed = scale;
+      AddGpuFrameTimeCallback(pDevice, pContext, OnGpuFrameTime);
+    }
 
-    if (!contextVtable || !deviceVtable)
+    g_size = GetUpscaleSize(scale);
+    if (g_size.width <= UPSCALE_BASE_WIDTH)
       return;
 
-    InstallVtableHook(contextVtable, 50, 44, (void *)Hooked_RSSetViewports,
-                      (volatile void **)&Original_RSSetViewports,
-                      &g_viewportsHookReady);
-
-    InstallVtableHook(
-        contextVtable, 50, 46, (void *)Hooked_CopySubresourceRegion,
-        (volatile void **)&Original_CopySubresourceRegion, &g_copyHookReady);
+    if (settings.GetBool("upscale_sparse", false)) {
+      g_sparseEnabled = InitSparseTargets(pDevice, pContext);
+      if (!g_sparseEnabled)
+        std::cout << "[Mod] Sparse upscale needs tiled resources tier 2, "
+                     "using full-size render targets"
+                  << std::endl;
+    }
 
-    InstallVtableHook(deviceVtable, 10, 5, (void *)Hooked_CreateTexture2D,
-                      (volatile void **)&Original_CreateTexture2D,
-                      &g_createTextureHookReady);
+    RSSetViewportsHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                 Hooked_RSSetViewports);
+    CopySubresourceRegionHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                        Hooked_CopySubresourceRegion);
+    // Render target shadow for the viewport hook
+    OMSetRenderTargetsHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                     Hooked_OMSetRenderTargets);
+    OMSetRenderTargetsAndUAVsHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                            Hooked_OMSetRenderTargetsAndUAVs);
+    // Only sparse targets need CopyResource and the other writes
+    if (g_sparseEnabled) {
+      CopyResourceHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                 Hooked_CopyResource);
+      UpdateSubresourceHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                      Hooked_UpdateSubresource);
+      ClearRenderTargetViewHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                          Hooked_ClearRenderTargetView);
+      ClearUnorderedAccessViewUintHook::Register(
+          pContext, HOOK_ORDER_UPSCALE, Hooked_ClearUnorderedAccessViewUint);
+      ClearUnorderedAccessViewFloatHook::Register(
+          pContext, HOOK_ORDER_UPSCALE, Hooked_ClearUnorderedAccessViewFloat);
+      CSSetUnorderedAccessViewsHook::Register(pContext, HOOK_ORDER_UPSCALE,
+                                              Hooked_CSSetUnorderedAccessViews);
+    }
+    CreateTexture2DHook::Register(pDevice, HOOK_ORDER_UPSCALE,
+                                  Hooked_CreateTexture2D);
 
     g_upscaleActive = true;
-    std::cout << "[Mod] " << scale << "x Upscale enabled" << std::endl;
+    std::cout << "[Mod] " << scale << "x Upscale enabled (" << g_size.width
+              << "x" << g_size.height << ")" << std::endl;
 
     Sleep(1);
   } catch (...) {
@@ -402,5 +595,5 @@ void ApplyUpscale4KPatch(ID3D11Device *pDevice, ID3D11DeviceContext *pContext) {
 }
 
 bool IsUpscaleActive() { return g_upscaleActive; }
-float GetUpscaledWidth() { return g_NewWidth; }
-float GetUpscaledHeight() { return g_NewHeight; }
+float GetUpscaledWidth() { return g_size.width; }
+float GetUpscaledHeight() { return g_size.height; }
@@ -0,0 +1,28 @@
+#include "upscale_rewrite.h"
+#include <cmath>
+
+UpscaleSize GetUpscaleSize(float scale) {
+  scale = std::clamp(scale, 1.0f, UPSCALE_MAX_SCALE);
+  UpscaleSize size;
+  size.width = std::round(UPSCALE_BASE_WIDTH * scale);
+  size.height = std::round(UPSCALE_BASE_HEIGHT * scale);
+  size.scaleX = size.width / UPSCALE_BASE_WIDTH;
+  size.scaleY = size.height / UPSCALE_BASE_HEIGHT;
+  return size;
+}
+
+bool IsUpscaleColorFormat(DXGI_FORMAT format) {
+  return format == DXGI_FORMAT_R8G8B8A8_UNORM ||
+         format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB ||
+         format == DXGI_FORMAT_B8G8R8A8_UNORM ||
+         format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+         format == DXGI_FORMAT_R16G16B16A16_FLOAT ||
+         format == DXGI_FORMAT_R32G32B32A32_FLOAT;
+}
+
+bool IsUpscaleTarget(uint32_t width, uint32_t height, bool renderTarget,
+                     DXGI_FORMAT format, bool hasInitialData) {
+  return width == (uint32_t)UPSCALE_BASE_WIDTH &&
+         height == (uint32_t)UPSCALE_BASE_HEIGHT && renderTarget &&
+         IsUpscaleColorFormat(format) && !hasInitialData;
+}
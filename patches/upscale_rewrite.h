@@ -0,0 +1,116 @@
+// Upscale Rewrite - coordinate math of the render target upscale
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <dxgiformat.h>
+
+// The upscale hooks (upscale4k.cpp) rewrite the game's calls with these, and
+// the trace replayer (tests/trace_replay.cpp) runs the same rewrites off
+// Windows, so nothing here may depend on Win32 or D3D11 beyond the format
+// enum. Viewports and boxes are any type with the fields of D3D11_VIEWPORT
+// and D3D11_BOX.
+
+// The game's render target size
+constexpr float UPSCALE_BASE_WIDTH = 4096.0f;
+constexpr float UPSCALE_BASE_HEIGHT = 2048.0f;
+
+// Largest scale that keeps the width within D3D11's 16384 texture limit
+constexpr float UPSCALE_MAX_SCALE = 4.0f;
+
+// Viewport coordinates D3D11 accepts
+constexpr float UPSCALE_MAX_VIEWPORT = 32767.0f;
+
+// Upscaled render target size and its ratio to the base size per axis.
+// Fractional scales round the size to whole pixels, so the two ratios can
+// differ slightly from the configured scale (and each other).
+struct UpscaleSize {
+  float width;
+  float height;
+  float scaleX;
+  float scaleY;
+};
+
+// Size for a scale, which is clamped to 1-UPSCALE_MAX_SCALE. Upscaling is
+// off when the width comes out no larger than the base width.
+UpscaleSize GetUpscaleSize(float scale);
+
+// Render target formats that are upscaled
+bool IsUpscaleColorFormat(DXGI_FORMAT format);
+
+// A texture the game creates with these properties is created at the
+// upscaled size instead
+bool IsUpscaleTarget(uint32_t width, uint32_t height, bool renderTarget,
+                     DXGI_FORMAT format, bool hasInitialData);
+
+inline bool IsUpscaledSize(const UpscaleSize &size, uint32_t width,
+                           uint32_t height) {
+  return width == (uint32_t)size.width && height == (uint32_t)size.height;
+}
+
+// Base render target coordinate -> upscaled, rounded to the nearest pixel so
+// adjacent boxes stay adjacent at fractional scales
+inline uint32_t ScaleCoord(uint32_t value, float base, float scale) {
+  return static_cast<uint32_t>((std::min)(static_cast<float>(value), base) *
+                                   scale +
+                               0.5f);
+}
+
+// Viewports for an upscaled render target, from base coordinates to
+// upscaled ones (through NDC, as SpecialK does)
+template <typename Viewport>
+void UpscaleViewports(const UpscaleSize &size, Viewport *vps, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    float left_ndc = 2.0f * (vps[i].TopLeftX / UPSCALE_BASE_WIDTH) - 1.0f;
+    float top_ndc = 2.0f * (vps[i].TopLeftY / UPSCALE_BASE_HEIGHT) - 1.0f;
+
+    vps[i].TopLeftX = (left_ndc * size.width + size.width) / 2.0f;
+    vps[i].TopLeftY = (top_ndc * size.height + size.height) / 2.0f;
+    vps[i].Width *= size.scaleX;
+    vps[i].Height *= size.scaleY;
+
+    vps[i].TopLeftX = (std::min)(vps[i].TopLeftX, UPSCALE_MAX_VIEWPORT);
+    vps[i].TopLeftY = (std::min)(vps[i].TopLeftY, UPSCALE_MAX_VIEWPORT);
+    vps[i].Width = (std::min)(vps[i].Width, UPSCALE_MAX_VIEWPORT);
+    vps[i].Height = (std::min)(vps[i].Height, UPSCALE_MAX_VIEWPORT);
+  }
+}
+
+// CopySubresourceRegion between textures of the given sizes. A box copied
+// between two upscaled targets is in the game's base coordinates, so it and
+// the destination point are scaled; any other box reaching past the source
+// is clipped to it. Returns true with the box to pass on in *outBox when it
+// changes; *dstX and *dstY are updated in place.
+template <typename Box>
+bool RewriteCopyRegion(const UpscaleSize &size, uint32_t srcWidth,
+                       uint32_t srcHeight, uint32_t dstWidth,
+                       uint32_t dstHeight, const Box *srcBox, uint32_t *dstX,
+                       uint32_t *dstY, Box *outBox) {
+  if (!srcBox)
+    return false;
+  if (IsUpscaledSize(size, srcWidth, srcHeight) &&
+      IsUpscaledSize(size, dstWidth, dstHeight)) {
+    *outBox = *srcBox;
+    outBox->left = ScaleCoord(srcBox->left, UPSCALE_BASE_WIDTH, size.scaleX);
+    outBox->top = ScaleCoord(srcBox->top, UPSCALE_BASE_HEIGHT, size.scaleY);
+    outBox->right = ScaleCoord(srcBox->right, UPSCALE_BASE_WIDTH, size.scaleX);
+    outBox->bottom =
+        ScaleCoord(srcBox->bottom, UPSCALE_BASE_HEIGHT, size.scaleY);
+
+    *dstX = static_cast<uint32_t>(*dstX * size.scaleX + 0.5f);
+    *dstY = static_cast<uint32_t>(*dstY * size.scaleY + 0.5f);
+
+    // Rounding can push a box flush with the edge one pixel past it
+    if (*dstX < dstWidth && outBox->right - outBox->left > dstWidth - *dstX)
+      outBox->right = outBox->left + (dstWidth - *dstX);
+    if (*dstY < dstHeight && outBox->bottom - outBox->top > dstHeight - *dstY)
+      outBox->bottom = outBox->top + (dstHeight - *dstY);
+    return true;
+  }
+  if (srcBox->right > srcWidth || srcBox->bottom > srcHeight) {
+    *outBox = *srcBox;
+    outBox->right = (std::min)(srcWidth, outBox->right);
+    outBox->bottom = (std::min)(srcHeight, outBox->bottom);
+    return true;
+  }
+  return false;
+}
@@ -2,51 +2,38 @@
 
 #define NOMINMAX
 #include "viewportwidescreenfix.h"
-#include "../utils/memory.h"
+#include "../utils/hook_registry.h"
 #include "../utils/viewport_utils.h"
 #include "widescreen.h"
 #include <Windows.h>
+#include <iostream>
+#include <string>
 
 namespace {
-typedef void(STDMETHODCALLTYPE *RSSetViewports_t)(ID3D11DeviceContext *, UINT,
-                                                  const D3D11_VIEWPORT *);
-
-volatile RSSetViewports_t Original_RSSetViewports_ViewportWidescreenFix =
-    nullptr;
-volatile LONG g_viewportWidescreenFixHookReady = 0;
-} // namespace
-
-void STDMETHODCALLTYPE Hooked_RSSetViewports_ViewportWidescreenFix(
-    ID3D11DeviceContext *This, UINT NumViewports,
-    const D3D11_VIEWPORT *pViewports) {
-  MemoryBarrier();
-  RSSetViewports_t pOriginal = Original_RSSetViewports_ViewportWidescreenFix;
-
-  if (!pOriginal)
-    return;
-  if (!pViewports || NumViewports == 0 || !g_viewportWidescreenFixHookReady) {
-    pOriginal(This, NumViewports, pViewports);
-    return;
-  }
-
-  // Allocate a small buffer on stack for modified viewports
-  D3D11_VIEWPORT vps[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-  UINT count = ViewportUtils::CopyViewportsToBuffer(
-      vps, D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE, pViewports,
-      NumViewports);
-
-  float ratio = GetCurrentWidescreenRatio();
+// Runs before the upscale handler, so rules match the game's own
+// coordinates whether or not the target is upscaled
+void Hooked_RSSetViewports(const RSSetViewportsHook::Next &next,
+                           ID3D11DeviceContext *This, UINT NumViewports,
+                           D3D11_VIEWPORT *pViewports) {
+  // Only changes anything in widescreen mode
+  ViewportUtils::ApplyViewportWidescreenFix(pViewports, NumViewports,
+                                            GetCurrentWidescreenRatio());
+
+  next(This, NumViewports, pViewports);
+}
 
-  // Only apply the fix if we're actually in widescreen mode
-  // Use tolerance to account for floating-point precision
-  // Ratio should be < 1.0 for widescreen (e.g., 0.75 for 16:9)
-  const float WIDESCREEN_THRESHOLD = 0.99f;
-  if (ratio < WIDESCREEN_THRESHOLD) {
-    ViewportUtils::ApplyViewportWidescreenFix(vps, count, ratio);
+std::string GetRulesPath() {
+  char exePath[MAX_PATH];
+  if (GetModuleFileNameA(NULL, exePath, MAX_PATH) != 0) {
+    std::string exePathStr(exePath);
+    size_t lastBackslash = exePathStr.find_last_of("\\/");
+    if (lastBackslash != std::string::npos)
+      return exePathStr.substr(0, lastBackslash + 1) +
+             "mods\\viewport_rules.txt";
   }
-
-  pOriginal(This, count, vps);
+  return "mods\\viewport_rules.txt";
 }
+} // namespace
 
 void ApplyViewportWidescreenFixPatch(ID3D11Device *pDevice,
                                     ID3D11DeviceContext *pContext) {
@@ -57,13 +44,13 @@ void ApplyViewportWidescreenFixPatch(ID3D11Device *pDevice,
   if (InterlockedCompareExchange(&applied, 1, 0) != 0)
     return;
 
-  void **contextVtable = *(void ***)pContext;
-  if (!contextVtable)
-    return;
+  std::string rulesPath = GetRulesPath();
+  size_t loaded = ViewportUtils::LoadViewportRules(rulesPath);
+  if (loaded > 0)
+    std::cout << "[Mod] Viewport fix: loaded " << loaded
+              << " viewport rules from " << rulesPath << std::endl;
 
-  InstallVtableHook(contextVtable, 50, 44,
-                    (void *)Hooked_RSSetViewports_ViewportWidescreenFix,
-                    (volatile void **)&Original_RSSetViewports_ViewportWidescreenFix,
-                    &g_viewportWidescreenFixHookReady);
+  RSSetViewportsHook::Register(pContext, HOOK_ORDER_VIEWPORT_FIX,
+                               Hooked_RSSetViewports);
   Sleep(1);
 }
@@ -20,6 +20,7 @@
 #include "../data/roomData.h"
 #include "../utils/memory.h"
 #include "battleuimenu.h"
+#include "room_preload.h"
 #include <cmath>
 
 // Global variables
@@ -135,6 +136,9 @@ extern "C" const ViewportRect *__cdecl GetRoomDataFromPath(const char *path) {
   }
   roomName[len] = '\0';
 
+  // Start loading the room's learned texture replacements
+  NotifyRoomLoaded(roomName);
+
   // Look up room data
   std::string roomNameStr(roomName);
   return RoomData::get(roomNameStr);
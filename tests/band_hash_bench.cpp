@@ -0,0 +1,86 @@
+// Band hash benchmark: HashBuffer (patches/band_hash.cpp), the hash of
+// replacement files and pack payloads, over 1-64 MB of random bytes with the
+// worker pool (utils/worker_pool.cpp) limited to 0-3 workers. Bands are
+// hashed independently and folded in order, so every worker count must give
+// the same hash.
+//
+//   band_hash_bench [passes]
+#include "../patches/band_hash.h"
+#include "../utils/worker_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+const size_t SIZES_MB[] = {1, 4, 16, 64};
+constexpr UINT MAX_LIMIT = 3;
+constexpr uint64_t SEED = 0x43524F5353464958ULL;
+
+std::vector<uint8_t> MakeBuffer(size_t size) {
+  std::mt19937_64 rng(size);
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i + 8 <= size; i += 8) {
+    uint64_t value = rng();
+    for (int b = 0; b < 8; ++b)
+      data[i + b] = (uint8_t)(value >> (b * 8));
+  }
+  return data;
+}
+
+// Average milliseconds per hash
+double TimeMs(int passes, const std::vector<uint8_t> &data, uint64_t *hash) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < passes; ++i) {
+    if (!HashBuffer(data.data(), data.size(), SEED, hash))
+      *hash = 0;
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / passes;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int passes = argc > 1 ? atoi(argv[1]) : 5;
+  if (passes < 1)
+    passes = 1;
+
+  // Start the pool so its threads aren't timed
+  uint64_t warm = 0;
+  std::vector<uint8_t> small = MakeBuffer(1 << 20);
+  HashBuffer(small.data(), small.size(), SEED, &warm);
+  printf("%u worker thread(s) in the pool\n", GetWorkerCount());
+
+  printf("%-8s", "MB");
+  for (UINT limit = 0; limit <= MAX_LIMIT; ++limit)
+    printf(" %8u wk", limit);
+  printf("\n");
+
+  int mismatches = 0;
+  for (size_t mb : SIZES_MB) {
+    std::vector<uint8_t> data = MakeBuffer(mb << 20);
+    uint64_t expected = 0;
+    printf("%-8zu", mb);
+    for (UINT limit = 0; limit <= MAX_LIMIT; ++limit) {
+      SetWorkerLimit(limit);
+      uint64_t hash = 0;
+      double ms = TimeMs(passes, data, &hash);
+      printf(" %6.0f MB/s", ms > 0 ? mb * 1000.0 / ms : 0.0);
+      if (limit == 0)
+        expected = hash;
+      else if (hash != expected)
+        ++mismatches;
+    }
+    printf("\n");
+  }
+  SetWorkerLimit(MAX_LIMIT);
+
+  if (mismatches) {
+    printf("%d hash(es) changed with the worker count\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,159 @@
+// Just enough of Windows.h to build the hook registry, the worker pool and
+// their helpers on other hosts for the tests and benchmarks. Vtables there
+// are ordinary writable arrays, so page protection and instruction cache
+// calls succeed without doing anything. __try/__except are try/catch, which
+// a faulting read never reaches.
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+typedef int BOOL;
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef float FLOAT;
+typedef uint8_t BYTE;
+typedef int32_t HRESULT;
+typedef void *LPVOID;
+typedef void *HANDLE;
+typedef struct HWND__ *HWND;
+
+#define TRUE 1
+#define FALSE 0
+#define STDMETHODCALLTYPE
+#define WINAPI
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define PAGE_EXECUTE_READWRITE 0x40
+#define SUCCEEDED(hr) ((HRESULT)(hr) >= 0)
+#define FAILED(hr) ((HRESULT)(hr) < 0)
+
+struct IUnknown;
+
+inline BOOL VirtualProtect(LPVOID, size_t, DWORD newProtect,
+                           DWORD *oldProtect) {
+  *oldProtect = newProtect;
+  return TRUE;
+}
+inline HANDLE GetCurrentProcess() { return nullptr; }
+inline BOOL FlushInstructionCache(HANDLE, const void *, size_t) {
+  return TRUE;
+}
+
+inline void MemoryBarrier() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchange(volatile LONG *target, LONG value) {
+  return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+inline LONG InterlockedCompareExchange(volatile LONG *target, LONG value,
+                                       LONG comparand) {
+  __atomic_compare_exchange_n(target, &comparand, value, false,
+                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return comparand;
+}
+inline LONG InterlockedIncrement(volatile LONG *target) {
+  return __atomic_add_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+inline LONG InterlockedDecrement(volatile LONG *target) {
+  return __atomic_sub_fetch(target, 1, __ATOMIC_SEQ_CST);
+}
+
+struct CRITICAL_SECTION {
+  std::recursive_mutex mutex;
+};
+inline void InitializeCriticalSection(CRITICAL_SECTION *) {}
+inline void EnterCriticalSection(CRITICAL_SECTION *cs) { cs->mutex.lock(); }
+inline void LeaveCriticalSection(CRITICAL_SECTION *cs) { cs->mutex.unlock(); }
+inline BOOL TryEnterCriticalSection(CRITICAL_SECTION *cs) {
+  return cs->mutex.try_lock() ? TRUE : FALSE;
+}
+
+// Matches libstdc++'s own __try
+#define EXCEPTION_EXECUTE_HANDLER 1
+#define __try try
+#define __except(filter) catch (...)
+
+struct SYSTEM_INFO {
+  DWORD dwNumberOfProcessors;
+};
+// At least 4, so the worker pool starts all its threads and the thread
+// count checks run threads even on a single core (without the speedup)
+inline void GetSystemInfo(SYSTEM_INFO *si) {
+  si->dwNumberOfProcessors = std::thread::hardware_concurrency();
+  if (si->dwNumberOfProcessors < 4)
+    si->dwNumberOfProcessors = 4;
+}
+
+// Semaphores, events and threads are all this one kind of handle. A thread's
+// is never signaled; nothing here waits on one.
+struct CompatHandle {
+  std::mutex mutex;
+  std::condition_variable signaled;
+  LONG count = 0; // Semaphore count, or 1 while an event is set
+  LONG maximum = 1;
+  bool manualReset = false;
+};
+
+inline HANDLE CreateSemaphoreA(void *, LONG initial, LONG maximum,
+                               const char *) {
+  CompatHandle *h = new CompatHandle();
+  h->count = initial;
+  h->maximum = maximum;
+  return h;
+}
+inline BOOL ReleaseSemaphore(HANDLE handle, LONG release, LONG *previous) {
+  CompatHandle *h = static_cast<CompatHandle *>(handle);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  if (previous)
+    *previous = h->count;
+  if (release <= 0 || h->count + release > h->maximum)
+    return FALSE;
+  h->count += release;
+  h->signaled.notify_all();
+  return TRUE;
+}
+
+inline HANDLE CreateEventA(void *, BOOL manualReset, BOOL initialState,
+                           const char *) {
+  CompatHandle *h = new CompatHandle();
+  h->count = initialState ? 1 : 0;
+  h->manualReset = manualReset != FALSE;
+  return h;
+}
+inline BOOL SetEvent(HANDLE handle) {
+  CompatHandle *h = static_cast<CompatHandle *>(handle);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  h->count = 1;
+  h->signaled.notify_all();
+  return TRUE;
+}
+inline BOOL ResetEvent(HANDLE handle) {
+  CompatHandle *h = static_cast<CompatHandle *>(handle);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  h->count = 0;
+  return TRUE;
+}
+
+// INFINITE only
+inline DWORD WaitForSingleObject(HANDLE handle, DWORD) {
+  CompatHandle *h = static_cast<CompatHandle *>(handle);
+  std::unique_lock<std::mutex> lock(h->mutex);
+  h->signaled.wait(lock, [h] { return h->count > 0; });
+  if (!h->manualReset)
+    h->count--;
+  return WAIT_OBJECT_0;
+}
+
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+inline HANDLE CreateThread(void *, size_t, LPTHREAD_START_ROUTINE start,
+                           LPVOID parameter, DWORD, DWORD *) {
+  std::thread(start, parameter).detach();
+  return new CompatHandle();
+}
+inline BOOL CloseHandle(HANDLE handle) {
+  delete static_cast<CompatHandle *>(handle);
+  return TRUE;
+}
@@ -0,0 +1,48 @@
+// Declarations the hook registry's slot typedefs name, for building it on
+// other hosts (see Windows.h here). Interfaces are only ever pointers.
+#pragma once
+
+#include "dxgi1_2.h"
+
+#define D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE 16
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Resource;
+struct ID3D11Texture2D;
+struct ID3D11SamplerState;
+struct ID3D11ShaderResourceView;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+struct ID3D11UnorderedAccessView;
+
+struct D3D11_TEXTURE2D_DESC;
+struct D3D11_SUBRESOURCE_DATA;
+struct D3D11_SAMPLER_DESC;
+struct D3D11_MAPPED_SUBRESOURCE;
+
+enum D3D11_MAP {
+  D3D11_MAP_READ = 1,
+  D3D11_MAP_WRITE = 2,
+  D3D11_MAP_READ_WRITE = 3,
+  D3D11_MAP_WRITE_DISCARD = 4,
+  D3D11_MAP_WRITE_NO_OVERWRITE = 5,
+};
+
+struct D3D11_VIEWPORT {
+  FLOAT TopLeftX;
+  FLOAT TopLeftY;
+  FLOAT Width;
+  FLOAT Height;
+  FLOAT MinDepth;
+  FLOAT MaxDepth;
+};
+
+struct D3D11_BOX {
+  UINT left;
+  UINT top;
+  UINT front;
+  UINT right;
+  UINT bottom;
+  UINT back;
+};
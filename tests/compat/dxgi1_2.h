@@ -0,0 +1,16 @@
+// DXGI declarations for the hook registry on other hosts (see Windows.h
+// here)
+#pragma once
+
+#include <Windows.h>
+#include <dxgiformat.h>
+
+struct IDXGIFactory;
+struct IDXGIFactory2;
+struct IDXGIOutput;
+struct IDXGISwapChain;
+struct IDXGISwapChain1;
+
+struct DXGI_SWAP_CHAIN_DESC;
+struct DXGI_SWAP_CHAIN_DESC1;
+struct DXGI_SWAP_CHAIN_FULLSCREEN_DESC;
@@ -0,0 +1,92 @@
+// Mip generator benchmark: full chains from GenerateMipChain
+// (patches/mip_generator.cpp) with the box and Kaiser filters, from 256x256
+// up to 4096x4096 RGBA8 tops, with the worker pool (utils/worker_pool.cpp)
+// limited to 0-3 workers. Every worker count must give the same levels.
+//
+//   mip_generator_bench [passes]
+#include "../patches/mip_generator.h"
+#include "../utils/worker_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+const UINT SIZES[] = {256, 1024, 4096};
+const MipFilter FILTERS[] = {MipFilter::Box, MipFilter::Kaiser};
+const char *const FILTER_NAMES[] = {"box", "kaiser"};
+constexpr UINT MAX_LIMIT = 3;
+constexpr UINT MAX_LEVELS = 15;
+
+// Mostly opaque with some transparent texels, as in UI and sprite art
+std::vector<uint8_t> MakeTexture(UINT size) {
+  std::mt19937 rng(size);
+  std::vector<uint8_t> data((size_t)size * size * 4);
+  for (size_t i = 0; i < data.size(); i += 4) {
+    uint32_t pixel = rng();
+    for (int b = 0; b < 3; ++b)
+      data[i + b] = (uint8_t)(pixel >> (b * 8));
+    data[i + 3] = (pixel >> 24) < 16 ? 0 : 255;
+  }
+  return data;
+}
+
+// Average milliseconds per chain
+double TimeMs(int passes, const std::vector<uint8_t> &top, UINT size,
+              MipFilter filter, std::vector<uint8_t> *levels) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < passes; ++i) {
+    levels->clear();
+    GenerateMipChain(top.data(), size, size, MAX_LEVELS, filter, levels);
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / passes;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int passes = argc > 1 ? atoi(argv[1]) : 5;
+  if (passes < 1)
+    passes = 1;
+
+  // Start the pool so its threads aren't timed
+  std::vector<uint8_t> warm = MakeTexture(256), levels;
+  GenerateMipChain(warm.data(), 256, 256, MAX_LEVELS, MipFilter::Box, &levels);
+  printf("%u worker thread(s) in the pool\n", GetWorkerCount());
+
+  printf("%-10s %-8s", "size", "filter");
+  for (UINT limit = 0; limit <= MAX_LIMIT; ++limit)
+    printf(" %8u wk", limit);
+  printf("\n");
+
+  int mismatches = 0;
+  for (UINT size : SIZES) {
+    std::vector<uint8_t> top = MakeTexture(size);
+    for (size_t f = 0; f < 2; ++f) {
+      char name[32];
+      snprintf(name, sizeof(name), "%ux%u", size, size);
+      printf("%-10s %-8s", name, FILTER_NAMES[f]);
+      std::vector<uint8_t> expected;
+      for (UINT limit = 0; limit <= MAX_LIMIT; ++limit) {
+        SetWorkerLimit(limit);
+        double ms = TimeMs(passes, top, size, FILTERS[f], &levels);
+        printf(" %8.2f ms", ms);
+        if (limit == 0)
+          expected = levels;
+        else if (levels != expected)
+          ++mismatches;
+      }
+      printf("\n");
+    }
+  }
+  SetWorkerLimit(MAX_LIMIT);
+
+  if (mismatches) {
+    printf("%d chain(s) changed with the worker count\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
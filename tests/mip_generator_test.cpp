@@ -0,0 +1,287 @@
+// Mip generator tests: GenerateMipChain (patches/mip_generator.cpp) with the
+// box and Kaiser filters. Covers level sizes for odd and 1-texel dimensions,
+// the box averages (odd sizes dropping the last row/column, 1-texel sides
+// reused), alpha-weighted colour where transparent texels meet opaque ones,
+// flat and gradient images through the Kaiser kernel, and the same result
+// from every worker count.
+//
+//   mip_generator_test
+#include "../patches/mip_generator.h"
+#include "../utils/worker_pool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+int g_failures = 0;
+
+#define CHECK(cond, what)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s (%s)\n", __FILE__, __LINE__, #cond,               \
+             std::string(what).c_str());                                       \
+      ++g_failures;                                                            \
+    }                                                                          \
+  } while (0)
+
+constexpr UINT MAX_LEVELS = 15;
+const MipFilter FILTERS[] = {MipFilter::Box, MipFilter::Kaiser};
+const char *const FILTER_NAMES[] = {"box", "kaiser"};
+
+struct Texel {
+  uint8_t r, g, b, a;
+};
+
+std::vector<uint8_t> MakeImage(UINT width, UINT height, Texel texel) {
+  std::vector<uint8_t> data((size_t)width * height * 4);
+  for (size_t i = 0; i < data.size(); i += 4) {
+    data[i] = texel.r;
+    data[i + 1] = texel.g;
+    data[i + 2] = texel.b;
+    data[i + 3] = texel.a;
+  }
+  return data;
+}
+
+void SetTexel(std::vector<uint8_t> *data, UINT width, UINT x, UINT y,
+              Texel texel) {
+  uint8_t *p = data->data() + ((size_t)y * width + x) * 4;
+  p[0] = texel.r;
+  p[1] = texel.g;
+  p[2] = texel.b;
+  p[3] = texel.a;
+}
+
+bool Near(int value, int expected, int tolerance) {
+  return abs(value - expected) <= tolerance;
+}
+
+bool TexelNear(const uint8_t *p, Texel expected, int tolerance) {
+  return Near(p[0], expected.r, tolerance) &&
+         Near(p[1], expected.g, tolerance) &&
+         Near(p[2], expected.b, tolerance) && Near(p[3], expected.a, tolerance);
+}
+
+std::string Case(const char *name, MipFilter filter, UINT width,
+                 UINT height) {
+  char text[128];
+  snprintf(text, sizeof(text), "%s %s %ux%u", name,
+           FILTER_NAMES[(int)filter], width, height);
+  return text;
+}
+
+// Levels halve each side (rounding down, never below 1) until 1x1, and only
+// the levels below the top one are appended
+void TestLevelSizes() {
+  struct Dims {
+    UINT width, height, levels;
+  };
+  const Dims DIMS[] = {{1, 1, 0},  {2, 1, 1},   {1, 8, 3},  {8, 1, 3},
+                       {5, 3, 2},  {7, 7, 2},   {3, 9, 3},  {33, 17, 5},
+                       {1, 257, 8}, {256, 256, 8}};
+  for (MipFilter filter : FILTERS) {
+    for (const Dims &d : DIMS) {
+      std::vector<uint8_t> top =
+          MakeImage(d.width, d.height, {10, 20, 30, 255});
+      std::vector<uint8_t> out(3, 0xCD); // Appended after existing bytes
+      UINT levels =
+          GenerateMipChain(top.data(), d.width, d.height, MAX_LEVELS, filter,
+                           &out);
+      std::string what = Case("sizes", filter, d.width, d.height);
+      CHECK(levels == d.levels, what);
+      size_t expected = 3;
+      for (UINT w = d.width, h = d.height; w > 1 || h > 1;) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+        expected += (size_t)w * h * 4;
+      }
+      CHECK(out.size() == expected, what);
+      CHECK(out[0] == 0xCD && out[2] == 0xCD, what);
+      // A flat image stays flat on every level
+      bool flat = true;
+      for (size_t i = 3; i < out.size(); i += 4)
+        flat = flat && TexelNear(&out[i], {10, 20, 30, 255}, 0);
+      CHECK(flat, what);
+    }
+
+    // maxLevels counts the top level
+    std::vector<uint8_t> top = MakeImage(64, 64, {0, 0, 0, 255});
+    std::vector<uint8_t> out;
+    CHECK(GenerateMipChain(top.data(), 64, 64, 3, filter, &out) == 2,
+          Case("maxLevels", filter, 64, 64));
+    CHECK(out.size() == (32 * 32 + 16 * 16) * 4,
+          Case("maxLevels", filter, 64, 64));
+  }
+}
+
+// Rounded 2x2 averages; odd sizes drop the last column/row and a 1-texel
+// side is used for both taps
+void TestBoxAverages() {
+  std::vector<uint8_t> top = MakeImage(3, 3, {0, 0, 0, 255});
+  SetTexel(&top, 3, 0, 0, {10, 0, 200, 255});
+  SetTexel(&top, 3, 1, 0, {20, 1, 100, 255});
+  SetTexel(&top, 3, 0, 1, {30, 0, 0, 255});
+  SetTexel(&top, 3, 1, 1, {41, 2, 50, 255});
+  SetTexel(&top, 3, 2, 0, {255, 255, 255, 255}); // Dropped column
+  SetTexel(&top, 3, 0, 2, {255, 255, 255, 255}); // Dropped row
+  std::vector<uint8_t> out;
+  CHECK(GenerateMipChain(top.data(), 3, 3, MAX_LEVELS, MipFilter::Box,
+                         &out) == 1,
+        "box 3x3");
+  CHECK(TexelNear(out.data(), {25, 1, 88, 255}, 0), "box 3x3");
+
+  // 1x2 and 2x1: the single column/row is averaged with itself
+  std::vector<uint8_t> column = MakeImage(1, 2, {0, 0, 0, 255});
+  SetTexel(&column, 1, 0, 0, {100, 0, 7, 255});
+  SetTexel(&column, 1, 0, 1, {201, 50, 8, 255});
+  out.clear();
+  GenerateMipChain(column.data(), 1, 2, MAX_LEVELS, MipFilter::Box, &out);
+  CHECK(out.size() == 4 && TexelNear(out.data(), {151, 25, 8, 255}, 0),
+        "box 1x2");
+  out.clear();
+  GenerateMipChain(column.data(), 2, 1, MAX_LEVELS, MipFilter::Box, &out);
+  CHECK(out.size() == 4 && TexelNear(out.data(), {151, 25, 8, 255}, 0),
+        "box 2x1");
+
+  // Long thin images through the SIMD path and its scalar tail
+  for (UINT width : {2u, 4u, 6u, 9u, 17u}) {
+    std::vector<uint8_t> strip = MakeImage(width, 1, {0, 0, 0, 255});
+    for (UINT x = 0; x < width; ++x)
+      SetTexel(&strip, width, x, 0, {(uint8_t)(x * 10), 0, 0, 255});
+    out.clear();
+    GenerateMipChain(strip.data(), width, 1, 2, MipFilter::Box, &out);
+    bool ok = out.size() == (size_t)(width / 2) * 4;
+    for (UINT x = 0; ok && x < width / 2; ++x)
+      ok = TexelNear(&out[x * 4], {(uint8_t)(x * 20 + 5), 0, 0, 255}, 0);
+    CHECK(ok, Case("box strip", MipFilter::Box, width, 1));
+  }
+}
+
+// One opaque texel among transparent black ones keeps its colour rather
+// than being darkened by theirs; a fully transparent area keeps the plain
+// average of its colour
+void TestAlphaWeighting() {
+  for (MipFilter filter : FILTERS) {
+    // Through the scalar quad and, at 4x2, the SIMD pair's fallback
+    for (UINT width : {2u, 4u}) {
+      std::vector<uint8_t> top = MakeImage(width, 2, {0, 0, 0, 0});
+      for (UINT x = 0; x < width; x += 2)
+        SetTexel(&top, width, x, 0, {255, 128, 0, 255});
+      std::vector<uint8_t> out;
+      GenerateMipChain(top.data(), width, 2, 2, filter, &out);
+      std::string what = Case("alpha", filter, width, 2);
+      CHECK(out.size() == (size_t)(width / 2) * 4, what);
+      int alphaSum = 0;
+      for (UINT x = 0; x < width / 2; ++x) {
+        CHECK(Near(out[x * 4], 255, 1) && Near(out[x * 4 + 1], 128, 1) &&
+                  out[x * 4 + 2] == 0,
+              what);
+        if (filter == MipFilter::Box)
+          CHECK(out[x * 4 + 3] == 64, what);
+        alphaSum += out[x * 4 + 3];
+      }
+      // A quarter coverage overall. The Kaiser taps reach past the pair and
+      // are clamped at the edges, so it moves between destination texels.
+      CHECK(Near(alphaSum / (int)(width / 2), 64, 1), what);
+    }
+
+    // Partial alpha: colour weighted 3:1 towards the more opaque texels
+    std::vector<uint8_t> top = MakeImage(2, 2, {0, 0, 0, 0});
+    SetTexel(&top, 2, 0, 0, {200, 0, 0, 192});
+    SetTexel(&top, 2, 1, 0, {200, 0, 0, 192});
+    SetTexel(&top, 2, 0, 1, {0, 0, 200, 64});
+    SetTexel(&top, 2, 1, 1, {0, 0, 200, 64});
+    std::vector<uint8_t> out;
+    GenerateMipChain(top.data(), 2, 2, 2, filter, &out);
+    CHECK(TexelNear(out.data(), {150, 0, 50, 128}, 1),
+          Case("partial alpha", filter, 2, 2));
+
+    // Fully transparent: no alpha to weight by
+    top = MakeImage(2, 2, {0, 0, 0, 0});
+    SetTexel(&top, 2, 0, 0, {40, 80, 120, 0});
+    SetTexel(&top, 2, 1, 1, {40, 80, 120, 0});
+    out.clear();
+    GenerateMipChain(top.data(), 2, 2, 2, filter, &out);
+    CHECK(TexelNear(out.data(), {20, 40, 60, 0}, 1),
+          Case("transparent", filter, 2, 2));
+
+    // 1-texel sides with mixed alpha
+    top = MakeImage(1, 2, {0, 0, 0, 0});
+    SetTexel(&top, 1, 0, 1, {0, 255, 0, 255});
+    out.clear();
+    GenerateMipChain(top.data(), 1, 2, 2, filter, &out);
+    CHECK(TexelNear(out.data(), {0, 255, 0, 128}, 1),
+          Case("alpha", filter, 1, 2));
+  }
+}
+
+// A symmetric, normalized kernel keeps a linear ramp exactly where no tap
+// is clamped, and the dimension it doesn't vary along untouched
+void TestKaiserGradient() {
+  const UINT width = 64, height = 5;
+  std::vector<uint8_t> top = MakeImage(width, height, {0, 0, 0, 255});
+  for (UINT y = 0; y < height; ++y)
+    for (UINT x = 0; x < width; ++x)
+      SetTexel(&top, width, x, y, {(uint8_t)(x * 4), 77, (uint8_t)y, 255});
+  std::vector<uint8_t> out;
+  GenerateMipChain(top.data(), width, height, 2, MipFilter::Kaiser, &out);
+  CHECK(out.size() == (size_t)(width / 2) * (height / 2) * 4,
+        "kaiser gradient");
+  for (UINT y = 0; y < height / 2; ++y) {
+    for (UINT x = 2; x + 2 < width / 2; ++x) {
+      const uint8_t *p = &out[((size_t)y * (width / 2) + x) * 4];
+      CHECK(Near(p[0], x * 8 + 2, 1) && p[1] == 77 && p[3] == 255,
+            Case("kaiser gradient", MipFilter::Kaiser, x, y));
+    }
+  }
+
+  // A hard edge stays in range (ringing is clamped)
+  std::vector<uint8_t> edge = MakeImage(16, 16, {0, 0, 0, 255});
+  for (UINT y = 0; y < 16; ++y)
+    for (UINT x = 8; x < 16; ++x)
+      SetTexel(&edge, 16, x, y, {255, 255, 255, 255});
+  out.clear();
+  GenerateMipChain(edge.data(), 16, 16, 2, MipFilter::Kaiser, &out);
+  CHECK(out[0] == 0 && out[7 * 4] == 255, "kaiser edge");
+}
+
+// Large levels are split across the pool; the split mustn't show
+void TestWorkerCounts() {
+  std::mt19937 rng(3);
+  const UINT width = 300, height = 517;
+  std::vector<uint8_t> top((size_t)width * height * 4);
+  for (uint8_t &b : top)
+    b = (uint8_t)rng();
+  for (MipFilter filter : FILTERS) {
+    std::vector<uint8_t> expected;
+    for (UINT limit = 0; limit <= 3; ++limit) {
+      SetWorkerLimit(limit);
+      std::vector<uint8_t> out;
+      GenerateMipChain(top.data(), width, height, MAX_LEVELS, filter, &out);
+      if (limit == 0)
+        expected = out;
+      else
+        CHECK(out == expected, Case("workers", filter, width, height));
+    }
+  }
+  SetWorkerLimit(3);
+}
+} // namespace
+
+int main() {
+  TestLevelSizes();
+  TestBoxAverages();
+  TestAlphaWeighting();
+  TestKaiserGradient();
+  TestWorkerCounts();
+
+  if (g_failures) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("All mip generator tests passed\n");
+  return 0;
+}
@@ -0,0 +1,157 @@
+// PNG decoder benchmark: decode time for typical replacement images with
+// the in-tree decoder and with the decoder it replaced (WIC on Windows,
+// libpng elsewhere when found), converting to 32bpp BGRA in both cases.
+//
+//   png_decoder_bench [iterations]
+#include "../utils/png_decoder.h"
+#include "png_encoder.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+using Microsoft::WRL::ComPtr;
+#elif defined(HAVE_LIBPNG)
+#include <png.h>
+#endif
+
+namespace {
+// Reference decoder, or false if none is built in
+bool DecodeReference(const std::vector<uint8_t> &file, uint32_t *width,
+                     uint32_t *height, std::vector<uint8_t> *pixels) {
+#ifdef _WIN32
+  static ComPtr<IWICImagingFactory> factory;
+  if (!factory) {
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr,
+                                CLSCTX_INPROC_SERVER,
+                                IID_PPV_ARGS(&factory))))
+      return false;
+  }
+  ComPtr<IWICStream> stream;
+  ComPtr<IWICBitmapDecoder> decoder;
+  ComPtr<IWICBitmapFrameDecode> frame;
+  ComPtr<IWICFormatConverter> converter;
+  if (FAILED(factory->CreateStream(&stream)) ||
+      FAILED(stream->InitializeFromMemory(const_cast<BYTE *>(file.data()),
+                                          (DWORD)file.size())) ||
+      FAILED(factory->CreateDecoderFromStream(
+          stream.Get(), nullptr, WICDecodeMetadataCacheOnLoad, &decoder)) ||
+      FAILED(decoder->GetFrame(0, &frame)) ||
+      FAILED(frame->GetSize(width, height)) ||
+      FAILED(factory->CreateFormatConverter(&converter)) ||
+      FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppBGRA,
+                                   WICBitmapDitherTypeNone, nullptr, 0.0,
+                                   WICBitmapPaletteTypeCustom)))
+    return false;
+  pixels->resize((size_t)*width * *height * 4);
+  return SUCCEEDED(converter->CopyPixels(nullptr, *width * 4,
+                                         (UINT)pixels->size(),
+                                         pixels->data()));
+#elif defined(HAVE_LIBPNG)
+  png_image image = {};
+  image.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_memory(&image, file.data(), file.size()))
+    return false;
+  image.format = PNG_FORMAT_BGRA;
+  pixels->resize(PNG_IMAGE_SIZE(image));
+  if (!png_image_finish_read(&image, nullptr, pixels->data(), 0, nullptr)) {
+    png_image_free(&image);
+    return false;
+  }
+  *width = image.width;
+  *height = image.height;
+  return true;
+#else
+  (void)file, (void)width, (void)height, (void)pixels;
+  return false;
+#endif
+}
+
+const char *ReferenceName() {
+#ifdef _WIN32
+  return "WIC";
+#elif defined(HAVE_LIBPNG)
+  return "libpng";
+#else
+  return nullptr;
+#endif
+}
+
+template <typename Decode>
+double TimeMs(int iterations, Decode decode) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    decode();
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 50;
+  if (iterations < 1)
+    iterations = 1;
+
+  // Sizes and formats replacement packs use: 4x upscaled sprite sheets and
+  // backgrounds, and small paletted UI pieces
+  const struct {
+    const char *name;
+    uint32_t width, height;
+    uint8_t colorType, bitDepth;
+  } CASES[] = {
+      {"RGBA8 1024x1024", 1024, 1024, 6, 8},
+      {"RGBA8 2048x2048", 2048, 2048, 6, 8},
+      {"RGB8 1280x960", 1280, 960, 2, 8},
+      {"palette8 512x512", 512, 512, 3, 8},
+      {"RGBA16 512x512", 512, 512, 6, 16},
+  };
+
+  TestRandom rng(42);
+  int failures = 0;
+  printf("%-18s %10s %10s %10s\n", "image", "in-tree ms",
+         ReferenceName() ? ReferenceName() : "(none)", "ratio");
+  for (const auto &c : CASES) {
+    PngSource src;
+    src.width = c.width;
+    src.height = c.height;
+    src.colorType = c.colorType;
+    src.bitDepth = c.bitDepth;
+    if (c.colorType == 3) {
+      for (int i = 0; i < 256 * 3; ++i)
+        src.palette.push_back((uint8_t)rng.Next());
+    }
+    FillSamples(&src, &rng);
+    std::vector<uint8_t> file = EncodePng(src);
+
+    uint32_t width, height;
+    std::vector<uint8_t> pixels;
+    if (!DecodePng(file.data(), file.size(), true, &width, &height,
+                   &pixels) ||
+        pixels != ExpectedPixels(src, true)) {
+      printf("%-18s decode FAILED\n", c.name);
+      ++failures;
+      continue;
+    }
+    double ours = TimeMs(iterations, [&] {
+      DecodePng(file.data(), file.size(), true, &width, &height, &pixels);
+    });
+
+    std::vector<uint8_t> refPixels;
+    if (ReferenceName() &&
+        DecodeReference(file, &width, &height, &refPixels)) {
+      double ref = TimeMs(iterations, [&] {
+        DecodeReference(file, &width, &height, &refPixels);
+      });
+      printf("%-18s %10.3f %10.3f %9.2fx\n", c.name, ours, ref, ref / ours);
+    } else {
+      printf("%-18s %10.3f %10s\n", c.name, ours, "-");
+    }
+  }
+  return failures ? 1 : 0;
+}
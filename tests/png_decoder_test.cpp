@@ -0,0 +1,296 @@
+// PNG decoder tests: every supported colour type and bit depth decoded
+// against pixels computed from the source samples, malformed files rejected,
+// and randomly mutated files decoded without faults (run under
+// CROSSFIX_SANITIZE for ASan/UBSan).
+//
+//   png_decoder_test [mutations]
+#include "../utils/png_decoder.h"
+#include "png_encoder.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+int g_failures = 0;
+
+#define CHECK(cond, what)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s (%s)\n", __FILE__, __LINE__, #cond,               \
+             std::string(what).c_str());                                       \
+      ++g_failures;                                                            \
+    }                                                                          \
+  } while (0)
+
+struct Format {
+  uint8_t colorType;
+  uint8_t bitDepth;
+};
+
+const Format FORMATS[] = {
+    {0, 1}, {0, 2}, {0, 4}, {0, 8}, {0, 16}, {2, 8},  {2, 16}, {3, 1},
+    {3, 2}, {3, 4}, {3, 8}, {4, 8}, {4, 16}, {6, 8},  {6, 16},
+};
+
+// Odd sizes cover partial bytes at the end of packed rows and the scalar
+// tails of the SSE2 paths
+const uint32_t SIZES[][2] = {{1, 1}, {7, 5}, {33, 17}, {64, 3}};
+
+PngSource MakeSource(const Format &format, uint32_t width, uint32_t height,
+                     TestRandom *rng) {
+  PngSource src;
+  src.width = width;
+  src.height = height;
+  src.colorType = format.colorType;
+  src.bitDepth = format.bitDepth;
+  if (src.colorType == 3) {
+    uint32_t entries = std::min(1u << src.bitDepth, 1u + rng->Below(256));
+    for (uint32_t i = 0; i < entries * 3; ++i)
+      src.palette.push_back((uint8_t)rng->Next());
+  }
+  FillSamples(&src, rng);
+  return src;
+}
+
+bool DecodeMatches(const PngSource &src, bool bgra, const std::string &what) {
+  std::vector<uint8_t> file = EncodePng(src);
+  uint32_t width = 0, height = 0;
+  std::vector<uint8_t> pixels;
+  bool ok = DecodePng(file.data(), file.size(), bgra, &width, &height,
+                      &pixels);
+  CHECK(ok, what);
+  if (!ok)
+    return false;
+  CHECK(width == src.width && height == src.height, what);
+  std::vector<uint8_t> expected = ExpectedPixels(src, bgra);
+  bool same = pixels == expected;
+  CHECK(same, what);
+  return same;
+}
+
+// Each format at several sizes, in both byte orders, with every filter
+int TestFormats() {
+  TestRandom rng(1);
+  int images = 0;
+  for (const Format &format : FORMATS) {
+    for (const auto &size : SIZES) {
+      PngSource src = MakeSource(format, size[0], size[1], &rng);
+      std::string what = DescribePng(src);
+      for (int filter = -1; filter <= 4; ++filter) {
+        src.filter = filter;
+        DecodeMatches(src, false, what + ", filter " + std::to_string(filter));
+      }
+      src.filter = -1;
+      DecodeMatches(src, true, what + ", BGRA");
+      ++images;
+    }
+  }
+  return images;
+}
+
+// Stored, fixed-Huffman, RLE and maximum-compression streams, and streams
+// split over many IDAT chunks
+void TestCompression() {
+  TestRandom rng(2);
+  const struct {
+    int level;
+    int strategy;
+    const char *name;
+  } MODES[] = {
+      {0, Z_DEFAULT_STRATEGY, "stored"},
+      {1, Z_DEFAULT_STRATEGY, "level 1"},
+      {9, Z_DEFAULT_STRATEGY, "level 9"},
+      {6, Z_FIXED, "fixed Huffman"},
+      {6, Z_HUFFMAN_ONLY, "Huffman only"},
+      {6, Z_RLE, "RLE"},
+  };
+  for (const auto &mode : MODES) {
+    PngSource src = MakeSource({6, 8}, 300, 40, &rng);
+    src.level = mode.level;
+    src.strategy = mode.strategy;
+    DecodeMatches(src, false, mode.name);
+    src.idatSplit = 7;
+    DecodeMatches(src, false, std::string(mode.name) + ", split IDAT");
+  }
+}
+
+// tRNS colour keys and palette alpha
+void TestTransparency() {
+  TestRandom rng(3);
+  for (uint8_t depth : {1, 2, 4, 8, 16}) {
+    PngSource src = MakeSource({0, depth}, 19, 9, &rng);
+    uint16_t key = src.samples[5];
+    src.trns = {(uint8_t)(key >> 8), (uint8_t)key};
+    DecodeMatches(src, false, DescribePng(src) + ", tRNS key");
+  }
+  for (uint8_t depth : {8, 16}) {
+    PngSource src = MakeSource({2, depth}, 19, 9, &rng);
+    for (int c = 0; c < 3; ++c) {
+      uint16_t key = src.samples[3 * 4 + c];
+      src.trns.push_back((uint8_t)(key >> 8));
+      src.trns.push_back((uint8_t)key);
+    }
+    DecodeMatches(src, true, DescribePng(src) + ", tRNS key");
+  }
+  for (uint8_t depth : {1, 2, 4, 8}) {
+    PngSource src = MakeSource({3, depth}, 19, 9, &rng);
+    size_t entries = src.palette.size() / 3;
+    for (size_t i = 0; i < (entries + 1) / 2; ++i)
+      src.trns.push_back((uint8_t)rng.Next());
+    DecodeMatches(src, false, DescribePng(src) + ", palette alpha");
+  }
+
+  // Indices past the end of the palette decode as opaque black
+  PngSource src = MakeSource({3, 8}, 16, 16, &rng);
+  src.palette.resize(4 * 3);
+  for (size_t i = 0; i < src.samples.size(); ++i)
+    src.samples[i] = (uint16_t)(i % 8);
+  DecodeMatches(src, false, "out-of-range palette indices");
+}
+
+bool Decodes(const std::vector<uint8_t> &file) {
+  uint32_t width, height;
+  std::vector<uint8_t> pixels;
+  return DecodePng(file.data(), file.size(), false, &width, &height, &pixels);
+}
+
+// Offset of the first chunk of the given type
+size_t FindChunk(const std::vector<uint8_t> &file, const char *type) {
+  size_t pos = 8;
+  while (pos + 12 <= file.size()) {
+    uint32_t length = (uint32_t)file[pos] << 24 | file[pos + 1] << 16 |
+                      file[pos + 2] << 8 | file[pos + 3];
+    if (memcmp(&file[pos + 4], type, 4) == 0)
+      return pos;
+    pos += 12 + (size_t)length;
+  }
+  return 0;
+}
+
+void TestRejects() {
+  TestRandom rng(4);
+  PngSource src = MakeSource({6, 8}, 16, 16, &rng);
+  std::vector<uint8_t> good = EncodePng(src);
+  CHECK(Decodes(good), "baseline");
+
+  std::vector<uint8_t> file = good;
+  file[1] = 'X';
+  CHECK(!Decodes(file), "bad signature");
+
+  for (size_t cut : {size_t(0), size_t(8), size_t(30), good.size() / 2})
+    CHECK(!Decodes(std::vector<uint8_t>(good.begin(), good.begin() + cut)),
+          "truncated to " + std::to_string(cut));
+
+  PngSource interlaced = src;
+  interlaced.interlaced = true;
+  CHECK(!Decodes(EncodePng(interlaced)), "interlaced");
+
+  file = good;
+  file[8 + 8 + 8] = 3; // Bit depth 3
+  CHECK(!Decodes(file), "bad bit depth");
+
+  file = good;
+  file[8 + 8] = 0x7F; // Width over MAX_DIMENSION
+  CHECK(!Decodes(file), "too wide");
+
+  // Unknown chunks after IHDR: ancillary ones (lowercase first letter) are
+  // skipped, critical ones rejected
+  const size_t afterHeader = 8 + 12 + 13;
+  for (const char *type : {"tEXt", "CRIT"}) {
+    file.assign(good.begin(), good.begin() + afterHeader);
+    PngPutChunk(&file, type, (const uint8_t *)"a\0b", 3);
+    file.insert(file.end(), good.begin() + afterHeader, good.end());
+    CHECK(Decodes(file) == (type[0] == 't'), type);
+  }
+
+  // Filter type 5 does not exist
+  PngSource badFilter = src;
+  badFilter.filter = 0;
+  badFilter.level = 0; // Stored, so the filter byte is easy to find
+  file = EncodePng(badFilter);
+  size_t data = FindChunk(file, "IDAT") + 8 + 2 + 5;
+  CHECK(file[data] == 0, "stored stream layout");
+  file[data] = 5;
+  CHECK(!Decodes(file), "bad filter type");
+
+  // Image data shorter than the image
+  PngSource shortData = src;
+  shortData.height = 8;
+  shortData.samples.resize(shortData.samples.size() / 2);
+  file = EncodePng(shortData);
+  file[8 + 8 + 7] = 16; // Claim 16 rows
+  CHECK(!Decodes(file), "short image data");
+
+  PngSource noPalette = MakeSource({3, 8}, 8, 8, &rng);
+  noPalette.palette.clear();
+  CHECK(!Decodes(EncodePng(noPalette)), "palette image without PLTE");
+}
+
+// Random byte flips, overwrites, insertions and truncations of valid files.
+// Any result is fine as long as the decoder neither faults nor returns a
+// buffer of the wrong size.
+int TestMutations(int count) {
+  TestRandom rng(5);
+  std::vector<std::vector<uint8_t>> seeds;
+  for (const Format &format : FORMATS) {
+    PngSource src = MakeSource(format, 23, 11, &rng);
+    seeds.push_back(EncodePng(src));
+    src.level = 0;
+    seeds.push_back(EncodePng(src));
+  }
+
+  int decoded = 0;
+  for (int i = 0; i < count; ++i) {
+    std::vector<uint8_t> file = seeds[rng.Below((uint32_t)seeds.size())];
+    int edits = 1 + (int)rng.Below(8);
+    for (int e = 0; e < edits && !file.empty(); ++e) {
+      size_t pos = rng.Below((uint32_t)file.size());
+      switch (rng.Below(5)) {
+      case 0:
+        file[pos] ^= (uint8_t)(1u << rng.Below(8));
+        break;
+      case 1:
+        file[pos] = (uint8_t)rng.Next();
+        break;
+      case 2:
+        file.insert(file.begin() + pos, (uint8_t)rng.Next());
+        break;
+      case 3:
+        file.erase(file.begin() + pos);
+        break;
+      case 4:
+        file.resize(pos);
+        break;
+      }
+    }
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> pixels;
+    if (DecodePng(file.data(), file.size(), (i & 1) != 0, &width, &height,
+                  &pixels)) {
+      CHECK(pixels.size() == (size_t)width * height * 4,
+            "mutation " + std::to_string(i));
+      ++decoded;
+    }
+  }
+  return decoded;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int mutations = argc > 1 ? atoi(argv[1]) : 20000;
+
+  int images = TestFormats();
+  TestCompression();
+  TestTransparency();
+  TestRejects();
+  int decoded = TestMutations(mutations);
+
+  printf("%d formats x sizes matched, %d mutated files (%d decoded)\n",
+         images, mutations, decoded);
+  if (g_failures) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("All PNG decoder tests passed\n");
+  return 0;
+}
@@ -0,0 +1,276 @@
+// PNG Encoder - builds test images for the decoder tests and benchmark
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// A test image: raw samples at any colour type and bit depth, plus the
+// chunks and compression to write it with
+struct PngSource {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t bitDepth = 8;
+  uint8_t colorType = 6;
+  // Samples in PNG order, one uint16_t per channel per pixel
+  std::vector<uint16_t> samples;
+  std::vector<uint8_t> palette; // RGB triples (colour type 3)
+  std::vector<uint8_t> trns;    // Written as-is when not empty
+  int filter = -1;              // 0-4, or -1 to cycle through all five
+  int level = Z_DEFAULT_COMPRESSION;
+  int strategy = Z_DEFAULT_STRATEGY;
+  size_t idatSplit = 0; // Split IDAT into chunks of this size (0 = one)
+  bool interlaced = false;
+};
+
+inline int PngChannels(uint8_t colorType) {
+  switch (colorType) {
+  case 0:
+  case 3:
+    return 1;
+  case 4:
+    return 2;
+  case 2:
+    return 3;
+  case 6:
+    return 4;
+  }
+  return 0;
+}
+
+inline uint32_t PngCrc(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  return (uint32_t)crc32(crc, data, (uInt)size);
+}
+
+inline void PngPutBE32(std::vector<uint8_t> *out, uint32_t v) {
+  out->push_back((uint8_t)(v >> 24));
+  out->push_back((uint8_t)(v >> 16));
+  out->push_back((uint8_t)(v >> 8));
+  out->push_back((uint8_t)v);
+}
+
+inline void PngPutChunk(std::vector<uint8_t> *out, const char *type,
+                        const uint8_t *body, size_t size) {
+  PngPutBE32(out, (uint32_t)size);
+  size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  if (size)
+    out->insert(out->end(), body, body + size);
+  PngPutBE32(out, PngCrc(out->data() + start, out->size() - start));
+}
+
+inline uint8_t PngPaeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = p > a ? p - a : a - p;
+  int pb = p > b ? p - b : b - p;
+  int pc = p > c ? p - c : c - p;
+  if (pa <= pb && pa <= pc)
+    return (uint8_t)a;
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+// Pack one row of samples into PNG scanline bytes (no filter byte)
+inline void PngPackRow(const PngSource &src, uint32_t y, uint8_t *row) {
+  int channels = PngChannels(src.colorType);
+  size_t count = (size_t)src.width * channels;
+  const uint16_t *s = src.samples.data() + y * count;
+  if (src.bitDepth == 16) {
+    for (size_t i = 0; i < count; ++i) {
+      row[i * 2] = (uint8_t)(s[i] >> 8);
+      row[i * 2 + 1] = (uint8_t)s[i];
+    }
+  } else if (src.bitDepth == 8) {
+    for (size_t i = 0; i < count; ++i)
+      row[i] = (uint8_t)s[i];
+  } else {
+    size_t rowBytes = (count * src.bitDepth + 7) / 8;
+    memset(row, 0, rowBytes);
+    for (size_t i = 0; i < count; ++i) {
+      size_t bit = i * src.bitDepth;
+      row[bit >> 3] |=
+          (uint8_t)(s[i] << (8 - src.bitDepth - (int)(bit & 7)));
+    }
+  }
+}
+
+// Encode src as a complete PNG file
+inline std::vector<uint8_t> EncodePng(const PngSource &src) {
+  int channels = PngChannels(src.colorType);
+  size_t bitsPerPixel = (size_t)channels * src.bitDepth;
+  size_t rowBytes = ((size_t)src.width * bitsPerPixel + 7) / 8;
+  size_t bpp = bitsPerPixel >= 8 ? bitsPerPixel / 8 : 1;
+
+  std::vector<uint8_t> filtered;
+  filtered.reserve((rowBytes + 1) * src.height);
+  std::vector<uint8_t> prev(rowBytes, 0);
+  std::vector<uint8_t> cur(rowBytes + 1);
+  for (uint32_t y = 0; y < src.height; ++y) {
+    PngPackRow(src, y, cur.data());
+    int filter = src.filter >= 0 ? src.filter : (int)(y % 5);
+    filtered.push_back((uint8_t)filter);
+    for (size_t i = 0; i < rowBytes; ++i) {
+      int a = i >= bpp ? cur[i - bpp] : 0;
+      int b = prev[i];
+      int c = i >= bpp ? prev[i - bpp] : 0;
+      int predictor = 0;
+      switch (filter) {
+      case 1:
+        predictor = a;
+        break;
+      case 2:
+        predictor = b;
+        break;
+      case 3:
+        predictor = (a + b) / 2;
+        break;
+      case 4:
+        predictor = PngPaeth(a, b, c);
+        break;
+      }
+      filtered.push_back((uint8_t)(cur[i] - predictor));
+    }
+    memcpy(prev.data(), cur.data(), rowBytes);
+  }
+
+  z_stream zs = {};
+  deflateInit2(&zs, src.level, Z_DEFLATED, 15, 8, src.strategy);
+  std::vector<uint8_t> compressed(deflateBound(&zs, (uLong)filtered.size()));
+  zs.next_in = filtered.data();
+  zs.avail_in = (uInt)filtered.size();
+  zs.next_out = compressed.data();
+  zs.avail_out = (uInt)compressed.size();
+  deflate(&zs, Z_FINISH);
+  compressed.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  static const uint8_t SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> out(SIGNATURE, SIGNATURE + 8);
+  std::vector<uint8_t> ihdr;
+  PngPutBE32(&ihdr, src.width);
+  PngPutBE32(&ihdr, src.height);
+  ihdr.push_back(src.bitDepth);
+  ihdr.push_back(src.colorType);
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  ihdr.push_back(src.interlaced ? 1 : 0);
+  PngPutChunk(&out, "IHDR", ihdr.data(), ihdr.size());
+  if (!src.palette.empty())
+    PngPutChunk(&out, "PLTE", src.palette.data(), src.palette.size());
+  if (!src.trns.empty())
+    PngPutChunk(&out, "tRNS", src.trns.data(), src.trns.size());
+  size_t split = src.idatSplit ? src.idatSplit : compressed.size();
+  for (size_t pos = 0; pos < compressed.size(); pos += split) {
+    size_t size = std::min(split, compressed.size() - pos);
+    PngPutChunk(&out, "IDAT", compressed.data() + pos, size);
+  }
+  PngPutChunk(&out, "IEND", nullptr, 0);
+  return out;
+}
+
+// Expected decoder output for src: 32bpp RGBA (or BGRA), 16-bit samples
+// reduced to their high byte, low bit depths scaled to 0-255
+inline std::vector<uint8_t> ExpectedPixels(const PngSource &src, bool bgra) {
+  int channels = PngChannels(src.colorType);
+  int maxSample = (1 << src.bitDepth) - 1;
+  auto toByte = [&](uint16_t v) -> uint8_t {
+    if (src.bitDepth == 16)
+      return (uint8_t)(v >> 8);
+    return (uint8_t)(v * 255 / maxSample);
+  };
+  auto keyOf = [&](int i) -> uint16_t {
+    return (uint16_t)(src.trns[i * 2] << 8 | src.trns[i * 2 + 1]);
+  };
+
+  std::vector<uint8_t> out((size_t)src.width * src.height * 4);
+  for (size_t p = 0; p < (size_t)src.width * src.height; ++p) {
+    const uint16_t *s = src.samples.data() + p * channels;
+    uint8_t r = 0, g = 0, b = 0, a = 255;
+    switch (src.colorType) {
+    case 0:
+      r = g = b = toByte(s[0]);
+      if (src.trns.size() >= 2 && s[0] == keyOf(0))
+        a = 0;
+      break;
+    case 2:
+      r = toByte(s[0]);
+      g = toByte(s[1]);
+      b = toByte(s[2]);
+      if (src.trns.size() >= 6 && s[0] == keyOf(0) && s[1] == keyOf(1) &&
+          s[2] == keyOf(2))
+        a = 0;
+      break;
+    case 3:
+      if (s[0] * 3u < src.palette.size()) {
+        r = src.palette[s[0] * 3];
+        g = src.palette[s[0] * 3 + 1];
+        b = src.palette[s[0] * 3 + 2];
+        if (s[0] < src.trns.size())
+          a = src.trns[s[0]];
+      }
+      break;
+    case 4:
+      r = g = b = toByte(s[0]);
+      a = toByte(s[1]);
+      break;
+    case 6:
+      r = toByte(s[0]);
+      g = toByte(s[1]);
+      b = toByte(s[2]);
+      a = toByte(s[3]);
+      break;
+    }
+    uint8_t *d = out.data() + p * 4;
+    d[0] = bgra ? b : r;
+    d[1] = g;
+    d[2] = bgra ? r : b;
+    d[3] = a;
+  }
+  return out;
+}
+
+// Small deterministic generator, so failures reproduce
+struct TestRandom {
+  uint64_t state;
+  explicit TestRandom(uint64_t seed) : state(seed ? seed : 1) {}
+  uint32_t Next() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return (uint32_t)(state >> 16);
+  }
+  uint32_t Below(uint32_t n) { return n ? Next() % n : 0; }
+};
+
+// Fill src.samples with noise over smooth gradients (so every filter type
+// and both literals and matches show up in the deflate stream)
+inline void FillSamples(PngSource *src, TestRandom *rng) {
+  int channels = PngChannels(src->colorType);
+  uint32_t maxSample = src->colorType == 3
+                           ? (uint32_t)(src->palette.size() / 3) - 1
+                           : (1u << src->bitDepth) - 1;
+  src->samples.resize((size_t)src->width * src->height * channels);
+  size_t i = 0;
+  for (uint32_t y = 0; y < src->height; ++y) {
+    for (uint32_t x = 0; x < src->width; ++x) {
+      for (int c = 0; c < channels; ++c, ++i) {
+        uint32_t v;
+        if (rng->Below(4) == 0)
+          v = rng->Below(maxSample + 1);
+        else
+          v = (uint32_t)(((uint64_t)(x + y * 3 + c * 7) * maxSample) /
+                         (src->width + src->height * 3 + 21));
+        src->samples[i] = (uint16_t)(v > maxSample ? maxSample : v);
+      }
+    }
+  }
+}
+
+inline std::string DescribePng(const PngSource &src) {
+  return "colour type " + std::to_string(src.colorType) + ", " +
+         std::to_string(src.bitDepth) + "-bit, " + std::to_string(src.width) +
+         "x" + std::to_string(src.height);
+}
@@ -0,0 +1,135 @@
+// Replacement index benchmark: the flat tables the texture replacer looks
+// replacements up in (utils/replacement_index.h, utils/flat_hash.h) against
+// the std::map and std::set they replaced, with 100k replacements spread
+// over a few hundred sizes. Half the lookups hit, half miss by hash, as a
+// texture at a replaced size usually does. Every structure must agree.
+//
+//   replacement_index_bench [entries] [lookups]
+#include "../utils/replacement_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+struct Key {
+  UINT width;
+  UINT height;
+  uint64_t hash;
+};
+
+constexpr UINT SIZES = 300;
+
+inline uint64_t DimensionKey(UINT width, UINT height) {
+  return ((uint64_t)width << 32) | height;
+}
+
+// Power-of-two sizes as the game uses, plus odd UI sizes
+std::vector<std::pair<UINT, UINT>> MakeSizes(std::mt19937_64 *rng) {
+  std::vector<std::pair<UINT, UINT>> sizes;
+  for (UINT w = 8; w <= 4096; w *= 2) {
+    for (UINT h = 8; h <= 4096; h *= 2)
+      sizes.push_back({w, h});
+  }
+  std::uniform_int_distribution<UINT> side(1, 1024);
+  while (sizes.size() < SIZES)
+    sizes.push_back({side(*rng), side(*rng)});
+  return sizes;
+}
+
+template <typename Find>
+double TimeNs(const std::vector<Key> &keys, size_t *found, Find find) {
+  auto start = std::chrono::steady_clock::now();
+  size_t count = 0;
+  for (const Key &k : keys)
+    count += find(k) ? 1 : 0;
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  *found = count;
+  return elapsed.count() / keys.size();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t entries = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  size_t lookups = argc > 2 ? strtoul(argv[2], nullptr, 10) : 2000000;
+  if (entries < 1)
+    entries = 1;
+  if (lookups < 2)
+    lookups = 2;
+
+  std::mt19937_64 rng(27);
+  std::vector<std::pair<UINT, UINT>> sizes = MakeSizes(&rng);
+  std::vector<Key> keys(entries);
+  for (Key &k : keys) {
+    const auto &size = sizes[rng() % sizes.size()];
+    k = {size.first, size.second, rng()};
+  }
+
+  ReplacementIndex index;
+  FlatHashSet64 dimensions;
+  std::map<std::tuple<UINT, UINT, uint64_t>, uint32_t> byHash;
+  std::set<std::pair<UINT, UINT>> dimensionSet;
+  index.Reserve(entries);
+  for (size_t i = 0; i < entries; ++i) {
+    const Key &k = keys[i];
+    index.Insert(k.width, k.height, k.hash, (uint32_t)i);
+    dimensions.Insert(DimensionKey(k.width, k.height));
+    byHash[std::make_tuple(k.width, k.height, k.hash)] = (uint32_t)i;
+    dimensionSet.insert({k.width, k.height});
+  }
+
+  // Half hits, half a known size with an unknown hash, shuffled
+  std::vector<Key> queries(lookups);
+  for (size_t i = 0; i < lookups; ++i) {
+    const Key &k = keys[rng() % entries];
+    queries[i] = i & 1 ? Key{k.width, k.height, rng()} : k;
+  }
+  std::shuffle(queries.begin(), queries.end(), rng);
+
+  size_t flatFound, mapFound, flatDims, setDims;
+  double flatNs = TimeNs(queries, &flatFound, [&](const Key &k) {
+    return index.Find(k.width, k.height, k.hash) != INVALID_REPLACEMENT_ID;
+  });
+  double mapNs = TimeNs(queries, &mapFound, [&](const Key &k) {
+    return byHash.find(std::make_tuple(k.width, k.height, k.hash)) !=
+           byHash.end();
+  });
+  double flatDimNs = TimeNs(queries, &flatDims, [&](const Key &k) {
+    return dimensions.Contains(DimensionKey(k.width, k.height));
+  });
+  double setDimNs = TimeNs(queries, &setDims, [&](const Key &k) {
+    return dimensionSet.count({k.width, k.height}) != 0;
+  });
+
+  int mismatches = 0;
+  for (size_t i = 0; i < entries; ++i) {
+    const Key &k = keys[i];
+    auto it = byHash.find(std::make_tuple(k.width, k.height, k.hash));
+    if (index.Find(k.width, k.height, k.hash) != it->second)
+      ++mismatches;
+  }
+  if (flatFound != mapFound || flatDims != setDims ||
+      index.Size() != byHash.size())
+    ++mismatches;
+
+  printf("%zu replacements, %zu sizes, %zu lookups (%zu hit)\n", entries,
+         dimensionSet.size(), lookups, mapFound);
+  printf("%-24s %12s\n", "lookup", "ns/lookup");
+  printf("%-24s %12.1f\n", "std::map by key", mapNs);
+  printf("%-24s %12.1f\n", "ReplacementIndex", flatNs);
+  printf("%-24s %12.1f\n", "std::set by size", setDimNs);
+  printf("%-24s %12.1f\n", "FlatHashSet64 by size", flatDimNs);
+  if (mismatches) {
+    printf("%d lookup result(s) differ\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
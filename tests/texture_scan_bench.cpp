@@ -0,0 +1,113 @@
+// Texture scan benchmark: the scalar, SSE2 and AVX2 row kernels
+// (patches/texture_scan.cpp) on RGBA8 textures up to the 4096x2048 VRAM
+// surface, classifying only and hashing as well, as ScanTextureData does.
+// The hash is serial FNV-1a, so it dominates the second column. All kernels
+// must agree.
+//
+//   texture_scan_bench [passes]
+#include "../patches/texture_scan.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+typedef void (*ScanRowsFn)(const uint8_t *, uint32_t, uint32_t, uint32_t,
+                           uint64_t *, PixelScan *);
+
+struct Kernel {
+  const char *name;
+  ScanRowsFn fn;
+};
+
+struct Size {
+  uint32_t width;
+  uint32_t height;
+};
+const Size SIZES[] = {{256, 256}, {1024, 1024}, {4096, 2048}};
+constexpr uint32_t ALPHA_MASK = 0xFF000000;
+
+// Opaque pixels, so the alpha test can't stop at the first clear bit
+std::vector<uint8_t> MakeTexture(const Size &size) {
+  std::mt19937 rng(size.width);
+  std::vector<uint8_t> data((size_t)size.width * size.height * 4);
+  for (size_t i = 0; i < data.size(); i += 4) {
+    uint32_t pixel = rng() | ALPHA_MASK;
+    for (int b = 0; b < 4; ++b)
+      data[i + b] = (uint8_t)(pixel >> (b * 8));
+  }
+  return data;
+}
+
+// Average milliseconds per texture; hash is null to classify only
+double TimeMs(int passes, ScanRowsFn fn, const std::vector<uint8_t> &data,
+              const Size &size, uint64_t *hash, PixelScan *scan) {
+  uint32_t pitch = size.width * 4;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < passes; ++i) {
+    if (hash)
+      *hash = 14695981039346656037ULL;
+    *scan = MakePixelScan(data.data(), 4, ALPHA_MASK);
+    fn(data.data(), pitch, pitch, size.height, hash, scan);
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / passes;
+}
+
+bool SameScan(const PixelScan &a, const PixelScan &b) {
+  return a.alphaSet == b.alphaSet && a.alphaClear == b.alphaClear &&
+         a.diff == b.diff;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int passes = argc > 1 ? atoi(argv[1]) : 10;
+  if (passes < 1)
+    passes = 1;
+
+  std::vector<Kernel> kernels = {{"scalar", ScanPixelRowsScalar},
+                                 {"SSE2", ScanPixelRowsSSE2}};
+  if (HasAVX2())
+    kernels.push_back({"AVX2", ScanPixelRowsAVX2});
+  else
+    printf("AVX2 not supported by this CPU\n");
+
+  printf("%-10s %-8s %16s %16s\n", "size", "kernel", "classify MB/s",
+         "+hash MB/s");
+  int mismatches = 0;
+  for (const Size &size : SIZES) {
+    std::vector<uint8_t> data = MakeTexture(size);
+    double mb = data.size() / (1024.0 * 1024.0);
+    PixelScan expectedScan = {};
+    uint64_t expectedHash = 0;
+    for (size_t k = 0; k < kernels.size(); ++k) {
+      PixelScan scan, hashedScan;
+      uint64_t hash = 0;
+      double classifyMs =
+          TimeMs(passes, kernels[k].fn, data, size, nullptr, &scan);
+      double hashMs =
+          TimeMs(passes, kernels[k].fn, data, size, &hash, &hashedScan);
+      char name[32];
+      snprintf(name, sizeof(name), "%ux%u", size.width, size.height);
+      printf("%-10s %-8s %16.0f %16.0f\n", name, kernels[k].name,
+             classifyMs > 0 ? mb * 1000.0 / classifyMs : 0.0,
+             hashMs > 0 ? mb * 1000.0 / hashMs : 0.0);
+      if (k == 0) {
+        expectedScan = scan;
+        expectedHash = hash;
+      } else if (!SameScan(scan, expectedScan) ||
+                 !SameScan(hashedScan, expectedScan) || hash != expectedHash) {
+        ++mismatches;
+      }
+    }
+  }
+
+  if (mismatches) {
+    printf("%d kernel result(s) differ from the scalar kernel\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
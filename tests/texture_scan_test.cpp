@@ -0,0 +1,191 @@
+// Texture scan tests: the SSE2 and AVX2 row kernels (patches/texture_scan.cpp)
+// against the scalar one on opaque, transparent, mixed, solid and random
+// pixels of every scanned pixel size, over widths around the vector sizes,
+// padded row pitches and unaligned rows. Hash, alpha class and solid flag
+// must all match. The AVX2 kernel is skipped where the CPU lacks it.
+//
+//   texture_scan_test
+#include "../patches/texture_scan.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+int g_failures = 0;
+
+#define CHECK(cond, what)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s (%s)\n", __FILE__, __LINE__, #cond,               \
+             std::string(what).c_str());                                       \
+      ++g_failures;                                                            \
+    }                                                                          \
+  } while (0)
+
+typedef void (*ScanRowsFn)(const uint8_t *, uint32_t, uint32_t, uint32_t,
+                           uint64_t *, PixelScan *);
+
+enum Alpha { ALPHA_UNKNOWN, ALPHA_TRANSPARENT, ALPHA_OPAQUE, ALPHA_MIXED };
+enum Fill { FILL_RANDOM, FILL_SOLID, FILL_OPAQUE, FILL_TRANSPARENT };
+const char *const FILL_NAMES[] = {"random", "solid", "opaque", "transparent"};
+
+// What ScanRows in texturedump.cpp makes of a scan
+struct Result {
+  uint64_t hash;
+  Alpha alpha;
+  bool solid;
+  PixelScan scan;
+};
+
+// The scanned formats' pixel sizes and alpha patterns
+struct Format {
+  uint32_t bytesPerPixel;
+  uint32_t alphaMask;
+  const char *name;
+};
+const Format FORMATS[] = {{4, 0xFF000000, "RGBA8"},
+                          {2, 0xF000F000, "BGRA4"},
+                          {2, 0, "RG8"},
+                          {1, 0, "R8"}};
+
+const uint32_t WIDTHS[] = {1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+                           100, 257};
+const uint32_t PITCH_PADDING[] = {0, 1, 4, 13, 64};
+constexpr uint32_t HEIGHT = 19;
+
+Result Scan(ScanRowsFn fn, const uint8_t *data, uint32_t pitch,
+            uint32_t rowSize, const Format &format) {
+  Result result = {};
+  result.hash = 14695981039346656037ULL;
+  result.scan = MakePixelScan(data, format.bytesPerPixel, format.alphaMask);
+  fn(data, pitch, rowSize, HEIGHT, &result.hash, &result.scan);
+  result.solid = result.scan.diff == 0;
+  if (format.alphaMask == 0)
+    result.alpha = ALPHA_UNKNOWN;
+  else if (result.scan.alphaSet == 0)
+    result.alpha = ALPHA_TRANSPARENT;
+  else if (result.scan.alphaClear == 0)
+    result.alpha = ALPHA_OPAQUE;
+  else
+    result.alpha = ALPHA_MIXED;
+  return result;
+}
+
+// Rows of rowSize bytes at the start of each pitch; padding is random so a
+// kernel reading past the row changes its result
+void FillRows(std::mt19937 *rng, Fill fill, const Format &format,
+              uint32_t pitch, uint32_t rowSize, uint8_t *data) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  uint8_t pixel[4];
+  for (uint8_t &b : pixel)
+    b = (uint8_t)byte(*rng);
+  for (uint32_t r = 0; r < HEIGHT; ++r) {
+    uint8_t *row = data + (size_t)r * pitch;
+    for (uint32_t i = 0; i < pitch; ++i)
+      row[i] = (uint8_t)byte(*rng);
+    for (uint32_t i = 0; i < rowSize; ++i) {
+      uint32_t lane = i % format.bytesPerPixel;
+      uint8_t alpha = (uint8_t)(format.alphaMask >> ((i & 3) * 8));
+      if (fill == FILL_SOLID)
+        row[i] = pixel[lane];
+      else if (fill == FILL_OPAQUE)
+        row[i] |= alpha;
+      else if (fill == FILL_TRANSPARENT)
+        row[i] &= (uint8_t)~alpha;
+    }
+  }
+}
+
+std::string Case(const Format &format, Fill fill, uint32_t width,
+                 uint32_t pitch, uint32_t offset) {
+  char text[128];
+  snprintf(text, sizeof(text), "%s %s width %u pitch %u offset %u",
+           format.name, FILL_NAMES[fill], width, pitch, offset);
+  return text;
+}
+
+void TestKernel(ScanRowsFn fn, const char *name) {
+  std::mt19937 rng(7);
+  std::vector<uint8_t> buffer;
+  int cases = 0;
+  for (const Format &format : FORMATS) {
+    for (int fill = FILL_RANDOM; fill <= FILL_TRANSPARENT; ++fill) {
+      for (uint32_t width : WIDTHS) {
+        uint32_t rowSize = width * format.bytesPerPixel;
+        for (uint32_t padding : PITCH_PADDING) {
+          // Pitches keep rows on a pixel, as D3D11's do
+          uint32_t pitch = rowSize + padding * format.bytesPerPixel;
+          for (uint32_t offset = 0; offset < 2; ++offset) {
+            buffer.assign((size_t)pitch * HEIGHT + 64, 0);
+            uint8_t *data = buffer.data() + offset * format.bytesPerPixel;
+            FillRows(&rng, (Fill)fill, format, pitch, rowSize, data);
+
+            Result expected =
+                Scan(ScanPixelRowsScalar, data, pitch, rowSize, format);
+            Result actual = Scan(fn, data, pitch, rowSize, format);
+            std::string what = std::string(name) + " " +
+                               Case(format, (Fill)fill, width, pitch, offset);
+            CHECK(actual.hash == expected.hash, what);
+            CHECK(actual.alpha == expected.alpha, what);
+            CHECK(actual.solid == expected.solid, what);
+            CHECK(actual.scan.alphaSet == expected.scan.alphaSet &&
+                      actual.scan.alphaClear == expected.scan.alphaClear &&
+                      actual.scan.diff == expected.scan.diff,
+                  what);
+            ++cases;
+          }
+        }
+      }
+    }
+  }
+  printf("%s: %d cases\n", name, cases);
+}
+
+// The scalar kernel classifies the fills as they were made
+void TestScalar() {
+  std::mt19937 rng(11);
+  const Format &rgba = FORMATS[0];
+  const uint32_t width = 33, rowSize = width * 4, pitch = rowSize + 12;
+  std::vector<uint8_t> data((size_t)pitch * HEIGHT);
+  const Alpha EXPECTED[] = {ALPHA_MIXED, ALPHA_UNKNOWN, ALPHA_OPAQUE,
+                            ALPHA_TRANSPARENT};
+  for (int fill = FILL_RANDOM; fill <= FILL_TRANSPARENT; ++fill) {
+    FillRows(&rng, (Fill)fill, rgba, pitch, rowSize, data.data());
+    Result result =
+        Scan(ScanPixelRowsScalar, data.data(), pitch, rowSize, rgba);
+    CHECK(result.solid == (fill == FILL_SOLID), FILL_NAMES[fill]);
+    if (fill != FILL_SOLID)
+      CHECK(result.alpha == EXPECTED[fill], FILL_NAMES[fill]);
+  }
+
+  // Hash only, and no rows
+  uint64_t hash = 14695981039346656037ULL;
+  ScanPixelRowsScalar(data.data(), pitch, rowSize, 0, &hash, nullptr);
+  CHECK(hash == 14695981039346656037ULL, "no rows");
+  uint64_t hashOnly = 14695981039346656037ULL;
+  ScanPixelRowsScalar(data.data(), pitch, rowSize, HEIGHT, &hashOnly,
+                      nullptr);
+  CHECK(hashOnly == Scan(ScanPixelRowsScalar, data.data(), pitch, rowSize,
+                         rgba).hash,
+        "hash only");
+}
+} // namespace
+
+int main() {
+  TestScalar();
+  TestKernel(ScanPixelRowsSSE2, "SSE2");
+  if (HasAVX2())
+    TestKernel(ScanPixelRowsAVX2, "AVX2");
+  else
+    printf("AVX2: not supported by this CPU, skipped\n");
+  TestKernel(ScanPixelRows, "dispatched");
+
+  if (g_failures) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("All texture scan tests passed\n");
+  return 0;
+}
@@ -0,0 +1,775 @@
+#include "trace_replay.h"
+#include "../patches/call_trace.h"
+#include "../patches/upscale_rewrite.h"
+#include "../utils/viewport_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+
+namespace {
+// D3D11 values the replay checks descriptors and calls against
+constexpr uint32_t BIND_RENDER_TARGET = 0x20;
+constexpr uint32_t MAX_TEXTURE_SIZE = 16384;
+constexpr uint32_t MAX_VIEWPORTS = 16;
+constexpr float VIEWPORT_BOUNDS_MIN = -32768.0f;
+constexpr float VIEWPORT_BOUNDS_MAX = 32767.0f;
+
+// Viewports are compared with the recording to within this
+constexpr float VIEWPORT_TOLERANCE = 0.01f;
+
+typedef std::chrono::steady_clock Clock;
+
+// Replacement sizes for BindFilter::hasReplacementAtSize, which takes no
+// context. The replay runs on one thread.
+const std::set<std::pair<uint32_t, uint32_t>> *g_replacementSizes = nullptr;
+
+bool HasReplacementAtSize(uint32_t width, uint32_t height) {
+  return g_replacementSizes &&
+         g_replacementSizes->count({width, height}) != 0;
+}
+
+struct Record {
+  uint16_t type;
+  uint8_t stage;
+  const uint8_t *payload;
+  uint32_t size;
+};
+
+// Records in order; false with *error set if the data runs out mid-record
+class RecordReader {
+public:
+  RecordReader(const uint8_t *data, size_t size)
+      : m_pos(data), m_end(data + size) {}
+
+  bool ReadHeader(std::string *error) {
+    TraceFileHeader header;
+    if ((size_t)(m_end - m_pos) < sizeof(header)) {
+      *error = "too short for a trace header";
+      return false;
+    }
+    memcpy(&header, m_pos, sizeof(header));
+    if (memcmp(header.magic, "CFXTRACE", 8) != 0) {
+      *error = "not a CFXTRACE file";
+      return false;
+    }
+    if (header.version != TRACE_FILE_VERSION) {
+      *error = "unsupported trace version " + std::to_string(header.version);
+      return false;
+    }
+    m_pos += sizeof(header);
+    return true;
+  }
+
+  bool Next(Record *record, std::string *error) {
+    if (m_pos == m_end)
+      return false;
+    TraceRecordHeader header;
+    if ((size_t)(m_end - m_pos) < sizeof(header) ||
+        (memcpy(&header, m_pos, sizeof(header)),
+         (size_t)(m_end - m_pos - sizeof(header)) < header.size)) {
+      *error = "trace ends mid-record";
+      m_pos = m_end;
+      return false;
+    }
+    record->type = header.type;
+    record->stage = header.stage;
+    record->payload = m_pos + sizeof(header);
+    record->size = header.size;
+    m_pos += sizeof(header) + header.size;
+    return true;
+  }
+
+private:
+  const uint8_t *m_pos;
+  const uint8_t *m_end;
+};
+
+template <typename T> bool ReadPayload(const Record &record, T *out) {
+  if (record.size < sizeof(T))
+    return false;
+  memcpy(out, record.payload, sizeof(T));
+  return true;
+}
+
+// TRACE_VIEWPORTS, TRACE_RENDER_TARGETS and TRACE_SHADER_RESOURCES: a
+// count (after startSlot for the last) and that many items
+template <typename T>
+bool ReadList(const Record &record, size_t offset, std::vector<T> *out) {
+  uint32_t count;
+  if (record.size < offset + sizeof(count))
+    return false;
+  memcpy(&count, record.payload + offset, sizeof(count));
+  offset += sizeof(count);
+  if ((record.size - offset) / sizeof(T) < count)
+    return false;
+  out->resize(count);
+  if (count)
+    memcpy(out->data(), record.payload + offset, count * sizeof(T));
+  return true;
+}
+
+bool IsRenderTarget(const TraceTextureDesc &desc) {
+  return (desc.bindFlags & BIND_RENDER_TARGET) != 0;
+}
+
+// The recorded upscaled size shows in the render targets the game made at
+// the base size: twice as wide as tall and wider than the base
+float RecordedScaleOf(const TraceTextureDesc &desc) {
+  if (!IsRenderTarget(desc) || desc.width != desc.height * 2 ||
+      desc.width <= (uint32_t)UPSCALE_BASE_WIDTH ||
+      !IsUpscaleColorFormat((DXGI_FORMAT)desc.format))
+    return 0.0f;
+  return desc.width / UPSCALE_BASE_WIDTH;
+}
+
+uint32_t MipSize(uint32_t size, uint32_t subresource, uint32_t mipLevels) {
+  uint32_t mip = subresource % (std::max)(mipLevels, 1u);
+  return (std::max)(size >> (std::min)(mip, 31u), 1u);
+}
+
+bool SameViewport(const D3D11_VIEWPORT &a, const TraceViewport &b) {
+  return std::fabs(a.TopLeftX - b.topLeftX) <= VIEWPORT_TOLERANCE &&
+         std::fabs(a.TopLeftY - b.topLeftY) <= VIEWPORT_TOLERANCE &&
+         std::fabs(a.Width - b.width) <= VIEWPORT_TOLERANCE &&
+         std::fabs(a.Height - b.height) <= VIEWPORT_TOLERANCE;
+}
+
+bool SameBox(const D3D11_BOX &a, const TraceBox &b) {
+  return a.left == b.left && a.top == b.top && a.front == b.front &&
+         a.right == b.right && a.bottom == b.bottom && a.back == b.back;
+}
+
+// What the bind hook settled on for a texture until it is next written
+enum VerdictKind {
+  VERDICT_SKIP,       // Filtered out; holds until the texture is recreated
+  VERDICT_NO_MATCH,   // Staged, nothing replaced it
+  VERDICT_REPLACED,   // Staged, bound as `replacement` instead
+};
+
+struct Verdict {
+  VerdictKind kind;
+  uint64_t replacement;
+};
+
+// What the recording shows about the settings it was made with
+struct Recorded {
+  float scale = 1.0f;
+  float ratio = 1.0f;
+  std::set<std::pair<uint32_t, uint32_t>> replacementSizes;
+};
+
+// One pass over the trace for the recorded settings: the upscaled target
+// size, the ratio widened UI viewports were passed on with and the sizes
+// of textures that were bound with a replacement
+Recorded InspectRecording(const uint8_t *data, size_t size) {
+  Recorded recorded;
+  bool scaleKnown = false, ratioKnown = false;
+  std::unordered_map<uint64_t, TraceTextureDesc> textures;
+  uint64_t boundTarget = 0;
+  std::vector<TraceViewport> gameViewports;
+  std::vector<uint64_t> gameResources;
+  uint32_t gameStartSlot = 0;
+
+  RecordReader reader(data, size);
+  std::string error;
+  Record record;
+  if (!reader.ReadHeader(&error))
+    return recorded;
+  while (reader.Next(&record, &error)) {
+    switch (record.type) {
+    case TRACE_TEXTURE: {
+      TraceTexture texture;
+      if (!ReadPayload(record, &texture))
+        break;
+      textures[texture.id] = texture.desc;
+      float scale = RecordedScaleOf(texture.desc);
+      if (!scaleKnown && scale > 0.0f) {
+        recorded.scale = scale;
+        scaleKnown = true;
+      }
+      break;
+    }
+    case TRACE_RENDER_TARGETS: {
+      std::vector<uint64_t> ids;
+      if (ReadList(record, 0, &ids))
+        boundTarget = ids.empty() ? 0 : ids[0];
+      break;
+    }
+    case TRACE_VIEWPORTS: {
+      if (record.stage == TRACE_STAGE_GAME) {
+        if (!ReadList(record, 0, &gameViewports))
+          gameViewports.clear();
+        break;
+      }
+      std::vector<TraceViewport> passed;
+      if (ratioKnown || !ReadList(record, 0, &passed) ||
+          passed.size() != gameViewports.size())
+        break;
+      auto target = textures.find(boundTarget);
+      float scaleX = 1.0f;
+      if (target != textures.end() && RecordedScaleOf(target->second) > 0)
+        scaleX = target->second.width / UPSCALE_BASE_WIDTH;
+      for (size_t i = 0; i < passed.size() && !ratioKnown; ++i) {
+        const TraceViewport &vp = gameViewports[i];
+        float x = vp.topLeftX, width = vp.width;
+        if (vp.width > 0 &&
+            ViewportUtils::WidenUIViewport(&x, vp.topLeftY, &width,
+                                           vp.height, 0.5f)) {
+          recorded.ratio = passed[i].width / (vp.width * scaleX);
+          ratioKnown = true;
+        }
+      }
+      break;
+    }
+    case TRACE_SHADER_RESOURCES: {
+      std::vector<uint64_t> ids;
+      uint32_t startSlot;
+      if (!ReadPayload(record, &startSlot) || !ReadList(record, 4, &ids))
+        break;
+      if (record.stage == TRACE_STAGE_GAME) {
+        gameResources.swap(ids);
+        gameStartSlot = startSlot;
+        break;
+      }
+      if (startSlot != gameStartSlot || ids.size() != gameResources.size())
+        break;
+      for (size_t i = 0; i < ids.size(); ++i) {
+        auto bound = textures.find(gameResources[i]);
+        if (ids[i] != gameResources[i] && bound != textures.end())
+          recorded.replacementSizes.insert(
+              {bound->second.width, bound->second.height});
+      }
+      break;
+    }
+    }
+  }
+  return recorded;
+}
+
+class Replayer {
+public:
+  Replayer(const ReplayOptions &options, const Recorded &recorded,
+           ReplayResult *result)
+      : m_options(options), m_recorded(recorded), m_result(result) {
+    float scale =
+        options.upscaleScale > 0 ? options.upscaleScale : recorded.scale;
+    m_size = GetUpscaleSize(scale);
+    m_upscale = m_size.width > UPSCALE_BASE_WIDTH;
+    m_ratio = options.widescreenRatio > 0 ? options.widescreenRatio
+                                          : recorded.ratio;
+    result->upscaleScale = m_upscale ? m_size.scaleX : 1.0f;
+    result->widescreenRatio = m_ratio;
+
+    if (options.replacementsKnown) {
+      m_replacementSizes.insert(options.replacementSizes.begin(),
+                                options.replacementSizes.end());
+      m_filter.replaceEnabled = true;
+    } else {
+      m_replacementSizes = recorded.replacementSizes;
+      m_filter.replaceEnabled = !m_replacementSizes.empty();
+    }
+    m_filter.dumpEnabled = options.dumpEnabled;
+    if (m_upscale) {
+      m_filter.upscaledWidth = (uint32_t)m_size.width;
+      m_filter.upscaledHeight = (uint32_t)m_size.height;
+    }
+    m_filter.hasReplacementAtSize = HasReplacementAtSize;
+    g_replacementSizes = &m_replacementSizes;
+
+    // Cost of the timer itself, taken off each timed call
+    const int CALIBRATION = 10000;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < CALIBRATION; ++i)
+      Elapsed(Clock::now());
+    m_timerNs = Elapsed(start) / CALIBRATION;
+  }
+
+  ~Replayer() { g_replacementSizes = nullptr; }
+
+  void Replay(const Record &record) {
+    m_result->records++;
+    if (record.type != TRACE_CREATE_TEXTURE && record.type != TRACE_TEXTURE)
+      m_creates.clear();
+
+    switch (record.type) {
+    case TRACE_FRAME:
+      ReadPayload(record, &m_frame);
+      m_result->frames++;
+      break;
+    case TRACE_TEXTURE:
+      Texture(record);
+      break;
+    case TRACE_CREATE_TEXTURE:
+      CreateTexture(record);
+      break;
+    case TRACE_VIEWPORTS:
+      Viewports(record);
+      break;
+    case TRACE_COPY_REGION:
+      CopyRegion(record);
+      break;
+    case TRACE_COPY_RESOURCE: {
+      TraceCopyResource copy;
+      if (ReadPayload(record, &copy) && record.stage == TRACE_STAGE_GAME)
+        Written(copy.dst);
+      break;
+    }
+    case TRACE_UPDATE_SUBRESOURCE: {
+      TraceUpdateSubresource update;
+      if (ReadPayload(record, &update) && record.stage == TRACE_STAGE_GAME)
+        Written(update.dst);
+      break;
+    }
+    case TRACE_MAP: {
+      TraceMap map;
+      // D3D11_MAP_READ is 1
+      if (ReadPayload(record, &map) && map.hr >= 0 && map.mapType != 1)
+        Written(map.resource);
+      break;
+    }
+    case TRACE_RENDER_TARGETS: {
+      std::vector<uint64_t> ids;
+      if (!ReadList(record, 0, &ids))
+        break;
+      m_boundTarget = ids.empty() ? 0 : ids[0];
+      for (uint64_t id : ids)
+        Written(id);
+      break;
+    }
+    case TRACE_SHADER_RESOURCES:
+      ShaderResources(record);
+      break;
+    }
+  }
+
+private:
+  static double Elapsed(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start)
+        .count();
+  }
+
+  void Timed(ReplayHook hook, Clock::time_point start) {
+    m_result->hooks[hook].ns += (std::max)(Elapsed(start) - m_timerNs, 0.0);
+  }
+
+  void Compared(ReplayHook hook, bool same) {
+    if (same)
+      m_result->hooks[hook].matched++;
+    else
+      m_result->hooks[hook].differed++;
+  }
+
+  void Log(const char *format, ...);
+
+  const TraceTextureDesc *Find(uint64_t id) const {
+    auto it = m_textures.find(id);
+    return it == m_textures.end() ? nullptr : &it->second;
+  }
+
+  // Whatever replaced or ruled out a texture's contents no longer holds
+  void Written(uint64_t id) {
+    auto it = m_verdicts.find(id);
+    if (it != m_verdicts.end() && it->second.kind != VERDICT_SKIP)
+      m_verdicts.erase(it);
+  }
+
+  void Texture(const Record &record) {
+    TraceTexture texture;
+    if (!ReadPayload(record, &texture))
+      return;
+    if (!m_creates.empty()) {
+      // The texture a create made: the replayed descriptor if the replay
+      // rewrote it, else what was actually created
+      Create create = m_creates.back();
+      m_creates.pop_back();
+      m_textures[texture.id] =
+          create.rewritten ? create.replayed : texture.desc;
+      m_verdicts.erase(texture.id);
+      return;
+    }
+    // Made before the recording started, at the recorded scale
+    TraceTextureDesc desc = texture.desc;
+    if (RecordedScaleOf(desc) > 0.0f &&
+        desc.width == (uint32_t)GetUpscaleSize(m_recorded.scale).width) {
+      desc.width = (uint32_t)m_size.width;
+      desc.height = (uint32_t)m_size.height;
+      if (!m_upscale) {
+        desc.width = (uint32_t)UPSCALE_BASE_WIDTH;
+        desc.height = (uint32_t)UPSCALE_BASE_HEIGHT;
+      }
+    }
+    m_textures[texture.id] = desc;
+  }
+
+  void CreateTexture(const Record &record) {
+    TraceCreateTexture create;
+    if (!ReadPayload(record, &create))
+      return;
+    ReplayHookStats &stats = m_result->hooks[REPLAY_CREATE_TEXTURE];
+
+    if (record.stage == TRACE_STAGE_DRIVER) {
+      // Passed on by the innermost create still open
+      for (auto it = m_creates.rbegin(); it != m_creates.rend(); ++it) {
+        if (it->compared)
+          continue;
+        it->compared = true;
+        Compared(REPLAY_CREATE_TEXTURE,
+                 memcmp(&it->replayed, &create.desc, sizeof(create.desc)) ==
+                     0);
+        break;
+      }
+      return;
+    }
+
+    stats.calls++;
+    Create entry = {create.desc, false, false};
+    Clock::time_point start = Clock::now();
+    // Creates inside a create (sparse targets, replacement loads) pass
+    // through the upscale hook unchanged
+    if (m_upscale && m_creates.empty() &&
+        IsUpscaleTarget(create.desc.width, create.desc.height,
+                        IsRenderTarget(create.desc),
+                        (DXGI_FORMAT)create.desc.format,
+                        create.hasInitialData != 0)) {
+      entry.replayed.width = (uint32_t)m_size.width;
+      entry.replayed.height = (uint32_t)m_size.height;
+      entry.rewritten = true;
+    }
+    Timed(REPLAY_CREATE_TEXTURE, start);
+
+    if (entry.replayed.width == 0 || entry.replayed.height == 0 ||
+        entry.replayed.width > MAX_TEXTURE_SIZE ||
+        entry.replayed.height > MAX_TEXTURE_SIZE)
+      m_result->invalidCalls++;
+    if (entry.rewritten) {
+      stats.rewritten++;
+      Log("frame %llu CreateTexture2D %ux%u -> %ux%u\n",
+          (unsigned long long)m_frame.frame, create.desc.width,
+          create.desc.height, entry.replayed.width, entry.replayed.height);
+    }
+    m_creates.push_back(entry);
+  }
+
+  void Viewports(const Record &record) {
+    std::vector<TraceViewport> recorded;
+    if (!ReadList(record, 0, &recorded))
+      return;
+
+    if (record.stage == TRACE_STAGE_DRIVER) {
+      if (!m_viewportsPending)
+        return;
+      m_viewportsPending = false;
+      bool same = recorded.size() == m_viewports.size();
+      for (size_t i = 0; same && i < recorded.size(); ++i)
+        same = SameViewport(m_viewports[i], recorded[i]);
+      Compared(REPLAY_VIEWPORTS, same);
+      return;
+    }
+
+    ReplayHookStats &stats = m_result->hooks[REPLAY_VIEWPORTS];
+    stats.calls++;
+    m_viewports.resize(recorded.size());
+    for (size_t i = 0; i < recorded.size(); ++i) {
+      const TraceViewport &vp = recorded[i];
+      m_viewports[i] = {vp.topLeftX, vp.topLeftY, vp.width,
+                        vp.height,   vp.minDepth, vp.maxDepth};
+    }
+    const TraceTextureDesc *target = Find(m_boundTarget);
+    uint32_t count = (uint32_t)m_viewports.size();
+
+    // In hook order: the widescreen fix, then the upscale
+    Clock::time_point start = Clock::now();
+    ViewportUtils::ApplyViewportWidescreenFix(m_viewports.data(), count,
+                                              m_ratio);
+    if (m_upscale && target &&
+        IsUpscaledSize(m_size, target->width, target->height))
+      UpscaleViewports(m_size, m_viewports.data(), count);
+    Timed(REPLAY_VIEWPORTS, start);
+    m_viewportsPending = true;
+
+    bool rewritten = false;
+    for (size_t i = 0; i < recorded.size(); ++i) {
+      const D3D11_VIEWPORT &vp = m_viewports[i];
+      if (vp.Width < 0 || vp.Height < 0 ||
+          vp.TopLeftX < VIEWPORT_BOUNDS_MIN ||
+          vp.TopLeftY < VIEWPORT_BOUNDS_MIN ||
+          vp.TopLeftX + vp.Width > VIEWPORT_BOUNDS_MAX ||
+          vp.TopLeftY + vp.Height > VIEWPORT_BOUNDS_MAX)
+        m_result->invalidCalls++;
+      if (SameViewport(vp, recorded[i]))
+        continue;
+      rewritten = true;
+      Log("frame %llu RSSetViewports[%zu] (%g, %g, %g, %g) -> "
+          "(%g, %g, %g, %g)\n",
+          (unsigned long long)m_frame.frame, i, recorded[i].topLeftX,
+          recorded[i].topLeftY, recorded[i].width, recorded[i].height,
+          vp.TopLeftX, vp.TopLeftY, vp.Width, vp.Height);
+    }
+    if (recorded.size() > MAX_VIEWPORTS)
+      m_result->invalidCalls++;
+    if (rewritten)
+      stats.rewritten++;
+  }
+
+  void CopyRegion(const Record &record) {
+    TraceCopyRegion copy;
+    if (!ReadPayload(record, &copy))
+      return;
+
+    if (record.stage == TRACE_STAGE_DRIVER) {
+      if (!m_copyPending)
+        return;
+      m_copyPending = false;
+      Compared(REPLAY_COPY_REGION,
+               copy.dstX == m_copy.dstX && copy.dstY == m_copy.dstY &&
+                   copy.hasBox == m_copy.hasBox &&
+                   (!copy.hasBox || SameBox(m_copyBox, copy.box)));
+      return;
+    }
+
+    ReplayHookStats &stats = m_result->hooks[REPLAY_COPY_REGION];
+    stats.calls++;
+    Written(copy.dst);
+    const TraceTextureDesc *src = Find(copy.src);
+    const TraceTextureDesc *dst = Find(copy.dst);
+    m_copy = copy;
+    m_copyBox = {copy.box.left,  copy.box.top,    copy.box.front,
+                 copy.box.right, copy.box.bottom, copy.box.back};
+    D3D11_BOX box = m_copyBox;
+
+    bool rewritten = false;
+    Clock::time_point start = Clock::now();
+    if (m_upscale && src && dst)
+      rewritten = RewriteCopyRegion(
+          m_size, src->width, src->height, dst->width, dst->height,
+          copy.hasBox ? &box : nullptr, &m_copy.dstX, &m_copy.dstY,
+          &m_copyBox);
+    Timed(REPLAY_COPY_REGION, start);
+    m_copyPending = true;
+
+    if (rewritten) {
+      stats.rewritten++;
+      Log("frame %llu CopySubresourceRegion (%u, %u) [%u, %u, %u, %u] -> "
+          "(%u, %u) [%u, %u, %u, %u]\n",
+          (unsigned long long)m_frame.frame, copy.dstX, copy.dstY,
+          box.left, box.top, box.right, box.bottom, m_copy.dstX,
+          m_copy.dstY, m_copyBox.left, m_copyBox.top, m_copyBox.right,
+          m_copyBox.bottom);
+    }
+
+    // The copy as the runtime sees it: the box within the source
+    // subresource and its extent within the destination
+    if (!src || !dst) {
+      m_result->invalidCalls++;
+      return;
+    }
+    uint32_t srcWidth = MipSize(src->width, copy.srcSubresource,
+                                src->mipLevels);
+    uint32_t srcHeight = MipSize(src->height, copy.srcSubresource,
+                                 src->mipLevels);
+    uint32_t dstWidth = MipSize(dst->width, copy.dstSubresource,
+                                dst->mipLevels);
+    uint32_t dstHeight = MipSize(dst->height, copy.dstSubresource,
+                                 dst->mipLevels);
+    uint32_t width = srcWidth, height = srcHeight;
+    if (copy.hasBox) {
+      if (m_copyBox.right > srcWidth || m_copyBox.bottom > srcHeight ||
+          m_copyBox.left > m_copyBox.right ||
+          m_copyBox.top > m_copyBox.bottom) {
+        m_result->invalidCalls++;
+        return;
+      }
+      width = m_copyBox.right - m_copyBox.left;
+      height = m_copyBox.bottom - m_copyBox.top;
+    }
+    if (m_copy.dstX > dstWidth || width > dstWidth - m_copy.dstX ||
+        m_copy.dstY > dstHeight || height > dstHeight - m_copy.dstY)
+      m_result->invalidCalls++;
+  }
+
+  void ShaderResources(const Record &record) {
+    uint32_t startSlot;
+    std::vector<uint64_t> ids;
+    if (!ReadPayload(record, &startSlot) || !ReadList(record, 4, &ids))
+      return;
+
+    if (record.stage == TRACE_STAGE_DRIVER) {
+      if (!m_bindPending)
+        return;
+      m_bindPending = false;
+      // Staged binds come out as the recording did
+      for (size_t slot : m_staged) {
+        if (slot >= ids.size() || ids[slot] == m_bound[slot])
+          continue;
+        m_verdicts[m_bound[slot]] = {VERDICT_REPLACED, ids[slot]};
+        m_result->bindReplaced++;
+        m_bound[slot] = ids[slot];
+      }
+      Compared(REPLAY_SHADER_RESOURCES,
+               startSlot == m_bindStartSlot && ids == m_bound);
+      return;
+    }
+
+    ReplayHookStats &stats = m_result->hooks[REPLAY_SHADER_RESOURCES];
+    stats.calls++;
+    m_bound = ids;
+    m_bindStartSlot = startSlot;
+    m_staged.clear();
+
+    bool rewritten = false;
+    Clock::time_point start = Clock::now();
+    for (size_t slot = 0; slot < m_bound.size(); ++slot) {
+      uint64_t id = m_bound[slot];
+      const TraceTextureDesc *desc = id ? Find(id) : nullptr;
+      if (!desc)
+        continue;
+      auto verdict = m_verdicts.find(id);
+      if (verdict != m_verdicts.end()) {
+        m_result->bindCached++;
+        if (verdict->second.kind == VERDICT_REPLACED) {
+          m_bound[slot] = verdict->second.replacement;
+          rewritten = true;
+        }
+        continue;
+      }
+      if (!m_filter.replaceEnabled && !m_filter.dumpEnabled)
+        continue;
+      BindSkip skip =
+          GetBindSkip(m_filter, desc->width, desc->height,
+                      (DXGI_FORMAT)desc->format, IsRenderTarget(*desc), false);
+      if (skip != BIND_SKIP_NONE) {
+        m_verdicts[id] = {VERDICT_SKIP, 0};
+        m_result->bindSkipped[skip]++;
+        continue;
+      }
+      // Staged; what it is replaced with is settled by the driver record
+      m_verdicts[id] = {VERDICT_NO_MATCH, 0};
+      m_result->bindStaged++;
+      m_staged.push_back(slot);
+    }
+    Timed(REPLAY_SHADER_RESOURCES, start);
+    m_bindPending = true;
+
+    if (rewritten) {
+      stats.rewritten++;
+      for (size_t slot = 0; slot < ids.size(); ++slot) {
+        if (ids[slot] != m_bound[slot])
+          Log("frame %llu PSSetShaderResources[%zu] %#llx -> %#llx\n",
+              (unsigned long long)m_frame.frame, startSlot + slot,
+              (unsigned long long)ids[slot],
+              (unsigned long long)m_bound[slot]);
+      }
+    }
+  }
+
+  struct Create {
+    TraceTextureDesc replayed;
+    bool rewritten;
+    bool compared; // Its driver record has been seen
+  };
+
+  const ReplayOptions &m_options;
+  const Recorded &m_recorded;
+  ReplayResult *m_result;
+  UpscaleSize m_size;
+  bool m_upscale;
+  float m_ratio;
+  BindFilter m_filter = {};
+  std::set<std::pair<uint32_t, uint32_t>> m_replacementSizes;
+  double m_timerNs = 0.0;
+
+  // Fake device state
+  TraceFrame m_frame = {};
+  std::unordered_map<uint64_t, TraceTextureDesc> m_textures;
+  std::unordered_map<uint64_t, Verdict> m_verdicts;
+  uint64_t m_boundTarget = 0;
+  std::vector<Create> m_creates; // Open creates, innermost last
+
+  // The last game call of each kind, as replayed, for its driver record
+  std::vector<D3D11_VIEWPORT> m_viewports;
+  bool m_viewportsPending = false;
+  TraceCopyRegion m_copy = {};
+  D3D11_BOX m_copyBox = {};
+  bool m_copyPending = false;
+  std::vector<uint64_t> m_bound;
+  uint32_t m_bindStartSlot = 0;
+  std::vector<size_t> m_staged;
+  bool m_bindPending = false;
+};
+
+void Replayer::Log(const char *format, ...) {
+  if (!m_options.log)
+    return;
+  va_list args;
+  va_start(args, format);
+  vfprintf(m_options.log, format, args);
+  va_end(args);
+}
+} // namespace
+
+const char *ReplayHookName(ReplayHook hook) {
+  switch (hook) {
+  case REPLAY_CREATE_TEXTURE:
+    return "CreateTexture2D";
+  case REPLAY_VIEWPORTS:
+    return "RSSetViewports";
+  case REPLAY_COPY_REGION:
+    return "CopySubresourceRegion";
+  case REPLAY_SHADER_RESOURCES:
+    return "PSSetShaderResources";
+  default:
+    return "?";
+  }
+}
+
+bool ReplayTrace(const uint8_t *data, size_t size,
+                 const ReplayOptions &options, ReplayResult *result) {
+  *result = ReplayResult();
+  RecordReader reader(data, size);
+  if (!reader.ReadHeader(&result->error))
+    return false;
+
+  ViewportUtils::LoadViewportRules(options.rulesPath);
+  Recorded recorded = InspectRecording(data, size);
+  Replayer replayer(options, recorded, result);
+  Record record;
+  while (reader.Next(&record, &result->error))
+    replayer.Replay(record);
+  return result->error.empty();
+}
+
+void PrintReplayReport(const ReplayResult &result, FILE *out) {
+  fprintf(out, "%llu records, %llu frames, upscale %gx, widescreen %g\n\n",
+          (unsigned long long)result.records,
+          (unsigned long long)result.frames, result.upscaleScale,
+          result.widescreenRatio);
+  fprintf(out, "%-22s %9s %9s %9s %9s %9s\n", "hook", "calls", "rewritten",
+          "matched", "differed", "ns/call");
+  for (int i = 0; i < REPLAY_HOOK_COUNT; ++i) {
+    const ReplayHookStats &hook = result.hooks[i];
+    fprintf(out, "%-22s %9llu %9llu %9llu %9llu %9.1f\n",
+            ReplayHookName((ReplayHook)i), (unsigned long long)hook.calls,
+            (unsigned long long)hook.rewritten,
+            (unsigned long long)hook.matched,
+            (unsigned long long)hook.differed,
+            hook.calls ? hook.ns / hook.calls : 0.0);
+  }
+  fprintf(out,
+          "\nbinds: %llu cached, %llu staged (%llu replaced), skipped %llu "
+          "upscaled, %llu unsupported, %llu without replacement\n",
+          (unsigned long long)result.bindCached,
+          (unsigned long long)result.bindStaged,
+          (unsigned long long)result.bindReplaced,
+          (unsigned long long)result.bindSkipped[BIND_SKIP_UPSCALED_TARGET],
+          (unsigned long long)result.bindSkipped[BIND_SKIP_UNSUPPORTED],
+          (unsigned long long)result.bindSkipped[BIND_SKIP_NO_REPLACEMENT]);
+  fprintf(out, "invalid calls: %llu\n",
+          (unsigned long long)result.invalidCalls);
+  if (!result.error.empty())
+    fprintf(out, "error: %s\n", result.error.c_str());
+}
@@ -0,0 +1,83 @@
+// Trace Replay - runs a recorded call trace (patches/call_trace.h) through
+// CrossFix's rewrite logic on the CPU, off Windows
+#pragma once
+
+#include "../patches/texture_filter.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Each call the game made (TRACE_STAGE_GAME) goes through the same code the
+// hooks run: the UI viewport rules (viewport_utils.h), the upscale rewrites
+// of viewports, copy boxes and render target creation (upscale_rewrite.h)
+// and the bind-time descriptor filter (texture_filter.h), in hook order.
+// The result goes to a fake device that keeps the texture table and the
+// bound render target the rewrites depend on, and checks each call the way
+// the D3D11 runtime would. It is compared with the call CrossFix actually
+// passed on (TRACE_STAGE_DRIVER), when the trace has one.
+//
+// Bind-time replacement depends on texture contents, which traces don't
+// carry: a bind the filter lets through is counted as staged, and whether it
+// was replaced is taken from the recording. The verdict is then cached
+// until the texture is written, as the hook does.
+
+// Settings to replay with. Scale, ratio and replacement sizes default to
+// what the recording shows.
+struct ReplayOptions {
+  float upscaleScale = 0.0f;    // 1 = off, 0 = as recorded
+  float widescreenRatio = 0.0f; // 1 = off, 0 = as recorded
+  std::string rulesPath;        // Viewport rules file, as mods/viewport_rules
+  bool dumpEnabled = false;
+  // Sizes replacement files exist at; from the recorded replacements when
+  // replacementsKnown is false
+  std::vector<std::pair<uint32_t, uint32_t>> replacementSizes;
+  bool replacementsKnown = false;
+  FILE *log = nullptr; // Each call the rewrites changed, if set
+};
+
+enum ReplayHook {
+  REPLAY_CREATE_TEXTURE,
+  REPLAY_VIEWPORTS,
+  REPLAY_COPY_REGION,
+  REPLAY_SHADER_RESOURCES,
+  REPLAY_HOOK_COUNT,
+};
+
+struct ReplayHookStats {
+  uint64_t calls;
+  uint64_t rewritten; // Passed on with different arguments
+  uint64_t matched;   // Same as the recorded driver call
+  uint64_t differed;  // Different from it
+  double ns;          // Time in the rewrite logic, timer overhead removed
+};
+
+struct ReplayResult {
+  uint64_t records;
+  uint64_t frames;
+  float upscaleScale;
+  float widescreenRatio;
+  ReplayHookStats hooks[REPLAY_HOOK_COUNT];
+
+  // Bound textures by what the bind hook did with them
+  uint64_t bindCached;      // Verdict cached since the last write
+  uint64_t bindStaged;      // Would be staged and hashed
+  uint64_t bindReplaced;    // Staged, and the recording replaced it
+  uint64_t bindSkipped[4];  // By BindSkip
+
+  // Calls the fake device rejected, as D3D11 would drop them
+  uint64_t invalidCalls;
+
+  std::string error; // Why the trace couldn't be read to its end
+};
+
+const char *ReplayHookName(ReplayHook hook);
+
+// False if the trace isn't a CFXTRACE file or ends mid-record. The records
+// before that are replayed either way.
+bool ReplayTrace(const uint8_t *data, size_t size,
+                 const ReplayOptions &options, ReplayResult *result);
+
+// Per-hook table and bind/device summary
+void PrintReplayReport(const ReplayResult &result, FILE *out);
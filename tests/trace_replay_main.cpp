@@ -0,0 +1,91 @@
+// Trace replayer: runs a crossfix.trace through the rewrite logic and
+// reports per-hook timings and how the rewritten calls compare with what
+// CrossFix passed on when it was recorded (see trace_replay.h).
+//
+//   trace_replay <trace> [--scale S] [--ratio R] [--rules FILE]
+//                [--replacements DIR] [--dump] [-v]
+//
+// --scale and --ratio replay with another upscale scale or widescreen ratio
+// (1 turns either off), --rules with a viewport rules file and
+// --replacements with the sizes of the replacement files in DIR instead of
+// those the recording shows. -v lists every call the rewrites changed.
+#include "trace_replay.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace {
+int Usage() {
+  fprintf(stderr, "usage: trace_replay <trace> [--scale S] [--ratio R] "
+                  "[--rules FILE] [--replacements DIR] [--dump] [-v]\n");
+  return 2;
+}
+
+// Sizes of the replacement files in dir, as texturereplace scans them
+bool ScanReplacements(const std::string &dir, ReplayOptions *options) {
+  std::error_code ec;
+  std::filesystem::directory_iterator it(dir, ec), end;
+  if (ec)
+    return false;
+  for (; it != end; it.increment(ec)) {
+    if (ec)
+      return false;
+    uint32_t width, height;
+    uint64_t hash;
+    if (it->is_regular_file(ec) &&
+        ParseReplacementFilename(it->path().filename().string(), &width,
+                                 &height, &hash))
+      options->replacementSizes.push_back({width, height});
+  }
+  options->replacementsKnown = true;
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *path = nullptr;
+  ReplayOptions options;
+  for (int i = 1; i < argc; ++i) {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--scale") && hasValue) {
+      options.upscaleScale = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--ratio") && hasValue) {
+      options.widescreenRatio = (float)atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rules") && hasValue) {
+      options.rulesPath = argv[++i];
+    } else if (!strcmp(argv[i], "--replacements") && hasValue) {
+      if (!ScanReplacements(argv[++i], &options)) {
+        fprintf(stderr, "can't read %s\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--dump")) {
+      options.dumpEnabled = true;
+    } else if (!strcmp(argv[i], "-v")) {
+      options.log = stdout;
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      return Usage();
+    }
+  }
+  if (!path)
+    return Usage();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fprintf(stderr, "can't open %s\n", path);
+    return 1;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                            std::istreambuf_iterator<char>());
+
+  ReplayResult result;
+  bool complete = ReplayTrace(data.data(), data.size(), options, &result);
+  if (options.log)
+    printf("\n");
+  PrintReplayReport(result, stdout);
+  return complete ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+// Trace replay tests: a synthetic trace, recorded at 2x upscale and a 16:9
+// widescreen ratio with one replacement, replayed as recorded and with both
+// turned off, and damaged traces rejected.
+//
+//   trace_replay_test
+#include "trace_replay.h"
+#include "../patches/call_trace.h"
+
+#include <cstring>
+
+namespace {
+int g_failures = 0;
+
+#define CHECK(cond, what)                                                      \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAIL %s:%d: %s (%s)\n", __FILE__, __LINE__, #cond,               \
+             std::string(what).c_str());                                       \
+      ++g_failures;                                                            \
+    }                                                                          \
+  } while (0)
+
+constexpr uint32_t FORMAT_RGBA8 = 28;
+constexpr uint32_t BIND_SHADER_RESOURCE = 0x8;
+constexpr uint32_t BIND_RENDER_TARGET = 0x20;
+
+class TraceWriter {
+public:
+  TraceWriter() {
+    TraceFileHeader header = {};
+    memcpy(header.magic, "CFXTRACE", 8);
+    header.version = TRACE_FILE_VERSION;
+    header.tickFrequency = 10000000;
+    Append(&header, sizeof(header));
+  }
+
+  template <typename T>
+  void Record(TraceRecordType type, TraceStage stage, const T &payload) {
+    Header(type, stage, sizeof(payload));
+    Append(&payload, sizeof(payload));
+  }
+
+  // count, then the items; startSlot first for shader resources
+  template <typename T>
+  void List(TraceRecordType type, TraceStage stage,
+            const std::vector<T> &items, const uint32_t *startSlot = nullptr) {
+    uint32_t count = (uint32_t)items.size();
+    Header(type, stage,
+           (startSlot ? 4 : 0) + sizeof(count) + count * sizeof(T));
+    if (startSlot)
+      Append(startSlot, sizeof(*startSlot));
+    Append(&count, sizeof(count));
+    Append(items.data(), count * sizeof(T));
+  }
+
+  const std::vector<uint8_t> &Data() const { return m_data; }
+
+private:
+  void Header(TraceRecordType type, TraceStage stage, size_t size) {
+    TraceRecordHeader header = {(uint16_t)type, (uint8_t)stage, 0,
+                                (uint32_t)size, ++m_ticks};
+    Append(&header, sizeof(header));
+  }
+
+  void Append(const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    m_data.insert(m_data.end(), bytes, bytes + size);
+  }
+
+  std::vector<uint8_t> m_data;
+  uint64_t m_ticks = 0;
+};
+
+TraceTextureDesc Desc(uint32_t width, uint32_t height, uint32_t bindFlags) {
+  TraceTextureDesc desc = {};
+  desc.width = width;
+  desc.height = height;
+  desc.mipLevels = 1;
+  desc.arraySize = 1;
+  desc.format = FORMAT_RGBA8;
+  desc.sampleCount = 1;
+  desc.bindFlags = bindFlags;
+  return desc;
+}
+
+// A create as the hooks record it: the game's call, the one passed on and
+// the texture made
+void Create(TraceWriter *trace, uint64_t id, const TraceTextureDesc &game,
+            const TraceTextureDesc &passed, bool initialData) {
+  trace->Record(TRACE_CREATE_TEXTURE, TRACE_STAGE_GAME,
+                TraceCreateTexture{game, initialData});
+  trace->Record(TRACE_CREATE_TEXTURE, TRACE_STAGE_DRIVER,
+                TraceCreateTexture{passed, initialData});
+  trace->Record(TRACE_TEXTURE, TRACE_STAGE_GAME, TraceTexture{id, passed});
+}
+
+void Viewport(TraceWriter *trace, const TraceViewport &game,
+              const TraceViewport &passed) {
+  trace->List(TRACE_VIEWPORTS, TRACE_STAGE_GAME,
+              std::vector<TraceViewport>{game});
+  trace->List(TRACE_VIEWPORTS, TRACE_STAGE_DRIVER,
+              std::vector<TraceViewport>{passed});
+}
+
+void Copy(TraceWriter *trace, const TraceCopyRegion &game,
+          const TraceCopyRegion &passed) {
+  trace->Record(TRACE_COPY_REGION, TRACE_STAGE_GAME, game);
+  trace->Record(TRACE_COPY_REGION, TRACE_STAGE_DRIVER, passed);
+}
+
+void Bind(TraceWriter *trace, uint64_t game, uint64_t passed) {
+  uint32_t slot = 0;
+  trace->List(TRACE_SHADER_RESOURCES, TRACE_STAGE_GAME,
+              std::vector<uint64_t>{game}, &slot);
+  trace->List(TRACE_SHADER_RESOURCES, TRACE_STAGE_DRIVER,
+              std::vector<uint64_t>{passed}, &slot);
+}
+
+// Ids: 1 and 2 render targets, 3 a sprite sheet replaced by 4, 5 a texture
+// at a size with no replacements
+std::vector<uint8_t> MakeTrace() {
+  TraceWriter trace;
+  const uint32_t RT = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+  Create(&trace, 1, Desc(4096, 2048, RT), Desc(8192, 4096, RT), false);
+  Create(&trace, 2, Desc(4096, 2048, RT), Desc(8192, 4096, RT), false);
+  Create(&trace, 3, Desc(64, 64, BIND_SHADER_RESOURCE),
+         Desc(64, 64, BIND_SHADER_RESOURCE), true);
+  Create(&trace, 4, Desc(256, 256, BIND_SHADER_RESOURCE),
+         Desc(256, 256, BIND_SHADER_RESOURCE), true);
+  trace.Record(TRACE_TEXTURE, TRACE_STAGE_GAME,
+               TraceTexture{5, Desc(128, 128, BIND_SHADER_RESOURCE)});
+
+  trace.List(TRACE_RENDER_TARGETS, TRACE_STAGE_GAME,
+             std::vector<uint64_t>{1});
+  // Full target, then the 1-person stamina bar, widened and moved
+  Viewport(&trace, {0, 0, 4096, 2048, 0, 1}, {0, 0, 8192, 4096, 0, 1});
+  Viewport(&trace, {716, 792, 212, 20, 0, 1}, {1074, 1584, 318, 40, 0, 1});
+
+  // Between upscaled targets, scaled; off the edge of the sprite sheet,
+  // clipped
+  Copy(&trace, {2, 0, 10, 20, 0, 1, 0, 1, {100, 50, 0, 300, 150, 1}},
+       {2, 0, 20, 40, 0, 1, 0, 1, {200, 100, 0, 600, 300, 1}});
+  Copy(&trace, {5, 0, 0, 0, 0, 3, 0, 1, {0, 0, 0, 100, 64, 1}},
+       {5, 0, 0, 0, 0, 3, 0, 1, {0, 0, 0, 64, 64, 1}});
+
+  Bind(&trace, 3, 4); // Staged and replaced
+  trace.Record(TRACE_FRAME, TRACE_STAGE_GAME, TraceFrame{1});
+  Bind(&trace, 3, 4); // Cached
+  trace.Record(TRACE_UPDATE_SUBRESOURCE, TRACE_STAGE_GAME,
+               TraceUpdateSubresource{3, 0, 0, {}, 256, 0});
+  Bind(&trace, 3, 3); // Written, staged again, no longer replaced
+  Bind(&trace, 1, 1); // Upscaled target
+  Bind(&trace, 5, 5); // No replacement at 128x128
+  trace.Record(TRACE_FRAME, TRACE_STAGE_GAME, TraceFrame{2});
+  return trace.Data();
+}
+
+std::string Name(int hook) { return ReplayHookName((ReplayHook)hook); }
+
+void TestAsRecorded(const std::vector<uint8_t> &trace) {
+  ReplayOptions options;
+  ReplayResult result;
+  CHECK(ReplayTrace(trace.data(), trace.size(), options, &result),
+        result.error);
+  CHECK(result.frames == 2, "frames");
+  CHECK(result.upscaleScale == 2.0f, "recorded scale");
+  CHECK(result.widescreenRatio == 0.75f, "recorded ratio");
+  CHECK(result.invalidCalls == 0, "invalid calls");
+
+  // calls, rewritten; every call matches the recording
+  const uint64_t EXPECTED[REPLAY_HOOK_COUNT][2] = {
+      {4, 2}, {2, 2}, {2, 2}, {5, 1}};
+  for (int i = 0; i < REPLAY_HOOK_COUNT; ++i) {
+    const ReplayHookStats &hook = result.hooks[i];
+    CHECK(hook.calls == EXPECTED[i][0], Name(i));
+    CHECK(hook.rewritten == EXPECTED[i][1], Name(i));
+    CHECK(hook.matched == hook.calls && hook.differed == 0, Name(i));
+  }
+
+  CHECK(result.bindCached == 1, "cached binds");
+  CHECK(result.bindStaged == 2, "staged binds");
+  CHECK(result.bindReplaced == 1, "replaced binds");
+  CHECK(result.bindSkipped[BIND_SKIP_UPSCALED_TARGET] == 1, "upscaled");
+  CHECK(result.bindSkipped[BIND_SKIP_UNSUPPORTED] == 0, "unsupported");
+  CHECK(result.bindSkipped[BIND_SKIP_NO_REPLACEMENT] == 1, "no replacement");
+}
+
+void TestSettingsOff(const std::vector<uint8_t> &trace) {
+  ReplayOptions options;
+  options.upscaleScale = 1.0f;
+  options.widescreenRatio = 1.0f;
+  ReplayResult result;
+  CHECK(ReplayTrace(trace.data(), trace.size(), options, &result),
+        result.error);
+  CHECK(result.upscaleScale == 1.0f, "scale off");
+
+  // Nothing is rewritten, so every call the recording rewrote differs
+  const ReplayHookStats *hooks = result.hooks;
+  CHECK(hooks[REPLAY_CREATE_TEXTURE].rewritten == 0, "creates");
+  CHECK(hooks[REPLAY_CREATE_TEXTURE].differed == 2, "creates");
+  CHECK(hooks[REPLAY_VIEWPORTS].rewritten == 0, "viewports");
+  CHECK(hooks[REPLAY_VIEWPORTS].differed == 2, "viewports");
+  CHECK(hooks[REPLAY_COPY_REGION].differed == 2, "copies");
+  // Unclipped, the sprite sheet copy is one D3D11 would drop
+  CHECK(result.invalidCalls == 1, "invalid calls");
+  CHECK(result.bindSkipped[BIND_SKIP_UPSCALED_TARGET] == 0, "upscaled");
+}
+
+void TestDamaged(const std::vector<uint8_t> &trace) {
+  ReplayOptions options;
+  ReplayResult full, result;
+  ReplayTrace(trace.data(), trace.size(), options, &full);
+
+  // Cut into the last record: everything before it still replays
+  CHECK(!ReplayTrace(trace.data(), trace.size() - 3, options, &result),
+        "truncated");
+  CHECK(!result.error.empty(), "truncated");
+  CHECK(result.records == full.records - 1, "truncated");
+
+  std::vector<uint8_t> wrong = trace;
+  wrong[0] = 'X';
+  CHECK(!ReplayTrace(wrong.data(), wrong.size(), options, &result),
+        "bad magic");
+  CHECK(result.records == 0, "bad magic");
+  CHECK(!ReplayTrace(trace.data(), 10, options, &result), "short header");
+}
+} // namespace
+
+int main() {
+  std::vector<uint8_t> trace = MakeTrace();
+  TestAsRecorded(trace);
+  TestSettingsOff(trace);
+  TestDamaged(trace);
+
+  if (g_failures) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("All trace replay tests passed\n");
+  return 0;
+}
@@ -0,0 +1,164 @@
+// Viewport rules benchmark: the compiled UI viewport matcher
+// (utils/viewport_utils.cpp) against the linear scan over the built-in
+// rules it replaced, on a mix of viewports like the game's: about half
+// full-target, one in ten a UI element, the rest random. Both must widen
+// the same viewports the same way. Times include re-copying the input.
+//
+//   viewport_rules_bench [passes]
+#include "../utils/viewport_utils.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+struct Viewport {
+  float TopLeftX;
+  float TopLeftY;
+  float Width;
+  float Height;
+  float MinDepth;
+  float MaxDepth;
+};
+
+constexpr uint32_t VIEWPORTS = 4096;
+constexpr float RATIO = 0.75f;
+constexpr float WILDCARD = -1.0f;
+
+// The built-in rules as the linear scan checked them:
+// { baseX, originalX, y, width, height, epsilon }
+const float RULES[][6] = {
+    {716.0f, 1996.0f, 792.0f, 212.0f, 20.0f, 1.0f},
+    {588.0f, 1868.0f, 792.0f, 472.0f, 20.0f, 1.0f},
+    {460.0f, 1740.0f, 792.0f, 724.0f, 20.0f, 1.0f},
+    {112.0f, 1392.0f, 640.0f, 272.0f, 208.0f, 1.0f},
+    {352.0f, 1632.0f, 672.0f, 32.0f, 144.0f, 1.0f},
+    {112.0f, 1392.0f, 672.0f, 32.0f, 144.0f, 1.0f},
+    {248.0f, 1528.0f, 816.0f, 104.0f, 32.0f, 1.0f},
+    {144.0f, 1424.0f, 816.0f, 104.0f, 32.0f, 1.0f},
+    {248.0f, 1528.0f, 640.0f, 104.0f, 32.0f, 1.0f},
+    {144.0f, 1424.0f, 640.0f, 104.0f, 32.0f, 1.0f},
+    {248.0f, 1528.0f, 672.0f, 104.0f, 144.0f, 1.0f},
+    {144.0f, 1424.0f, 672.0f, 104.0f, 144.0f, 1.0f},
+    {1108.0f, 2388.0f, 232.0f, 720.0f, 752.0f, 1.0f},
+    {896.0f, 2176.0f, 992.0f, WILDCARD, 32.0f, 1.0f},
+    {64.0f, 1344.0, 0.0, 256.0f, 1792.0f, 1.0f},
+    {1088.0f, 2368.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
+    {1088.0f, 2368.0f, 136.0f, 872.0f, 1500.0f, 1.0f},
+    {1088.0f, 2368.0f, 1260.0f, 500.0f, 376.0f, 1.0f},
+    {1576.0f, 1576.0f, 136.0f, 384.0f, 4.0f, 1.0f},
+    {1728.0f, 1728.0f, 136.0f, 232.0f, 4.0f, 1.0f},
+    {1196.0f, 1196.0f, 1260.0f, 392.0f, 184.0f, 1.0f},
+    {1488.0f, 1488.0f, 340.0f, 264.0f, 164.0f, 1.0f},
+    {1684.0f, 1684.0f, 504.0f, 32.0f, 4.0f, 1.0f},
+    {1616.0f, 1616.0f, 136.0f, 344.0f, 4.0f, 1.0f},
+    {1160.0f, 1160.0f, 1384.0f, 388.0f, 120.0f, 1.0f},
+    {1116.0f, 1116.0f, 1384.0f, 440.0f, 180.0f, 1.0f},
+    {1088.0f, 1088.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
+};
+
+// The matcher before the rules were compiled: the table built on the
+// stack each call, then every rule, in order, for every viewport
+void LinearWidescreenFix(Viewport *viewports, uint32_t count, float ratio) {
+  float rules[sizeof(RULES) / sizeof(*RULES)][6];
+  memcpy(rules, RULES, sizeof(RULES));
+  for (uint32_t i = 0; i < count; ++i) {
+    Viewport &vp = viewports[i];
+    for (const float *def : rules) {
+      float baseX = def[0], originalX = def[1], y = def[2];
+      float width = def[3], height = def[4], epsilon = def[5];
+      if ((width >= 0 && std::abs(vp.Width - width) >= 0.1f) ||
+          (y >= 0 && std::abs(vp.TopLeftY - y) >= epsilon) ||
+          (height >= 0 && std::abs(vp.Height - height) >= epsilon))
+        continue;
+      if (std::abs(vp.TopLeftX - baseX) >= epsilon &&
+          !(originalX > 0.0f && std::abs(vp.TopLeftX - originalX) < epsilon))
+        continue;
+      float xOffset = vp.TopLeftX - baseX;
+      vp.Width *= ratio;
+      vp.TopLeftX = baseX * ratio + xOffset;
+      break;
+    }
+  }
+}
+
+std::vector<Viewport> MakeViewports() {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(0.0f, 4096.0f);
+  std::uniform_int_distribution<int> pick(0, 99);
+  std::vector<Viewport> viewports(VIEWPORTS);
+  for (Viewport &vp : viewports) {
+    int kind = pick(rng);
+    if (kind < 50) {
+      vp = {0, 0, 4096, 2048, 0, 1};
+    } else if (kind < 60) {
+      // A UI element, at either of its X positions, the loading bar at
+      // any width
+      const float *def = RULES[pick(rng) % (sizeof(RULES) / sizeof(*RULES))];
+      float x = (pick(rng) & 1) && def[1] > 0 ? def[1] : def[0];
+      float width = def[3] >= 0 ? def[3] : coord(rng) / 4;
+      vp = {x, def[2], width, def[4], 0, 1};
+    } else {
+      vp = {coord(rng), coord(rng) / 2, coord(rng) / 4, coord(rng) / 8, 0, 1};
+    }
+  }
+  return viewports;
+}
+
+template <typename Fix>
+double TimeNs(int passes, const std::vector<Viewport> &input,
+              std::vector<Viewport> *output, Fix fix) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < passes; ++i) {
+    *output = input;
+    fix(output->data(), (uint32_t)output->size());
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / passes / input.size();
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  int passes = argc > 1 ? atoi(argv[1]) : 2000;
+  if (passes < 1)
+    passes = 1;
+
+  // Built-in rules only
+  ViewportUtils::LoadViewportRules("");
+  std::vector<Viewport> input = MakeViewports();
+  std::vector<Viewport> linear, compiled;
+
+  double linearNs =
+      TimeNs(passes, input, &linear, [](Viewport *vps, uint32_t count) {
+        LinearWidescreenFix(vps, count, RATIO);
+      });
+  double compiledNs =
+      TimeNs(passes, input, &compiled, [](Viewport *vps, uint32_t count) {
+        ViewportUtils::ApplyViewportWidescreenFix(vps, count, RATIO);
+      });
+
+  int widened = 0, mismatches = 0;
+  for (uint32_t i = 0; i < VIEWPORTS; ++i) {
+    if (linear[i].Width != input[i].Width ||
+        linear[i].TopLeftX != input[i].TopLeftX)
+      ++widened;
+    if (linear[i].Width != compiled[i].Width ||
+        linear[i].TopLeftX != compiled[i].TopLeftX)
+      ++mismatches;
+  }
+
+  printf("%u viewports, %d widened\n", VIEWPORTS, widened);
+  printf("%-10s %12s\n", "matcher", "ns/viewport");
+  printf("%-10s %12.1f\n", "linear", linearNs);
+  printf("%-10s %12.1f\n", "compiled", compiledNs);
+  if (mismatches) {
+    printf("%d viewport(s) widened differently\n", mismatches);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,270 @@
+// Flat Hash - open-addressing tables for hot-path lookups
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 64-bit finalizer (splitmix64). Spreads low-entropy keys such as packed
+// (width, height) pairs across the table.
+inline uint64_t FlatHashMix(uint64_t key) {
+  key ^= key >> 30;
+  key *= 0xBF58476D1CE4E5B9ULL;
+  key ^= key >> 27;
+  key *= 0x94D049BB133111EBULL;
+  key ^= key >> 31;
+  return key;
+}
+
+// Set of 64-bit keys. Linear probing over a power-of-two slot array; key 0
+// marks an empty slot and is tracked separately. Not thread-safe.
+class FlatHashSet64 {
+public:
+  FlatHashSet64() : m_count(0), m_hasZero(false) {}
+
+  void Reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2)
+      capacity <<= 1;
+    if (capacity > m_slots.size())
+      Rehash(capacity);
+  }
+
+  // Returns true if the key was not already present
+  bool Insert(uint64_t key) {
+    if (key == 0) {
+      bool inserted = !m_hasZero;
+      m_hasZero = true;
+      return inserted;
+    }
+    if ((m_count + 1) * 2 > m_slots.size())
+      Rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = (size_t)FlatHashMix(key) & mask;; i = (i + 1) & mask) {
+      if (m_slots[i] == key)
+        return false;
+      if (m_slots[i] == 0) {
+        m_slots[i] = key;
+        m_count++;
+        return true;
+      }
+    }
+  }
+
+  bool Contains(uint64_t key) const {
+    if (key == 0)
+      return m_hasZero;
+    if (m_slots.empty())
+      return false;
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = (size_t)FlatHashMix(key) & mask;; i = (i + 1) & mask) {
+      if (m_slots[i] == key)
+        return true;
+      if (m_slots[i] == 0)
+        return false;
+    }
+  }
+
+  size_t Size() const { return m_count + (m_hasZero ? 1 : 0); }
+
+  void Clear() {
+    m_slots.clear();
+    m_count = 0;
+    m_hasZero = false;
+  }
+
+private:
+  void Rehash(size_t capacity) {
+    std::vector<uint64_t> old;
+    old.swap(m_slots);
+    m_slots.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for (uint64_t key : old) {
+      if (key == 0)
+        continue;
+      size_t i = (size_t)FlatHashMix(key) & mask;
+      while (m_slots[i] != 0)
+        i = (i + 1) & mask;
+      m_slots[i] = key;
+    }
+  }
+
+  std::vector<uint64_t> m_slots;
+  size_t m_count;
+  bool m_hasZero;
+};
+
+// Fixed-capacity pointer -> pointer map with lock-free reads (seqlock per
+// slot). Writers must be serialized by the caller. A reader that sees a slot
+// mid-write, or a table being compacted, reports a miss - so a miss only
+// means "ask the authoritative (locked) store", never "absent".
+class SeqlockPointerMap {
+public:
+  // capacity must be a power of two
+  explicit SeqlockPointerMap(size_t capacity)
+      : m_slots(capacity), m_mask(capacity - 1), m_used(0), m_live(0),
+        m_generation(0) {}
+
+  SeqlockPointerMap(const SeqlockPointerMap &) = delete;
+  SeqlockPointerMap &operator=(const SeqlockPointerMap &) = delete;
+
+  // Lock-free. A nonzero useStamp is recorded on the slot (see GetLastUsed).
+  // On a miss, *outAbsent (if given) is set when the key was definitely not
+  // in the table, as opposed to a read that raced a writer.
+  bool Find(const void *key, void **outValue, DWORD useStamp = 0,
+            bool *outAbsent = nullptr) {
+    if (outAbsent)
+      *outAbsent = false;
+    LONG generation = m_generation;
+    size_t i = SlotFor(key);
+    for (size_t n = 0; n <= m_mask; ++n, i = (i + 1) & m_mask) {
+      Slot &s = m_slots[i];
+      LONG seq = s.seq;
+      if (seq & 1)
+        return false;
+      void *slotKey = s.key;
+      void *slotValue = s.value;
+      if (s.seq != seq)
+        return false;
+      if (slotKey == nullptr) {
+        // Slots are emptied only by Clear/Compact
+        if (outAbsent)
+          *outAbsent = !(generation & 1) && m_generation == generation;
+        return false;
+      }
+      if (slotKey == key) {
+        *outValue = slotValue;
+        if (useStamp)
+          s.lastUsed = useStamp;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Writer only. Returns false if the table is full.
+  bool Insert(const void *key, void *value, DWORD useStamp = 0) {
+    Slot *existing = FindSlot(key);
+    if (existing) {
+      if (useStamp)
+        existing->lastUsed = useStamp;
+      Write(*existing, existing->key, value);
+      return true;
+    }
+    if ((m_used + 1) * 4 > m_slots.size() * 3) {
+      if ((m_live + 1) * 4 > m_slots.size() * 3)
+        return false;
+      Compact();
+    }
+    size_t i = SlotFor(key);
+    while (m_slots[i].key != nullptr && m_slots[i].key != Tombstone())
+      i = (i + 1) & m_mask;
+    if (m_slots[i].key == nullptr)
+      m_used++;
+    m_live++;
+    m_slots[i].lastUsed = useStamp;
+    Write(m_slots[i], const_cast<void *>(key), value);
+    return true;
+  }
+
+  // Writer only
+  void Erase(const void *key) {
+    Slot *s = FindSlot(key);
+    if (!s)
+      return;
+    Write(*s, Tombstone(), nullptr);
+    m_live--;
+  }
+
+  // Writer only
+  void Clear() {
+    InterlockedIncrement(&m_generation);
+    ClearSlots();
+    InterlockedIncrement(&m_generation);
+  }
+
+  // Writer only. Last stamp passed to Find() for this key, 0 if none/absent.
+  DWORD GetLastUsed(const void *key) const {
+    const Slot *s = const_cast<SeqlockPointerMap *>(this)->FindSlot(key);
+    return s ? s->lastUsed : 0;
+  }
+
+  size_t Size() const { return m_live; }
+
+private:
+  struct Slot {
+    Slot() : seq(0), key(nullptr), value(nullptr), lastUsed(0) {}
+    volatile LONG seq; // Odd while being written
+    void *volatile key; // nullptr = empty, Tombstone() = erased
+    void *volatile value;
+    volatile DWORD lastUsed;
+  };
+
+  static void *Tombstone() { return reinterpret_cast<void *>(1); }
+
+  void ClearSlots() {
+    for (Slot &s : m_slots) {
+      if (s.key != nullptr)
+        Write(s, nullptr, nullptr);
+    }
+    m_used = 0;
+    m_live = 0;
+  }
+
+  size_t SlotFor(const void *key) const {
+    return (size_t)FlatHashMix((uint64_t)(uintptr_t)key) & m_mask;
+  }
+
+  static void Write(Slot &s, void *key, void *value) {
+    InterlockedIncrement(&s.seq);
+    s.key = key;
+    s.value = value;
+    InterlockedIncrement(&s.seq);
+  }
+
+  Slot *FindSlot(const void *key) {
+    size_t i = SlotFor(key);
+    for (size_t n = 0; n <= m_mask; ++n, i = (i + 1) & m_mask) {
+      if (m_slots[i].key == nullptr)
+        return nullptr;
+      if (m_slots[i].key == key)
+        return &m_slots[i];
+    }
+    return nullptr;
+  }
+
+  // Drop tombstones by re-inserting live entries. Concurrent readers may
+  // miss while this runs, which is allowed.
+  void Compact() {
+    struct Live {
+      void *key;
+      void *value;
+      DWORD lastUsed;
+    };
+    std::vector<Live> live;
+    live.reserve(m_live);
+    for (const Slot &s : m_slots) {
+      if (s.key != nullptr && s.key != Tombstone())
+        live.push_back({s.key, s.value, s.lastUsed});
+    }
+    InterlockedIncrement(&m_generation);
+    ClearSlots();
+    for (const Live &e : live) {
+      size_t i = SlotFor(e.key);
+      while (m_slots[i].key != nullptr)
+        i = (i + 1) & m_mask;
+      m_slots[i].lastUsed = e.lastUsed;
+      Write(m_slots[i], e.key, e.value);
+    }
+    m_used = live.size();
+    m_live = live.size();
+    InterlockedIncrement(&m_generation);
+  }
+
+  std::vector<Slot> m_slots;
+  size_t m_mask;
+  size_t m_used; // Live + tombstones
+  size_t m_live;
+  volatile LONG m_generation; // Odd while Clear/Compact runs
+};
@@ -0,0 +1,21 @@
+#include "hook_registry.h"
+#include <iostream>
+
+namespace {
+CRITICAL_SECTION g_hookRegistryCS;
+volatile LONG g_hookRegistryCSInitialized = 0;
+} // namespace
+
+void LockHookRegistry() {
+  if (InterlockedCompareExchange(&g_hookRegistryCSInitialized, 1, 0) == 0) {
+    InitializeCriticalSection(&g_hookRegistryCS);
+  }
+  EnterCriticalSection(&g_hookRegistryCS);
+}
+
+void UnlockHookRegistry() { LeaveCriticalSection(&g_hookRegistryCS); }
+
+void ReportHookRegisterFailure(int slot, int order) {
+  std::cout << "[Mod] Warning: couldn't hook vtable slot " << slot
+            << " (order " << order << ")" << std::endl;
+}
@@ -0,0 +1,317 @@
+// Hook Registry - shared D3D11/DXGI vtable hooks with ordered handlers
+#pragma once
+#include "memory.h"
+#include "viewport_utils.h"
+#include <Windows.h>
+#include <d3d11.h>
+#include <dxgi1_2.h>
+
+// Several patches hook the same vtable slots. Rather than each one swapping
+// the entry and chaining into whatever it found there (so the install order
+// decided who ran first, and a later hook could shadow an earlier one), a
+// slot is patched once with a dispatcher that runs the registered handlers
+// in HookOrder and then the original method. A handler receives the call's
+// arguments and `next`, the rest of the chain: it may act before or after
+// calling it, pass different arguments, or not call it at all.
+//
+//   void Hooked_CopyResource(const CopyResourceHook::Next &next,
+//                            ID3D11DeviceContext *This,
+//                            ID3D11Resource *pDst, ID3D11Resource *pSrc) {
+//     next(This, pDst, pSrc);
+//     MarkTextureDirty(pDst);
+//   }
+//   CopyResourceHook::Register(pContext, HOOK_ORDER_TEXTURE_DUMP,
+//                              Hooked_CopyResource);
+
+// Lower runs first, seeing the arguments before later handlers change them
+enum HookOrder {
+  HOOK_ORDER_PROFILE_CALL = -100, // Times the whole call
+  HOOK_ORDER_TRACE_GAME = 0,      // Call as the game made it
+  HOOK_ORDER_TEXTURE_DUMP = 100,  // Dirty tracking in the game's coordinates
+  HOOK_ORDER_VIEWPORT_FIX = 200,  // Widescreen UI, before any rescaling
+  HOOK_ORDER_UPSCALE = 300,
+  HOOK_ORDER_SAMPLER_OVERRIDE = 400,
+  HOOK_ORDER_FRAME_TIMING = 500,
+  HOOK_ORDER_TRACE_DRIVER = 1000,    // Call as passed on to D3D
+  HOOK_ORDER_PROFILE_ORIGINAL = 2000, // Times the original method
+};
+
+// Serializes registration across all slots (hook_registry.cpp)
+void LockHookRegistry();
+void UnlockHookRegistry();
+
+// Logs a Register call that didn't take, so a patch that silently lost its
+// hook shows up in the log without every call site checking
+void ReportHookRegisterFailure(int slot, int order);
+
+// A slot's handlers, sorted by order. Immutable once published:
+// registering builds a new chain, and the old one is kept because a call
+// on another thread may still be walking it.
+template <typename R, typename... Args> class HookNext;
+
+template <typename R, typename... Args> struct HookChain {
+  typedef R (*Handler)(const HookNext<R, Args...> &next, Args... args);
+  typedef R (*Tail)(void *original, Args... args);
+
+  Tail tail; // Calls the original method
+  void *original;
+  int count;
+  const Handler *handlers; // count entries, allocated with the chain
+  const int *orders;
+};
+
+// The rest of the chain from one handler's point of view
+template <typename R, typename... Args> class HookNext {
+public:
+  typedef HookChain<R, Args...> Chain;
+  typedef typename Chain::Handler Handler;
+
+  HookNext(const Chain *chain, int index) : m_chain(chain), m_index(index) {}
+
+  R operator()(Args... args) const {
+    if (m_index < m_chain->count)
+      return m_chain->handlers[m_index](HookNext(m_chain, m_index + 1),
+                                        args...);
+    return m_chain->tail(m_chain->original, args...);
+  }
+
+private:
+  const Chain *m_chain;
+  int m_index;
+};
+
+// Work done once per call before the first handler. The default hands the
+// method's arguments to the chain as they are.
+template <typename Method> struct DirectPrologue;
+
+template <typename R, typename... Args>
+struct DirectPrologue<R(STDMETHODCALLTYPE *)(Args...)> {
+  typedef HookNext<R, Args...> Next;
+  static R Enter(const Next &next, Args... args) { return next(args...); }
+};
+
+// One vtable slot: Method is the slot's function pointer type, Slot its
+// index counting from IUnknown::QueryInterface (0). All objects registered
+// with a slot must share one vtable, which holds for the single device,
+// context and swap chain class the game uses.
+template <typename Method, int Slot,
+          typename Prologue = DirectPrologue<Method>>
+class HookSlot;
+
+template <typename R, typename... Args, int Slot, typename Prologue>
+class HookSlot<R(STDMETHODCALLTYPE *)(Args...), Slot, Prologue> {
+public:
+  typedef R(STDMETHODCALLTYPE *Method)(Args...);
+  typedef typename Prologue::Next Next;
+  typedef typename Next::Chain Chain;
+  typedef typename Next::Handler Handler;
+
+  // Patch object's vtable (first time only) and add handler at order.
+  // Registering the same handler again is a no-op. False (and logged) if
+  // the vtable can't be patched or object has a different vtable than the
+  // one already patched.
+  static bool Register(void *object, int order, Handler handler) {
+    void **vtable = object ? *(void ***)object : nullptr;
+    if (!vtable || !handler) {
+      ReportHookRegisterFailure(Slot, order);
+      return false;
+    }
+
+    LockHookRegistry();
+    bool registered = false;
+    if (s_vtable == vtable ||
+        (!s_vtable &&
+         InstallVtableHook(vtable, Slot + 1, Slot, (void *)&Dispatch,
+                           (volatile void **)&s_original, &s_installed))) {
+      s_vtable = vtable;
+      registered = AddHandler(order, handler);
+    }
+    UnlockHookRegistry();
+    if (!registered)
+      ReportHookRegisterFailure(Slot, order);
+    return registered;
+  }
+
+private:
+  static R STDMETHODCALLTYPE Dispatch(Args... args) {
+    MemoryBarrier();
+    const Chain *chain = s_chain;
+    // Between patching the vtable and publishing the first chain
+    if (!chain)
+      return ((Method)s_original)(args...);
+    return Prologue::Enter(Next(chain, 0), args...);
+  }
+
+  // Parameters are the chain's, which a prologue may have made more
+  // specific than the method's (e.g. a writable copy of a const array)
+  template <typename... ChainArgs>
+  static R CallOriginal(void *original, ChainArgs... args) {
+    return ((Method)original)(args...);
+  }
+
+  // Chains are sized to their handlers: one more than the current chain's,
+  // in a single allocation behind the chain itself
+  static bool AddHandler(int order, Handler handler) {
+    const Chain *current = s_chain;
+    int count = current ? current->count : 0;
+    for (int i = 0; i < count; ++i) {
+      if (current->handlers[i] == handler)
+        return true;
+    }
+
+    size_t size = sizeof(Chain) + sizeof(Handler) * (count + 1) +
+                  sizeof(int) * (count + 1);
+    char *block = new char[size];
+    Chain *chain = (Chain *)block;
+    Handler *handlers = (Handler *)(block + sizeof(Chain));
+    int *orders = (int *)(handlers + count + 1);
+    chain->tail = &CallOriginal;
+    chain->original = (void *)s_original;
+    chain->count = count + 1;
+    chain->handlers = handlers;
+    chain->orders = orders;
+
+    // After handlers of equal order, so ties keep registration order
+    int pos = 0;
+    while (pos < count && current->orders[pos] <= order) {
+      handlers[pos] = current->handlers[pos];
+      orders[pos] = current->orders[pos];
+      ++pos;
+    }
+    handlers[pos] = handler;
+    orders[pos] = order;
+    for (int i = pos; i < count; ++i) {
+      handlers[i + 1] = current->handlers[i];
+      orders[i + 1] = current->orders[i];
+    }
+
+    MemoryBarrier();
+    s_chain = chain;
+    return true;
+  }
+
+  static inline void **s_vtable = nullptr;
+  static inline void *volatile s_original = nullptr;
+  static inline volatile LONG s_installed = 0;
+  static inline const Chain *volatile s_chain = nullptr;
+};
+
+// RSSetViewports handlers share one writable copy of the viewports, so each
+// adjusts them in place instead of copying them again
+struct ViewportPrologue {
+  typedef HookNext<void, ID3D11DeviceContext *, UINT, D3D11_VIEWPORT *> Next;
+  static constexpr UINT MAX_VIEWPORTS =
+      D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+
+  static void Enter(const Next &next, ID3D11DeviceContext *This,
+                    UINT NumViewports, const D3D11_VIEWPORT *pViewports) {
+    if (!pViewports || NumViewports == 0) {
+      next(This, NumViewports, nullptr);
+      return;
+    }
+    D3D11_VIEWPORT vps[MAX_VIEWPORTS];
+    UINT count = ViewportUtils::CopyViewportsToBuffer(vps, MAX_VIEWPORTS,
+                                                      pViewports, NumViewports);
+    next(This, count, vps);
+  }
+};
+
+// ID3D11DeviceContext
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *, UINT, UINT,
+                                           ID3D11ShaderResourceView *const *),
+                 8>
+    PSSetShaderResourcesHook;
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                              ID3D11Resource *, UINT,
+                                              D3D11_MAP, UINT,
+                                              D3D11_MAPPED_SUBRESOURCE *),
+                 14>
+    MapHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *, UINT,
+                                           ID3D11RenderTargetView *const *,
+                                           ID3D11DepthStencilView *),
+                 33>
+    OMSetRenderTargetsHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(
+                     ID3D11DeviceContext *, UINT,
+                     ID3D11RenderTargetView *const *, ID3D11DepthStencilView *,
+                     UINT, UINT, ID3D11UnorderedAccessView *const *,
+                     const UINT *),
+                 34>
+    OMSetRenderTargetsAndUAVsHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *, UINT,
+                                           const D3D11_VIEWPORT *),
+                 44, ViewportPrologue>
+    RSSetViewportsHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11Resource *, UINT, UINT, UINT,
+                                           UINT, ID3D11Resource *, UINT,
+                                           const D3D11_BOX *),
+                 46>
+    CopySubresourceRegionHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11Resource *, ID3D11Resource *),
+                 47>
+    CopyResourceHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11Resource *, UINT,
+                                           const D3D11_BOX *, const void *,
+                                           UINT, UINT),
+                 48>
+    UpdateSubresourceHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11RenderTargetView *,
+                                           const FLOAT *),
+                 50>
+    ClearRenderTargetViewHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11UnorderedAccessView *,
+                                           const UINT *),
+                 51>
+    ClearUnorderedAccessViewUintHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11UnorderedAccessView *,
+                                           const FLOAT *),
+                 52>
+    ClearUnorderedAccessViewFloatHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(ID3D11DeviceContext *,
+                                           ID3D11Resource *, UINT,
+                                           ID3D11Resource *, UINT,
+                                           DXGI_FORMAT),
+                 57>
+    ResolveSubresourceHook;
+typedef HookSlot<void(STDMETHODCALLTYPE *)(
+                     ID3D11DeviceContext *, UINT, UINT,
+                     ID3D11UnorderedAccessView *const *, const UINT *),
+                 68>
+    CSSetUnorderedAccessViewsHook;
+
+// ID3D11Device
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(ID3D11Device *,
+                                              const D3D11_TEXTURE2D_DESC *,
+                                              const D3D11_SUBRESOURCE_DATA *,
+                                              ID3D11Texture2D **),
+                 5>
+    CreateTexture2DHook;
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(ID3D11Device *,
+                                              const D3D11_SAMPLER_DESC *,
+                                              ID3D11SamplerState **),
+                 23>
+    CreateSamplerStateHook;
+
+// DXGI
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(IDXGIFactory *, IUnknown *,
+                                              DXGI_SWAP_CHAIN_DESC *,
+                                              IDXGISwapChain **),
+                 10>
+    CreateSwapChainHook;
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(
+                     IDXGIFactory2 *, IUnknown *, HWND,
+                     const DXGI_SWAP_CHAIN_DESC1 *,
+                     const DXGI_SWAP_CHAIN_FULLSCREEN_DESC *, IDXGIOutput *,
+                     IDXGISwapChain1 **),
+                 15>
+    CreateSwapChainForHwndHook;
+typedef HookSlot<HRESULT(STDMETHODCALLTYPE *)(IDXGISwapChain *, UINT, UINT),
+                 8>
+    PresentHook;
@@ -0,0 +1,51 @@
+#include "mapped_file.h"
+
+MappedFile::MappedFile()
+    : m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_data(nullptr),
+      m_size(0) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+
+  m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (m_file == INVALID_HANDLE_VALUE)
+    return false;
+
+  // Whole-file views must fit the (32-bit) address space
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0 ||
+      (uint64_t)size.QuadPart > (uint64_t)(SIZE_MAX / 2)) {
+    Close();
+    return false;
+  }
+
+  m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_mapping) {
+    Close();
+    return false;
+  }
+
+  m_data = (const uint8_t *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!m_data) {
+    Close();
+    return false;
+  }
+  m_size = (size_t)size.QuadPart;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_data)
+    UnmapViewOfFile(m_data);
+  if (m_mapping)
+    CloseHandle(m_mapping);
+  if (m_file != INVALID_HANDLE_VALUE)
+    CloseHandle(m_file);
+  m_file = INVALID_HANDLE_VALUE;
+  m_mapping = nullptr;
+  m_data = nullptr;
+  m_size = 0;
+}
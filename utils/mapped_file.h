@@ -0,0 +1,31 @@
+// Mapped File - read-only view of a whole file
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Maps a file for reading so its contents can be parsed (or handed to the
+// device) in place, without copying them into a buffer first. Empty files
+// fail to open.
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool Open(const std::string &path);
+  void Close();
+
+  const uint8_t *GetData() const { return m_data; }
+  size_t GetSize() const { return m_size; }
+
+private:
+  HANDLE m_file;
+  HANDLE m_mapping;
+  const uint8_t *m_data;
+  size_t m_size;
+};
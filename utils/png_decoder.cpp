@@ -0,0 +1,824 @@
+#include "png_decoder.h"
+
+#include <cstring>
+#include <new>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                   \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PNG_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+// D3D11's texture size limit; anything larger could never be uploaded
+constexpr uint32_t MAX_DIMENSION = 16384;
+
+// ============================================================================
+// Inflate (RFC 1950/1951)
+// ============================================================================
+
+// Codes up to this length resolve with a single table lookup
+constexpr int FAST_BITS = 10;
+constexpr uint32_t FAST_MASK = (1u << FAST_BITS) - 1;
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                  15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                  67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                  1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                  4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                       11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+uint32_t ReverseBits(uint32_t v, int bits) {
+  v = ((v & 0xAAAA) >> 1) | ((v & 0x5555) << 1);
+  v = ((v & 0xCCCC) >> 2) | ((v & 0x3333) << 2);
+  v = ((v & 0xF0F0) >> 4) | ((v & 0x0F0F) << 4);
+  v = ((v & 0xFF00) >> 8) | ((v & 0x00FF) << 8);
+  return v >> (16 - bits);
+}
+
+// Canonical Huffman decoder. Short codes hit the fast table directly
+// (entries are length << 9 | symbol, 0 = not in table); longer ones are found
+// by comparing the bit-reversed input against each length's code limit.
+struct Huffman {
+  uint16_t fast[1 << FAST_BITS];
+  uint16_t firstCode[16];
+  uint16_t firstSymbol[16];
+  uint32_t maxCode[17];
+  uint8_t size[288];
+  uint16_t value[288];
+};
+
+bool BuildHuffman(Huffman *h, const uint8_t *lengths, int count) {
+  int sizes[17] = {};
+  int nextCode[16];
+  memset(h->fast, 0, sizeof(h->fast));
+  for (int i = 0; i < count; ++i)
+    sizes[lengths[i]]++;
+  sizes[0] = 0;
+  for (int i = 1; i < 16; ++i) {
+    if (sizes[i] > (1 << i))
+      return false;
+  }
+  int code = 0;
+  int symbol = 0;
+  for (int i = 1; i < 16; ++i) {
+    nextCode[i] = code;
+    h->firstCode[i] = (uint16_t)code;
+    h->firstSymbol[i] = (uint16_t)symbol;
+    code += sizes[i];
+    if (sizes[i] && code - 1 >= (1 << i))
+      return false; // Over-subscribed
+    h->maxCode[i] = (uint32_t)code << (16 - i);
+    code <<= 1;
+    symbol += sizes[i];
+  }
+  h->maxCode[16] = 0x10000;
+  for (int i = 0; i < count; ++i) {
+    int len = lengths[i];
+    if (!len)
+      continue;
+    int slot = nextCode[len] - h->firstCode[len] + h->firstSymbol[len];
+    h->size[slot] = (uint8_t)len;
+    h->value[slot] = (uint16_t)i;
+    if (len <= FAST_BITS) {
+      uint16_t entry = (uint16_t)((len << 9) | i);
+      for (uint32_t j = ReverseBits(nextCode[len], len); j < (1u << FAST_BITS);
+           j += 1u << len)
+        h->fast[j] = entry;
+    }
+    nextCode[len]++;
+  }
+  return true;
+}
+
+class Inflater {
+public:
+  Inflater(const uint8_t *in, size_t inSize, uint8_t *out, size_t outSize)
+      : m_in(in), m_inEnd(in + inSize), m_bits(0), m_count(0), m_pastEnd(0),
+        m_outStart(out), m_out(out), m_outEnd(out + outSize) {}
+
+  // Decodes a zlib stream; succeeds only if it fills the output exactly.
+  // The Adler-32 trailer is not verified.
+  bool Run() {
+    if (m_inEnd - m_in < 2)
+      return false;
+    uint8_t cmf = m_in[0];
+    uint8_t flg = m_in[1];
+    m_in += 2;
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0 ||
+        (flg & 0x20))
+      return false;
+
+    bool last;
+    do {
+      if (m_pastEnd > 8)
+        return false; // Ran off the end of a truncated stream
+      last = GetBits(1) != 0;
+      uint32_t type = GetBits(2);
+      bool ok;
+      if (type == 0)
+        ok = StoredBlock();
+      else if (type == 1)
+        ok = FixedBlock();
+      else if (type == 2)
+        ok = DynamicBlock();
+      else
+        ok = false;
+      if (!ok)
+        return false;
+    } while (!last);
+    return m_out == m_outEnd && m_pastEnd <= 8;
+  }
+
+private:
+  // Tops the bit buffer up to at least 56 bits. Bytes past the end of the
+  // input read as zero and are counted so truncation can be detected.
+  void Refill() {
+    if (m_inEnd - m_in >= 8) {
+      // Little-endian load; every platform this builds for is little-endian
+      uint64_t v;
+      memcpy(&v, m_in, 8);
+      m_bits |= v << m_count;
+      int bytes = (63 - m_count) >> 3;
+      m_in += bytes;
+      m_count += bytes * 8;
+      return;
+    }
+    while (m_count <= 56) {
+      uint64_t b = 0;
+      if (m_in < m_inEnd)
+        b = *m_in++;
+      else
+        m_pastEnd++;
+      m_bits |= b << m_count;
+      m_count += 8;
+    }
+  }
+
+  uint32_t GetBits(int n) {
+    if (m_count < n)
+      Refill();
+    uint32_t v = (uint32_t)(m_bits & ((1ull << n) - 1));
+    m_bits >>= n;
+    m_count -= n;
+    return v;
+  }
+
+  int Decode(const Huffman &h) {
+    if (m_count < 16)
+      Refill();
+    uint32_t entry = h.fast[m_bits & FAST_MASK];
+    if (entry) {
+      int len = entry >> 9;
+      m_bits >>= len;
+      m_count -= len;
+      return entry & 511;
+    }
+    uint32_t k = ReverseBits((uint32_t)(m_bits & 0xFFFF), 16);
+    int len = FAST_BITS + 1;
+    while (k >= h.maxCode[len])
+      len++;
+    if (len >= 16)
+      return -1;
+    int slot = (int)(k >> (16 - len)) - h.firstCode[len] + h.firstSymbol[len];
+    if (slot < 0 || slot >= 288 || h.size[slot] != len)
+      return -1;
+    m_bits >>= len;
+    m_count -= len;
+    return h.value[slot];
+  }
+
+  bool StoredBlock() {
+    // Drop to a byte boundary and hand unread whole bytes back to the input
+    GetBits(m_count & 7);
+    size_t buffered = (size_t)(m_count >> 3);
+    size_t padding = buffered < m_pastEnd ? buffered : m_pastEnd;
+    m_in -= buffered - padding;
+    m_bits = 0;
+    m_count = 0;
+    m_pastEnd = 0;
+
+    if (m_inEnd - m_in < 4)
+      return false;
+    uint32_t len = m_in[0] | (m_in[1] << 8);
+    uint32_t nlen = m_in[2] | (m_in[3] << 8);
+    m_in += 4;
+    if ((len ^ 0xFFFF) != nlen || len > (size_t)(m_inEnd - m_in) ||
+        len > (size_t)(m_outEnd - m_out))
+      return false;
+    memcpy(m_out, m_in, len);
+    m_in += len;
+    m_out += len;
+    return true;
+  }
+
+  bool FixedBlock() {
+    uint8_t lengths[288 + 32];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    memset(lengths + 288, 5, 32);
+    if (!BuildHuffman(&m_literals, lengths, 288) ||
+        !BuildHuffman(&m_distances, lengths + 288, 32))
+      return false;
+    return DecodeSymbols();
+  }
+
+  bool DynamicBlock() {
+    int literalCount = (int)GetBits(5) + 257;
+    int distanceCount = (int)GetBits(5) + 1;
+    int codeLengthCount = (int)GetBits(4) + 4;
+    if (literalCount > 286 || distanceCount > 30)
+      return false;
+
+    uint8_t codeLengthSizes[19] = {};
+    for (int i = 0; i < codeLengthCount; ++i)
+      codeLengthSizes[CODE_LENGTH_ORDER[i]] = (uint8_t)GetBits(3);
+    Huffman codeLengths;
+    if (!BuildHuffman(&codeLengths, codeLengthSizes, 19))
+      return false;
+
+    uint8_t lengths[286 + 30];
+    int total = literalCount + distanceCount;
+    int n = 0;
+    while (n < total) {
+      int sym = Decode(codeLengths);
+      if (sym < 0 || sym > 18)
+        return false;
+      if (sym < 16) {
+        lengths[n++] = (uint8_t)sym;
+        continue;
+      }
+      uint8_t fill = 0;
+      int repeat;
+      if (sym == 16) {
+        if (n == 0)
+          return false;
+        fill = lengths[n - 1];
+        repeat = 3 + (int)GetBits(2);
+      } else if (sym == 17) {
+        repeat = 3 + (int)GetBits(3);
+      } else {
+        repeat = 11 + (int)GetBits(7);
+      }
+      if (total - n < repeat)
+        return false;
+      memset(lengths + n, fill, repeat);
+      n += repeat;
+    }
+    if (lengths[256] == 0)
+      return false; // No end-of-block code
+    if (!BuildHuffman(&m_literals, lengths, literalCount) ||
+        !BuildHuffman(&m_distances, lengths + literalCount, distanceCount))
+      return false;
+    return DecodeSymbols();
+  }
+
+  bool DecodeSymbols() {
+    for (;;) {
+      int sym = Decode(m_literals);
+      if (sym < 256) {
+        if (sym < 0 || m_out == m_outEnd)
+          return false;
+        *m_out++ = (uint8_t)sym;
+        continue;
+      }
+      if (sym == 256)
+        return true;
+      sym -= 257;
+      if (sym >= 29)
+        return false;
+      size_t len = LENGTH_BASE[sym] + GetBits(LENGTH_EXTRA[sym]);
+      int d = Decode(m_distances);
+      if (d < 0 || d >= 30)
+        return false;
+      size_t dist = DIST_BASE[d] + GetBits(DIST_EXTRA[d]);
+      if (dist > (size_t)(m_out - m_outStart) ||
+          len > (size_t)(m_outEnd - m_out))
+        return false;
+      CopyMatch(m_out, dist, len);
+      m_out += len;
+    }
+  }
+
+  static void CopyMatch(uint8_t *out, size_t dist, size_t len) {
+    const uint8_t *src = out - dist;
+    if (dist == 1) {
+      memset(out, *src, len);
+    } else if (dist >= 8) {
+      // Each 8-byte chunk only reads bytes that are already written
+      while (len >= 8) {
+        memcpy(out, src, 8);
+        out += 8;
+        src += 8;
+        len -= 8;
+      }
+      while (len--)
+        *out++ = *src++;
+    } else {
+      while (len--)
+        *out++ = *src++;
+    }
+  }
+
+  const uint8_t *m_in;
+  const uint8_t *m_inEnd;
+  uint64_t m_bits;
+  int m_count;
+  size_t m_pastEnd; // Zero bytes fed in beyond the input
+  uint8_t *m_outStart;
+  uint8_t *m_out;
+  uint8_t *m_outEnd;
+  Huffman m_literals;
+  Huffman m_distances;
+};
+
+// ============================================================================
+// Scanline unfiltering
+// ============================================================================
+
+enum PngFilter : uint8_t {
+  FILTER_NONE = 0,
+  FILTER_SUB = 1,
+  FILTER_UP = 2,
+  FILTER_AVERAGE = 3,
+  FILTER_PAETH = 4,
+};
+
+uint8_t PaethPredictor(int a, int b, int c) {
+  int pa = b - c;
+  int pb = a - c;
+  int pc = pa + pb;
+  pa = pa < 0 ? -pa : pa;
+  pb = pb < 0 ? -pb : pb;
+  pc = pc < 0 ? -pc : pc;
+  if (pa <= pb && pa <= pc)
+    return (uint8_t)a;
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+void UnfilterRowScalar(uint8_t filter, uint8_t *cur, const uint8_t *prev,
+                       size_t rowBytes, size_t bpp, size_t start) {
+  switch (filter) {
+  case FILTER_SUB:
+    for (size_t i = start < bpp ? bpp : start; i < rowBytes; ++i)
+      cur[i] = (uint8_t)(cur[i] + cur[i - bpp]);
+    break;
+  case FILTER_UP:
+    for (size_t i = start; i < rowBytes; ++i)
+      cur[i] = (uint8_t)(cur[i] + prev[i]);
+    break;
+  case FILTER_AVERAGE:
+    for (size_t i = start; i < rowBytes; ++i) {
+      int a = i >= bpp ? cur[i - bpp] : 0;
+      cur[i] = (uint8_t)(cur[i] + ((a + prev[i]) >> 1));
+    }
+    break;
+  case FILTER_PAETH:
+    for (size_t i = start; i < rowBytes; ++i) {
+      int a = i >= bpp ? cur[i - bpp] : 0;
+      int c = i >= bpp ? prev[i - bpp] : 0;
+      cur[i] = (uint8_t)(cur[i] + PaethPredictor(a, prev[i], c));
+    }
+    break;
+  }
+}
+
+#ifdef PNG_DECODER_SSE2
+// Per-pixel loads/stores for 3- and 4-byte pixels. A 3-byte load reads one
+// byte past the pixel, so row buffers carry padding; stores write exactly
+// bpp bytes.
+__m128i LoadPixel(const uint8_t *p) {
+  int v;
+  memcpy(&v, p, 4);
+  return _mm_cvtsi32_si128(v);
+}
+
+void StorePixel(uint8_t *p, __m128i v, size_t bpp) {
+  int x = _mm_cvtsi128_si32(v);
+  memcpy(p, &x, bpp);
+}
+
+__m128i Select(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+__m128i Abs16(__m128i v) {
+  return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// Returns the number of leading bytes handled; the scalar path finishes the
+// rest. Up works on any pixel size, the others on 3- and 4-byte pixels.
+size_t UnfilterRowSSE2(uint8_t filter, uint8_t *cur, const uint8_t *prev,
+                       size_t rowBytes, size_t bpp) {
+  size_t i = 0;
+  if (filter == FILTER_UP) {
+    for (; i + 16 <= rowBytes; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(cur + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(prev + i));
+      _mm_storeu_si128((__m128i *)(cur + i), _mm_add_epi8(x, b));
+    }
+    return i;
+  }
+  if (bpp != 3 && bpp != 4)
+    return 0;
+
+  const __m128i zero = _mm_setzero_si128();
+  if (filter == FILTER_SUB && bpp == 4) {
+    // Prefix sum of four pixels per register, carried across registers
+    __m128i carry = zero;
+    for (; i + 16 <= rowBytes; i += 16) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(cur + i));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, carry);
+      _mm_storeu_si128((__m128i *)(cur + i), x);
+      carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    return i;
+  }
+  if (filter == FILTER_SUB) {
+    __m128i a = zero;
+    for (; i + bpp <= rowBytes; i += bpp) {
+      a = _mm_add_epi8(LoadPixel(cur + i), a);
+      StorePixel(cur + i, a, bpp);
+    }
+    return i;
+  }
+  if (filter == FILTER_AVERAGE) {
+    // avg_epu8 rounds up; subtract the carry bit to get floor((a + b) / 2)
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = zero;
+    for (; i + bpp <= rowBytes; i += bpp) {
+      __m128i b = LoadPixel(prev + i);
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+                                 _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(LoadPixel(cur + i), avg);
+      StorePixel(cur + i, a, bpp);
+    }
+    return i;
+  }
+  if (filter == FILTER_PAETH) {
+    // 16-bit lanes: pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|, ties
+    // resolved in the order a, b, c as the spec requires
+    const __m128i low = _mm_set1_epi16(0xFF);
+    __m128i a = zero;
+    __m128i c = zero;
+    for (; i + bpp <= rowBytes; i += bpp) {
+      __m128i b = _mm_unpacklo_epi8(LoadPixel(prev + i), zero);
+      __m128i x = _mm_unpacklo_epi8(LoadPixel(cur + i), zero);
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = Abs16(_mm_add_epi16(pa, pb));
+      pa = Abs16(pa);
+      pb = Abs16(pb);
+      __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      __m128i nearest =
+          Select(_mm_cmpeq_epi16(pa, smallest), a,
+                 Select(_mm_cmpeq_epi16(pb, smallest), b, c));
+      a = _mm_and_si128(_mm_add_epi16(x, nearest), low);
+      c = b;
+      StorePixel(cur + i, _mm_packus_epi16(a, a), bpp);
+    }
+    return i;
+  }
+  return 0;
+}
+#endif
+
+void UnfilterRow(uint8_t filter, uint8_t *cur, const uint8_t *prev,
+                 size_t rowBytes, size_t bpp) {
+  if (filter == FILTER_NONE)
+    return;
+  size_t done = 0;
+#ifdef PNG_DECODER_SSE2
+  done = UnfilterRowSSE2(filter, cur, prev, rowBytes, bpp);
+#endif
+  if (done < rowBytes)
+    UnfilterRowScalar(filter, cur, prev, rowBytes, bpp, done);
+}
+
+// ============================================================================
+// Row conversion to 32bpp
+// ============================================================================
+
+enum PngColorType : uint8_t {
+  COLOR_GREY = 0,
+  COLOR_RGB = 2,
+  COLOR_PALETTE = 3,
+  COLOR_GREY_ALPHA = 4,
+  COLOR_RGBA = 6,
+};
+
+struct PngImage {
+  uint32_t width;
+  uint32_t height;
+  uint8_t bitDepth;
+  uint8_t colorType;
+  bool bgra;
+  bool hasKey; // tRNS colour key for grey/RGB images
+  uint16_t key[3];
+  uint32_t palette[256]; // Already in output byte order
+};
+
+uint32_t PackPixel(const PngImage &img, uint8_t r, uint8_t g, uint8_t b,
+                   uint8_t a) {
+  if (img.bgra)
+    return (uint32_t)b | ((uint32_t)g << 8) | ((uint32_t)r << 16) |
+           ((uint32_t)a << 24);
+  return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) |
+         ((uint32_t)a << 24);
+}
+
+// Sample x of a row packed at 1/2/4/8 bits per sample
+uint32_t PackedSample(const uint8_t *row, uint32_t x, int depth) {
+  uint32_t bit = x * depth;
+  return (row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1u << depth) - 1);
+}
+
+void SwapRedBlue(const uint8_t *src, uint8_t *dst, uint32_t width) {
+  uint32_t x = 0;
+#ifdef PNG_DECODER_SSE2
+  const __m128i ga = _mm_set1_epi32((int)0xFF00FF00);
+  const __m128i lowByte = _mm_set1_epi32(0xFF);
+  for (; x + 4 <= width; x += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    __m128i r = _mm_and_si128(v, lowByte);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), lowByte);
+    v = _mm_or_si128(_mm_and_si128(v, ga),
+                     _mm_or_si128(_mm_slli_epi32(r, 16), b));
+    _mm_storeu_si128((__m128i *)(dst + x * 4), v);
+  }
+#endif
+  for (; x < width; ++x) {
+    dst[x * 4 + 0] = src[x * 4 + 2];
+    dst[x * 4 + 1] = src[x * 4 + 1];
+    dst[x * 4 + 2] = src[x * 4 + 0];
+    dst[x * 4 + 3] = src[x * 4 + 3];
+  }
+}
+
+void ConvertRow(const PngImage &img, const uint8_t *row, uint8_t *out) {
+  uint32_t width = img.width;
+  uint32_t *dst = (uint32_t *)out;
+  bool wide = img.bitDepth == 16;
+  size_t step = wide ? 2 : 1; // 16-bit samples keep their high byte
+
+  switch (img.colorType) {
+  case COLOR_RGBA:
+    if (!wide) {
+      if (img.bgra)
+        SwapRedBlue(row, out, width);
+      else
+        memcpy(out, row, (size_t)width * 4);
+      return;
+    }
+    for (uint32_t x = 0; x < width; ++x, row += 8)
+      dst[x] = PackPixel(img, row[0], row[2], row[4], row[6]);
+    return;
+
+  case COLOR_RGB:
+    for (uint32_t x = 0; x < width; ++x, row += 3 * step) {
+      uint8_t a = 255;
+      if (img.hasKey) {
+        bool match = wide ? ((row[0] << 8 | row[1]) == img.key[0] &&
+                             (row[2] << 8 | row[3]) == img.key[1] &&
+                             (row[4] << 8 | row[5]) == img.key[2])
+                          : (row[0] == img.key[0] && row[1] == img.key[1] &&
+                             row[2] == img.key[2]);
+        if (match)
+          a = 0;
+      }
+      dst[x] = PackPixel(img, row[0], row[step], row[2 * step], a);
+    }
+    return;
+
+  case COLOR_GREY_ALPHA:
+    for (uint32_t x = 0; x < width; ++x, row += 2 * step)
+      dst[x] = PackPixel(img, row[0], row[0], row[0], row[step]);
+    return;
+
+  case COLOR_PALETTE:
+    if (img.bitDepth == 8) {
+      for (uint32_t x = 0; x < width; ++x)
+        dst[x] = img.palette[row[x]];
+    } else {
+      for (uint32_t x = 0; x < width; ++x)
+        dst[x] = img.palette[PackedSample(row, x, img.bitDepth)];
+    }
+    return;
+
+  case COLOR_GREY: {
+    static const uint8_t SCALE[9] = {0, 255, 85, 0, 17, 0, 0, 0, 1};
+    for (uint32_t x = 0; x < width; ++x) {
+      uint32_t sample;
+      uint8_t grey;
+      if (wide) {
+        sample = (uint32_t)(row[x * 2] << 8 | row[x * 2 + 1]);
+        grey = row[x * 2];
+      } else {
+        sample = img.bitDepth == 8 ? row[x]
+                                   : PackedSample(row, x, img.bitDepth);
+        grey = (uint8_t)(sample * SCALE[img.bitDepth]);
+      }
+      uint8_t a = (img.hasKey && sample == img.key[0]) ? 0 : 255;
+      dst[x] = PackPixel(img, grey, grey, grey, a);
+    }
+    return;
+  }
+  }
+}
+
+// ============================================================================
+// Chunk parsing
+// ============================================================================
+
+uint32_t ReadBE32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool IsChunk(const uint8_t *type, const char *name) {
+  return memcmp(type, name, 4) == 0;
+}
+
+int ChannelCount(uint8_t colorType) {
+  switch (colorType) {
+  case COLOR_GREY:
+  case COLOR_PALETTE:
+    return 1;
+  case COLOR_GREY_ALPHA:
+    return 2;
+  case COLOR_RGB:
+    return 3;
+  case COLOR_RGBA:
+    return 4;
+  }
+  return 0;
+}
+
+bool IsSupportedDepth(uint8_t colorType, uint8_t depth) {
+  switch (colorType) {
+  case COLOR_GREY:
+    return depth == 1 || depth == 2 || depth == 4 || depth == 8 ||
+           depth == 16;
+  case COLOR_PALETTE:
+    return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+  case COLOR_RGB:
+  case COLOR_GREY_ALPHA:
+  case COLOR_RGBA:
+    return depth == 8 || depth == 16;
+  }
+  return false;
+}
+
+struct ByteSpan {
+  const uint8_t *data;
+  size_t size;
+};
+
+bool DecodePngImpl(const uint8_t *data, size_t size, bool bgra,
+                   uint32_t *outWidth, uint32_t *outHeight,
+                   std::vector<uint8_t> *outPixels) {
+  static const uint8_t SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1A, '\n'};
+  if (size < 8 || memcmp(data, SIGNATURE, 8) != 0)
+    return false;
+
+  PngImage img = {};
+  img.bgra = bgra;
+  bool haveHeader = false;
+  uint32_t paletteSize = 0;
+  uint8_t paletteRGB[256 * 3] = {};
+  uint8_t paletteAlpha[256];
+  memset(paletteAlpha, 255, sizeof(paletteAlpha));
+  std::vector<ByteSpan> idat;
+  size_t idatSize = 0;
+
+  size_t pos = 8;
+  while (size - pos >= 12) {
+    uint32_t length = ReadBE32(data + pos);
+    const uint8_t *type = data + pos + 4;
+    const uint8_t *body = data + pos + 8;
+    if (length > size - pos - 12)
+      return false;
+    pos += 12 + (size_t)length; // CRCs are not checked
+
+    if (IsChunk(type, "IHDR")) {
+      if (length != 13 || haveHeader)
+        return false;
+      img.width = ReadBE32(body);
+      img.height = ReadBE32(body + 4);
+      img.bitDepth = body[8];
+      img.colorType = body[9];
+      if (img.width == 0 || img.height == 0 || img.width > MAX_DIMENSION ||
+          img.height > MAX_DIMENSION ||
+          !IsSupportedDepth(img.colorType, img.bitDepth) || body[10] != 0 ||
+          body[11] != 0)
+        return false;
+      if (body[12] != 0)
+        return false; // Adam7 interlacing is left to the fallback decoder
+      haveHeader = true;
+    } else if (!haveHeader) {
+      return false;
+    } else if (IsChunk(type, "PLTE")) {
+      if (length % 3 != 0 || length / 3 > 256)
+        return false;
+      paletteSize = length / 3;
+      memcpy(paletteRGB, body, length);
+    } else if (IsChunk(type, "tRNS")) {
+      if (img.colorType == COLOR_PALETTE) {
+        if (length > 256)
+          return false;
+        memcpy(paletteAlpha, body, length);
+      } else if (img.colorType == COLOR_GREY && length >= 2) {
+        img.hasKey = true;
+        img.key[0] = (uint16_t)(body[0] << 8 | body[1]);
+      } else if (img.colorType == COLOR_RGB && length >= 6) {
+        img.hasKey = true;
+        for (int i = 0; i < 3; ++i)
+          img.key[i] = (uint16_t)(body[i * 2] << 8 | body[i * 2 + 1]);
+      }
+    } else if (IsChunk(type, "IDAT")) {
+      idat.push_back({body, length});
+      idatSize += length;
+    } else if (IsChunk(type, "IEND")) {
+      break;
+    } else if (!(type[0] & 0x20)) {
+      return false; // Unknown critical chunk
+    }
+  }
+  if (!haveHeader || idat.empty())
+    return false;
+  if (img.colorType == COLOR_PALETTE) {
+    if (paletteSize == 0)
+      return false;
+    // Out-of-range indices decode as opaque black
+    for (uint32_t i = 0; i < 256; ++i) {
+      const uint8_t *rgb = paletteRGB + i * 3;
+      img.palette[i] = i < paletteSize
+                           ? PackPixel(img, rgb[0], rgb[1], rgb[2],
+                                       paletteAlpha[i])
+                           : PackPixel(img, 0, 0, 0, 255);
+    }
+  }
+
+  // Sequential IDATs form one zlib stream; only join them when split
+  std::vector<uint8_t> joined;
+  const uint8_t *stream = idat[0].data;
+  if (idat.size() > 1) {
+    joined.reserve(idatSize);
+    for (const ByteSpan &span : idat)
+      joined.insert(joined.end(), span.data, span.data + span.size);
+    stream = joined.data();
+  }
+
+  size_t bitsPerPixel = (size_t)ChannelCount(img.colorType) * img.bitDepth;
+  size_t rowBytes = ((size_t)img.width * bitsPerPixel + 7) / 8;
+  size_t bpp = bitsPerPixel >= 8 ? bitsPerPixel / 8 : 1;
+  size_t stride = rowBytes + 1; // Filter byte + scanline
+
+  // Padding covers the one-byte overread of 3-byte pixel loads
+  std::vector<uint8_t> raw(stride * img.height + 16);
+  Inflater inflater(stream, idatSize, raw.data(), stride * img.height);
+  if (!inflater.Run())
+    return false;
+
+  // Unfilter in place and convert each row while it is still in cache
+  std::vector<uint8_t> zeroRow(rowBytes + 16, 0);
+  outPixels->resize((size_t)img.width * img.height * 4);
+  const uint8_t *prev = zeroRow.data();
+  for (uint32_t y = 0; y < img.height; ++y) {
+    uint8_t *line = raw.data() + y * stride;
+    if (line[0] > FILTER_PAETH)
+      return false;
+    UnfilterRow(line[0], line + 1, prev, rowBytes, bpp);
+    ConvertRow(img, line + 1, outPixels->data() + (size_t)y * img.width * 4);
+    prev = line + 1;
+  }
+
+  *outWidth = img.width;
+  *outHeight = img.height;
+  return true;
+}
+} // namespace
+
+bool DecodePng(const uint8_t *data, size_t size, bool bgra,
+               uint32_t *outWidth, uint32_t *outHeight,
+               std::vector<uint8_t> *outPixels) {
+  try {
+    return DecodePngImpl(data, size, bgra, outWidth, outHeight, outPixels);
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+}
@@ -0,0 +1,16 @@
+// PNG Decoder - in-tree decoder for texture replacements (no COM/WIC)
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decode a PNG held in memory straight into 32bpp BGRA or RGBA rows (width *
+// 4 bytes each). Handles every non-interlaced colour type at 8 or 16 bits,
+// plus 1/2/4-bit grey and palette images; 16-bit channels keep their high
+// byte. Returns false for malformed data and for interlaced images, which the
+// caller should hand to a general-purpose decoder instead. Only depends on
+// the C++ standard library (SSE2 is used when the compiler targets it).
+bool DecodePng(const uint8_t *data, size_t size, bool bgra,
+               uint32_t *outWidth, uint32_t *outHeight,
+               std::vector<uint8_t> *outPixels);
@@ -0,0 +1,83 @@
+// Replacement Index - exact lookups for the texture replacer
+#pragma once
+
+#include "flat_hash.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Find() result for a key with no replacement
+constexpr uint32_t INVALID_REPLACEMENT_ID = 0xFFFFFFFFu;
+
+// Exact lookup: (width, height, hash) -> replacement ID.
+// Flat open-addressing table (linear probing, power-of-two capacity) so the
+// D3D hot paths hit one or two cache lines instead of walking a tree.
+class ReplacementIndex {
+public:
+  ReplacementIndex() : m_count(0) {}
+
+  void Reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2)
+      capacity <<= 1;
+    if (capacity > m_slots.size())
+      Rehash(capacity);
+  }
+
+  // Overwrites the ID if the key already exists
+  void Insert(UINT width, UINT height, uint64_t hash, uint32_t id) {
+    if ((m_count + 1) * 2 > m_slots.size())
+      Rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+    Slot *slot = Probe(width, height, hash);
+    if (slot->id == INVALID_REPLACEMENT_ID)
+      m_count++;
+    slot->hash = hash;
+    slot->width = width;
+    slot->height = height;
+    slot->id = id;
+  }
+
+  uint32_t Find(UINT width, UINT height, uint64_t hash) const {
+    if (m_slots.empty())
+      return INVALID_REPLACEMENT_ID;
+    return Probe(width, height, hash)->id;
+  }
+
+  size_t Size() const { return m_count; }
+
+private:
+  struct Slot {
+    uint64_t hash;
+    UINT width;
+    UINT height;
+    uint32_t id; // INVALID_REPLACEMENT_ID = empty
+  };
+
+  static size_t SlotFor(UINT width, UINT height, uint64_t hash) {
+    return (size_t)FlatHashMix(hash ^ (((uint64_t)width << 32) | height));
+  }
+
+  // Returns the matching slot, or the empty slot where the key would go
+  Slot *Probe(UINT width, UINT height, uint64_t hash) const {
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = SlotFor(width, height, hash) & mask;; i = (i + 1) & mask) {
+      const Slot &s = m_slots[i];
+      if (s.id == INVALID_REPLACEMENT_ID ||
+          (s.hash == hash && s.width == width && s.height == height))
+        return const_cast<Slot *>(&s);
+    }
+  }
+
+  void Rehash(size_t capacity) {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.assign(capacity, Slot{0, 0, 0, INVALID_REPLACEMENT_ID});
+    for (const Slot &s : old) {
+      if (s.id != INVALID_REPLACEMENT_ID)
+        *Probe(s.width, s.height, s.hash) = s;
+    }
+  }
+
+  std::vector<Slot> m_slots;
+  size_t m_count;
+};
@@ -123,6 +123,19 @@ int Settings::GetInt(const std::string &key, int defaultValue) const {
   }
 }
 
+float Settings::GetFloat(const std::string &key, float defaultValue) const {
+  auto it = values.find(key);
+  if (it == values.end()) {
+    return defaultValue;
+  }
+
+  try {
+    return std::stof(it->second);
+  } catch (...) {
+    return defaultValue;
+  }
+}
+
 bool Settings::GetBool(const std::string &key, bool defaultValue) const {
   auto it = values.find(key);
   if (it == values.end()) {
@@ -259,7 +272,20 @@ bool Settings::SaveDefault(const std::string &filename) {
   file << "#   Textures / upscaling\n";
   file << "# ============================================\n\n";
   file << "# Upscale: 1=off, 2=2x, 3=3x, 4=4x (experimental, may crash).\n";
+  file << "# Fractional values (e.g. 1.5, 2.5) also work.\n";
   file << "upscale_scale=1\n\n";
+  file << "# Pick upscale_scale from measured GPU frame time; the scale the "
+          "GPU\n";
+  file << "# can afford is saved and used from the next launch.\n";
+  file << "upscale_dynamic=0\n\n";
+  file << "# Bounds and GPU frame time target (ms) for upscale_dynamic.\n";
+  file << "upscale_dynamic_min=1\n";
+  file << "upscale_dynamic_max=4\n";
+  file << "upscale_dynamic_target_ms=10\n\n";
+  file << "# Back the upscaled render target only where the game draws "
+          "(needs\n";
+  file << "# tiled resources tier 2; experimental).\n";
+  file << "upscale_sparse=0\n\n";
   file << "# Internal: first-run upscale prompt already shown (do not edit).\n";
   file << "upscale_setup_completed=0\n\n";
   file << "# Dump textures to /dump/ (hash filenames). Disables upscale while "
@@ -279,10 +305,50 @@ bool Settings::SaveDefault(const std::string &filename) {
   file << "mod_loader_enabled=1\n\n";
   file << "# Load replacement textures from mods/textures (by hash).\n";
   file << "texture_replace_enabled=0\n\n";
+  file << "# Compile mods/textures into mods/textures.pack on next launch\n";
+  file << "# (resets to 0 once built).\n";
+  file << "# When the pack exists it is used instead of the loose files.\n";
+  file << "texture_pack_build=0\n\n";
+  file << "# Video memory budget for bind-time replacement textures, in MB.\n";
+  file << "# Least recently used replacements are released when over. 0 = "
+          "unlimited.\n";
+  file << "texture_replace_budget_mb=512\n\n";
+  file << "# Generate mipmaps for HD replacements that have none (smoother "
+          "when\n";
+  file << "# drawn smaller). Packs pick up a change on their next build.\n";
+  file << "texture_replace_mipmaps=1\n\n";
+  file << "# Filter for generated mipmaps: box (fast) or kaiser (sharper, "
+          "slower to\n";
+  file << "# generate). Packs pick up a change on their next build.\n";
+  file << "texture_replace_mip_filter=box\n\n";
+  file << "# Block-compress PNG replacements swapped in at bind time when\n";
+  file << "# loaded (0=off, 1=BC1/BC3, 2=BC7). Cached in "
+          "mods/textures.bccache.\n";
+  file << "texture_replace_compress=0\n\n";
+  file << "# Remember which replacements each room uses and load them in the\n";
+  file << "# background when the room is entered (mods/textures.rooms).\n";
+  file << "texture_replace_preload=1\n\n";
+  file << "# Upscale factor for atlas textures with region replacements\n";
+  file << "# (mods/textures/regions). Replacements must be 64x64 times this.\n";
+  file << "texture_region_scale=2\n\n";
   file << "# Play custom voice MP3s during dialog "
           "(mods/voices/<sceneId>/<dialog>-<page>-<speaker>.mp3).\n";
   file << "# 0 = off, 1 = on\n";
-  file << "voices_enabled=0\n";
+  file << "voices_enabled=0\n\n";
+
+  // --- Diagnostics ---
+  file << "# ============================================\n";
+  file << "#   Diagnostics\n";
+  file << "# ============================================\n\n";
+  file << "# Record hooked D3D11 calls to crossfix.trace for this many "
+          "frames.\n";
+  file << "trace_record=0\n";
+  file << "trace_record_frames=600\n\n";
+  file << "# Time CrossFix's hooks and frames, appended to "
+          "crossfix_profile.csv\n";
+  file << "# every profile_dump_frames frames.\n";
+  file << "profile_hooks=0\n";
+  file << "profile_dump_frames=600\n";
 
   file.close();
   return true;
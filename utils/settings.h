@@ -9,6 +9,7 @@ public:
   Settings();
   bool Load(const std::string &filename);
   int GetInt(const std::string &key, int defaultValue = 0) const;
+  float GetFloat(const std::string &key, float defaultValue = 0.0f) const;
   bool GetBool(const std::string &key, bool defaultValue = false) const;
   std::string GetString(const std::string &key,
                         const std::string &defaultValue = "") const;
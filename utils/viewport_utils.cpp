@@ -4,24 +4,22 @@
 #include "viewport_utils.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
 
 namespace ViewportUtils {
-UINT CopyViewportsToBuffer(D3D11_VIEWPORT *outBuffer, UINT bufferSize,
-                           const D3D11_VIEWPORT *pViewports,
-                           UINT numViewports) {
-  if (!outBuffer || !pViewports || bufferSize == 0 || numViewports == 0) {
-    return 0;
-  }
-
-  UINT count = std::min(numViewports, bufferSize);
-  memcpy(outBuffer, pViewports, sizeof(D3D11_VIEWPORT) * count);
-  return count;
-}
-
+namespace {
 // Sentinel value: use -1 for any field to match any value (wildcard)
 constexpr float WILDCARD = -1.0f;
 
+// Width is matched tighter than the per-rule epsilon
+constexpr float WIDTH_EPSILON = 0.1f;
+
 // Viewport definition for matching and transforming specific UI elements
 struct ViewportDefinition {
   float baseX;     // Base X position for repositioning (normalized, <1280)
@@ -32,119 +30,279 @@ struct ViewportDefinition {
   float epsilon;   // Tolerance for matching
 };
 
-void ApplyViewportWidescreenFix(D3D11_VIEWPORT *viewports, UINT count,
-                                float widescreenRatio) {
-  if (!viewports || count == 0) {
-    return;
-  }
-
-  // Define viewport configurations to handle
-  // Add more entries here for different UI elements in the future
-  const ViewportDefinition definitions[] = {
-      // Format: { baseX, originalX, y, width, height, epsilon }
-
-      // Stamina bars - 1 person team
-      {716.0f, 1996.0f, 792.0f, 212.0f, 20.0f, 1.0f},
-
-      // Stamina bars - 2 person team
-      {588.0f, 1868.0f, 792.0f, 472.0f, 20.0f, 1.0f},
-
-      // Stamina bars - 3 person team
-      {460.0f, 1740.0f, 792.0f, 724.0f, 20.0f, 1.0f},
-
-      // Battle UI Menu
-      {112.0f, 1392.0f, 640.0f, 272.0f, 208.0f, 1.0f},
-
-      // Battle UI - Command Menu
-      {352.0f, 1632.0f, 672.0f, 32.0f, 144.0f, 1.0f},
-      {112.0f, 1392.0f, 672.0f, 32.0f, 144.0f, 1.0f},
-      {248.0f, 1528.0f, 816.0f, 104.0f, 32.0f, 1.0f},
-      {144.0f, 1424.0f, 816.0f, 104.0f, 32.0f, 1.0f},
-      {248.0f, 1528.0f, 640.0f, 104.0f, 32.0f, 1.0f},
-      {144.0f, 1424.0f, 640.0f, 104.0f, 32.0f, 1.0f},
-      {248.0f, 1528.0f, 672.0f, 104.0f, 144.0f, 1.0f},
-      {144.0f, 1424.0f, 672.0f, 104.0f, 144.0f, 1.0f},
-
-      // Menu Customise Selectors
-      {1108.0f, 2388.0f, 232.0f, 720.0f, 752.0f, 1.0f},
-
-      // Loading Bar
-      {896.0f, 2176.0f, 992.0f, WILDCARD, 32.0f, 1.0f},
-
-      // Character name legacy portrait screen
-      {64.0f, 1344.0, 0.0, 256.0f, 1792.0f, 1.0f},
-
-      // Menu item underlines
-      {1088.0f, 2368.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
-      {1088.0f, 2368.0f, 136.0f, 872.0f, 1500.0f, 1.0f},
-      {1088.0f, 2368.0f, 1260.0f, 500.0f, 376.0f, 1.0f},
-      {1576.0f, 1576.0f, 136.0f, 384.0f, 4.0f, 1.0f},
-      {1728.0f, 1728.0f, 136.0f, 232.0f, 4.0f, 1.0f},
-      {1196.0f, 1196.0f, 1260.0f, 392.0f, 184.0f, 1.0f},
-      {1488.0f, 1488.0f, 340.0f, 264.0f, 164.0f, 1.0f},
-      {1684.0f, 1684.0f, 504.0f, 32.0f, 4.0f, 1.0f},
-      {1616.0f, 1616.0f, 136.0f, 344.0f, 4.0f, 1.0f},
-
-      // Menu item underlines
-      {1160.0f, 1160.0f, 1384.0f, 388.0f, 120.0f, 1.0f},
-      {1116.0f, 1116.0f, 1384.0f, 440.0f, 180.0f, 1.0f},
-      {1088.0f, 1088.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
+const ViewportDefinition BUILTIN_DEFINITIONS[] = {
+    // Format: { baseX, originalX, y, width, height, epsilon }
+
+    // Stamina bars - 1 person team
+    {716.0f, 1996.0f, 792.0f, 212.0f, 20.0f, 1.0f},
+
+    // Stamina bars - 2 person team
+    {588.0f, 1868.0f, 792.0f, 472.0f, 20.0f, 1.0f},
+
+    // Stamina bars - 3 person team
+    {460.0f, 1740.0f, 792.0f, 724.0f, 20.0f, 1.0f},
+
+    // Battle UI Menu
+    {112.0f, 1392.0f, 640.0f, 272.0f, 208.0f, 1.0f},
+
+    // Battle UI - Command Menu
+    {352.0f, 1632.0f, 672.0f, 32.0f, 144.0f, 1.0f},
+    {112.0f, 1392.0f, 672.0f, 32.0f, 144.0f, 1.0f},
+    {248.0f, 1528.0f, 816.0f, 104.0f, 32.0f, 1.0f},
+    {144.0f, 1424.0f, 816.0f, 104.0f, 32.0f, 1.0f},
+    {248.0f, 1528.0f, 640.0f, 104.0f, 32.0f, 1.0f},
+    {144.0f, 1424.0f, 640.0f, 104.0f, 32.0f, 1.0f},
+    {248.0f, 1528.0f, 672.0f, 104.0f, 144.0f, 1.0f},
+    {144.0f, 1424.0f, 672.0f, 104.0f, 144.0f, 1.0f},
+
+    // Menu Customise Selectors
+    {1108.0f, 2388.0f, 232.0f, 720.0f, 752.0f, 1.0f},
+
+    // Loading Bar
+    {896.0f, 2176.0f, 992.0f, WILDCARD, 32.0f, 1.0f},
+
+    // Character name legacy portrait screen
+    {64.0f, 1344.0, 0.0, 256.0f, 1792.0f, 1.0f},
+
+    // Menu item underlines
+    {1088.0f, 2368.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
+    {1088.0f, 2368.0f, 136.0f, 872.0f, 1500.0f, 1.0f},
+    {1088.0f, 2368.0f, 1260.0f, 500.0f, 376.0f, 1.0f},
+    {1576.0f, 1576.0f, 136.0f, 384.0f, 4.0f, 1.0f},
+    {1728.0f, 1728.0f, 136.0f, 232.0f, 4.0f, 1.0f},
+    {1196.0f, 1196.0f, 1260.0f, 392.0f, 184.0f, 1.0f},
+    {1488.0f, 1488.0f, 340.0f, 264.0f, 164.0f, 1.0f},
+    {1684.0f, 1684.0f, 504.0f, 32.0f, 4.0f, 1.0f},
+    {1616.0f, 1616.0f, 136.0f, 344.0f, 4.0f, 1.0f},
+
+    // Menu item underlines
+    {1160.0f, 1160.0f, 1384.0f, 388.0f, 120.0f, 1.0f},
+    {1116.0f, 1116.0f, 1384.0f, 440.0f, 180.0f, 1.0f},
+    {1088.0f, 1088.0f, 1452.0f, 496.0f, 184.0f, 1.0f},
+
+    // Add more viewport definitions here as needed (or, without a rebuild,
+    // in mods/viewport_rules.txt):
+    // { BaseX, OriginalX, Y, Width, Height, Epsilon },
+};
 
-      // Add more viewport definitions here as needed:
-      // { BaseX, OriginalX, Y, Width, Height, Epsilon },
+// Definitions compiled by LoadViewportRules, in priority order. Rules
+// without wildcards are found through a sorted (cell, rule) list: width,
+// height and Y are quantized into cells at least twice the widest
+// tolerance, so each rule is listed under the few cells its tolerance
+// overlaps and a viewport only has to check the rules in its own cell.
+// Cells are looked up in a hash table of their ranges in that list, which
+// takes one probe where a binary search mispredicts its way down.
+// Wildcard rules can't be keyed and are checked for every viewport.
+struct CellRange {
+  uint64_t key;
+  uint32_t begin; // begin == end: empty slot
+  uint32_t end;
+};
 
-  };
+struct CompiledRules {
+  std::vector<ViewportDefinition> definitions;
+  std::vector<std::pair<uint64_t, uint32_t>> cells; // Sorted
+  std::vector<CellRange> table;                     // Power of two
+  int tableShift = 64;
+  std::vector<uint32_t> wildcards; // Ascending
+  float cellSize = 2.0f;
+};
+CompiledRules g_rules;
 
-  const int numDefinitions = sizeof(definitions) / sizeof(definitions[0]);
+int64_t CellOf(float value, float cellSize) {
+  return (int64_t)std::floor(value / cellSize);
+}
 
-  for (UINT i = 0; i < count; ++i) {
-    bool matched = false;
+// 21 bits per axis; wrapped values only add candidates, which are checked
+uint64_t CellKey(int64_t width, int64_t height, int64_t y) {
+  return ((uint64_t)(width & 0x1FFFFF) << 42) |
+         ((uint64_t)(height & 0x1FFFFF) << 21) | (uint64_t)(y & 0x1FFFFF);
+}
 
-    // Check against all defined viewport configurations
-    for (int d = 0; d < numDefinitions; d++) {
-      const ViewportDefinition &def = definitions[d];
+size_t TableSlot(uint64_t key, int shift) {
+  return shift >= 64 ? 0 : (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+}
 
-      // Check if viewport matches this definition
-      // Match on Width, Y, and Height (WILDCARD = -1 skips that field)
-      bool widthMatch =
-          (def.width < 0) || (std::abs(viewports[i].Width - def.width) < 0.1f);
-      bool yMatch = (def.y < 0) ||
-                    (std::abs(viewports[i].TopLeftY - def.y) < def.epsilon);
-      bool heightMatch =
-          (def.height < 0) ||
-          (std::abs(viewports[i].Height - def.height) < def.epsilon);
-      bool dimensionsMatch = widthMatch && yMatch && heightMatch;
+bool HasWildcard(const ViewportDefinition &def) {
+  return def.width < 0 || def.y < 0 || def.height < 0;
+}
 
-      if (!dimensionsMatch)
-        continue;
+bool Matches(const ViewportDefinition &def, float x, float y, float width,
+             float height) {
+  // Match on Width, Y, and Height (WILDCARD = -1 skips that field)
+  bool widthMatch =
+      (def.width < 0) || (std::abs(width - def.width) < WIDTH_EPSILON);
+  bool yMatch = (def.y < 0) || (std::abs(y - def.y) < def.epsilon);
+  bool heightMatch =
+      (def.height < 0) || (std::abs(height - def.height) < def.epsilon);
+  if (!widthMatch || !yMatch || !heightMatch)
+    return false;
+
+  // X can be either the baseX or, if set, the originalX
+  return std::abs(x - def.baseX) < def.epsilon ||
+         (def.originalX > 0.0f && std::abs(x - def.originalX) < def.epsilon);
+}
 
-      // Now check X coordinate - it can be either the baseX or originalX
-      float incomingX = viewports[i].TopLeftX;
-      bool xMatches = (std::abs(incomingX - def.baseX) < def.epsilon);
+void Compile(std::vector<ViewportDefinition> definitions) {
+  CompiledRules rules;
+  float widest = WIDTH_EPSILON;
+  for (const ViewportDefinition &def : definitions)
+    widest = std::max(widest, def.epsilon);
+  float cell = 2.0f * widest;
+  rules.cellSize = cell;
+
+  for (uint32_t i = 0; i < (uint32_t)definitions.size(); ++i) {
+    const ViewportDefinition &def = definitions[i];
+    if (HasWildcard(def)) {
+      rules.wildcards.push_back(i);
+      continue;
+    }
+    // Cells the matching range overlaps: at most two per axis
+    for (int64_t w = CellOf(def.width - WIDTH_EPSILON, cell);
+         w <= CellOf(def.width + WIDTH_EPSILON, cell); ++w)
+      for (int64_t h = CellOf(def.height - def.epsilon, cell);
+           h <= CellOf(def.height + def.epsilon, cell); ++h)
+        for (int64_t y = CellOf(def.y - def.epsilon, cell);
+             y <= CellOf(def.y + def.epsilon, cell); ++y)
+          rules.cells.push_back({CellKey(w, h, y), i});
+  }
+  std::sort(rules.cells.begin(), rules.cells.end());
+
+  // At most half full, so probes stay short
+  size_t slots = 1;
+  rules.tableShift = 64;
+  while (slots < rules.cells.size() * 2) {
+    slots *= 2;
+    rules.tableShift--;
+  }
+  rules.table.assign(slots, CellRange{0, 0, 0});
+  for (uint32_t begin = 0; begin < (uint32_t)rules.cells.size();) {
+    uint64_t key = rules.cells[begin].first;
+    uint32_t end = begin;
+    while (end < rules.cells.size() && rules.cells[end].first == key)
+      ++end;
+    size_t slot = TableSlot(key, rules.tableShift);
+    while (rules.table[slot].begin != rules.table[slot].end)
+      slot = (slot + 1) & (slots - 1);
+    rules.table[slot] = {key, begin, end};
+    begin = end;
+  }
+  rules.definitions.swap(definitions);
+  g_rules = std::move(rules);
+}
 
-      // If originalX is set (not -1), also check against that
-      if (!xMatches && def.originalX > 0.0f) {
-        xMatches = (std::abs(incomingX - def.originalX) < def.epsilon);
-      }
+// First rule, in priority order, matching the viewport
+const ViewportDefinition *FindRule(float x, float y, float width,
+                                   float height) {
+  float size = g_rules.cellSize;
+  uint64_t key = CellKey(CellOf(width, size), CellOf(height, size),
+                         CellOf(y, size));
+  uint32_t cell = 0, cellEnd = 0;
+  size_t mask = g_rules.table.size() - 1;
+  for (size_t slot = TableSlot(key, g_rules.tableShift);;
+       slot = (slot + 1) & mask) {
+    const CellRange &range = g_rules.table[slot];
+    if (range.begin == range.end)
+      break;
+    if (range.key == key) {
+      cell = range.begin;
+      cellEnd = range.end;
+      break;
+    }
+  }
+  auto wildcard = g_rules.wildcards.begin();
+
+  // Merge the cell's rules with the wildcard rules by index
+  for (;;) {
+    bool inCell = cell != cellEnd;
+    bool inWildcards = wildcard != g_rules.wildcards.end();
+    uint32_t index;
+    if (inCell && (!inWildcards || g_rules.cells[cell].second < *wildcard))
+      index = g_rules.cells[cell++].second;
+    else if (inWildcards)
+      index = *wildcard++;
+    else
+      return nullptr;
+    if (Matches(g_rules.definitions[index], x, y, width, height))
+      return &g_rules.definitions[index];
+  }
+}
 
-      bool isMatch = dimensionsMatch && xMatches;
+// "*" is a wildcard; originalX also accepts "-" for none
+bool ParseRuleField(const std::string &token, float *out) {
+  if (token == "*" || token == "-") {
+    *out = WILDCARD;
+    return true;
+  }
+  try {
+    size_t used = 0;
+    *out = std::stof(token, &used);
+    return used == token.size();
+  } catch (...) {
+    return false;
+  }
+}
+} // namespace
+
+size_t LoadViewportRules(const std::string &rulesPath) {
+  std::vector<ViewportDefinition> definitions;
+
+  std::ifstream file(rulesPath);
+  std::string line;
+  int lineNumber = 0;
+  while (file && std::getline(file, line)) {
+    lineNumber++;
+    size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.resize(comment);
+    std::istringstream fields(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (fields >> token)
+      tokens.push_back(token);
+    if (tokens.empty())
+      continue;
+
+    // baseX originalX y width height [epsilon]
+    ViewportDefinition def = {0.0f, WILDCARD, WILDCARD,
+                              WILDCARD, WILDCARD, 1.0f};
+    float *targets[] = {&def.baseX,  &def.originalX, &def.y,
+                        &def.width,  &def.height,    &def.epsilon};
+    bool valid = tokens.size() == 5 || tokens.size() == 6;
+    for (size_t i = 0; valid && i < tokens.size(); ++i)
+      valid = ParseRuleField(tokens[i], targets[i]);
+    valid = valid && def.baseX >= 0.0f && def.epsilon > 0.0f;
+    if (!valid) {
+      std::cout << "[Mod] Warning: ignoring viewport rule on line "
+                << lineNumber << " of " << rulesPath << std::endl;
+      continue;
+    }
+    definitions.push_back(def);
+  }
+  size_t loaded = definitions.size();
 
-      if (isMatch) {
-        matched = true;
+  // File rules first, so they can also override a built-in one
+  definitions.insert(definitions.end(), std::begin(BUILTIN_DEFINITIONS),
+                     std::end(BUILTIN_DEFINITIONS));
+  Compile(std::move(definitions));
+  return loaded;
+}
 
-        // Store original X before width scaling
-        float originalX = viewports[i].TopLeftX;
+bool WidenUIViewport(float *x, float y, float *width, float height,
+                     float widescreenRatio) {
+  const ViewportDefinition *def = FindRule(*x, y, *width, height);
+  if (!def)
+    return false;
 
-        // Apply width scaling
-        viewports[i].Width *= widescreenRatio;
+  // Store original X before width scaling
+  float originalX = *x;
 
-        // Calculate repositioned X based on base position
-        float xOffset = originalX - def.baseX;
-        viewports[i].TopLeftX = (def.baseX * widescreenRatio) + xOffset;
+  // Apply width scaling
+  *width *= widescreenRatio;
 
-        break;
-      }
-    }
-  }
+  // Calculate repositioned X based on base position
+  float xOffset = originalX - def->baseX;
+  *x = (def->baseX * widescreenRatio) + xOffset;
+  return true;
 }
 } // namespace ViewportUtils
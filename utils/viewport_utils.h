@@ -1,16 +1,57 @@
 // Viewport Utilities - Shared viewport manipulation logic
 #pragma once
 
-#include <d3d11.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
 
+// Viewports are any type with the fields of D3D11_VIEWPORT, so the rules
+// also run off Windows in the trace replayer (tests/trace_replay.cpp)
 namespace ViewportUtils {
 // Copy viewports to a stack-allocated buffer with bounds checking
 // Returns the actual count of viewports copied
-UINT CopyViewportsToBuffer(D3D11_VIEWPORT *outBuffer, UINT bufferSize,
-                           const D3D11_VIEWPORT *pViewports, UINT numViewports);
+template <typename Viewport>
+uint32_t CopyViewportsToBuffer(Viewport *outBuffer, uint32_t bufferSize,
+                               const Viewport *pViewports,
+                               uint32_t numViewports) {
+  if (!outBuffer || !pViewports || bufferSize == 0 || numViewports == 0) {
+    return 0;
+  }
+
+  uint32_t count = (std::min)(numViewports, bufferSize);
+  memcpy(outBuffer, pViewports, sizeof(Viewport) * count);
+  return count;
+}
+
+// Compile the UI viewport definitions: those in rulesPath, if it exists,
+// then the built-in ones. Lines are "baseX originalX y width height
+// [epsilon]" with "*" for any value and "#" comments. Call before the
+// viewport hook is installed. Returns the number of rules read from the file.
+size_t LoadViewportRules(const std::string &rulesPath);
+
+// Widen one viewport (TopLeftX, TopLeftY, Width, Height) if it matches a UI
+// element definition. Returns false if none matches.
+bool WidenUIViewport(float *x, float y, float *width, float height,
+                     float widescreenRatio);
+
+// Ratios from here up are 4:3 (with tolerance for float precision)
+constexpr float WIDESCREEN_RATIO_THRESHOLD = 0.99f;
 
 // Apply viewport widescreen fix to UI viewports
 // Modifies viewports in-place based on known UI element viewport definitions
-void ApplyViewportWidescreenFix(D3D11_VIEWPORT *viewports, UINT count,
-                                float widescreenRatio);
+// when widescreenRatio (< 1.0 for widescreen, e.g. 0.75 for 16:9) is one
+template <typename Viewport>
+void ApplyViewportWidescreenFix(Viewport *viewports, uint32_t count,
+                                float widescreenRatio) {
+  if (!viewports || count == 0 ||
+      widescreenRatio >= WIDESCREEN_RATIO_THRESHOLD) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < count; ++i)
+    WidenUIViewport(&viewports[i].TopLeftX, viewports[i].TopLeftY,
+                    &viewports[i].Width, viewports[i].Height,
+                    widescreenRatio);
+}
 } // namespace ViewportUtils
@@ -0,0 +1,102 @@
+#include "worker_pool.h"
+
+namespace {
+// Leave most of the CPU to the game's own threads
+constexpr UINT MAX_WORKERS = 3;
+
+struct ParallelJob {
+  ParallelForFn fn;
+  void *context;
+  size_t count;
+  volatile LONG next;
+  volatile LONG pending; // Workers still running this job
+};
+
+ParallelJob g_job = {};
+HANDLE g_wakeSemaphore = nullptr;
+HANDLE g_doneEvent = nullptr;
+UINT g_workerCount = 0;
+UINT g_workerLimit = MAX_WORKERS;
+volatile LONG g_poolState = 0; // 0 = not started, 1 = starting, 2 = ready
+CRITICAL_SECTION g_jobCS;
+
+void RunItems(ParallelJob *job) {
+  for (;;) {
+    size_t i = (size_t)(InterlockedIncrement(&job->next) - 1);
+    if (i >= job->count)
+      return;
+    job->fn(job->context, i);
+  }
+}
+
+DWORD WINAPI WorkerThread(LPVOID) {
+  for (;;) {
+    WaitForSingleObject(g_wakeSemaphore, INFINITE);
+    RunItems(&g_job);
+    if (InterlockedDecrement(&g_job.pending) == 0)
+      SetEvent(g_doneEvent);
+  }
+}
+
+// First caller starts the threads; everyone else runs inline until ready
+bool EnsurePool() {
+  if (g_poolState == 2)
+    return true;
+  if (InterlockedCompareExchange(&g_poolState, 1, 0) != 0)
+    return false;
+
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  UINT workers = si.dwNumberOfProcessors > 1 ? si.dwNumberOfProcessors - 1 : 0;
+  if (workers > MAX_WORKERS)
+    workers = MAX_WORKERS;
+
+  InitializeCriticalSection(&g_jobCS);
+  g_wakeSemaphore = CreateSemaphoreA(nullptr, 0, MAX_WORKERS, nullptr);
+  g_doneEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+  if (!g_wakeSemaphore || !g_doneEvent)
+    workers = 0;
+
+  for (UINT i = 0; i < workers; ++i) {
+    HANDLE thread =
+        CreateThread(nullptr, 0, WorkerThread, nullptr, 0, nullptr);
+    if (!thread)
+      break;
+    CloseHandle(thread);
+    g_workerCount++;
+  }
+
+  InterlockedExchange(&g_poolState, 2);
+  return true;
+}
+} // namespace
+
+void ParallelFor(size_t count, ParallelForFn fn, void *context) {
+  if (count == 0)
+    return;
+  if (count == 1 || !EnsurePool() || g_workerCount == 0 ||
+      g_workerLimit == 0 || !TryEnterCriticalSection(&g_jobCS)) {
+    for (size_t i = 0; i < count; ++i)
+      fn(context, i);
+    return;
+  }
+
+  UINT workers = g_workerCount < g_workerLimit ? g_workerCount : g_workerLimit;
+  if (count - 1 < workers)
+    workers = (UINT)(count - 1);
+  g_job.fn = fn;
+  g_job.context = context;
+  g_job.count = count;
+  g_job.next = 0;
+  g_job.pending = (LONG)workers;
+  ResetEvent(g_doneEvent);
+  ReleaseSemaphore(g_wakeSemaphore, (LONG)workers, nullptr);
+
+  RunItems(&g_job);
+  WaitForSingleObject(g_doneEvent, INFINITE);
+  LeaveCriticalSection(&g_jobCS);
+}
+
+UINT GetWorkerCount() { return g_workerCount; }
+
+void SetWorkerLimit(UINT limit) { g_workerLimit = limit; }
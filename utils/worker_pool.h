@@ -0,0 +1,22 @@
+// Worker Pool - persistent threads for splitting CPU-heavy loops across cores
+#pragma once
+
+#include <Windows.h>
+#include <cstddef>
+
+// Work item callback. Items are claimed dynamically by whichever thread is
+// free, so each item must write its own result slot; combine them in index
+// order afterwards to keep results independent of thread count.
+typedef void (*ParallelForFn)(void *context, size_t index);
+
+// Run fn(context, i) for every i in [0, count) on the pool and the calling
+// thread; returns once all items are done. Runs inline on single-core
+// systems, for single items, or while another thread is using the pool.
+void ParallelFor(size_t count, ParallelForFn fn, void *context);
+
+// Worker threads besides the caller (0 until the pool first starts)
+UINT GetWorkerCount();
+
+// Use at most limit workers for later jobs (0 runs them inline), so the
+// benchmarks can compare thread counts. The pool itself keeps its threads.
+void SetWorkerLimit(UINT limit);